@@ -0,0 +1,42 @@
+// FW21Cache.cpp : writes the binary columnar companion (.fw21b) of a FW21 file.
+//
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "fw21binary.h"
+
+using namespace std;
+
+void Usage()
+{
+    cout << "FW21Cache converts a FW21 fire weather data file to a binary FW21 file (.fw21b)\n";
+    cout << "that NFDRS4_cli and CFW21Data load in place of the FW21 file without parsing it\n";
+    cout << "FW21Cache expects three or four parameters:\n";
+    cout << "FW21Cache FW21file UTCoffset FW21Bfile [needMxFields]\n";
+    cout << "\twhere\n\tFW21file is the complete path to the input FW21 file to be converted\n";
+    cout << "\tUTCoffset is the integer offset from UTC time applied to Zulu times, as NFDRS4_cli's TimeZoneOffsetHours\n";
+    cout << "\tFW21Bfile is the complete path to the binary FW21 file to be produced\n";
+    cout << "\tneedMxFields, if 1, also stores the fuel moisture, GSI and KBDI fields (for useStoredOutputs runs)\n";
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4)
+    {
+        Usage();
+        exit(1);
+    }
+    int tzOffset = atoi(argv[2]);
+    bool needMxFields = argc > 4 && atoi(argv[4]) != 0;
+    int status = CFW21BinaryFile::Write(argv[1], argv[3], tzOffset, needMxFields);
+    if (status != 0)
+    {
+        cout << "Error converting " << argv[1] << " to " << argv[3] << "\n";
+        return status;
+    }
+    CFW21BinaryFile binary;
+    if (binary.Open(argv[3]) == 0)
+        cout << "Wrote " << binary.GetHeader()->numRecs << " records for " << binary.GetNumStations() << " station(s) to " << argv[3] << "\n";
+    return 0;
+}
@@ -3,515 +3,330 @@
 
 #include <iostream>
 #include <fstream>
-#include <deque>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "fw21.h"
 #include "csv_readrow.h"
 #include "utctime.h"
+#include "fw13.h"
 #include <vector>
-#include <numeric>
-#include <cmath>
 #include <cstring>
 
 using namespace std;
 using namespace utctime;
 
-const string errStrings[] =
-{
-	"Blank station id",
-	"Invalid date",
-	"Unrecognized Region ID",
-	"Unrecognized Unit ID",
-	"Unrecognized Unit ID (District)",
-	"Invalid Hour in RAWS record",
-	"Invalid Minutes in RAWS record.",
-	"-9999 found in record",
-	"Change in Precipitation Measurement code mid stream",
-	"Invalid or missing Precipitation Measurement Code",
-	"Solar radiation out of range",
-	"Missing solar radiation",
-	"Bad Gust Speed or Gust Azimuth"
-};
-
 void Usage()
 {
     cout << "FireWxConverter converts FW13 fire weather data files to FW21 fire weather data files\n";
-    cout << "FireWxConverter expects three parameters:\n";
     cout << "FireWxConverter FW13file UTCoffset FW21file\n";
     cout << "\twhere\n\tFW13file is the complete path to the input FW13 file to be converted\n";
     cout << "\tUTCoffest is the integer offset from UTC time for the location the FW13 file represents\n";
     cout << "\tFW21file is the complete path to the input FW21 file to be produced\n";
+    cout << "FireWxConverter [options] FW13file [FW13file ...]\n";
+    cout << "\tconverts many FW13 files in parallel, writing output in input order\n";
+    cout << "\t-o dir\t\twrite one FW21 file per station, dir/STATION.fw21\n";
+    cout << "\t-m FW21file\twrite all stations to one merged FW21 file\n";
+    cout << "\t-z UTCoffset\tUTC offset of the input files (default 0)\n";
+    cout << "\t-l listFile\tread input files from listFile, one \"FW13file [UTCoffset]\" per line\n";
+    cout << "\t-t threads\tnumber of decoding threads (default: all cores)\n";
 }
 
-//RH conversion utility routines
-double satvap(double t)
+//------------------------------------------------------------------------------
+/*! \struct ConvertJob
+    \brief One input file, decoded on a worker thread and written by the main thread.
+ */
+struct ConvertJob
+{
+    string fileName;
+    int tzOffset = 0;
+    int status = 0;
+    bool done = false;
+    unique_ptr<CFW13Decoder> decoder;
+};
 
-{//return saturationvapor pressure, baset on temperature t(degrees K)
-	if (t != 35.86)
-		return exp(1.81 + (t * 17.27 - 4717.31) / (t - 35.86));
-	else
-		return 0.0;
-}
+//------------------------------------------------------------------------------
+/*! \class CFW21Output
+    \brief Receives the decoded stations in input order and writes them either to
+    one merged FW21 file or to one file per station.
 
-double fTok(double f)
+    Records that are not after the station's previous record are rejected with
+    the messages CFW21Data::AddRecord() gives.
+ */
+class CFW21Output
 {
-	//convert fahrenheit to kelvin
-	return (f - 32.0) / 1.8 + 273.16;
-}
+public:
+    CFW21Output(const string& mergedFile, const string& stationDir)
+        : m_mergedFile(mergedFile), m_stationDir(stationDir), m_numRecords(0), m_writeErrors(0) {}
 
+    bool Open()
+    {
+        return m_mergedFile.empty() || m_merged.Open(m_mergedFile.c_str()) == 1;
+    }
+    void Write(vector<FW13StationRecords>& stations, int tzOffset)
+    {
+        for (auto& sta : stations)
+        {
+            CFW21Writer stationWriter;
+            CFW21Writer& writer = m_stationDir.empty() ? m_merged : stationWriter;
+            if (!m_stationDir.empty())
+            {
+                //each station file is truncated the first time it is seen in this run
+                string path = m_stationDir + "/" + sta.station + ".fw21";
+                bool seen = m_lastTimes.find(sta.station) != m_lastTimes.end();
+                if (stationWriter.Open(path.c_str(), seen) != 1)
+                {
+                    printf("Error opening %s for output\n", path.c_str());
+                    m_writeErrors++;
+                    continue;
+                }
+            }
+            for (auto& rec : sta.records)
+            {
+                //same order as the UTC times, without converting every record
+                long long recUtc = ((((long long)rec.GetYear() * 13 + rec.GetMonth()) * 32 + rec.GetDay()) * 24 + rec.GetHour()) * 61 + rec.GetMinutes();
+                auto last = m_lastTimes.find(sta.station);
+                if (last != m_lastTimes.end() && recUtc <= last->second)
+                {
+                    cout << "Error, rectime is <= last record time\n";
+                    cout << "Error adding record to FW21Data, " << rec.GetStation() << ", " << rec.GetYear() << "/" << rec.GetMonth() << "/" << rec.GetDay() << " : " << rec.GetHour() << "\n";
+                    continue;
+                }
+                m_lastTimes[sta.station] = recUtc;
+                if (!writer.WriteRecord(rec, tzOffset))
+                    m_writeErrors++;
+                m_numRecords++;
+            }
+            if (!m_stationDir.empty() && !stationWriter.Close())
+                m_writeErrors++;
+        }
+    }
+    bool Close()
+    {
+        if (!m_merged.Close())
+            m_writeErrors++;
+        return m_writeErrors == 0;
+    }
+    size_t GetNumRecords() const { return m_numRecords; }
+    size_t GetNumStations() const { return m_lastTimes.size(); }
+
+private:
+    string m_mergedFile;
+    string m_stationDir;
+    CFW21Writer m_merged;
+    map<string, long long> m_lastTimes;
+    size_t m_numRecords;
+    int m_writeErrors;
+};
 
-int rhFromWb(double td, double tw, double pp)
+static bool IsInteger(const char* s)
 {
-	double corr = (0.00066 * (1.0 + (0.00115 * (tw - 273.16))) * pp * (td - tw));
-	double val = max(1.0, min(100.0, ((satvap(tw) - corr) / satvap(td)) * 100.0));
-	double rem = val - floor(val);
-	int ret = (int)floor(val);
-	return ret + ((rem >= 0.5) ? 1 : 0);
+    char* end;
+    strtol(s, &end, 10);
+    return end != s && *end == 0;
 }
 
-int rhFromDp(double dry, double dew)
-{
-	double val = 100.0 * (exp(-7482.6 / (dew + 398.36) + 15.674)
-		/ exp(-7482.6 / (dry + 398.36) + 15.674));
-	double rem = val - floor(val);
-	int ret = (int)floor(val);
-	return ret + ((rem >= 0.5) ? 1 : 0);
-}
+//------------------------------------------------------------------------------
+/*! \brief Decodes the jobs on numThreads threads and writes them in input order.
 
-int RH(int RHType, int in, int db)
+    At most window files are decoded ahead of the one being written, which
+    bounds the memory held by decoded records.
+    \param[out] bytesRead Size of the input files.
+    \return Number of FW13 errors, or -1 if an input file could not be read.
+ */
+static int ConvertFiles(vector<ConvertJob>& jobs, CFW21Output& output, unsigned numThreads, bool verbose, size_t& bytesRead)
 {
-	int ret;
-	switch (RHType)
-	{
-	case 1://wet bulb
-		ret = rhFromWb(fTok(db), fTok((double)in), 900.0);//station press not corrected for elevation
-		break;
-	case 3:
-		ret = rhFromDp((double)db, (double)in);
-		break;
-	default:
-		ret = in;
-	}
-	return ret;
+    const size_t window = numThreads * 4;
+    mutex lock;
+    condition_variable cv;
+    size_t written = 0;
+    atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            size_t j = next++;
+            if (j >= jobs.size())
+                return;
+            {
+                unique_lock<mutex> guard(lock);
+                cv.wait(guard, [&]() { return j < written + window; });
+            }
+            unique_ptr<CFW13Decoder> decoder(new CFW13Decoder());
+            int status = decoder->DecodeFile(jobs[j].fileName);
+            {
+                lock_guard<mutex> guard(lock);
+                jobs[j].decoder = std::move(decoder);
+                jobs[j].status = status;
+                jobs[j].done = true;
+            }
+            cv.notify_all();
+        }
+    };
+    vector<thread> threads;
+    for (unsigned t = 0; t < numThreads; t++)
+        threads.emplace_back(worker);
+
+    int errors = 0;
+    bool readFailed = false;
+    bytesRead = 0;
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        unique_ptr<CFW13Decoder> decoder;
+        {
+            unique_lock<mutex> guard(lock);
+            cv.wait(guard, [&]() { return jobs[j].done; });
+            decoder = std::move(jobs[j].decoder);
+        }
+        if (jobs[j].status != 1)
+        {
+            cout << "Error opening " << jobs[j].fileName << " as input FW13 file\n";
+            readFailed = true;
+        }
+        else
+        {
+            if (verbose)
+                printf("%s: %zu records, %zu stations, %d errors\n", jobs[j].fileName.c_str(),
+                    decoder->GetNumRecords(), decoder->GetStations().size(), decoder->GetErrors());
+            cout << decoder->GetMessages();
+            output.Write(decoder->GetStations(), jobs[j].tzOffset);
+            errors += decoder->GetErrors();
+            bytesRead += decoder->GetBytesRead();
+        }
+        decoder.reset();
+        {
+            lock_guard<mutex> guard(lock);
+            written++;
+        }
+        cv.notify_all();
+    }
+    for (auto& t : threads)
+        t.join();
+    return readFailed ? -1 : errors;
 }
 
-
 int main(int argc, char* argv[])
 {
-    if (argc < 4)
+    if (argc < 2)
     {
         Usage();
         exit(1);
     }
-    string inFileName, outFileName;
-    inFileName = argv[1];
-    outFileName = argv[3];
-    int tzOffset = atoi(argv[2]);
-	//for hourly precip tracking...
-	UTCTime lastTime;
-	time_t hoursDiff = utctime::get_hour_diff();
-	std::deque<double> prev23;
-	for (int i = 0; i < 23; i++)
-		prev23.push_back(0.0);
-
-    int encType = 0;
-	int prevPcpCode = -1, pcpCode = -1, errors = 0 , m, d, y;
-    char buf[161], temp[16];
-    wchar_t bufw[161];
-    string sta, oldStationID, seekStr;
-	vector<string> staList;
-    ifstream in;
-    in.open(inFileName);
-    if (!in.is_open())
+    //FireWxConverter FW13file UTCoffset FW21file
+    if (argc == 4 && argv[1][0] != '-' && IsInteger(argv[2]))
     {
-        cout << "Error opening " << inFileName << " as input FW13 file\n";
+        string outFileName = argv[3];
+        vector<ConvertJob> jobs(1);
+        jobs[0].fileName = argv[1];
+        jobs[0].tzOffset = atoi(argv[2]);
+        if (!ifstream(jobs[0].fileName).is_open())
+        {
+            cout << "Error opening " << jobs[0].fileName << " as input FW13 file\n";
+            return -1;
+        }
+        CFW21Output output(outFileName, "");
+        size_t bytesRead;
+        if (!output.Open())
+        {
+            cout << "Error writing " << outFileName << "\n";
+            return -1;
+        }
+        if (ConvertFiles(jobs, output, 1, false, bytesRead) < 0)
+            return -1;
+        if (output.Close())
+        {
+            cout << "Successfully wrote " << outFileName << "\n";
+            return 0;
+        }
+        cout << "Error writing " << outFileName << "\n";
         return -1;
     }
-    // first check to see if we've got ASCII
 
-    in.read((char*)(&bufw), 152);
-
-    if (bufw[0] > 256)
-        encType = 0;   // ASCII
-    else
-        encType = 1;   // UTF-16
-    in.close();
-
-    in.open(inFileName, ios_base::in | ios_base::binary);   // re-open
-
-	vector<FW21Record> vRecs;
-        //need to know precipitation code
-    while (!in.eof() && pcpCode < 0)
+    string mergedFile, stationDir;
+    int tzOffset = 0;
+    unsigned numThreads = max(1u, thread::hardware_concurrency());
+    vector<ConvertJob> jobs;
+    vector<string> listFiles;
+    for (int a = 1; a < argc; a++)
     {
-        if (encType == 0)
-        {   // Ascii / UTF-8
-            in.getline(buf, 1024);
+        string arg = argv[a];
+        bool hasValue = a + 1 < argc;
+        if (arg == "-o" && hasValue)
+            stationDir = argv[++a];
+        else if (arg == "-m" && hasValue)
+            mergedFile = argv[++a];
+        else if (arg == "-z" && hasValue)
+            tzOffset = atoi(argv[++a]);
+        else if (arg == "-t" && hasValue)
+            numThreads = max(1, atoi(argv[++a]));
+        else if (arg == "-l" && hasValue)
+            listFiles.push_back(argv[++a]);
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            Usage();
+            exit(1);
         }
         else
-        {   // UTF-16
-            in.read((char*)(&bufw), 152);
-            for (int i = 0; i < 75; i++)
-                buf[i] = (char)bufw[i + 2];
+        {
+            jobs.push_back(ConvertJob());
+            jobs.back().fileName = arg;
         }
-        if (strlen(buf) > 63)
+    }
+    for (auto& job : jobs)
+        job.tzOffset = tzOffset;
+    for (auto& listFile : listFiles)
+    {
+        ifstream list(listFile);
+        if (!list.is_open())
         {
-            if (buf[0] != 'W')
-            {
+            printf("Error opening list file %s\n", listFile.c_str());
+            return -1;
+        }
+        string line;
+        while (getline(list, line))
+        {
+            istringstream fields(line);
+            string fileName;
+            if (!(fields >> fileName) || fileName[0] == '#')
                 continue;
-            }
-            strncpy(temp, &buf[62], 1);
-            temp[1] = 0;
-            //1 = running 24 inches, 2 = running 24 mm, 3 = hourly inches, 4 = hourly mm
-            pcpCode = atoi(temp);
-            if (pcpCode < 1 || pcpCode > 4)
-                pcpCode = -1;
+            jobs.push_back(ConvertJob());
+            jobs.back().fileName = fileName;
+            if (!(fields >> jobs.back().tzOffset))
+                jobs.back().tzOffset = tzOffset;
         }
     }
-    if (pcpCode > 0)
-        prevPcpCode = pcpCode;
-    else
+    if (jobs.empty() || mergedFile.empty() == stationDir.empty())
     {
-       cout << "\tError: Can not determine precipitation code (column 63)\n";
-        errors++;
+        printf("Specify input files and one of -o or -m\n");
+        Usage();
+        exit(1);
     }
-    in.seekg(0, in.beg);
-    long recNo = 0, lineNo = 0, nonwx = 0, raws = 0, fcast = 0, daily = 0, other = 0, rejects = 0;
-	bool isRaws, isNFDRS;
-	while (!in.eof())
-	{
-		recNo++;
-
-		if (encType == 0)
-		{   // Ascii / UTF-8
-			in.getline(buf, 1024);
-		}
-		else
-		{   // UTF-16
-			in.read((char*)(&bufw), 152);
-			for (int i = 0; i < 75; i++)
-				buf[i] = (char)bufw[i + 2];
-		}
-
-		if (in.eof())
-			break;
-		int rtype = 0;
-		lineNo++;
-		isRaws = isNFDRS = false;
-		//check buffer for NODATA since IBM can't understand fixed width fields....
-		//NODATA is -9999 slammed anywhere into the record
-		if (strstr(buf, "-9999") != NULL)
-		{
-			cout << "\tError: Line Number " << lineNo <<", " << errStrings[7] << "\n";
-			errors++;
-			continue;
-		}
-		//check record type
-		if (buf[0] != 'W')
-		{
-			nonwx++;
-			continue;
-		}
+    numThreads = (unsigned)min((size_t)numThreads, jobs.size());
 
-		if (buf[1] == '1' && buf[2] == '3')
-			rtype = 13;
-		// FW13
-		else if (buf[1] == '9' && buf[2] == '8')
-			rtype = 9;
-		// FW9
-		else
-		{
-			nonwx++;
-			continue;
-		}
-		switch (buf[21])
-		{
-		case 'R':
-			isRaws = true;
-			raws++;
-			break;
-		case 'F':
-			fcast++;
-			break;
-		case 'O':
-			isNFDRS = true;
-			daily++;
-			break;
-		default:
-			other++;
-		}
-		if (!isNFDRS && !isRaws)
-			continue;
-		strncpy(temp, &buf[3], 6);
-		temp[6] = 0;
-		string sta = temp;
-		sta = trim(sta);
-		if (sta.length() == 0)//stationID can not be blank!!!!!!
-		{
-			cout << "\tError: Line Number " << lineNo << ", " << errStrings[0] << "\n";
-			errors++;
-			continue;
-		}
-		//string tempSta = sta;// .TrimLeft();
-		//if (tempSta.length() == 5)
-		//{
-			//sta = "0" + tempSta;
-		//}
-		strncpy(temp, &buf[9], 4);
-		temp[4] = 0;
-		y = atoi(temp);
-		strncpy(temp, &buf[13], 2);
-		temp[2] = 0;
-		m = atoi(temp);
-		strncpy(temp, &buf[15], 2);
-		temp[2] = 0;
-		d = atoi(temp);
-		UTCTime y2kCheck(y, m, d, 0, 0, 0);
-		if (y2kCheck.timestamp() == 0 || y < 1900)
-		{
-			cout << "\tError: Line Number " << lineNo << ", " << errStrings[1] << ": "<< m << "/" << d << "/" << y << "\n";
-			rejects++;
-			errors++;
-			continue;
-		}
-		if (staList.empty())
-			staList.push_back(sta);
-		else
-		{
-			if (std::find(staList.begin(), staList.end(), sta) == staList.end())
-			{
-				staList.push_back(sta);
-				//cout << "\tError: Multpile stations encountered, line number " << lineNo << ", ignoring record for " << sta << "\n";
-				//continue;
-			}
-		}
-
-			strncpy(temp, &buf[17], 2);
-		temp[2] = 0;
-		int hr = atoi(temp);
-		if (hr >= 24 || hr < 0)
-		{
-			cout << "\tError: Line Number " << lineNo << ", " << errStrings[5] << " : " << hr << "\n";
-			errors++;
-			continue;
-		}
-
-		strncpy(temp, &buf[19], 2);
-		temp[2] = 0;
-		int mn = atoi(temp);
-		if (mn > 60 || mn < 0)
-		{
-			cout << "\tError: Line Number " << lineNo << ", " << errStrings[6] << " : " << mn << "\n";
-			errors++;
-			continue;
-		}
-
-		UTCTime thisTime(y, m, d, hr, mn, 0);
-		FW21Record rec;
-		rec.SetStation(sta);
-		rec.SetDateTime(thisTime.get_tm());
-		strncpy(temp, &buf[23], 3);
-		temp[3] = 0;
-		int db;
-		if (strncmp(temp, "   ", 3) != 0)
-		{
-			db = atoi(temp);
-			rec.SetTemp(db);
-		}
-		else
-		{
-			cout << "\tError: Line Number " << lineNo << ", temperature is blank\n";
-			errors++;
-			continue;
-		}
-		char t[2];
-		t[0] = buf[61];
-		t[1] = 0;
-		strncpy(temp, &buf[26], 3);
-		temp[3] = 0;
-		if (strncmp(temp, "   ", 3) != 0)
-		{
-			rec.SetRH(max(1, RH(atoi(t), atoi(temp), db)));
-		}
-		else
-		{
-			cout << "\tError: Line Number " << lineNo << ", RH is invalid\n";
-			errors++;
-			continue;
-		}
-
-		//****************WIND SPEED AND DIRECTION *****************
-		strncpy(temp, &buf[29], 3);
-		temp[3] = 0;
-		int tdir = -1, tws = -1;
-		if (strncmp(temp, "   ", 3) != 0)
-			tdir = atoi(temp);
-		strncpy(temp, &buf[32], 3);
-		temp[3] = 0;
-		if (strncmp(temp, "   ", 3) != 0)
-			tws = atoi(temp);
-		if (tws >= 0 && tdir >= 0 && tdir <= 360)
-		{
-			rec.SetWindAzimuth(tdir);
-			rec.SetWindSpeed(tws);
-		}
-		//NEED TO CHECK PRECIP MEASUREMENT TYPE CODE
-		strncpy(temp, &buf[62], 1);
-		temp[1] = 0;
-		//1 = running 24 inches, 2 = running 24 mm, 3 = hourly inches, 4 = hourly mm
-		pcpCode = atoi(temp);
-		if (prevPcpCode <= 0)
-			prevPcpCode = pcpCode;
-		if (prevPcpCode != pcpCode)
-		{
-			//this is an error that never should happen
-			cout << "\tError: Line Number " << lineNo << ", " << errStrings[8] << " : " << pcpCode <<"\n";
-			errors++;
-			continue;
-		}
-		strncpy(temp, &buf[51], 5);
-		temp[5] = 0;
-		double thisPcp24 = -1.0, thisPcp = -1.0;
-		switch (pcpCode)
-		{
-		case 1:
-			thisPcp24 = atof(temp) / 1000.0;//inches have implied decimal point
-			break;
-		case 2:
-			thisPcp24 = atof(temp) * 0.03937007874; //millimeter to inch
-			break;
-		case 3:
-			thisPcp = atof(temp) / 1000.0;//inches have implied decimal point
-			break;
-		case 4:
-			thisPcp = atof(temp) * 0.03937007874; //millimeter to inch
-			break;
-		default:
-			cout << "\tError: Line Number " << lineNo << ", " << errStrings[9] << " : " << pcpCode << "\n";
-			errors++;
-			continue;
-
-		}
-		//now deal with precip
-		double hours = (thisTime - lastTime) / hoursDiff, sum23;
-		for (int t = 1; t < hours && prev23.size() > 0; t++)
-			prev23.pop_front();
-		if (vRecs.size() > 0)
-		{
-			if (thisPcp < 0.0)
-			{
-				sum23 = std::accumulate(prev23.begin(), prev23.end(), 0.0);
-				thisPcp = thisPcp24 - sum23;
-				if (thisPcp < 0.0)
-					thisPcp = 0.0;
-			}
-		}
-		else
-		{
-			if (thisPcp < 0.0)
-			{
-				thisPcp = thisPcp24;
-			}
-		}
-		rec.SetPrecip(thisPcp);
-		prev23.push_back(thisPcp);
-		while(prev23.size() > 23)
-			prev23.pop_front();
-		strncpy(temp, &buf[64], 4);
-		temp[4] = 0;
-		string tSlr = temp;
-		trim(tSlr);
-		//tSlr.Trim();
-		//if(strncmp(temp, "    ", 4) != 0)
-		if (tSlr.length() > 0)
-		{
-			int tSolRad = stoi(tSlr);
-			if (tSolRad < 1400 && tSolRad >= 0)
-				rec.SetSolarRadiation(tSolRad);
-				//twxObs.m_SolarRadiation = tSolRad;// atoi(tSlr);
-			else
-			{
-				cout << "\tError: Line Number " << lineNo << ", " << errStrings[10] << " : " << tSolRad << "\n";
-				continue;
-			}
-		}
-		else
-		{
-			cout << "\tError: Line Number " << lineNo << ", " << errStrings[11] << "\n";
-			continue;
-		}
-		// end solar radiation addition
-
-		//****************GUST SPEED AND DIRECTION *****************
-		// 11/2012 added for FFP4.1
-		strncpy(temp, &buf[68], 3);
-		temp[3] = 0;
-		int tgdir = -1, tgws = -1;
-		if (strncmp(temp, "   ", 3) != 0)
-			tgdir = atoi(temp);
-
-		strncpy(temp, &buf[71], 3);
-		temp[3] = 0;
-		if (strncmp(temp, "   ", 3) != 0)
-			tgws = atoi(temp);
-		if (tgws >= 0 && tgdir >= 0 && tgdir <= 360)
-		{
-			if (tgdir == 360)
-				tgdir = 0;
-
-			//twxObs.m_GustDir = tgdir;
-			//twxObs.m_GustSpd = tgws;
-			rec.SetGustAzimuth(tgdir);
-			rec.SetGustSpeed(tgws);
-		}
-		else
-		{
-			cout << "\tWarning: Line Number " << lineNo << ", " << errStrings[12] << "\n";
-		}
-
-		//***************end gusts ********************************
-
-		// added code to get snow flag
-		// 11/2012 added for FFP4.1
-
-		strncpy(temp, &buf[74], 1);
-		temp[1] = 0;
-		if (temp[0] == 'Y' || temp[0] == 'y')
-			rec.SetSnowFlag(1);
-			//twxObs.m_SnowFlag = 1;
-		else //if (temp[0] == 'N' || temp[0] == 'n')
-			rec.SetSnowFlag(0);
-			//twxObs.m_SnowFlag = 0;
-		//else
-			//twxObs.SetFieldNull(&twxObs.m_SnowFlag);
-		// end snow flag addition
-
-		vRecs.push_back(rec);		//twxObs.Update();
-		lastTime = thisTime;
-	}
-	in.close();
-
-                                                            
-    //int errors = 0;
-
-	CFW21Data data;
-	for (auto sIt = staList.begin(); sIt != staList.end(); ++sIt)
-	{
-		for (vector<FW21Record>::iterator it = vRecs.begin(); it != vRecs.end(); ++it)
-		{
-			if ((*sIt).compare((*it).GetStation()) == 0)
-			{
-				if (data.AddRecord(*it) != 1)
-				{
-					cout << "Error adding record to FW21Data, " << (*it).GetStation() << ", " << (*it).GetYear() << "/" << (*it).GetMonth() << "/" << (*it).GetDay() << " : " << (*it).GetHour() << endl;
-				}
-			}
-		}
-	}
-	if (data.WriteFile(outFileName.c_str(), tzOffset) == 1)
-	{
-		cout << "Successfully wrote " << outFileName << "\n";
-		return 0;
-	}
-	cout << "Error writing " << outFileName << "\n";
-	return -1;
+    CFW21Output output(mergedFile, stationDir);
+    if (!output.Open())
+    {
+        printf("Error opening %s for output\n", mergedFile.c_str());
+        return -1;
+    }
+    auto start = chrono::steady_clock::now();
+    size_t bytes;
+    int errors = ConvertFiles(jobs, output, numThreads, true, bytes);
+    bool writeOk = output.Close();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("Converted %zu files, %zu records, %zu stations, %d errors in %.2f s (%.1f MB/s, %u threads)\n",
+        jobs.size(), output.GetNumRecords(), output.GetNumStations(), max(errors, 0), seconds,
+        seconds > 0.0 ? bytes / seconds / 1048576.0 : 0.0, numThreads);
+    if (!writeOk)
+    {
+        printf("Error writing %s\n", stationDir.empty() ? mergedFile.c_str() : stationDir.c_str());
+        return -1;
+    }
+    return errors < 0 ? -1 : 0;
 }
-
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""Compares two NFDRS4_bench JSON results.
+
+usage: compare_bench.py <baseline.json> <candidate.json> [--threshold <percent>]
+
+Prints the median time per operation of each benchmark in both runs and the
+change. A benchmark slower than the baseline by more than the threshold
+(default 5%) is flagged, and the exit status is 1 if any benchmark is flagged.
+Benchmarks found in only one of the files are listed but not compared.
+"""
+import argparse
+import json
+import sys
+
+
+def load(fileName):
+    with open(fileName) as f:
+        results = json.load(f)
+    return {b["name"]: b for b in results["benchmarks"]}, results.get("context", {})
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two NFDRS4_bench JSON results.")
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=5.0, help="slowdown in percent flagged as a regression")
+    args = parser.parse_args()
+
+    base, baseContext = load(args.baseline)
+    cand, candContext = load(args.candidate)
+    if baseContext.get("compiler") != candContext.get("compiler"):
+        print("Note: different compilers (%s, %s)" % (baseContext.get("compiler"), candContext.get("compiler")))
+
+    print("%-40s %14s %14s %9s" % ("benchmark", "baseline ns", "candidate ns", "change"))
+    regressions = 0
+    for name in list(base) + [n for n in cand if n not in base]:
+        if name not in cand or name not in base:
+            print("%-40s %s" % (name, "only in baseline" if name in base else "only in candidate"))
+            continue
+        b = base[name]["ns_per_op"]
+        c = cand[name]["ns_per_op"]
+        change = (c - b) / b * 100.0 if b > 0 else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  SLOWER"
+            regressions += 1
+        elif change < -args.threshold:
+            flag = "  faster"
+        print("%-40s %14.1f %14.1f %+8.1f%%%s" % (name, b, c, change, flag))
+    if regressions:
+        print("%d benchmark(s) slower than the baseline by more than %.1f%%" % (regressions, args.threshold))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,72 @@
+#include "BenchWeather.h"
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+//------------------------------------------------------------------------------
+/*! \brief A year of hourly weather with a seasonal and daily cycle and rain
+    on about one day in eight.
+ */
+vector<BenchWx> MakeWeather(int numHours)
+{
+	static const int daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	vector<BenchWx> wx(numHours);
+	CBenchRandom rnd(12345);
+	int year = 2021, month = 1, day = 1, doy = 1;
+	bool rainDay = false;
+	for (int h = 0; h < numHours; h++)
+	{
+		BenchWx& w = wx[h];
+		int hour = h % 24;
+		if (hour == 0 && h > 0)
+		{
+			doy++;
+			if (++day > daysInMonth[month - 1])
+			{
+				day = 1;
+				if (++month > 12)
+				{
+					month = 1;
+					year++;
+					doy = 1;
+				}
+			}
+		}
+		if (hour == 0)
+			rainDay = rnd.Next() < 0.125;
+		double season = -cos(2.0 * 3.14159265 * (doy - 15) / 365.0);
+		double daily = -cos(2.0 * 3.14159265 * (hour - 3) / 24.0);
+		w.year = year;
+		w.month = month;
+		w.day = day;
+		w.hour = hour;
+		w.doy = doy;
+		w.tempF = 50.0 + 25.0 * season + 12.0 * daily + 4.0 * (rnd.Next() - 0.5);
+		w.rh = min(100.0, max(5.0, 55.0 - 25.0 * daily - 10.0 * season + (rainDay ? 30.0 : 0.0) + 10.0 * (rnd.Next() - 0.5)));
+		w.pcpIn = rainDay && rnd.Next() < 0.3 ? 0.02 + 0.1 * rnd.Next() : 0.0;
+		w.solRad = max(0.0, (rainDay ? 300.0 : 850.0) * sin(3.14159265 * (hour - 6) / 12.0)) * (hour >= 6 && hour <= 18 ? 1.0 : 0.0);
+		w.windSpeed = 3.0 + 10.0 * rnd.Next();
+	}
+	return wx;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Writes the synthetic weather as a FW21 csv file.
+ */
+bool WriteFW21(const char* fileName, const vector<BenchWx>& wx)
+{
+	FILE* out = fopen(fileName, "wt");
+	if (!out)
+		return false;
+	fprintf(out, "StationID,DateTime,Temperature(F),RelativeHumidity(%%),Precipitation(in),WindSpeed(mph),WindAzimuth(degrees),SolarRadiation(W/m2),SnowFlag,GustSpeed(mph),GustAzimuth(degrees)\n");
+	for (size_t h = 0; h < wx.size(); h++)
+	{
+		const BenchWx& w = wx[h];
+		//no newline after the last record, it would be read as a short line
+		fprintf(out, "%sBENCH,%04d-%02d-%02dT%02d:00:00-06:00,%.1f,%.0f,%.2f,%.0f,%d,%.0f,0,%.0f,180", h > 0 ? "\n" : "", w.year, w.month, w.day, w.hour,
+			w.tempF, w.rh, w.pcpIn, w.windSpeed, (int)(h * 37 % 360), w.solRad, w.windSpeed + 3.0);
+	}
+	fclose(out);
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+/*! \struct BenchWx BenchWeather.h
+    \brief One hour of synthetic weather, in the units NFDRS4::Update() takes.
+ */
+struct BenchWx
+{
+	int year, month, day, hour, doy;
+	double tempF, rh, pcpIn, solRad, windSpeed;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CBenchRandom BenchWeather.h
+    \brief Deterministic pseudo random numbers in [0, 1), the same on every platform.
+ */
+class CBenchRandom
+{
+public:
+	CBenchRandom(unsigned int seed) : m_state(seed) {}
+	double Next()
+	{
+		m_state = m_state * 1664525u + 1013904223u;
+		return (m_state >> 8) / 16777216.0;
+	}
+private:
+	unsigned int m_state;
+};
+
+std::vector<BenchWx> MakeWeather(int numHours);
+bool WriteFW21(const char* fileName, const std::vector<BenchWx>& wx);
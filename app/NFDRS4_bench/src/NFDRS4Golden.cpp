@@ -0,0 +1,445 @@
+#include "NFDRS4Golden.h"
+#include "nfdrs4.h"
+#include "fw21.h"
+#include "csv_readrow.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+using namespace std;
+
+static const char* goldenFieldNames[GOLDEN_NFIELDS] = { "MC1", "MC10", "MC100", "MC1000", "MCHERB", "MCWOOD",
+	"BI", "ERC", "SC", "IC", "GSI", "KBDI" };
+
+CNFDRS4Golden::CNFDRS4Golden() : m_reportHour(-1)
+{
+	//moistures and GSI are smooth, the indexes are rounded by some fuel models
+	for (int f = 0; f < GOLDEN_NFIELDS; f++)
+		m_tolerance[f] = 1e-6;
+	m_tolerance[GOLDEN_BI] = m_tolerance[GOLDEN_ERC] = m_tolerance[GOLDEN_SC] = m_tolerance[GOLDEN_IC] = 1e-3;
+	m_tolerance[GOLDEN_KBDI] = 0.0;
+	m_wx = MakeWeather(24 * 365);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Adds a case running the records of a FW21 file, as NFDRS4_cli does.
+    \param[in] fw21File FW21 csv file name.
+    \param[in] stationID The station to run, its case is fw21_<stationID>.
+ */
+void CNFDRS4Golden::AddWeatherFile(const string& fw21File, const string& stationID)
+{
+	m_wxFiles.push_back(fw21File);
+	m_stationIDs.push_back(stationID);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Writes and checks only the updates at one hour of the day.
+    \param[in] hour 0 to 23, or -1 (the default) for every update.
+ */
+void CNFDRS4Golden::SetReportHour(int hour)
+{
+	m_reportHour = hour;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Sets the absolute tolerance of one field.
+    \param[in] spec FIELD=value, for example ERC=0.01, or MC=value for every
+    moisture field.
+    \return false if spec is not valid.
+ */
+bool CNFDRS4Golden::SetTolerance(const char* spec)
+{
+	const char* eq = strchr(spec, '=');
+	if (!eq || eq == spec || eq[1] == 0)
+		return false;
+	string name(spec, eq - spec);
+	double tolerance = atof(eq + 1);
+	if (tolerance < 0.0)
+		return false;
+	bool found = false;
+	for (int f = 0; f < GOLDEN_NFIELDS; f++)
+	{
+		if (name == goldenFieldNames[f] || (name == "MC" && f <= GOLDEN_MCWOOD))
+		{
+			m_tolerance[f] = tolerance;
+			found = true;
+		}
+	}
+	return found;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief The outputs of calc after update step.
+ */
+static GoldenRow Snapshot(const NFDRS4& calc, int step, int year, int month, int day, int hour)
+{
+	GoldenRow row;
+	char date[64];
+	snprintf(date, sizeof(date), "%04d-%02d-%02dT%02d:00:00", year, month, day, hour);
+	row.step = step;
+	row.dateTime = date;
+	row.values[GOLDEN_MC1] = calc.MC1;
+	row.values[GOLDEN_MC10] = calc.MC10;
+	row.values[GOLDEN_MC100] = calc.MC100;
+	row.values[GOLDEN_MC1000] = calc.MC1000;
+	row.values[GOLDEN_MCHERB] = calc.MCHERB;
+	row.values[GOLDEN_MCWOOD] = calc.MCWOOD;
+	row.values[GOLDEN_BI] = calc.BI;
+	row.values[GOLDEN_ERC] = calc.ERC;
+	row.values[GOLDEN_SC] = calc.SC;
+	row.values[GOLDEN_IC] = calc.IC;
+	row.values[GOLDEN_GSI] = calc.m_GSI;
+	row.values[GOLDEN_KBDI] = calc.KBDI;
+	return row;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Minimum and maximum temperature, minimum RH and precipitation of the
+    24 hours ending at hour h.
+ */
+static void Trailing24(const vector<BenchWx>& wx, size_t h, double& minTemp, double& maxTemp, double& minRH, double& pcp24)
+{
+	minTemp = maxTemp = wx[h].tempF;
+	minRH = wx[h].rh;
+	pcp24 = 0.0;
+	for (size_t i = h >= 23 ? h - 23 : 0; i <= h; i++)
+	{
+		minTemp = min(minTemp, wx[i].tempF);
+		maxTemp = max(maxTemp, wx[i].tempF);
+		minRH = min(minRH, wx[i].rh);
+		pcp24 += wx[i].pcpIn;
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Dead fuel moistures (%) and fuel temperature (C) for the overloads
+    that take them, following the humidity and the season.
+ */
+static void GivenMoistures(const BenchWx& w, double mc[4], double& fuelTempC)
+{
+	double season = -cos(2.0 * 3.14159265 * (w.doy - 15) / 365.0);
+	mc[0] = 2.0 + 0.2 * w.rh;
+	mc[1] = 3.0 + 0.18 * w.rh;
+	mc[2] = 12.0 - 5.0 * season + 0.02 * w.rh;
+	mc[3] = 16.0 - 6.0 * season;
+	fuelTempC = (w.tempF - 32.0) * 5.0 / 9.0 + 0.01 * w.solRad;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs every case on the synthetic weather, and the FW21 files if added.
+    \return false if a FW21 file cannot be run.
+ */
+bool CNFDRS4Golden::RunCases(vector<GoldenCase>& cases)
+{
+	const vector<BenchWx>& wx = m_wx;
+	const char fuelModels[] = { 'Y', 'V' };
+	for (int f = 0; f < 2; f++)
+	{
+		GoldenCase golden;
+		golden.name = string("hourly_") + fuelModels[f];
+		NFDRS4 calc;
+		calc.Init(46.8, fuelModels[f], 1, 13.4, true, true, true, 100);
+		for (size_t h = 0; h < wx.size(); h++)
+		{
+			const BenchWx& w = wx[h];
+			calc.Update(w.year, w.month, w.day, w.hour, w.tempF, w.rh, w.pcpIn, w.solRad, w.windSpeed, false);
+			golden.rows.push_back(Snapshot(calc, (int)h, w.year, w.month, w.day, w.hour));
+		}
+		cases.push_back(golden);
+	}
+	{
+		GoldenCase golden;
+		golden.name = "hourly_full_Y";
+		NFDRS4 calc;
+		calc.Init(46.8, 'Y', 1, 13.4, true, true, true, 100);
+		double minTemp, maxTemp, minRH, pcp24;
+		for (size_t h = 0; h < wx.size(); h++)
+		{
+			const BenchWx& w = wx[h];
+			Trailing24(wx, h, minTemp, maxTemp, minRH, pcp24);
+			calc.Update(w.year, w.month, w.day, w.hour, w.doy, w.tempF, minTemp, maxTemp, w.rh, minRH, w.pcpIn, pcp24, w.solRad, w.windSpeed, false, 13);
+			golden.rows.push_back(Snapshot(calc, (int)h, w.year, w.month, w.day, w.hour));
+		}
+		cases.push_back(golden);
+	}
+	{
+		GoldenCase golden;
+		golden.name = "hourly_full_mc_Y";
+		NFDRS4 calc;
+		calc.Init(46.8, 'Y', 1, 13.4, true, true, true, 100);
+		double minTemp, maxTemp, minRH, pcp24, mc[4], fuelTempC;
+		for (size_t h = 0; h < wx.size(); h++)
+		{
+			const BenchWx& w = wx[h];
+			Trailing24(wx, h, minTemp, maxTemp, minRH, pcp24);
+			GivenMoistures(w, mc, fuelTempC);
+			calc.Update(w.year, w.month, w.day, w.hour, w.tempF, minTemp, maxTemp, w.rh, minRH, w.pcpIn, pcp24, w.windSpeed, false, 13,
+				mc[0], mc[1], mc[2], mc[3], fuelTempC);
+			golden.rows.push_back(Snapshot(calc, (int)h, w.year, w.month, w.day, w.hour));
+		}
+		cases.push_back(golden);
+	}
+	{
+		GoldenCase golden;
+		golden.name = "hourly_mc_Y";
+		NFDRS4 calc;
+		calc.Init(46.8, 'Y', 1, 13.4, true, true, true, 100);
+		double mc[4], fuelTempC;
+		for (size_t h = 0; h < wx.size(); h++)
+		{
+			const BenchWx& w = wx[h];
+			GivenMoistures(w, mc, fuelTempC);
+			calc.Update(w.year, w.month, w.day, w.hour, w.tempF, w.rh, w.pcpIn, w.windSpeed, false, mc[0], mc[1], mc[2], mc[3], fuelTempC);
+			golden.rows.push_back(Snapshot(calc, (int)h, w.year, w.month, w.day, w.hour));
+		}
+		cases.push_back(golden);
+	}
+	{
+		GoldenCase golden;
+		golden.name = "daily_Y";
+		NFDRS4 calc;
+		calc.Init(46.8, 'Y', 1, 13.4, true, true, true, 100);
+		double minTemp, maxTemp, minRH, pcp24, mc[4], fuelTempC;
+		for (size_t h = 13; h < wx.size(); h += 24)
+		{
+			const BenchWx& w = wx[h];
+			Trailing24(wx, h, minTemp, maxTemp, minRH, pcp24);
+			GivenMoistures(w, mc, fuelTempC);
+			calc.UpdateDaily(w.year, w.month, w.day, w.doy, w.tempF, minTemp, maxTemp, w.rh, minRH, pcp24, w.windSpeed,
+				mc[0], mc[1], mc[2], mc[3], fuelTempC, false);
+			golden.rows.push_back(Snapshot(calc, (int)(h / 24), w.year, w.month, w.day, w.hour));
+		}
+		cases.push_back(golden);
+	}
+	{
+		//as a useStoredOutputs run: moistures, GSI and KBDI come with the weather
+		GoldenCase golden;
+		golden.name = "stored_Y";
+		NFDRS4 calc;
+		calc.Init(46.8, 'Y', 1, 13.4, true, true, true, 100);
+		double mc[4], fuelTempC, sc, erc, bi, ic;
+		for (size_t h = 0; h < wx.size(); h++)
+		{
+			const BenchWx& w = wx[h];
+			GivenMoistures(w, mc, fuelTempC);
+			double season = -cos(2.0 * 3.14159265 * (w.doy - 15) / 365.0);
+			double gsi = max(0.0, min(1.0, 0.5 - 0.6 * season));
+			int kbdi = (int)(300.0 + 250.0 * season);
+			calc.iSetFuelMoistures(mc[0], mc[1], mc[2], mc[3], 60.0 + 140.0 * gsi, 30.0 + 220.0 * gsi, fuelTempC);
+			calc.iCalcIndexes((int)w.windSpeed, 1, &sc, &erc, &bi, &ic, gsi, kbdi);
+			golden.rows.push_back(Snapshot(calc, (int)h, w.year, w.month, w.day, w.hour));
+		}
+		cases.push_back(golden);
+	}
+	for (size_t w = 0; w < m_wxFiles.size(); w++)
+	{
+		GoldenCase golden;
+		golden.name = "fw21_" + m_stationIDs[w];
+		if (!RunWeatherFile(m_wxFiles[w], m_stationIDs[w], golden))
+			return false;
+		cases.push_back(golden);
+	}
+	KeepReportHour(cases);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs the FW21 file's station record by record.
+    \return false if the file cannot be loaded.
+ */
+bool CNFDRS4Golden::RunWeatherFile(const string& fw21File, const string& stationID, GoldenCase& golden)
+{
+	CFW21Data data;
+	if (data.LoadFile(fw21File.c_str(), stationID) != 0 || data.GetNumRecs() == 0)
+	{
+		printf("Error, no records of station %s in %s\n", stationID.c_str(), fw21File.c_str());
+		return false;
+	}
+	NFDRS4 calc;
+	calc.Init(46.8, 'Y', 1, 13.4, true, true, true, 100);
+	for (size_t r = 0; r < data.GetNumRecs(); r++)
+	{
+		FW21Record rec = data.GetRec(r);
+		calc.Update(rec.GetYear(), rec.GetMonth(), rec.GetDay(), rec.GetHour(), rec.GetTemp(), rec.GetRH(), rec.GetPrecip(),
+			rec.GetSolarRadiation(), rec.GetWindSpeed(), rec.GetSnowFlag());
+		golden.rows.push_back(Snapshot(calc, (int)r, rec.GetYear(), rec.GetMonth(), rec.GetDay(), rec.GetHour()));
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Drops the updates at other hours than the report hour, if it is set.
+ */
+void CNFDRS4Golden::KeepReportHour(vector<GoldenCase>& cases) const
+{
+	if (m_reportHour < 0)
+		return;
+	for (size_t c = 0; c < cases.size(); c++)
+	{
+		vector<GoldenRow>& rows = cases[c].rows;
+		//dateTime is yyyy-mm-ddThh:00:00
+		rows.erase(remove_if(rows.begin(), rows.end(), [this](const GoldenRow& row)
+			{ return atoi(row.dateTime.c_str() + 11) != m_reportHour; }), rows.end());
+	}
+}
+
+bool CNFDRS4Golden::WriteCase(const string& fileName, const GoldenCase& golden)
+{
+	FILE* out = fopen(fileName.c_str(), "wt");
+	if (!out)
+		return false;
+	fprintf(out, "Step,DateTime");
+	for (int f = 0; f < GOLDEN_NFIELDS; f++)
+		fprintf(out, ",%s", goldenFieldNames[f]);
+	fprintf(out, "\n");
+	for (size_t r = 0; r < golden.rows.size(); r++)
+	{
+		const GoldenRow& row = golden.rows[r];
+		fprintf(out, "%d,%s", row.step, row.dateTime.c_str());
+		//round trips every double exactly
+		for (int f = 0; f < GOLDEN_NFIELDS; f++)
+			fprintf(out, ",%.17g", row.values[f]);
+		fprintf(out, "\n");
+	}
+	bool ok = ferror(out) == 0;
+	fclose(out);
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads a golden file written by WriteCase().
+    \return 0 on success, -1 if it cannot be opened, -2 if it is not a golden file.
+ */
+int CNFDRS4Golden::ReadCase(const string& fileName, GoldenCase& golden)
+{
+	ifstream in(fileName.c_str());
+	if (!in.is_open())
+		return -1;
+	string line;
+	getline(in, line);
+	vector<string> vFields = csv_read_row(line, ',');
+	if (vFields.size() != GOLDEN_NFIELDS + 2)
+		return -2;
+	for (int f = 0; f < GOLDEN_NFIELDS; f++)
+	{
+		if (trim(vFields[f + 2]) != goldenFieldNames[f])
+			return -2;
+	}
+	golden.rows.clear();
+	while (getline(in, line))
+	{
+		vector<string> vRow = csv_read_row(line, ',');
+		if (vRow.size() != GOLDEN_NFIELDS + 2)
+			continue;
+		GoldenRow row;
+		row.step = atoi(vRow[0].c_str());
+		row.dateTime = trim(vRow[1]);
+		for (int f = 0; f < GOLDEN_NFIELDS; f++)
+			row.values[f] = strtod(vRow[f + 2].c_str(), NULL);
+		golden.rows.push_back(row);
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Saves the outputs of every case as <dir>/<case>.csv.
+    \return 0 on success, -1 if a file cannot be written.
+ */
+int CNFDRS4Golden::Write(const char* dir)
+{
+	vector<GoldenCase> cases;
+	if (!RunCases(cases))
+		return -1;
+	for (size_t c = 0; c < cases.size(); c++)
+	{
+		string fileName = string(dir) + "/" + cases[c].name + ".csv";
+		if (!WriteCase(fileName, cases[c]))
+		{
+			printf("Error opening %s as output.\n", fileName.c_str());
+			return -1;
+		}
+		printf("%-24s %zu updates written to %s\n", cases[c].name.c_str(), cases[c].rows.size(), fileName.c_str());
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Compares one case with its golden outputs and prints the first
+    diverging update and the largest difference of each field.
+    \return The number of diverging updates, or 1 if the number of updates differs.
+ */
+int CNFDRS4Golden::CompareCase(const GoldenCase& golden, const GoldenCase& actual)
+{
+	if (golden.rows.size() != actual.rows.size())
+	{
+		printf("%-24s FAIL: %zu golden updates, %zu now\n", actual.name.c_str(), golden.rows.size(), actual.rows.size());
+		return 1;
+	}
+	double maxDiff[GOLDEN_NFIELDS] = { 0 };
+	int nDiverging = 0;
+	for (size_t r = 0; r < golden.rows.size(); r++)
+	{
+		const GoldenRow& g = golden.rows[r];
+		const GoldenRow& a = actual.rows[r];
+		bool diverged = false;
+		for (int f = 0; f < GOLDEN_NFIELDS; f++)
+		{
+			double diff = fabs(a.values[f] - g.values[f]);
+			//NaN in either never compares within tolerance, unless both are NaN
+			bool within = diff <= m_tolerance[f] || (std::isnan(a.values[f]) && std::isnan(g.values[f]));
+			if (!within && !std::isnan(diff))
+				maxDiff[f] = max(maxDiff[f], diff);
+			if (!within && !diverged && nDiverging == 0)
+			{
+				printf("%-24s FAIL: first divergence at step %d (%s) %s golden %.17g now %.17g (tolerance %g)\n", actual.name.c_str(),
+					g.step, g.dateTime.c_str(), goldenFieldNames[f], g.values[f], a.values[f], m_tolerance[f]);
+			}
+			diverged = diverged || !within;
+		}
+		if (diverged)
+			nDiverging++;
+	}
+	if (nDiverging == 0)
+	{
+		printf("%-24s ok, %zu updates\n", actual.name.c_str(), actual.rows.size());
+		return 0;
+	}
+	printf("%-24s %d of %zu updates diverge, largest differences:", actual.name.c_str(), nDiverging, actual.rows.size());
+	for (int f = 0; f < GOLDEN_NFIELDS; f++)
+	{
+		if (maxDiff[f] > 0.0)
+			printf(" %s %g", goldenFieldNames[f], maxDiff[f]);
+	}
+	printf("\n");
+	return nDiverging;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs every case and compares it with <dir>/<case>.csv.
+    \return 0 if every case matches, 1 if any diverges or has no golden file.
+ */
+int CNFDRS4Golden::Check(const char* dir)
+{
+	vector<GoldenCase> cases;
+	if (!RunCases(cases))
+		return -1;
+	int nFailed = 0;
+	for (size_t c = 0; c < cases.size(); c++)
+	{
+		string fileName = string(dir) + "/" + cases[c].name + ".csv";
+		GoldenCase golden;
+		golden.name = cases[c].name;
+		int status = ReadCase(fileName, golden);
+		if (status != 0)
+		{
+			printf("%-24s FAIL: %s %s\n", cases[c].name.c_str(), status == -1 ? "cannot open" : "is not a golden file:", fileName.c_str());
+			nFailed++;
+		}
+		else if (CompareCase(golden, cases[c]) != 0)
+			nFailed++;
+	}
+	printf("%d of %zu cases match their golden outputs\n", (int)cases.size() - nFailed, cases.size());
+	return nFailed > 0 ? 1 : 0;
+}
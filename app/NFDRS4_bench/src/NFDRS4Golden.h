@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "BenchWeather.h"
+
+//------------------------------------------------------------------------------
+/*! \brief The NFDRS4 outputs compared by CNFDRS4Golden, in golden file column order.
+ */
+enum GoldenField { GOLDEN_MC1, GOLDEN_MC10, GOLDEN_MC100, GOLDEN_MC1000, GOLDEN_MCHERB, GOLDEN_MCWOOD,
+	GOLDEN_BI, GOLDEN_ERC, GOLDEN_SC, GOLDEN_IC, GOLDEN_GSI, GOLDEN_KBDI, GOLDEN_NFIELDS };
+
+//------------------------------------------------------------------------------
+/*! \struct GoldenRow NFDRS4Golden.h
+    \brief The outputs after one update.
+ */
+struct GoldenRow
+{
+	int step;
+	std::string dateTime;
+	double values[GOLDEN_NFIELDS];
+};
+
+//------------------------------------------------------------------------------
+/*! \struct GoldenCase NFDRS4Golden.h
+    \brief One way of driving NFDRS4 and its outputs, saved as <name>.csv.
+ */
+struct GoldenCase
+{
+	std::string name;
+	std::vector<GoldenRow> rows;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CNFDRS4Golden NFDRS4Golden.h
+    \brief Numerical regression check of NFDRS4 against saved (golden) outputs.
+
+    A year of synthetic weather is run through each NFDRS4::Update() overload,
+    NFDRS4::UpdateDaily() and the stored outputs path (iSetFuelMoistures() and
+    iCalcIndexes()), and optionally through the records of a FW21 file. Write()
+    saves the outputs of every update; Check() runs the cases again and compares
+    each field within its absolute tolerance, reporting the first update that
+    diverges. SetReportHour() keeps only the updates at one hour of the day,
+    which keeps golden files small enough to check in; every update is still
+    run, so a divergence at any hour carries into the kept ones. The golden
+    outputs in data/golden are checked by the nfdrs4_golden test.
+ */
+class CNFDRS4Golden
+{
+public:
+	CNFDRS4Golden();
+
+	void AddWeatherFile(const std::string& fw21File, const std::string& stationID);
+	void SetReportHour(int hour);
+	bool SetTolerance(const char* spec);
+	int Write(const char* dir);
+	int Check(const char* dir);
+
+private:
+	bool RunCases(std::vector<GoldenCase>& cases);
+	bool RunWeatherFile(const std::string& fw21File, const std::string& stationID, GoldenCase& golden);
+	void KeepReportHour(std::vector<GoldenCase>& cases) const;
+	static bool WriteCase(const std::string& fileName, const GoldenCase& golden);
+	static int ReadCase(const std::string& fileName, GoldenCase& golden);
+	int CompareCase(const GoldenCase& golden, const GoldenCase& actual);
+
+	std::vector<BenchWx> m_wx;
+	std::vector<std::string> m_wxFiles;
+	std::vector<std::string> m_stationIDs;
+	int m_reportHour;
+	double m_tolerance[GOLDEN_NFIELDS];
+};
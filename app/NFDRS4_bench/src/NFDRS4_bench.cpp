@@ -0,0 +1,510 @@
+// NFDRS4_bench.cpp : micro-benchmarks of the NFDRS4 and fw21 library hot paths.
+//
+// Every benchmark runs on deterministic synthetic weather, so runs on the same
+// machine are comparable. Each benchmark is repeated and the median time per
+// operation is reported; see compare_bench.py to compare two JSON results.
+// --golden-write and --golden-check instead save or check the numerical
+// outputs of NFDRS4, see CNFDRS4Golden.
+
+#include "nfdrs4.h"
+#include "deadfuelmoisture.h"
+#include "livefuelmoisture.h"
+#include "livefuelmoisturebatch.h"
+#include "nfdrs4calcstate.h"
+#include "fw21.h"
+#include "csv_readrow.h"
+#include "BenchWeather.h"
+#include "NFDRS4Golden.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+//------------------------------------------------------------------------------
+/*! \struct BenchResult
+    \brief Timing of one benchmark.
+ */
+struct BenchResult
+{
+	string name;
+	double nsPerOp;//median of the repetitions
+	double minNsPerOp;
+	double maxNsPerOp;
+	size_t opsPerRepetition;
+	int repetitions;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CBenchRunner
+    \brief Runs benchmarks: each is a function doing a batch of operations and
+    returning their count. Batches are repeated until a repetition lasts at
+    least minSeconds, and the repetitions' median time per operation is kept.
+ */
+class CBenchRunner
+{
+public:
+	CBenchRunner(double minSeconds, int repetitions, const string& filter)
+		: m_minSeconds(minSeconds), m_repetitions(repetitions), m_filter(filter) {}
+
+	void Run(const string& name, function<size_t()> batch)
+	{
+		if (!m_filter.empty() && name.find(m_filter) == string::npos)
+			return;
+		//calibrate the number of batches per repetition, after one warm up batch
+		batch();
+		size_t batchesPerRep = 1;
+		while (true)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for (size_t b = 0; b < batchesPerRep; b++)
+				batch();
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			if (seconds >= m_minSeconds || batchesPerRep >= ((size_t)1 << 30))
+				break;
+			batchesPerRep = seconds > 0.0 ? max(batchesPerRep * 2, (size_t)(batchesPerRep * 1.2 * m_minSeconds / seconds)) : batchesPerRep * 10;
+		}
+		vector<double> nsPerOp(m_repetitions);
+		size_t ops = 0;
+		for (int r = 0; r < m_repetitions; r++)
+		{
+			ops = 0;
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for (size_t b = 0; b < batchesPerRep; b++)
+				ops += batch();
+			double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+			nsPerOp[r] = ns / (double)max(ops, (size_t)1);
+		}
+		BenchResult res;
+		res.name = name;
+		res.minNsPerOp = *min_element(nsPerOp.begin(), nsPerOp.end());
+		res.maxNsPerOp = *max_element(nsPerOp.begin(), nsPerOp.end());
+		sort(nsPerOp.begin(), nsPerOp.end());
+		res.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+		res.opsPerRepetition = ops;
+		res.repetitions = m_repetitions;
+		m_results.push_back(res);
+		printf("%-40s %14.1f ns/op  (min %.1f, max %.1f, %zu ops x %d)\n", name.c_str(), res.nsPerOp, res.minNsPerOp,
+			res.maxNsPerOp, res.opsPerRepetition, res.repetitions);
+		fflush(stdout);
+	}
+
+	bool WriteJSON(const char* fileName)
+	{
+		FILE* out = fopen(fileName, "wt");
+		if (!out)
+			return false;
+		time_t now = time(NULL);
+		char date[64];
+		strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+		fprintf(out, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"compiler\": \"%s\",\n    \"min_seconds\": %g,\n    \"repetitions\": %d\n  },\n",
+			date, Compiler().c_str(), m_minSeconds, m_repetitions);
+		fprintf(out, "  \"benchmarks\": [\n");
+		for (size_t b = 0; b < m_results.size(); b++)
+		{
+			const BenchResult& r = m_results[b];
+			fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, \"max_ns_per_op\": %.3f, \"ops\": %zu, \"repetitions\": %d}%s\n",
+				r.name.c_str(), r.nsPerOp, r.minNsPerOp, r.maxNsPerOp, r.opsPerRepetition, r.repetitions, b + 1 < m_results.size() ? "," : "");
+		}
+		fprintf(out, "  ]\n}\n");
+		fclose(out);
+		return true;
+	}
+
+private:
+	static string Compiler()
+	{
+#if defined(__clang__)
+		return string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+		return string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc " + to_string(_MSC_VER);
+#else
+		return "unknown";
+#endif
+	}
+
+	double m_minSeconds;
+	int m_repetitions;
+	string m_filter;
+	vector<BenchResult> m_results;
+};
+
+//------------------------------------------------------------------------------
+/*! \brief Gives benchmarks access to the protected diffusivity computation.
+ */
+class CBenchDeadFuelMoisture : public DeadFuelMoisture
+{
+public:
+	CBenchDeadFuelMoisture(double radius, const string& name) : DeadFuelMoisture(radius, name) {}
+	using DeadFuelMoisture::diffusivity;
+};
+
+static const double stickRadius[] = { 0.2, 0.64, 2.0, 6.4 };//as createDeadFuelMoisture1 ... 1000
+static const char* stickNames[] = { "1h", "10h", "100h", "1000h" };
+
+//------------------------------------------------------------------------------
+/*! \brief DeadFuelMoisture::update() per size class in three weather regimes:
+    dry (hot, sunny, low humidity), rain, and condensation (cold, saturated, dark).
+ */
+static void BenchDeadFuel(CBenchRunner& runner)
+{
+	struct Regime { const char* name; double at, rh, sW, rainCmPerHour; };
+	const Regime regimes[] = { { "dry", 32.0, 0.12, 900.0, 0.0 }, { "rain", 12.0, 0.95, 100.0, 0.25 }, { "condensation", 2.0, 0.99, 0.0, 0.0 } };
+	for (int s = 0; s < 4; s++)
+	{
+		for (int g = 0; g < 3; g++)
+		{
+			const Regime regime = regimes[g];
+			DeadFuelMoisture dfm(stickRadius[s], stickNames[s]);
+			dfm.initializeEnvironment(20.0, 0.5, 0.0, 0.0, 20.0, 0.5, 0.1);
+			double rcum = 0.0;
+			runner.Run(string("dfm_update/") + stickNames[s] + "/" + regime.name, [&]()
+			{
+				const size_t n = 24;
+				for (size_t h = 0; h < n; h++)
+				{
+					rcum += regime.rainCmPerHour;
+					dfm.update(1.0, regime.at, regime.rh, regime.sW, rcum);
+				}
+				return n;
+			});
+		}
+	}
+	for (int s = 0; s < 4; s++)
+	{
+		CBenchDeadFuelMoisture dfm(stickRadius[s], stickNames[s]);
+		dfm.initializeEnvironment(20.0, 0.5, 0.0, 0.0, 20.0, 0.5, 0.1);
+		dfm.update(1.0, 20.0, 0.5, 500.0, 0.0);
+		runner.Run(string("dfm_diffusivity/") + stickNames[s], [&]()
+		{
+			const size_t n = 64;
+			for (size_t i = 0; i < n; i++)
+				dfm.diffusivity(0.0218);
+			return n;
+		});
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief NFDRS4::iCalcIndexes() per standard fuel model from fixed moistures.
+ */
+static void BenchIndexes(CBenchRunner& runner)
+{
+	const char fuelModels[] = { 'V', 'W', 'X', 'Y', 'Z' };
+	for (int f = 0; f < 5; f++)
+	{
+		NFDRS4 calc;
+		calc.Init(46.8, fuelModels[f], 1, 13.4, true, true, true, 100);
+		calc.iSetFuelMoistures(6.0, 8.0, 12.0, 15.0, 90.0, 60.0, 25.0);
+		runner.Run(string("calc_indexes/") + fuelModels[f], [&]()
+		{
+			const size_t n = 256;
+			double sc, erc, bi, ic;
+			for (size_t i = 0; i < n; i++)
+				calc.iCalcIndexes(5 + (int)(i & 7), 1, &sc, &erc, &bi, &ic, 0.5, 200);
+			return n;
+		});
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief LiveFuelMoisture daily update and GSI over a synthetic year.
+ */
+static void BenchLiveFuel(CBenchRunner& runner, const vector<BenchWx>& wx)
+{
+	vector<BenchWx> daily;
+	for (size_t h = 14; h < wx.size(); h += 24)
+		daily.push_back(wx[h]);
+	LiveFuelMoisture herb(46.8, true, true);
+	size_t next = 0;
+	runner.Run("lfm_update", [&]()
+	{
+		const size_t n = 32;
+		for (size_t i = 0; i < n; i++)
+		{
+			const BenchWx& w = daily[next++ % daily.size()];
+			herb.Update(w.tempF, w.tempF + 10.0, w.tempF - 15.0, w.rh, w.rh * 0.6, w.doy, 0.1, (time_t)(next * 86400));
+		}
+		return n;
+	});
+	LiveFuelMoisture gsi(46.8, true, true);
+	runner.Run("lfm_calcgsi", [&]()
+	{
+		const size_t n = 64;
+		double sum = 0.0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const BenchWx& w = daily[(next++) % daily.size()];
+			sum += gsi.CalcGSI(w.rh * 0.6, w.tempF + 10.0, w.tempF - 15.0, 0.1, 46.8, w.doy);
+		}
+		return sum > -1.0 ? n : 0;
+	});
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Daily live fuel inputs of grid cell c, spread around the day's weather.
+ */
+static LFMDailyInputs GridDay(const BenchWx& w, size_t c, size_t day)
+{
+	LFMDailyInputs in;
+	in.Temp = w.tempF + (double)(c % 16) * 0.5 - 4.0;
+	in.MaxTemp = in.Temp + 10.0;
+	in.MinTemp = in.Temp - 15.0;
+	in.RH = min(100.0, w.rh + (double)(c % 8));
+	in.MinRH = in.RH * 0.6;
+	in.HerbPrecip = in.WoodyPrecip = 0.1;
+	in.Jday = w.doy;
+	in.Time = (time_t)((day + 1) * 86400);
+	in.SnowDay = false;
+	in.ResetHerb = w.doy == 1;
+	return in;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Daily herb and woody update of a grid: a LiveFuelMoisture pair per cell,
+    as NFDRS4 runs them, against LiveFuelMoistureBatch with exact latitudes and
+    with 0.5 degree latitude bands. The exact batch is first checked to give the
+    objects' results over two years.
+ */
+static void BenchLiveFuelGrid(CBenchRunner& runner, const vector<BenchWx>& wx)
+{
+	const size_t numCells = 1024;
+	vector<BenchWx> daily;
+	for (size_t h = 14; h < wx.size(); h += 24)
+		daily.push_back(wx[h]);
+	vector<double> lats(numCells);
+	vector<LiveFuelMoisture> herbs(numCells), woodies(numCells);
+	for (size_t c = 0; c < numCells; c++)
+	{
+		lats[c] = 25.0 + 24.0 * c / numCells;
+		herbs[c].Initialize(lats[c], true, false);
+		woodies[c].Initialize(lats[c], false, false);
+	}
+	vector<LFMDailyInputs> inputs(numCells);
+	vector<LFMDailyOutputs> outputs(numCells), expected(numCells);
+	auto updateObjects = [&](vector<LiveFuelMoisture>& herb, vector<LiveFuelMoisture>& woody, LFMDailyOutputs* out)
+	{
+		for (size_t c = 0; c < numCells; c++)
+		{
+			const LFMDailyInputs& in = inputs[c];
+			if (in.ResetHerb)
+				herb[c].ResetHerbState();
+			herb[c].Update(in.Temp, in.MaxTemp, in.MinTemp, in.RH, in.MinRH, in.Jday, in.HerbPrecip, in.Time);
+			woody[c].Update(in.Temp, in.MaxTemp, in.MinTemp, in.RH, in.MinRH, in.Jday, in.WoodyPrecip, in.Time);
+			out[c].GSI = herb[c].CalcRunningAvgGSI();
+			out[c].HerbFM = herb[c].GetMoisture(in.SnowDay);
+			out[c].WoodyFM = woody[c].GetMoisture(in.SnowDay);
+		}
+	};
+
+	LiveFuelMoistureBatch check;
+	check.Initialize(herbs[0], woodies[0], lats);
+	vector<LiveFuelMoisture> checkHerbs = herbs, checkWoodies = woodies;
+	size_t mismatches = 0;
+	for (size_t day = 0; day < 2 * daily.size(); day++)
+	{
+		for (size_t c = 0; c < numCells; c++)
+			inputs[c] = GridDay(daily[day % daily.size()], c, day);
+		updateObjects(checkHerbs, checkWoodies, &expected[0]);
+		check.Update(0, numCells, &inputs[0], &outputs[0]);
+		for (size_t c = 0; c < numCells; c++)
+		{
+			if (outputs[c].GSI != expected[c].GSI || outputs[c].HerbFM != expected[c].HerbFM || outputs[c].WoodyFM != expected[c].WoodyFM)
+				mismatches++;
+		}
+	}
+	if (mismatches > 0)
+		printf("Error, LiveFuelMoistureBatch differs from LiveFuelMoisture in %zu of %zu cell days\n", mismatches, 2 * daily.size() * numCells);
+
+	size_t day = 0;
+	runner.Run("lfm_grid/objects", [&]()
+	{
+		for (size_t c = 0; c < numCells; c++)
+			inputs[c] = GridDay(daily[day % daily.size()], c, day);
+		day++;
+		updateObjects(herbs, woodies, &outputs[0]);
+		return numCells;
+	});
+	const double bands[] = { 0.0, 0.5 };
+	for (double band : bands)
+	{
+		LiveFuelMoistureBatch batch;
+		batch.Initialize(herbs[0], woodies[0], lats, band);
+		day = 0;
+		runner.Run(band > 0.0 ? "lfm_grid/batch_band0.5" : "lfm_grid/batch", [&]()
+		{
+			for (size_t c = 0; c < numCells; c++)
+				inputs[c] = GridDay(daily[day % daily.size()], c, day);
+			day++;
+			batch.Update(0, numCells, &inputs[0], &outputs[0]);
+			return numCells;
+		});
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief NFDRS4::Update() end to end, hour after hour of synthetic weather.
+ */
+static void BenchUpdate(CBenchRunner& runner, const vector<BenchWx>& wx)
+{
+	NFDRS4 calc;
+	calc.Init(46.8, 'Y', 1, 13.4, true, true, true, 100);
+	size_t next = 0;
+	int yearOffset = 0;
+	runner.Run("nfdrs4_update", [&]()
+	{
+		const size_t n = 24;
+		for (size_t i = 0; i < n; i++)
+		{
+			if (next == wx.size())
+			{
+				//continue with the next year, time must keep moving forward
+				next = 0;
+				yearOffset++;
+			}
+			const BenchWx& w = wx[next++];
+			calc.Update(w.year + yearOffset, w.month, w.day, w.hour, w.tempF, w.rh, w.pcpIn, w.solRad, w.windSpeed, false);
+		}
+		return n;
+	});
+}
+
+//------------------------------------------------------------------------------
+/*! \brief csv_read_row() on a typical FW21 line and CFW21Data::LoadFile() per record.
+ */
+static void BenchFW21(CBenchRunner& runner, const vector<BenchWx>& wx, const string& wxFile)
+{
+	string line = "BENCH,2021-07-14T13:00:00-06:00,88.2,14,0.00,9,237,846,0,14,180";
+	runner.Run("csv_read_row", [&]()
+	{
+		const size_t n = 64;
+		size_t fields = 0;
+		for (size_t i = 0; i < n; i++)
+			fields += csv_read_row(line, ',').size();
+		return fields > 0 ? n : 0;
+	});
+	if (!WriteFW21(wxFile.c_str(), wx))
+	{
+		printf("Error, cannot write %s, skipping fw21_loadfile\n", wxFile.c_str());
+		return;
+	}
+	runner.Run("fw21_loadfile", [&]()
+	{
+		CFW21Data data;
+		data.LoadFile(wxFile.c_str(), "BENCH");
+		return data.GetNumRecs();
+	});
+	remove(wxFile.c_str());
+}
+
+//------------------------------------------------------------------------------
+/*! \brief NFDRS4 state file save and load, after a season of updates.
+ */
+static void BenchState(CBenchRunner& runner, const vector<BenchWx>& wx, const string& stateFile)
+{
+	NFDRS4 calc;
+	calc.Init(46.8, 'Y', 1, 13.4, true, true, true, 100);
+	for (size_t h = 0; h < wx.size() && h < 24 * 120; h++)
+		calc.Update(wx[h].year, wx[h].month, wx[h].day, wx[h].hour, wx[h].tempF, wx[h].rh, wx[h].pcpIn, wx[h].solRad, wx[h].windSpeed, false);
+	if (!calc.SaveState(stateFile))
+	{
+		printf("Error, cannot write %s, skipping state benchmarks\n", stateFile.c_str());
+		return;
+	}
+	runner.Run("state_save", [&]()
+	{
+		return calc.SaveState(stateFile) ? (size_t)1 : (size_t)0;
+	});
+	runner.Run("state_load", [&]()
+	{
+		NFDRS4State state;
+		state.LoadState(stateFile);
+		NFDRS4 loaded;
+		loaded.LoadState(state);
+		return (size_t)1;
+	});
+	remove(stateFile.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+	const char* jsonFile = NULL;
+	string filter;
+	string tmpDir = ".";
+	double minSeconds = 0.2;
+	int repetitions = 5;
+	const char* goldenWriteDir = NULL;
+	const char* goldenCheckDir = NULL;
+	CNFDRS4Golden golden;
+	for (int a = 1; a < argc; a++)
+	{
+		if (strcmp(argv[a], "--json") == 0 && a + 1 < argc)
+			jsonFile = argv[++a];
+		else if (strcmp(argv[a], "--filter") == 0 && a + 1 < argc)
+			filter = argv[++a];
+		else if (strcmp(argv[a], "--min-time") == 0 && a + 1 < argc)
+			minSeconds = atof(argv[++a]);
+		else if (strcmp(argv[a], "--repetitions") == 0 && a + 1 < argc)
+			repetitions = max(1, atoi(argv[++a]));
+		else if (strcmp(argv[a], "--tmpdir") == 0 && a + 1 < argc)
+			tmpDir = argv[++a];
+		else if (strcmp(argv[a], "--golden-write") == 0 && a + 1 < argc)
+			goldenWriteDir = argv[++a];
+		else if (strcmp(argv[a], "--golden-check") == 0 && a + 1 < argc)
+			goldenCheckDir = argv[++a];
+		else if (strcmp(argv[a], "--golden-wx") == 0 && a + 2 < argc)
+		{
+			golden.AddWeatherFile(argv[a + 1], argv[a + 2]);
+			a += 2;
+		}
+		else if (strcmp(argv[a], "--golden-hour") == 0 && a + 1 < argc && atoi(argv[a + 1]) >= 0 && atoi(argv[a + 1]) <= 23)
+			golden.SetReportHour(atoi(argv[++a]));
+		else if (strcmp(argv[a], "--tolerance") == 0 && a + 1 < argc && golden.SetTolerance(argv[a + 1]))
+			a++;
+		else
+		{
+			printf("NFDRS4_bench runs micro-benchmarks of the NFDRS4 and fw21 libraries.\n"
+				"NFDRS4_bench [--json <file>] [--filter <text>] [--min-time <seconds>] [--repetitions <n>] [--tmpdir <dir>]\n"
+				"\t--json writes the results as JSON (compare two with compare_bench.py)\n"
+				"\t--filter runs only benchmarks whose name contains text\n"
+				"\t--min-time is the least time of one repetition (default 0.2)\n"
+				"\t--repetitions of each benchmark, the median is reported (default 5)\n"
+				"\t--tmpdir for the temporary FW21 and state files (default .)\n"
+				"NFDRS4_bench --golden-write <dir> | --golden-check <dir> [--golden-wx <fw21File> <stationID>]... [--golden-hour <h>] [--tolerance <FIELD=value>]...\n"
+				"\t--golden-write saves the outputs of every update of the numerical regression cases to dir\n"
+				"\t--golden-check runs the cases again and compares them with dir, exits 1 on a divergence\n"
+				"\t--golden-wx adds a case running the station's records from a FW21 file\n"
+				"\t--golden-hour writes and checks only the updates at hour h (0-23) of each day\n"
+				"\t--tolerance sets a field's absolute tolerance, e.g. ERC=0.01 or MC=1e-4 for all moistures\n"
+				"\t\t(defaults: moistures and GSI 1e-6, BI ERC SC IC 1e-3, KBDI 0)\n");
+			return strcmp(argv[a], "--help") == 0 ? 0 : 1;
+		}
+	}
+	if (goldenWriteDir)
+		return golden.Write(goldenWriteDir);
+	if (goldenCheckDir)
+		return golden.Check(goldenCheckDir);
+	CBenchRunner runner(minSeconds, repetitions, filter);
+	vector<BenchWx> wx = MakeWeather(24 * 365);
+	BenchDeadFuel(runner);
+	BenchIndexes(runner);
+	BenchLiveFuel(runner, wx);
+	BenchLiveFuelGrid(runner, wx);
+	BenchUpdate(runner, wx);
+	BenchFW21(runner, wx, tmpDir + "/NFDRS4_bench.fw21");
+	BenchState(runner, wx, tmpDir + "/NFDRS4_bench.nfdrs");
+	if (jsonFile && !runner.WriteJSON(jsonFile))
+	{
+		printf("Error opening %s as output.\n", jsonFile);
+		return -1;
+	}
+	return 0;
+}
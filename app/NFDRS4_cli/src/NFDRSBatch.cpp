@@ -0,0 +1,146 @@
+#include "NFDRSBatch.h"
+#include "fw21index.h"
+#include "fw21binary.h"
+#include "csv_readrow.h"
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+using namespace std;
+
+CNFDRSBatch::CNFDRSBatch()
+{
+}
+
+CNFDRSBatch::~CNFDRSBatch()
+{
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads the stations of a batch manifest (see CNFDRSBatch).
+    \param[in] manifestFile Manifest csv file name.
+    \param[in] defaultInitFile NFDRSInit file for stations without one.
+    \param[in] defaultLoadStateFile State file for stations without one.
+    \return 0 on success, -1 if the file cannot be opened, -2 if it has no
+    StationID column or no stations.
+ */
+int CNFDRSBatch::LoadManifest(const char* manifestFile, const char* defaultInitFile, const char* defaultLoadStateFile)
+{
+	m_runs.clear();
+	ifstream in(manifestFile);
+	if (!in.is_open())
+	{
+		printf("Error opening %s as input\n", manifestFile);
+		return -1;
+	}
+	string line;
+	getline(in, line);
+	vector<string> vFields = csv_read_row(line, ',');
+	for (size_t f = 0; f < vFields.size(); f++)
+		trim(vFields[f]);
+	enum { COL_STATION, COL_INIT, COL_LOADSTATE, COL_SAVESTATE, COL_ALL, COL_INDEX, COL_MOISTURE, COL_FUELMODELINDEX, COL_END };
+	const char* colNames[COL_END] = { "StationID", "initFile", "loadFromStateFile", "saveToStateFile", "allOutputsFile",
+		"indexOutputFile", "fuelMoisturesOutputFile", "fuelModelIndexOutputFile" };
+	int col[COL_END];
+	for (int c = 0; c < COL_END; c++)
+		col[c] = getColIndex(colNames[c], vFields);
+	if (col[COL_STATION] < 0)
+	{
+		printf("Error, field %s not found in %s header\n", colNames[COL_STATION], manifestFile);
+		return -2;
+	}
+	while (getline(in, line))
+	{
+		vector<string> vRow = csv_read_row(line, ',');
+		string value[COL_END];
+		for (int c = 0; c < COL_END; c++)
+		{
+			if (col[c] >= 0 && col[c] < (int)vRow.size())
+				value[c] = trim(vRow[col[c]]);
+		}
+		if (value[COL_STATION].empty())
+			continue;
+		NFDRSStationRun run;
+		run.stationID = value[COL_STATION];
+		run.initFile = value[COL_INIT].empty() ? defaultInitFile : value[COL_INIT];
+		run.loadStateFile = value[COL_LOADSTATE].empty() ? defaultLoadStateFile : value[COL_LOADSTATE];
+		run.saveStateFile = value[COL_SAVESTATE];
+		run.allOutputsFile = value[COL_ALL];
+		run.indexOutputFile = value[COL_INDEX];
+		run.fuelMoisturesOutputFile = value[COL_MOISTURE];
+		run.fuelModelIndexOutputFile = value[COL_FUELMODELINDEX];
+		run.numRecords = 0;
+		run.status = 0;
+		m_runs.push_back(run);
+	}
+	if (m_runs.empty())
+	{
+		printf("Error, no stations in %s\n", manifestFile);
+		return -2;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Sets each station's numRecords from the station index of a csv
+    weather file or from a .fw21b file; either may be NULL.
+ */
+void CNFDRSBatch::EstimateWork(const CFW21StationIndex* index, const CFW21BinaryFile* binary)
+{
+	for (size_t s = 0; s < m_runs.size(); s++)
+	{
+		NFDRSStationRun& run = m_runs[s];
+		if (index)
+			run.numRecords = (size_t)index->GetNumLines(run.stationID);
+		else if (binary && binary->IsOpen())
+		{
+			int stationNum = binary->FindStation(run.stationID);
+			run.numRecords = stationNum >= 0 ? (size_t)binary->GetStationEntry(stationNum)->numRows : 0;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs every station, longest first, on numThreads threads.
+    \param[in] numThreads Threads, 0 for one per core.
+    \param[in] runStation Runs one station and returns its status, called
+    concurrently from several threads.
+    \return 0 if every station succeeded, else the first failed station's status.
+ */
+int CNFDRSBatch::Run(int numThreads, function<int(const NFDRSStationRun&)> runStation)
+{
+	if (numThreads <= 0)
+		numThreads = (int)thread::hardware_concurrency();
+	if (numThreads <= 0)
+		numThreads = 1;
+	if ((size_t)numThreads > m_runs.size())
+		numThreads = (int)m_runs.size();
+	vector<size_t> order(m_runs.size());
+	for (size_t s = 0; s < order.size(); s++)
+		order[s] = s;
+	stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return m_runs[a].numRecords > m_runs[b].numRecords; });
+	//stations are independent, each idle thread takes the next longest
+	atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		size_t s;
+		while ((s = next++) < order.size())
+		{
+			NFDRSStationRun& run = m_runs[order[s]];
+			run.status = runStation(run);
+		}
+	};
+	vector<thread> threads;
+	for (int t = 1; t < numThreads; t++)
+		threads.push_back(thread(worker));
+	worker();
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+	for (size_t s = 0; s < m_runs.size(); s++)
+	{
+		if (m_runs[s].status != 0)
+			return m_runs[s].status;
+	}
+	return 0;
+}
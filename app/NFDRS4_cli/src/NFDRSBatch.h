@@ -0,0 +1,57 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+class CFW21StationIndex;
+class CFW21BinaryFile;
+
+//------------------------------------------------------------------------------
+/*! \struct NFDRSStationRun NFDRSBatch.h
+    \brief One station's NFDRS4_cli run: the station, its NFDRSInit and state
+    files and its output files. Empty names are not used.
+ */
+struct NFDRSStationRun
+{
+	std::string stationID;
+	std::string initFile;
+	std::string loadStateFile;
+	std::string saveStateFile;
+	std::string allOutputsFile;
+	std::string indexOutputFile;
+	std::string fuelMoisturesOutputFile;
+	std::string fuelModelIndexOutputFile;
+	size_t numRecords;//estimated work, longest stations are started first
+	int status;//result of the run
+};
+
+//------------------------------------------------------------------------------
+/*! \class CNFDRSBatch NFDRSBatch.h
+    \brief Runs many stations of one weather file on a pool of threads.
+
+    The stations come from a csv manifest whose header names the columns
+    after the RunNFDRS configuration settings: StationID (required),
+    initFile, loadFromStateFile, saveToStateFile, allOutputsFile,
+    indexOutputFile, fuelMoisturesOutputFile and fuelModelIndexOutputFile.
+    A missing or blank initFile or loadFromStateFile is taken from the
+    RunNFDRS configuration. Stations are started longest first (by their
+    line count in the station index, or rows in a .fw21b file) and each idle
+    thread takes the next one, so a few long stations do not end the batch
+    on a single thread.
+ */
+class CNFDRSBatch
+{
+public:
+	CNFDRSBatch();
+	~CNFDRSBatch();
+
+	int LoadManifest(const char* manifestFile, const char* defaultInitFile, const char* defaultLoadStateFile);
+	void EstimateWork(const CFW21StationIndex* index, const CFW21BinaryFile* binary);
+	int Run(int numThreads, std::function<int(const NFDRSStationRun&)> runStation);
+
+	size_t GetNumStations() const { return m_runs.size(); }
+	const NFDRSStationRun& GetStation(size_t s) const { return m_runs[s]; }
+
+private:
+	std::vector<NFDRSStationRun> m_runs;//manifest order
+};
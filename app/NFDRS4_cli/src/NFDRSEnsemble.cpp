@@ -0,0 +1,190 @@
+#include "NFDRSEnsemble.h"
+#include "NFDRSOutputWriter.h"
+#include <stdio.h>
+#include <algorithm>
+using namespace std;
+
+//class CNFDRSForcing
+CNFDRSForcing::CNFDRSForcing()
+{
+}
+
+CNFDRSForcing::~CNFDRSForcing()
+{
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Decodes every record of a loaded CFW21Data into the forcing columns.
+    \param[in] data Loaded FW21 data.
+ */
+void CNFDRSForcing::Load(CFW21Data& data)
+{
+	size_t nRecs = data.GetNumRecs();
+	m_station.resize(nRecs);
+	m_dateTime.resize(nRecs);
+	m_year.resize(nRecs);
+	m_month.resize(nRecs);
+	m_day.resize(nRecs);
+	m_hour.resize(nRecs);
+	m_temp.resize(nRecs);
+	m_rh.resize(nRecs);
+	m_precip.resize(nRecs);
+	m_solarRad.resize(nRecs);
+	m_windSpeed.resize(nRecs);
+	m_snowFlag.resize(nRecs);
+	for (size_t r = 0; r < nRecs; r++)
+	{
+		FW21Record rec = data.GetRec(r);
+		m_station[r] = rec.GetStation();
+		m_dateTime[r] = data.DateToOriginal(rec.GetDateTime(), rec.GetTimeZoneOffset());
+		m_year[r] = rec.GetYear();
+		m_month[r] = rec.GetMonth();
+		m_day[r] = rec.GetDay();
+		m_hour[r] = rec.GetHour();
+		m_temp[r] = rec.GetTemp();
+		m_rh[r] = rec.GetRH();
+		m_precip[r] = rec.GetPrecip();
+		m_solarRad[r] = rec.GetSolarRadiation();
+		m_windSpeed[r] = rec.GetWindSpeed();
+		m_snowFlag[r] = rec.GetSnowFlag() != 0 ? 1 : 0;
+	}
+}
+
+//class CNFDRSEnsemble
+CNFDRSEnsemble::CNFDRSEnsemble()
+{
+	m_blockSize = 240;
+}
+
+CNFDRSEnsemble::~CNFDRSEnsemble()
+{
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Adds a member initialized from params.
+    \param[in] params Parameters for the member's NFDRS4 instance.
+    \param[in] name Name reported for the member (e.g. its NFDRSInit file).
+ */
+void CNFDRSEnsemble::AddMember(CNFDRSParams params, const char* name)
+{
+	m_params.push_back(params);
+	m_names.push_back(name ? name : "");
+	m_members.emplace_back();
+	m_params.back().InitNFDRS(&m_members.back());
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Starts every member from a saved state, keeping each member's own
+    configuration.
+
+    NFDRS4::LoadState() also restores the fuel model, latitude and other
+    settings saved with the state, which would make all members the same. The
+    state is loaded into a scratch NFDRS4 instead and only its evolving state
+    (stick profiles, GSI and precipitation windows, KBDI, ...) is copied into
+    the members with NFDRS4::CopyStateFrom().
+    \param[in] state Loaded state file.
+ */
+void CNFDRSEnsemble::LoadState(const NFDRS4State& state)
+{
+	NFDRS4 scratch;
+	scratch.LoadState(state);
+	for (size_t m = 0; m < m_members.size(); m++)
+		m_members[m].CopyStateFrom(scratch);
+}
+
+const char* CNFDRSEnsemble::GetOutputName(ENSEMBLE_OUTPUTS output)
+{
+	static const char* names[] = { "MC1", "MC10", "MC100", "MC1000", "MCHERB", "MCWOOD", "FuelTemp",
+		"BI", "ERC", "SC", "IC", "GSI", "KBDI" };
+	if (output < 0 || output >= ENS_NUM_OUTPUTS)
+		return "";
+	return names[output];
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs all members over the forcing and writes one csv row per output
+    record, with ENS_NUM_OUTPUTS columns per member.
+    \param[in] forcing Decoded weather shared by all members.
+    \param[in] outputFile Output csv file name (overwritten).
+    \param[in] outputInterval 0 = each record, 1 = daily at the first member's ObsHour.
+    \param[in] backgroundOutput Write the output file from a background thread.
+    \return 0 on success, -3 if the output file could not be opened.
+ */
+int CNFDRSEnsemble::Run(const CNFDRSForcing& forcing, const char* outputFile, int outputInterval, bool backgroundOutput/* = false*/)
+{
+	if (m_members.size() == 0)
+		return 0;
+	CNFDRSOutputWriter out;
+	if (!out.Open(outputFile, backgroundOutput))
+	{
+		printf("Error opening %s as output.\n", outputFile);
+		return -3;
+	}
+	int nMembers = (int)m_members.size();
+	out.Text(CFW21Data::GetFieldName(CFW21Data::FW21_STATION) + "," + CFW21Data::GetFieldName(CFW21Data::FW21_DATE));
+	for (int m = 0; m < nMembers; m++)
+	{
+		for (int o = 0; o < ENS_NUM_OUTPUTS; o++)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), ",M%d_%s", m + 1, GetOutputName((ENSEMBLE_OUTPUTS)o));
+			out.Text(name);
+		}
+	}
+	out.EndRow();
+
+	int obsHour = m_params[0].getObsHour();
+	size_t nRecs = forcing.GetNumRecs();
+	vector<double> results(m_blockSize * nMembers * ENS_NUM_OUTPUTS);
+	for (size_t start = 0; start < nRecs; start += m_blockSize)
+	{
+		size_t end = min(nRecs, start + m_blockSize);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int m = 0; m < nMembers; m++)
+		{
+			NFDRS4& calc = m_members[m];
+			for (size_t r = start; r < end; r++)
+			{
+				calc.Update(forcing.m_year[r], forcing.m_month[r], forcing.m_day[r], forcing.m_hour[r], forcing.m_temp[r], forcing.m_rh[r],
+					forcing.m_precip[r], forcing.m_solarRad[r], forcing.m_windSpeed[r], forcing.m_snowFlag[r] != 0);
+				double* res = &results[((r - start) * nMembers + m) * ENS_NUM_OUTPUTS];
+				res[ENS_MC1] = calc.MC1;
+				res[ENS_MC10] = calc.MC10;
+				res[ENS_MC100] = calc.MC100;
+				res[ENS_MC1000] = calc.MC1000;
+				res[ENS_MCHERB] = calc.MCHERB;
+				res[ENS_MCWOOD] = calc.MCWOOD;
+				res[ENS_FUELTEMP] = calc.GetFuelTemperature();
+				res[ENS_BI] = calc.BI;
+				res[ENS_ERC] = calc.ERC;
+				res[ENS_SC] = calc.SC;
+				res[ENS_IC] = calc.IC;
+				res[ENS_GSI] = calc.m_GSI;
+				res[ENS_KBDI] = calc.KBDI;
+			}
+		}
+		for (size_t r = start; r < end; r++)
+		{
+			if (outputInterval != 0 && !(outputInterval == 1 && forcing.m_hour[r] == obsHour))
+				continue;
+			out.Text(forcing.m_station[r]);
+			out.Char(',');
+			out.Text(forcing.m_dateTime[r]);
+			for (int m = 0; m < nMembers; m++)
+			{
+				//moistures and fuel temperature as "%.10f", indexes "%.2f", GSI "%.10f", KBDI "%d"
+				const double* res = &results[((r - start) * nMembers + m) * ENS_NUM_OUTPUTS];
+				for (int o = ENS_MC1; o < ENS_KBDI; o++)
+				{
+					out.Char(',');
+					out.Fixed(res[o], (o >= ENS_BI && o <= ENS_IC) ? 2 : 10);
+				}
+				out.Char(',');
+				out.Int((int)res[ENS_KBDI]);
+			}
+			out.EndRow();
+		}
+	}
+	out.Close();
+	return 0;
+}
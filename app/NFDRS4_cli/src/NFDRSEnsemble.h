@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "nfdrs4.h"
+#include "nfdrs4calcstate.h"
+#include "CNFDRSParams.h"
+#include "fw21.h"
+
+//------------------------------------------------------------------------------
+/*! \class CNFDRSForcing NFDRSEnsemble.h
+    \brief Hourly weather forcing for one station, decoded once from a CFW21Data
+    (units, time base and output date strings) and shared read only by every
+    member of a CNFDRSEnsemble.
+ */
+class CNFDRSForcing
+{
+public:
+	CNFDRSForcing();
+	~CNFDRSForcing();
+
+	void Load(CFW21Data& data);
+	size_t GetNumRecs() const { return m_year.size(); }
+
+	std::vector<std::string> m_station;
+	std::vector<std::string> m_dateTime;//original (local) ISO8601 date strings for output
+	std::vector<int> m_year;
+	std::vector<int> m_month;
+	std::vector<int> m_day;
+	std::vector<int> m_hour;
+	std::vector<double> m_temp;
+	std::vector<double> m_rh;
+	std::vector<double> m_precip;
+	std::vector<double> m_solarRad;
+	std::vector<double> m_windSpeed;
+	std::vector<char> m_snowFlag;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CNFDRSEnsemble NFDRSEnsemble.h
+    \brief Runs K independently parameterized NFDRS4 instances over the same
+    CNFDRSForcing in lockstep and writes all members to one columnar csv file.
+
+    Records are processed in blocks; within a block the members are updated in
+    parallel (OpenMP, when available) and their outputs buffered, then the block
+    is written in record order. Each member keeps its own state, including its
+    24 hour and precipitation windows, so results match running each member alone.
+ */
+class CNFDRSEnsemble
+{
+public:
+	CNFDRSEnsemble();
+	~CNFDRSEnsemble();
+
+	void AddMember(CNFDRSParams params, const char* name);
+	size_t GetNumMembers() const { return m_members.size(); }
+	const char* GetMemberName(size_t m) const { return m_names[m].c_str(); }
+	NFDRS4& GetMember(size_t m) { return m_members[m]; }
+	void LoadState(const NFDRS4State& state);
+	int Run(const CNFDRSForcing& forcing, const char* outputFile, int outputInterval, bool backgroundOutput = false);
+
+	enum ENSEMBLE_OUTPUTS { ENS_MC1, ENS_MC10, ENS_MC100, ENS_MC1000, ENS_MCHERB, ENS_MCWOOD, ENS_FUELTEMP,
+		ENS_BI, ENS_ERC, ENS_SC, ENS_IC, ENS_GSI, ENS_KBDI, ENS_NUM_OUTPUTS };
+	static const char* GetOutputName(ENSEMBLE_OUTPUTS output);
+
+private:
+	std::vector<CNFDRSParams> m_params;
+	std::vector<std::string> m_names;
+	std::vector<NFDRS4> m_members;
+	size_t m_blockSize;//records per lockstep block
+};
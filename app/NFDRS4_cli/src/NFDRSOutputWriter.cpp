@@ -0,0 +1,159 @@
+#include "NFDRSOutputWriter.h"
+#include <charconv>
+#include <cstring>
+using namespace std;
+
+//longest "%.10f" of a double is 309 digits, sign, point and decimals
+static const size_t maxFieldChars = 400;
+
+CNFDRSOutputWriter::CNFDRSOutputWriter(size_t bufferSize/* = 1024 * 1024*/)
+{
+	m_file = NULL;
+	m_buf.resize(bufferSize < 2 * maxFieldChars ? 2 * maxFieldChars : bufferSize);
+	m_used = 0;
+	m_background = false;
+	m_pendingUsed = 0;
+	m_hasPending = false;
+	m_stop = false;
+}
+
+CNFDRSOutputWriter::~CNFDRSOutputWriter()
+{
+	Close();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Creates (or truncates) a csv file.
+    \param[in] fileName File name.
+    \param[in] backgroundThread Write full buffers from a background thread.
+    \return false if the file cannot be created.
+ */
+bool CNFDRSOutputWriter::Open(const char* fileName, bool backgroundThread/* = false*/)
+{
+	Close();
+	m_file = fopen(fileName, "wt");
+	if (!m_file)
+		return false;
+	m_used = 0;
+	m_background = backgroundThread;
+	if (m_background)
+	{
+		m_pending.resize(m_buf.size());
+		m_hasPending = false;
+		m_stop = false;
+		m_thread = thread(&CNFDRSOutputWriter::WriteLoop, this);
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Writes what is buffered and closes the file.
+ */
+void CNFDRSOutputWriter::Close()
+{
+	if (!m_file)
+		return;
+	Flush();
+	if (m_background)
+	{
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		m_thread.join();
+		m_background = false;
+	}
+	fclose(m_file);
+	m_file = NULL;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Background thread: writes each buffer handed over by Flush().
+ */
+void CNFDRSOutputWriter::WriteLoop()
+{
+	unique_lock<mutex> lock(m_mutex);
+	while (true)
+	{
+		m_cv.wait(lock, [this] { return m_hasPending || m_stop; });
+		if (m_hasPending)
+		{
+			fwrite(m_pending.data(), 1, m_pendingUsed, m_file);
+			m_hasPending = false;
+			m_cv.notify_all();
+		}
+		else if (m_stop)
+			break;
+	}
+}
+
+void CNFDRSOutputWriter::Flush()
+{
+	if (m_used == 0)
+		return;
+	if (!m_background)
+		fwrite(m_buf.data(), 1, m_used, m_file);
+	else
+	{
+		unique_lock<mutex> lock(m_mutex);
+		m_cv.wait(lock, [this] { return !m_hasPending; });
+		m_pending.swap(m_buf);
+		m_pendingUsed = m_used;
+		m_hasPending = true;
+		m_buf.resize(m_pending.size());
+		lock.unlock();
+		m_cv.notify_all();
+	}
+	m_used = 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns room for len more characters, flushing the buffer if needed.
+ */
+char* CNFDRSOutputWriter::Reserve(size_t len)
+{
+	if (m_used + len > m_buf.size())
+	{
+		Flush();
+		if (len > m_buf.size())
+			m_buf.resize(len);
+	}
+	return m_buf.data() + m_used;
+}
+
+void CNFDRSOutputWriter::Text(const char* text, size_t len)
+{
+	memcpy(Reserve(len), text, len);
+	m_used += len;
+}
+
+void CNFDRSOutputWriter::Text(const char* text)
+{
+	Text(text, strlen(text));
+}
+
+void CNFDRSOutputWriter::Char(char c)
+{
+	*Reserve(1) = c;
+	m_used++;
+}
+
+void CNFDRSOutputWriter::Fixed(double value, int precision)
+{
+	char* p = Reserve(maxFieldChars);
+	to_chars_result res = to_chars(p, p + maxFieldChars, value, chars_format::fixed, precision);
+	m_used += res.ptr - p;
+}
+
+void CNFDRSOutputWriter::Int(int value)
+{
+	char* p = Reserve(16);
+	to_chars_result res = to_chars(p, p + 16, value);
+	m_used += res.ptr - p;
+}
+
+void CNFDRSOutputWriter::EndRow()
+{
+	Char('\n');
+}
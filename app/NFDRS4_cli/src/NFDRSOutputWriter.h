@@ -0,0 +1,53 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+/*! \class CNFDRSOutputWriter NFDRSOutputWriter.h
+    \brief Buffered csv writer for NFDRS4_cli result files.
+
+    Fields are formatted with std::to_chars into a large reusable buffer,
+    giving the same text as the printf formats they replace ("%.Nf", "%d"),
+    and the buffer is written in big blocks. With a background thread a full
+    buffer is handed to the thread and formatting continues in a second one.
+ */
+class CNFDRSOutputWriter
+{
+public:
+	CNFDRSOutputWriter(size_t bufferSize = 1024 * 1024);
+	~CNFDRSOutputWriter();
+
+	bool Open(const char* fileName, bool backgroundThread = false);
+	void Close();
+	bool IsOpen() const { return m_file != NULL; }
+
+	void Text(const char* text, size_t len);
+	void Text(const char* text);
+	void Text(const std::string& text) { Text(text.data(), text.size()); }
+	void Char(char c);
+	void Fixed(double value, int precision);//as printf("%.<precision>f")
+	void Int(int value);//as printf("%d")
+	void EndRow();
+
+private:
+	char* Reserve(size_t len);
+	void Flush();
+	void WriteLoop();
+
+	FILE* m_file;
+	std::vector<char> m_buf;
+	size_t m_used;
+	//background writing
+	bool m_background;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::vector<char> m_pending;
+	size_t m_pendingUsed;
+	bool m_hasPending;
+	bool m_stop;
+};
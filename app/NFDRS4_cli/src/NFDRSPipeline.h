@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+/*! \class CNFDRSQueue NFDRSPipeline.h
+    \brief Bounded lock-free queue between one producer and one consumer thread.
+
+    Items are moved through a fixed ring of slots, so a producer that gets
+    ahead of its consumer waits for a free slot instead of growing memory.
+    A waiting thread yields for a while and then sleeps briefly, so an idle
+    stage does not take a core from the stage it waits for. The producer
+    calls Close() after its last item and Pop() returns false once the queue
+    is closed and empty.
+ */
+template <class T>
+class CNFDRSQueue
+{
+public:
+	CNFDRSQueue(size_t capacity)
+		: m_slots(capacity + 1), m_head(0), m_tail(0), m_closed(false)
+	{
+	}
+
+	//------------------------------------------------------------------------------
+	/*! \brief Producer: moves item into the queue, waiting while it is full.
+	 */
+	void Push(T& item)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) % m_slots.size();
+		for (int tries = 0; next == m_head.load(std::memory_order_acquire); tries++)
+			Wait(tries);
+		m_slots[tail] = std::move(item);
+		m_tail.store(next, std::memory_order_release);
+	}
+
+	//------------------------------------------------------------------------------
+	/*! \brief Producer: no more items follow.
+	 */
+	void Close()
+	{
+		m_closed.store(true, std::memory_order_release);
+	}
+
+	//------------------------------------------------------------------------------
+	/*! \brief Consumer: moves the next item out of the queue, waiting while it is empty.
+	    \param[out] item The item.
+	    \return false if the queue is closed and empty.
+	 */
+	bool Pop(T& item)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		for (int tries = 0; head == m_tail.load(std::memory_order_acquire); tries++)
+		{
+			//items pushed before Close() are visible once it is seen
+			if (m_closed.load(std::memory_order_acquire) && head == m_tail.load(std::memory_order_acquire))
+				return false;
+			Wait(tries);
+		}
+		item = std::move(m_slots[head]);
+		m_head.store((head + 1) % m_slots.size(), std::memory_order_release);
+		return true;
+	}
+
+private:
+	static void Wait(int tries)
+	{
+		if (tries < 64)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+
+	std::vector<T> m_slots;//one slot is always free to tell full from empty
+	alignas(64) std::atomic<size_t> m_head;//next slot to pop, written by the consumer
+	alignas(64) std::atomic<size_t> m_tail;//next slot to push, written by the producer
+	std::atomic<bool> m_closed;
+};
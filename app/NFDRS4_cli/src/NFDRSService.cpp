@@ -0,0 +1,193 @@
+#include "NFDRSService.h"
+#include "csv_readrow.h"
+#include <stdio.h>
+using namespace std;
+
+CNFDRSService::CNFDRSService()
+{
+	m_haveHeader = false;
+	m_stationCol = -1;
+	m_dateCol = -1;
+	m_failedSaves = 0;
+}
+
+CNFDRSService::~CNFDRSService()
+{
+	WaitForCheckpoint();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Adds a station with its initialized (and state loaded) model.
+    \param[in] run The station and its saveStateFile.
+    \param[in] tzOffsetHours The station's UTC offset, applied to Zulu times.
+    \param[in] calc The station's model, copied.
+ */
+void CNFDRSService::AddStation(const NFDRSStationRun& run, int tzOffsetHours, const NFDRS4& calc)
+{
+	unique_ptr<NFDRSServiceStation> station(new NFDRSServiceStation(run, tzOffsetHours, calc));
+	m_stationIds[run.stationID] = m_stations.size();
+	m_stations.push_back(move(station));
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads requests from in and writes a reply to out for each, see
+    CNFDRSService, until QUIT or the end of in.
+    \return 0, or -1 if a checkpoint could not save a station's state.
+ */
+int CNFDRSService::Run(istream& in, FILE* out)
+{
+	fprintf(out, "OK,READY,%d\n", (int)m_stations.size());
+	fflush(out);
+	string line, reply;
+	while (getline(in, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty())
+			continue;
+		if (line == "QUIT")
+			break;
+		if (line == "CHECKPOINT")
+		{
+			char buf[64];
+			sprintf(buf, "OK,CHECKPOINT,%d", Checkpoint(false));
+			reply = buf;
+		}
+		else if (line.find(CFW21Data::GetFieldName(CFW21Data::FW21_DATE)) != string::npos)
+			SetHeader(line, reply);
+		else
+			Update(line, reply);
+		fprintf(out, "%s\n", reply.c_str());
+		fflush(out);
+	}
+	Checkpoint(true);
+	fprintf(out, "OK,QUIT\n");
+	fflush(out);
+	return m_failedSaves > 0 ? -1 : 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Parser messages on one reply line.
+ */
+static string OneLine(string message)
+{
+	for (size_t c = 0; c < message.size(); c++)
+	{
+		if (message[c] == '\n' || message[c] == '\r')
+			message[c] = ' ';
+	}
+	return trim(message);
+}
+
+static bool ErrorReply(const string& message, string& reply)
+{
+	reply = "ERROR," + OneLine(message);
+	return false;
+}
+
+bool CNFDRSService::SetHeader(string& line, string& reply)
+{
+	vector<string> vFields = csv_read_row(line, ',');
+	for (size_t f = 0; f < vFields.size(); f++)
+		trim(vFields[f]);
+	m_haveHeader = false;
+	m_stationCol = getColIndex(CFW21Data::GetFieldName(CFW21Data::FW21_STATION), vFields);
+	m_dateCol = getColIndex(CFW21Data::GetFieldName(CFW21Data::FW21_DATE), vFields);
+	if (m_stationCol < 0)
+		return ErrorReply("field " + CFW21Data::GetFieldName(CFW21Data::FW21_STATION) + " not found in header", reply);
+	string messages;
+	if (m_parser.OpenLineParser(line, 0, false, &messages) != 0)
+		return ErrorReply(messages, reply);
+	m_haveHeader = true;
+	reply = "OK,HEADER";
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Updates a station's model with one record line.
+    \param[in] line The record.
+    \param[out] reply The station's indexes, or the error.
+    \return false if the record was not used.
+ */
+bool CNFDRSService::Update(string& line, string& reply)
+{
+	if (!m_haveHeader)
+		return ErrorReply("no header", reply);
+	vector<string> vRow = csv_read_row(line, ',');
+	if ((int)vRow.size() <= max(m_stationCol, m_dateCol))
+		return ErrorReply("record has too few fields", reply);
+	string stationID = trim(vRow[m_stationCol]);
+	map<string, size_t>::iterator it = m_stationIds.find(stationID);
+	if (it == m_stationIds.end())
+		return ErrorReply("unknown station " + stationID, reply);
+	NFDRSServiceStation& station = *m_stations[it->second];
+	FW21Record rec;
+	string messages;
+	m_parser.SetTimeZoneOffset(station.tzOffsetHours);
+	bool accepted = m_parser.ParseLine(line, rec, &messages);
+	if (!accepted)
+		return ErrorReply(messages.empty() ? "record rejected" : messages, reply);
+	NFDRS4& calc = station.calc;
+	calc.Update(rec.GetYear(), rec.GetMonth(), rec.GetDay(), rec.GetHour(), rec.GetTemp(), rec.GetRH(), rec.GetPrecip(),
+		rec.GetSolarRadiation(), rec.GetWindSpeed(), rec.GetSnowFlag());
+	station.updated = true;
+	char buf[256];
+	snprintf(buf, sizeof(buf), ",%.2f,%.2f,%.2f,%.2f,%.10f,%d", calc.BI, calc.ERC, calc.SC, calc.IC, calc.m_GSI, calc.KBDI);
+	reply = stationID + "," + trim(vRow[m_dateCol]) + buf;
+	if (!messages.empty())
+		reply += ",WARNING," + OneLine(messages);
+	return true;
+}
+
+void CNFDRSService::WaitForCheckpoint()
+{
+	if (m_checkpointThread.joinable())
+		m_checkpointThread.join();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Saves the state of each station updated since the last checkpoint.
+    The states are copied before returning and written by a background thread,
+    after any earlier checkpoint has finished.
+    \param[in] wait Wait for the states to be written.
+    \return The number of stations saved.
+ */
+int CNFDRSService::Checkpoint(bool wait)
+{
+	vector<pair<string, NFDRS4State> > states;
+	vector<NFDRSServiceStation*> stations;
+	//finish the previous checkpoint first, it may mark stations to retry
+	WaitForCheckpoint();
+	for (size_t s = 0; s < m_stations.size(); s++)
+	{
+		NFDRSServiceStation& station = *m_stations[s];
+		if (!station.updated || station.run.saveStateFile.empty())
+			continue;
+		states.push_back(make_pair(station.run.saveStateFile, NFDRS4State(&station.calc)));
+		stations.push_back(&station);
+		station.updated = false;
+	}
+	int nStates = (int)states.size();
+	m_checkpointThread = thread([this, stations](vector<pair<string, NFDRS4State> > states)
+	{
+		for (size_t s = 0; s < states.size(); s++)
+		{
+			string tmpFile = states[s].first + ".tmp";
+			bool saved = states[s].second.SaveState(tmpFile);
+#ifdef WIN32
+			if (saved)
+				remove(states[s].first.c_str());
+#endif
+			if (!saved || rename(tmpFile.c_str(), states[s].first.c_str()) != 0)
+			{
+				fprintf(stderr, "Error saving %s as NFDRS State file\n", states[s].first.c_str());
+				m_failedSaves++;
+				//save it again at the next checkpoint, even without new observations
+				stations[s]->updated = true;
+			}
+		}
+	}, move(states));
+	if (wait)
+		WaitForCheckpoint();
+	return nStates;
+}
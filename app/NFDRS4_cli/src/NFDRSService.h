@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nfdrs4.h"
+#include "NFDRSBatch.h"
+#include "fw21.h"
+
+//------------------------------------------------------------------------------
+/*! \struct NFDRSServiceStation NFDRSService.h
+    \brief One resident station of a CNFDRSService.
+ */
+struct NFDRSServiceStation
+{
+	NFDRSServiceStation(const NFDRSStationRun& run, int tzOffsetHours, const NFDRS4& calc)
+		: run(run), calc(calc), tzOffsetHours(tzOffsetHours), updated(false) {}
+
+	NFDRSStationRun run;
+	NFDRS4 calc;
+	int tzOffsetHours;//applied to its Zulu times
+	std::atomic<bool> updated;//since the last checkpoint, or its state failed to save
+};
+
+//------------------------------------------------------------------------------
+/*! \class CNFDRSService NFDRSService.h
+    \brief Keeps the NFDRS4 states of many stations in memory and updates them
+    with observations that arrive one line at a time.
+
+    The line protocol (one reply line per request line):
+    - a FW21 csv header (any line naming the DateTime field), with a
+      StationID column, sets the fields of the following records; reply
+      "OK,HEADER".
+    - a FW21 csv record updates its station; reply
+      "StationID,DateTime,BI,ERC,SC,IC,GSI,KBDI" formatted as in an
+      indexOutputFile, with the DateTime as sent, followed by
+      ",WARNING,<message>" if the record has a non-fatal warning.
+    - CHECKPOINT saves the state of every station updated since the last
+      checkpoint to its saveToStateFile, from a background thread; reply
+      "OK,CHECKPOINT,<stations>".
+    - QUIT (or the end of the input) saves a final checkpoint and stops;
+      reply "OK,QUIT".
+    Errors are replied as "ERROR,<message>". After loading the stations
+    Run() writes "OK,READY,<stations>" before reading any request.
+
+    A state file is written as <file>.tmp and renamed, so a crash during a
+    checkpoint leaves the previous state in place. A station whose state could
+    not be written stays marked as updated, so the next checkpoint retries it.
+ */
+class CNFDRSService
+{
+public:
+	CNFDRSService();
+	~CNFDRSService();
+
+	void AddStation(const NFDRSStationRun& run, int tzOffsetHours, const NFDRS4& calc);
+	size_t GetNumStations() const { return m_stations.size(); }
+	int Run(std::istream& in, FILE* out);
+	int Checkpoint(bool wait);
+
+private:
+	bool SetHeader(std::string& line, std::string& reply);
+	bool Update(std::string& line, std::string& reply);
+	void WaitForCheckpoint();
+
+	std::vector<std::unique_ptr<NFDRSServiceStation> > m_stations;
+	std::map<std::string, size_t> m_stationIds;
+	CFW21Data m_parser;
+	bool m_haveHeader;
+	int m_stationCol;//StationID and DateTime columns of the header
+	int m_dateCol;
+	std::thread m_checkpointThread;
+	std::atomic<int> m_failedSaves;//state files not written
+};
@@ -5,13 +5,24 @@
 #include "RunNFDRSConfiguration.h"
 #include "NFDRSConfiguration.h"
 #include "CNFDRSParams.h"
+#include "NFDRSEnsemble.h"
+#include "NFDRSOutputWriter.h"
+#include "NFDRSBatch.h"
+#include "NFDRSPipeline.h"
+#include "NFDRSService.h"
 #include "fw21.h"
+#include "fw21index.h"
+#include "fw21binary.h"
+#include "fw13.h"
 #ifdef WIN32
 #include <io.h>
 #else
 #include <unistd.h>
 #endif
 #include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <mutex>
 using namespace std;
 
 string FormatToISO8061Offset(TM inTm, int offset)
@@ -23,6 +34,138 @@ string FormatToISO8061Offset(TM inTm, int offset)
 	return ret;
 }
 
+//------------------------------------------------------------------------------
+/*! \struct NFDRSOutputRow
+    \brief One output record of a station: its weather and the model results
+    written to the NFDRS4_cli csv files.
+ */
+struct NFDRSOutputRow
+{
+	FW21Record wx;
+	string dateTime;//as in the weather file
+	double moistures[7];//MC1, MC10, MC100, MC1000, MCHERB, MCWOOD, FuelTemp
+	double indexes[4];//BI, ERC, SC, IC
+	double GSI;
+	int KBDI;
+	vector<NFDRS4Indexes> fuelModelIndexes;//empty unless fuelModelIndexOutputFile is written
+};
+
+//------------------------------------------------------------------------------
+/*! \struct NFDRSOutputFiles
+    \brief The csv files of one station run, unused files are not open.
+ */
+struct NFDRSOutputFiles
+{
+	CNFDRSOutputWriter allOut;
+	CNFDRSOutputWriter indexOut;
+	CNFDRSOutputWriter moistOut;
+	CNFDRSOutputWriter fuelModelIndexOut;
+};
+
+//------------------------------------------------------------------------------
+/*! \brief Writes ",MC1,MC10,MC100,MC1000,MCHERB,MCWOOD,FuelTemp" as "%.10f".
+ */
+static void WriteMoistures(CNFDRSOutputWriter& out, const NFDRSOutputRow& row)
+{
+	for (int v = 0; v < 7; v++)
+	{
+		out.Char(',');
+		out.Fixed(row.moistures[v], 10);
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Writes ",BI,ERC,SC,IC,GSI,KBDI" as "%.2f" indexes, "%.10f" GSI and "%d" KBDI.
+ */
+static void WriteIndexes(CNFDRSOutputWriter& out, const NFDRSOutputRow& row)
+{
+	for (int v = 0; v < 4; v++)
+	{
+		out.Char(',');
+		out.Fixed(row.indexes[v], 2);
+	}
+	out.Char(',');
+	out.Fixed(row.GSI, 10);
+	out.Char(',');
+	out.Int(row.KBDI);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Writes one output record to each open csv file.
+ */
+static void WriteRow(NFDRSOutputFiles& out, NFDRSOutputRow& row)
+{
+	FW21Record& rec = row.wx;
+	string station = rec.GetStation();
+	if (out.allOut.IsOpen())
+	{
+		CNFDRSOutputWriter& allOut = out.allOut;
+		allOut.Text(station);
+		allOut.Char(',');
+		allOut.Text(row.dateTime);
+		allOut.Char(',');
+		allOut.Fixed(rec.GetTemp(), 1);
+		allOut.Char(',');
+		allOut.Fixed(rec.GetRH(), 1);
+		allOut.Char(',');
+		allOut.Fixed(rec.GetPrecip(), 3);
+		allOut.Char(',');
+		allOut.Fixed(rec.GetWindSpeed(), 1);
+		allOut.Char(',');
+		allOut.Int(rec.GetWindAzimuth());
+		allOut.Char(',');
+		allOut.Fixed(rec.GetSolarRadiation(), 1);
+		allOut.Char(',');
+		allOut.Int(rec.GetSnowFlag());
+		allOut.Char(',');
+		allOut.Fixed(rec.GetGustSpeed(), 1);
+		allOut.Char(',');
+		allOut.Int(rec.GetGustAzimuth());
+		WriteMoistures(allOut, row);
+		WriteIndexes(allOut, row);
+		allOut.EndRow();
+	}
+	if (out.indexOut.IsOpen())
+	{
+		out.indexOut.Text(station);
+		out.indexOut.Char(',');
+		out.indexOut.Text(row.dateTime);
+		WriteIndexes(out.indexOut, row);
+		out.indexOut.EndRow();
+	}
+	if (out.fuelModelIndexOut.IsOpen())
+	{
+		CNFDRSOutputWriter& fuelModelIndexOut = out.fuelModelIndexOut;
+		fuelModelIndexOut.Text(station);
+		fuelModelIndexOut.Char(',');
+		fuelModelIndexOut.Text(row.dateTime);
+		for (size_t f = 0; f < row.fuelModelIndexes.size(); f++)
+		{
+			const NFDRS4Indexes& idx = row.fuelModelIndexes[f];
+			if (idx.Valid)
+			{
+				const double values[] = { idx.BI, idx.ERC, idx.SC, idx.IC };
+				for (int v = 0; v < 4; v++)
+				{
+					fuelModelIndexOut.Char(',');
+					fuelModelIndexOut.Fixed(values[v], 2);
+				}
+			}
+			else
+				fuelModelIndexOut.Text(",,,,", 4);
+		}
+		fuelModelIndexOut.EndRow();
+	}
+	if (out.moistOut.IsOpen())
+	{
+		out.moistOut.Text(station);
+		out.moistOut.Char(',');
+		out.moistOut.Text(row.dateTime);
+		WriteMoistures(out.moistOut, row);
+		out.moistOut.EndRow();
+	}
+}
+
 bool fileExists(const char *fileName)
 {
 	bool ret = false;
@@ -31,6 +174,424 @@ bool fileExists(const char *fileName)
 	return ret;
 }
 
+//------------------------------------------------------------------------------
+/*! \brief Opens one output csv file and writes its header.
+    \return false if the file cannot be created.
+ */
+static bool OpenOutput(CNFDRSOutputWriter& out, const string& fileName, bool backgroundOutput, const string& header)
+{
+	if (!out.Open(fileName.c_str(), backgroundOutput))
+	{
+		printf("Error opening %s as output.\n", fileName.c_str());
+		return false;
+	}
+	out.Text(header);
+	out.EndRow();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Updates the station's model with one weather record.
+    \param[in] cfg The NFDRS4_cli configuration.
+    \param[in] params The station's NFDRSInit parameters.
+    \param[in] fw21Calc The station's NFDRS4.
+    \param[in] FW21data The station's weather, for the output date format.
+    \param[in] indexFuelModels Extra fuel models, empty for none.
+    \param[in] fw21Rec The weather record.
+    \param[out] row The record's outputs, if it is an output record.
+    \return true if the record is written to the outputs (see outputInterval).
+ */
+static bool UpdateStation(RunNFDRSConfiguration* cfg, CNFDRSParams& params, NFDRS4& fw21Calc, CFW21Data& FW21data,
+	const vector<char>& indexFuelModels, FW21Record& fw21Rec, NFDRSOutputRow& row)
+{
+	if (cfg->getUseStoredOutputs() != 0)
+	{
+		fw21Calc.iSetFuelMoistures(fw21Rec.GetMx1(), fw21Rec.GetMx10(),
+			fw21Rec.GetMx100(), fw21Rec.GetMx1000(), fw21Rec.GetMxWood(), fw21Rec.GetMxHerb(),
+			fw21Rec.GetFuelTTempC());
+		double tSC, tERC, tBI, tIC;
+		fw21Calc.iCalcIndexes(fw21Rec.GetWindSpeed(), params.getSlopeClass(), &tSC, &tERC, &tBI, &tIC, fw21Rec.GetGSI(), fw21Rec.GetKBDI());
+		//are these even necessary????????? Yes - Stu 10/24/2024
+		fw21Calc.SC = tSC;
+		fw21Calc.ERC = tERC;
+		fw21Calc.BI = tBI;
+		fw21Calc.IC = tIC;
+		fw21Calc.KBDI = fw21Rec.GetKBDI();
+		fw21Calc.m_GSI = fw21Rec.GetGSI();
+	}
+	else
+		fw21Calc.Update(fw21Rec.GetYear(), fw21Rec.GetMonth(), fw21Rec.GetDay(), fw21Rec.GetHour(), fw21Rec.GetTemp(), fw21Rec.GetRH(), fw21Rec.GetPrecip(),
+			fw21Rec.GetSolarRadiation(), fw21Rec.GetWindSpeed(), fw21Rec.GetSnowFlag());
+	if (!(cfg->getOutputInterval() == 0 || (cfg->getOutputInterval() == 1 && fw21Rec.GetHour() == params.getObsHour())))
+		return false;
+	row.dateTime = FW21data.DateToOriginal(fw21Rec.GetDateTime(), fw21Rec.GetTimeZoneOffset());
+	const double moistures[] = { fw21Calc.MC1, fw21Calc.MC10, fw21Calc.MC100, fw21Calc.MC1000, fw21Calc.MCHERB, fw21Calc.MCWOOD, fw21Calc.GetFuelTemperature() };
+	const double indexes[] = { fw21Calc.BI, fw21Calc.ERC, fw21Calc.SC, fw21Calc.IC };
+	copy(moistures, moistures + 7, row.moistures);
+	copy(indexes, indexes + 4, row.indexes);
+	row.GSI = fw21Calc.m_GSI;
+	row.KBDI = fw21Calc.KBDI;
+	if (indexFuelModels.size() > 0)
+	{
+		if (cfg->getUseStoredOutputs() != 0)
+			fw21Calc.iCalcIndexesForFuelModels(fw21Rec.GetWindSpeed(), params.getSlopeClass(), indexFuelModels, row.fuelModelIndexes, fw21Rec.GetGSI(), fw21Rec.GetKBDI());
+		else
+			fw21Calc.iCalcIndexesForFuelModels(fw21Rec.GetWindSpeed(), params.getSlopeClass(), indexFuelModels, row.fuelModelIndexes);
+	}
+	row.wx = fw21Rec;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs a station in three stages: a thread reading weather records,
+    the model on the calling thread and a thread writing the outputs.
+
+    Records pass between the stages in batches through bounded queues, so a
+    stage that gets ahead waits and memory stays at a few batches, while
+    parsing and formatting overlap the fuel moisture models.
+ */
+static void RunStationPipelined(RunNFDRSConfiguration* cfg, CNFDRSParams& params, NFDRS4& fw21Calc, CFW21Data& FW21data,
+	const vector<char>& indexFuelModels, NFDRSOutputFiles& out)
+{
+	const size_t batchSize = 512;
+	const size_t queueBatches = 8;
+	CNFDRSQueue<vector<FW21Record> > wxQueue(queueBatches);
+	CNFDRSQueue<vector<NFDRSOutputRow> > rowQueue(queueBatches);
+	thread reader([&]()
+	{
+		vector<FW21Record> recs;
+		while (FW21data.ReadRecords(recs, batchSize) > 0)
+		{
+			wxQueue.Push(recs);
+			recs = vector<FW21Record>();
+		}
+		wxQueue.Close();
+	});
+	thread writer([&]()
+	{
+		vector<NFDRSOutputRow> rows;
+		while (rowQueue.Pop(rows))
+		{
+			for (size_t r = 0; r < rows.size(); r++)
+				WriteRow(out, rows[r]);
+		}
+	});
+	vector<FW21Record> recs;
+	vector<NFDRSOutputRow> rows;
+	NFDRSOutputRow row;
+	while (wxQueue.Pop(recs))
+	{
+		for (size_t r = 0; r < recs.size(); r++)
+		{
+			if (UpdateStation(cfg, params, fw21Calc, FW21data, indexFuelModels, recs[r], row))
+				rows.push_back(row);
+		}
+		if (rows.size() >= batchSize)
+		{
+			rowQueue.Push(rows);
+			rows = vector<NFDRSOutputRow>();
+		}
+	}
+	if (rows.size() > 0)
+		rowQueue.Push(rows);
+	rowQueue.Close();
+	reader.join();
+	writer.join();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Prints where NFDRS4 spent its time, when the library is built with
+    NFDRS4_PERF_COUNTERS (see nfdrs4perf.h); otherwise prints nothing.
+ */
+static void PrintPerfCounters(FILE* out)
+{
+	NFDRS4PerfCounters counters = NFDRS4::GetPerfCounters();
+	if (!counters.enabled)
+		return;
+	double totalNs = 0.0;
+	for (int p = 0; p < NFDRS4_PERF_PHASES; p++)
+	{
+		//diffusivity time is also in the stick phases
+		if (p != NFDRS4_PERF_DIFFUSIVITY)
+			totalNs += (double)counters.nanoseconds[p];
+	}
+	fprintf(out, "NFDRS4 phase      calls       seconds   ns/call  %% of update\n");
+	for (int p = 0; p < NFDRS4_PERF_PHASES; p++)
+	{
+		double ns = (double)counters.nanoseconds[p];
+		fprintf(out, "%-12s %10llu %13.3f %9.1f  %5.1f\n", NFDRS4PerfCounters::GetPhaseName(p), counters.calls[p], ns * 1e-9,
+			counters.calls[p] > 0 ? ns / counters.calls[p] : 0.0, totalNs > 0.0 ? 100.0 * ns / totalNs : 0.0);
+	}
+	fprintf(out, "Dead fuel stick updates %llu, rejected inputs %llu, moisture time steps %llu (%.1f per update)\n", counters.dfmUpdates,
+		counters.dfmRejected, counters.dfmSubSteps, counters.dfmUpdates > 0 ? (double)counters.dfmSubSteps / counters.dfmUpdates : 0.0);
+	fprintf(out, "Dead fuel time steps by state:");
+	for (int s = 0; s < NFDRS4_PERF_DFM_STATES; s++)
+	{
+		if (counters.dfmStates[s] > 0)
+			fprintf(out, " %s %.1f%%", NFDRS4PerfCounters::GetDFMStateName(s), 100.0 * counters.dfmStates[s] / counters.dfmSubSteps);
+	}
+	fprintf(out, "\n");
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs one station over its open weather stream and writes its outputs.
+    \param[in] cfg The NFDRS4_cli configuration (output interval, fuel models, ...).
+    \param[in] run The station's files.
+    \param[in] params The station's NFDRSInit parameters.
+    \param[in] fw21Calc The station's initialized NFDRS4.
+    \param[in] FW21data The station's weather, opened with OpenStream().
+    \param[in] printTime Print the processing time.
+    \return 0 on success, -3 if an output file cannot be opened.
+ */
+static int RunStation(RunNFDRSConfiguration* cfg, const NFDRSStationRun& run, CNFDRSParams& params, NFDRS4& fw21Calc, CFW21Data& FW21data, bool printTime)
+{
+	//also need any output files for dumping data, written through large buffers
+	NFDRSOutputFiles out;
+	bool backgroundOutput = cfg->getBackgroundOutput() != 0;
+	string stationDate = CFW21Data::GetFieldName(CFW21Data::FW21_STATION) + "," + CFW21Data::GetFieldName(CFW21Data::FW21_DATE);
+
+	if (run.allOutputsFile.length() > 0)
+	{
+		string header;
+		for (int fieldNum = CFW21Data::FW21_STATION; fieldNum < CFW21Data::FW21_TEMPC; fieldNum++)
+		{
+			if (fieldNum > 0)
+				header += ",";
+			header += CFW21Data::GetFieldName((CFW21Data::FW21FIELDS)fieldNum);
+		}
+		if (!OpenOutput(out.allOut, run.allOutputsFile, backgroundOutput, header))
+			return -3;
+	}
+	if (run.indexOutputFile.length() > 0)
+	{
+		string header = stationDate;
+		for (int f = CFW21Data::FW21_BI; f < CFW21Data::FW21_TEMPC; f++)
+			header += "," + CFW21Data::GetFieldName((CFW21Data::FW21FIELDS)f);
+		if (!OpenOutput(out.indexOut, run.indexOutputFile, backgroundOutput, header))
+			return -3;
+	}
+	if (run.fuelMoisturesOutputFile.length() > 0)
+	{
+		string header = stationDate;
+		for (int f = CFW21Data::FW21_DFM1; f <= CFW21Data::FW21_FUELTEMPC; f++)
+			header += "," + CFW21Data::GetFieldName((CFW21Data::FW21FIELDS)f);
+		if (!OpenOutput(out.moistOut, run.fuelMoisturesOutputFile, backgroundOutput, header))
+			return -3;
+	}
+
+	//indexes for additional fuel models, sharing this run's fuel moistures
+	vector<char> indexFuelModels;
+	if (cfg->getIndexFuelModels().size() > 0 && run.fuelModelIndexOutputFile.length() > 0)
+	{
+		indexFuelModels = cfg->getIndexFuelModels();
+		string header = stationDate;
+		for (size_t f = 0; f < indexFuelModels.size(); f++)
+		{
+			const char* names[] = { "_BI", "_ERC", "_SC", "_IC" };
+			for (int n = 0; n < 4; n++)
+				header += string(",") + indexFuelModels[f] + names[n];
+		}
+		if (!OpenOutput(out.fuelModelIndexOut, run.fuelModelIndexOutputFile, backgroundOutput, header))
+			return -3;
+	}
+
+	//now need to read the wxFile and process the records
+	time_t startTime = clock();
+	if (cfg->getPipeline() != 0)
+		RunStationPipelined(cfg, params, fw21Calc, FW21data, indexFuelModels, out);
+	else
+	{
+		FW21Record fw21Rec;
+		NFDRSOutputRow row;
+		while (FW21data.ReadRecord(fw21Rec))
+		{
+			if (UpdateStation(cfg, params, fw21Calc, FW21data, indexFuelModels, fw21Rec, row))
+				WriteRow(out, row);
+		}
+	}
+	FW21data.CloseStream();
+	time_t endTime = clock();
+	double total = endTime - startTime;
+	if (printTime)
+	{
+		printf("Total seconds time for NFDRS: %.2f\n", total / (double) CLOCKS_PER_SEC);
+		PrintPerfCounters(stdout);
+	}
+	if (run.saveStateFile.length() > 0)
+	{
+		bool success = fw21Calc.SaveState(run.saveStateFile.c_str());
+		if (!success)
+			printf("Error saving %s as NFDRS State file\n", run.saveStateFile.c_str());
+	}
+	out.allOut.Close();
+	out.indexOut.Close();
+	out.moistOut.Close();
+	out.fuelModelIndexOut.Close();
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads a station's NFDRSInit file and initializes its model, then
+    loads its state file.
+    \param[in] run The station.
+    \param[out] params The station's NFDRSInit parameters.
+    \param[out] fw21Calc The station's model.
+    \return 0 on success, or an error code as main() returns.
+ */
+static int InitStation(const NFDRSStationRun& run, CNFDRSParams& params, NFDRS4& fw21Calc)
+{
+	static mutex parseMutex;
+	const char* initFileName = run.initFile.c_str();
+	const char* loadStateFileName = run.loadStateFile.c_str();
+	if (!fileExists(initFileName) && !fileExists(loadStateFileName))
+	{
+		printf("Error, station %s needs an existing NFDRSInit file or loadStateFile (%s, %s)\n", run.stationID.c_str(), initFileName, loadStateFileName);
+		return -1;
+	}
+	if (fileExists(initFileName))
+	{
+		//config4cpp parsing is not known to be thread safe
+		lock_guard<mutex> lock(parseMutex);
+		NFDRSConfiguration nfdrsCfg;
+		try
+		{
+			nfdrsCfg.parse(initFileName);
+			params = nfdrsCfg.getNFDRSParams();
+		}
+		catch (NFDRSConfigurationException & ex)
+		{
+			fprintf(stderr, "%s\n", ex.c_str());
+			return -4;
+		}
+	}
+	params.InitNFDRS(&fw21Calc);
+	if (run.loadStateFile.length() > 0)
+	{
+		NFDRS4State state;
+		state.LoadState(loadStateFileName);
+		fw21Calc.LoadState(state);
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs one station of a batch: reads its NFDRSInit and state files,
+    streams its records from the shared weather file and writes its outputs.
+    \param[in] cfg The NFDRS4_cli configuration.
+    \param[in] run The station.
+    \param[in] stationIndex Station index of the weather file, NULL if none.
+    \return 0 on success, or an error code as main() returns.
+ */
+static int RunBatchStation(RunNFDRSConfiguration* cfg, const NFDRSStationRun& run, const CFW21StationIndex* stationIndex)
+{
+	CNFDRSParams params;
+	NFDRS4 fw21Calc;
+	int status = InitStation(run, params, fw21Calc);
+	if (status != 0)
+		return status;
+	CFW21Data FW21data;
+	if (stationIndex)
+		FW21data.SetStationIndex(stationIndex);
+	status = FW21data.OpenStream(cfg->getWxFile(), run.stationID, params.getTimeZoneOffsetHours(), cfg->getUseStoredOutputs() != 0 ? true : false);
+	if (status != 0)
+	{
+		printf("Error loading %s as FW21 file for station %s\n", cfg->getWxFile(), run.stationID.c_str());
+		return -5;
+	}
+	return RunStation(cfg, run, params, fw21Calc, FW21data, false);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Batch mode: runs every station of a manifest (see CNFDRSBatch)
+    over the configuration's wxFile on a pool of threads. A csv wxFile is
+    indexed once so each station parses only its own lines.
+    \param[in] cfg The NFDRS4_cli configuration.
+    \param[in] manifestFileName The manifest.
+    \return 0 if every station succeeded, else an error code as main() returns.
+ */
+static int RunBatch(RunNFDRSConfiguration* cfg, const char* manifestFileName)
+{
+	const char* wxFileName = cfg->getWxFile();
+	if (strlen(wxFileName) == 0)
+	{
+		printf("A wxFile must be specified in the NFDRS4_cli Configuration file\n");
+		return -3;
+	}
+	CNFDRSBatch batch;
+	if (batch.LoadManifest(manifestFileName, cfg->getInitFile(), cfg->getLoadStateFile()) != 0)
+		return -1;
+	CFW21StationIndex stationIndex;
+	CFW21BinaryFile binary;
+	bool useIndex = false;
+	if (CFW21BinaryFile::IsBinaryFile(wxFileName))
+		binary.Open(wxFileName);
+	else if (!CFW13Decoder::IsFW13File(wxFileName))
+	{
+		const char* stationIndexFileName = cfg->getStationIndexFile();
+		bool haveIndexFile = stationIndexFileName && strlen(stationIndexFileName) > 0;
+		useIndex = haveIndexFile && fileExists(stationIndexFileName) && stationIndex.Load(stationIndexFileName, wxFileName) == 0;
+		if (!useIndex)
+		{
+			//a file without StationID column holds one station, it is read whole
+			useIndex = stationIndex.Build(wxFileName) == 0;
+			if (useIndex && haveIndexFile)
+				stationIndex.Save(stationIndexFileName);
+		}
+	}
+	batch.EstimateWork(useIndex ? &stationIndex : NULL, &binary);
+	binary.Close();
+	printf("Batch of %d stations from %s\n", (int)batch.GetNumStations(), manifestFileName);
+	chrono::steady_clock::time_point wallStart = chrono::steady_clock::now();
+	int status = batch.Run(cfg->getBatchThreads(), [&](const NFDRSStationRun& run)
+		{
+			return RunBatchStation(cfg, run, useIndex ? &stationIndex : NULL);
+		});
+	double total = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+	int nFailed = 0;
+	for (size_t s = 0; s < batch.GetNumStations(); s++)
+	{
+		if (batch.GetStation(s).status != 0)
+		{
+			printf("Station %s failed with status %d\n", batch.GetStation(s).stationID.c_str(), batch.GetStation(s).status);
+			nFailed++;
+		}
+	}
+	printf("Total seconds time for NFDRS batch (%d stations, %d failed): %.2f\n", (int)batch.GetNumStations(), nFailed, total);
+	PrintPerfCounters(stdout);
+	return status;
+}
+
+
+//------------------------------------------------------------------------------
+/*! \brief Service mode: loads every station of a manifest once and keeps
+    their models in memory, updated with records read from stdin and replied
+    to on stdout (see CNFDRSService).
+    \param[in] cfg The NFDRS4_cli configuration.
+    \param[in] manifestFileName The manifest.
+    \return 0 on success, else an error code as main() returns.
+ */
+static int RunService(RunNFDRSConfiguration* cfg, const char* manifestFileName)
+{
+	CNFDRSBatch batch;
+	if (batch.LoadManifest(manifestFileName, cfg->getInitFile(), cfg->getLoadStateFile()) != 0)
+		return -1;
+	CNFDRSService service;
+	for (size_t s = 0; s < batch.GetNumStations(); s++)
+	{
+		const NFDRSStationRun& run = batch.GetStation(s);
+		CNFDRSParams params;
+		NFDRS4 fw21Calc;
+		int status = InitStation(run, params, fw21Calc);
+		if (status != 0)
+			return status;
+		service.AddStation(run, params.getTimeZoneOffsetHours(), fw21Calc);
+	}
+	int status = service.Run(cin, stdout);
+	//stdout carries the replies
+	PrintPerfCounters(stderr);
+	return status;
+}
+
  
 int main(int argc, char* argv[])
 {
@@ -75,6 +636,17 @@ int main(int argc, char* argv[])
 		delete cfg;
 		return -1;
 	}
+	//batch mode: the manifest's stations instead of stationID
+	const char* batchManifestFileName = cfg->getBatchManifest();
+	if (batchManifestFileName && strlen(batchManifestFileName) > 0)
+	{
+		if (cfg->getService() != 0)
+			exitStatus = RunService(cfg, batchManifestFileName);
+		else
+			exitStatus = RunBatch(cfg, batchManifestFileName);
+		delete cfg;
+		return exitStatus;
+	}
 
 	if (!fileExists(nfdrsInitFileName) && !fileExists(loadStateFileName))
 	{
@@ -127,8 +699,30 @@ int main(int argc, char* argv[])
 		state.LoadState(loadStateFileName);
 		fw21Calc.LoadState(state);
 	}
+	//ensemble members share the loaded weather, a single run streams it record by record
+	const char* ensembleOutputFileName = cfg->getEnsembleOutputFile();
+	bool ensembleRun = cfg->getEnsembleInitFiles().size() > 0 && ensembleOutputFileName && strlen(ensembleOutputFileName) > 0;
 	CFW21Data FW21data;
-	int status = FW21data.LoadFile(wxFileName, cfg->getStationID(), params.getTimeZoneOffsetHours(), cfg->getUseStoredOutputs() != 0 ? true : false);
+	//a station index lets runs on a multi station file skip the other stations' lines (.fw21b and .fw13 files need none)
+	CFW21StationIndex stationIndex;
+	const char* stationIndexFileName = cfg->getStationIndexFile();
+	if (stationIndexFileName && strlen(stationIndexFileName) > 0 && !CFW21BinaryFile::IsBinaryFile(wxFileName)
+		&& !CFW13Decoder::IsFW13File(wxFileName))
+	{
+		if (!fileExists(stationIndexFileName) || stationIndex.Load(stationIndexFileName, wxFileName) != 0)
+		{
+			if (stationIndex.Build(wxFileName) == 0)
+				stationIndex.Save(stationIndexFileName);
+		}
+		if (stationIndex.GetNumStations() > 0)
+			FW21data.SetStationIndex(&stationIndex);
+	}
+	FW21data.SetNumThreads(cfg->getThreads());
+	int status;
+	if (ensembleRun)
+		status = FW21data.LoadFile(wxFileName, cfg->getStationID(), params.getTimeZoneOffsetHours(), cfg->getUseStoredOutputs() != 0 ? true : false);
+	else
+		status = FW21data.OpenStream(wxFileName, cfg->getStationID(), params.getTimeZoneOffsetHours(), cfg->getUseStoredOutputs() != 0 ? true : false);
 	if (status != 0)
 	{
 		printf("Error loading %s as FW21 file\n", wxFileName);
@@ -138,135 +732,78 @@ int main(int argc, char* argv[])
 		delete cfg;
 		return -5;
 	}
-	//also need any output files for dumping data
-	FILE* allOut = NULL, * indexOut = NULL, * moistOut = NULL, * wxAllOut = NULL;// , * fw21Out = NULL;
-
-	if (allOutputsFileName && strlen(allOutputsFileName) > 0)
+	//ensemble mode: run every ensembleInitFiles member over the same weather
+	if (ensembleRun)
 	{
-		allOut = fopen(allOutputsFileName, "wt");
-		if (!allOut)
-		{
-			printf("Error opening %s as output.\n", allOutputsFileName);
-			delete nfdrsCfg;
-			delete cfg;
-			return -3;
-		}
-		for (int fieldNum = CFW21Data::FW21_STATION; fieldNum < CFW21Data::FW21_TEMPC; fieldNum++)
-		{
-			if (fieldNum == 0)
-				fprintf(allOut, "%s", CFW21Data::GetFieldName((CFW21Data::FW21FIELDS)fieldNum).c_str());
-			else
-				fprintf(allOut, ",%s", CFW21Data::GetFieldName((CFW21Data::FW21FIELDS)fieldNum).c_str());
-		}
-		fprintf(allOut, "\n");
-	}
-	if (indexOutputsFileName && strlen(indexOutputsFileName) > 0)
-	{
-		indexOut = fopen(indexOutputsFileName, "wt");
-		if (!indexOut)
-		{
-			
-			printf("Error opening %s as output.\n", indexOutputsFileName);
-			if (allOut)
-				fclose(allOut);
-			delete nfdrsCfg;
-			delete cfg;
-			return -3;
-		}
-		fprintf(indexOut, "%s,%s", CFW21Data::GetFieldName(CFW21Data::FW21_STATION).c_str(),CFW21Data::GetFieldName(CFW21Data::FW21_DATE).c_str());
-		for (int f = CFW21Data::FW21_BI; f < CFW21Data::FW21_TEMPC; f++)
-			fprintf(indexOut, ",%s", CFW21Data::GetFieldName((CFW21Data::FW21FIELDS)f).c_str());
-		fprintf(indexOut, "\n");
-	}
-	if (fuelMoistureOutputsFileName && strlen(fuelMoistureOutputsFileName) > 0)
-	{
-		moistOut = fopen(fuelMoistureOutputsFileName, "wt");
-		if (!moistOut)
+		if (cfg->getUseStoredOutputs() != 0)
 		{
-
-			printf("Error opening %s as output.\n", fuelMoistureOutputsFileName);
-			if (allOut)
-				fclose(allOut);
-			if (indexOut)
-				fclose(indexOut);
+			printf("useStoredOutputs is not supported for ensemble runs\n");
 			delete nfdrsCfg;
 			delete cfg;
 			return -3;
 		}
-		fprintf(moistOut, "%s,%s", CFW21Data::GetFieldName(CFW21Data::FW21_STATION).c_str(), CFW21Data::GetFieldName(CFW21Data::FW21_DATE).c_str());
-		for (int f = CFW21Data::FW21_DFM1; f <= CFW21Data::FW21_FUELTEMPC; f++)
-			fprintf(moistOut, ",%s", CFW21Data::GetFieldName((CFW21Data::FW21FIELDS)f).c_str());
-		fprintf(moistOut, "\n");
-	}
-
-	//now need to read the wxFile and process the records
-	time_t startTime = clock();
-	for (size_t r = 0; r < FW21data.GetNumRecs(); r++)
-	{
-		FW21Record fw21Rec = FW21data.GetRec(r);
-		if (cfg->getUseStoredOutputs() != 0)
-		{
-			fw21Calc.iSetFuelMoistures(fw21Rec.GetMx1(), fw21Rec.GetMx10(),
-				fw21Rec.GetMx100(), fw21Rec.GetMx1000(), fw21Rec.GetMxWood(), fw21Rec.GetMxHerb(),
-				fw21Rec.GetFuelTTempC());
-			double tSC, tERC, tBI, tIC;
-			fw21Calc.iCalcIndexes(fw21Rec.GetWindSpeed(), params.getSlopeClass(), &tSC, &tERC, &tBI, &tIC, fw21Rec.GetGSI(), fw21Rec.GetKBDI());
-			//are these even necessary????????? Yes - Stu 10/24/2024
-			fw21Calc.SC = tSC;
-			fw21Calc.ERC = tERC;
-			fw21Calc.BI = tBI;
-			fw21Calc.IC = tIC;
-			fw21Calc.KBDI = fw21Rec.GetKBDI();
-			fw21Calc.m_GSI = fw21Rec.GetGSI();
-		}
-		else
-			fw21Calc.Update(fw21Rec.GetYear(), fw21Rec.GetMonth(), fw21Rec.GetDay(), fw21Rec.GetHour(), fw21Rec.GetTemp(), fw21Rec.GetRH(), fw21Rec.GetPrecip(),
-				fw21Rec.GetSolarRadiation(), fw21Rec.GetWindSpeed(), fw21Rec.GetSnowFlag());
-		if (cfg->getOutputInterval() == 0 || (cfg->getOutputInterval() == 1 && fw21Rec.GetHour() == params.getObsHour()))
+		CNFDRSEnsemble ensemble;
+		for (size_t m = 0; m < cfg->getEnsembleInitFiles().size(); m++)
 		{
-			//output to open csv files
-			if (allOut)
+			const char* memberInitFileName = cfg->getEnsembleInitFiles()[m].c_str();
+			if (!fileExists(memberInitFileName))
 			{
-				fprintf(allOut, "%s,%s,%.1f,%.1f,%.3f,%.1f,%d,%.1f,%d,%.1f,%d,%.10f,"
-					"%.10f,%.10f,%.10f,%.10f,%.10f,%.10f,%.2f,%.2f,%.2f,%.2f,%.10f,%d\n",
-					fw21Rec.GetStation().c_str(),
-					FW21data.DateToOriginal(fw21Rec.GetDateTime(), fw21Rec.GetTimeZoneOffset()).c_str(),
-					fw21Rec.GetTemp(), fw21Rec.GetRH(), fw21Rec.GetPrecip(), fw21Rec.GetWindSpeed(), fw21Rec.GetWindAzimuth(), fw21Rec.GetSolarRadiation(),
-					fw21Rec.GetSnowFlag(), fw21Rec.GetGustSpeed(), fw21Rec.GetGustAzimuth(), 
-					fw21Calc.MC1, fw21Calc.MC10, fw21Calc.MC100, fw21Calc.MC1000, fw21Calc.MCHERB, fw21Calc.MCWOOD, fw21Calc.GetFuelTemperature(),
-					fw21Calc.BI, fw21Calc.ERC, fw21Calc.SC, fw21Calc.IC, fw21Calc.m_GSI, fw21Calc.KBDI);
+				printf("NFDRS Init file %s does not exist!\n", memberInitFileName);
+				delete nfdrsCfg;
+				delete cfg;
+				return -1;
 			}
-			if (indexOut)
+			NFDRSConfiguration memberCfg;
+			try
 			{
-				fprintf(indexOut, "%s,%s,%.2f,%.2f,%.2f,%.2f,%.10f,%d\n",
-					fw21Rec.GetStation().c_str(),
-					FW21data.DateToOriginal(fw21Rec.GetDateTime(), fw21Rec.GetTimeZoneOffset()).c_str(),
-					fw21Calc.BI, fw21Calc.ERC, fw21Calc.SC, fw21Calc.IC, fw21Calc.m_GSI, fw21Calc.KBDI);
+				memberCfg.parse(memberInitFileName);
 			}
-			if (moistOut)
+			catch (NFDRSConfigurationException & ex)
+			{
+				fprintf(stderr, "%s\n", ex.c_str());
+				delete nfdrsCfg;
+				delete cfg;
+				return -4;
+			}
+			ensemble.AddMember(memberCfg.getNFDRSParams(), memberInitFileName);
+			printf("Ensemble member M%d: %s\n", (int)m + 1, memberInitFileName);
+		}
+		if (strlen(loadStateFileName) > 0)
+		{
+			NFDRS4State state;
+			if (!state.LoadState(loadStateFileName))
 			{
-				fprintf(moistOut, "%s,%s,%.10f,%.10f,%.10f,%.10f,%.10f,%.10f,%.10f\n",
-					fw21Rec.GetStation().c_str(),
-					FW21data.DateToOriginal(fw21Rec.GetDateTime(), fw21Rec.GetTimeZoneOffset()).c_str(),
-					fw21Calc.MC1, fw21Calc.MC10, fw21Calc.MC100, fw21Calc.MC1000, fw21Calc.MCHERB, fw21Calc.MCWOOD, fw21Calc.GetFuelTemperature());
+				printf("Unable to load NFDRS state file %s\n", loadStateFileName);
+				delete nfdrsCfg;
+				delete cfg;
+				return -1;
 			}
+			//members keep their own fuel model and parameters, only the state is shared
+			ensemble.LoadState(state);
 		}
+		if (FW21data.GetNumRecs() > 0)
+			printf("Loaded %d weather records, %.1f bytes per record\n", (int)FW21data.GetNumRecs(),
+				(double)FW21data.GetRecordsMemoryUsage() / FW21data.GetNumRecs());
+		CNFDRSForcing forcing;
+		forcing.Load(FW21data);
+		//members run on several threads, so report wall clock rather than cpu time
+		chrono::steady_clock::time_point wallStart = chrono::steady_clock::now();
+		status = ensemble.Run(forcing, ensembleOutputFileName, cfg->getOutputInterval(), cfg->getBackgroundOutput() != 0);
+		double total = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+		printf("Total seconds time for NFDRS ensemble (%d members): %.2f\n", (int)ensemble.GetNumMembers(), total);
+		PrintPerfCounters(stdout);
+		delete nfdrsCfg;
+		delete cfg;
+		return status;
 	}
-	time_t endTime = clock();
-	double total = endTime - startTime;
-	printf("Total seconds time for NFDRS: %.2f\n", total / (double) CLOCKS_PER_SEC);
-	if (saveStateFileName && strlen(saveStateFileName) > 0)
-	{
-		bool success = fw21Calc.SaveState(saveStateFileName);
-		if (!success)
-			printf("Error saving %s as NFDRS State file\n", saveStateFileName);
-	}
-	if (allOut)
-		fclose(allOut);
-	if (indexOut)
-		fclose(indexOut);
-	if (moistOut)
-		fclose(moistOut);
+	NFDRSStationRun run;
+	run.stationID = cfg->getStationID();
+	run.saveStateFile = saveStateFileName;
+	run.allOutputsFile = allOutputsFileName;
+	run.indexOutputFile = indexOutputsFileName;
+	run.fuelMoisturesOutputFile = fuelMoistureOutputsFileName;
+	run.fuelModelIndexOutputFile = cfg->getFuelModelIndexOutputFile();
+	exitStatus = RunStation(cfg, run, params, fw21Calc, FW21data, true);
 	delete nfdrsCfg;
 	delete cfg;
 	return exitStatus;
@@ -7,6 +7,7 @@
 using CONFIG4CPP_NAMESPACE::Configuration;
 using CONFIG4CPP_NAMESPACE::ConfigurationException;
 using CONFIG4CPP_NAMESPACE::SchemaValidator;
+using CONFIG4CPP_NAMESPACE::StringVector;
 
 //class RunNFDRSConfigurationException
 RunNFDRSConfigurationException::RunNFDRSConfigurationException(const char *str)
@@ -54,6 +55,17 @@ RunNFDRSConfiguration::~RunNFDRSConfiguration()
 	m_fuelMoisturesOutputsFile = "";
 	m_outputInterval = 0;//default to hourly
 	m_bUseStoredOutputs = 0;
+	m_ensembleInitFiles.clear();
+	m_ensembleOutputFile = "";
+	m_indexFuelModels.clear();
+	m_fuelModelIndexOutputFile = "";
+	m_stationIndexFile = "";
+	m_threads = 1;
+	m_backgroundOutput = 0;
+	m_pipeline = 0;
+	m_batchManifest = "";
+	m_batchThreads = 0;
+	m_service = 0;
 }
 
 void RunNFDRSConfiguration::parse(
@@ -88,6 +100,30 @@ void RunNFDRSConfiguration::parse(
 		m_fuelMoisturesOutputsFile = cfg->lookupString(cfgScope, "fuelMoisturesOutputFile");
 		m_outputInterval = cfg->lookupInt(cfgScope, "outputInterval");
 		m_bUseStoredOutputs = cfg->lookupInt(cfgScope, "useStoredOutputs");
+		//ensemble settings are optional
+		StringVector ensembleInitFiles, noFiles;
+		cfg->lookupList(cfgScope, "ensembleInitFiles", ensembleInitFiles, noFiles);
+		m_ensembleInitFiles.clear();
+		for (int i = 0; i < ensembleInitFiles.length(); i++)
+			m_ensembleInitFiles.push_back(ensembleInitFiles[i]);
+		m_ensembleOutputFile = cfg->lookupString(cfgScope, "ensembleOutputFile", "");
+		//indexes for several fuel models from one set of fuel moistures (optional)
+		StringVector indexFuelModels;
+		cfg->lookupList(cfgScope, "indexFuelModels", indexFuelModels, noFiles);
+		m_indexFuelModels.clear();
+		for (int i = 0; i < indexFuelModels.length(); i++)
+		{
+			if (strlen(indexFuelModels[i]) > 0)
+				m_indexFuelModels.push_back(indexFuelModels[i][0]);
+		}
+		m_fuelModelIndexOutputFile = cfg->lookupString(cfgScope, "fuelModelIndexOutputFile", "");
+		m_stationIndexFile = cfg->lookupString(cfgScope, "stationIndexFile", "");
+		m_threads = cfg->lookupInt(cfgScope, "threads", 1);
+		m_backgroundOutput = cfg->lookupInt(cfgScope, "backgroundOutput", 0);
+		m_pipeline = cfg->lookupInt(cfgScope, "pipeline", 0);
+		m_batchManifest = cfg->lookupString(cfgScope, "batchManifest", "");
+		m_batchThreads = cfg->lookupInt(cfgScope, "batchThreads", 0);
+		m_service = cfg->lookupInt(cfgScope, "service", 0);
 	}
 	catch (const ConfigurationException & ex) {
 		//do nothing but print the message
@@ -1,4 +1,6 @@
 #pragma once
+#include <string>
+#include <vector>
 
 class RunNFDRSConfigurationException
 {
@@ -42,6 +44,17 @@ public:
 	const char *	getFuelMoisturesOutputsFile() { return m_fuelMoisturesOutputsFile; }
 	int getOutputInterval() { return m_outputInterval; }
 	int getUseStoredOutputs() { return m_bUseStoredOutputs; }
+	const std::vector<std::string>& getEnsembleInitFiles() { return m_ensembleInitFiles; }
+	const char *	getEnsembleOutputFile() { return m_ensembleOutputFile; }
+	const std::vector<char>& getIndexFuelModels() { return m_indexFuelModels; }
+	const char *	getFuelModelIndexOutputFile() { return m_fuelModelIndexOutputFile; }
+	const char *	getStationIndexFile() { return m_stationIndexFile; }
+	int getThreads() { return m_threads; }
+	int getBackgroundOutput() { return m_backgroundOutput; }
+	int getPipeline() { return m_pipeline; }
+	const char *	getBatchManifest() { return m_batchManifest; }
+	int getBatchThreads() { return m_batchThreads; }
+	int getService() { return m_service; }
 private:
 	void * m_cfg;
 	bool m_wantDiagnostics;
@@ -57,6 +70,17 @@ private:
 	const char * m_fuelMoisturesOutputsFile;
 	int m_outputInterval;//0 = hourly(each record), 1 = daily
 	int m_bUseStoredOutputs; //non-zero value causes NFDRS4_cli to bypass Nelson and GSI models
+	std::vector<std::string> m_ensembleInitFiles;//optional, one NFDRSInit file per ensemble member
+	const char * m_ensembleOutputFile;
+	std::vector<char> m_indexFuelModels;//optional, extra fuel models for fuelModelIndexOutputFile
+	const char * m_fuelModelIndexOutputFile;
+	const char * m_stationIndexFile;//optional, station index of a multi station wxFile, built if missing
+	int m_threads;//optional, threads parsing wxFile, 0 = one per core
+	int m_backgroundOutput;//optional, non-zero writes output files from a background thread
+	int m_pipeline;//optional, non-zero reads, models and writes a station on three threads
+	const char * m_batchManifest;//optional, csv of stations run together, see CNFDRSBatch
+	int m_batchThreads;//optional, threads running batch stations, 0 = one per core
+	int m_service;//optional, non-zero keeps the batchManifest stations resident, see CNFDRSService
 	//--------
 	// Not implemented
 	//--------
@@ -0,0 +1,127 @@
+/*
+    Records timed spans of a run in the Chrome trace event format (load the
+    file in chrome://tracing or https://ui.perfetto.dev) and keeps the total
+    time of each span name for a summary.
+*/
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TraceRecorder
+{
+public:
+    struct PhaseTotal
+    {
+        size_t count = 0;
+        double seconds = 0.0;
+    };
+
+    // With recordEvents false only the phase totals are kept
+    explicit TraceRecorder(bool recordEvents = false)
+        : recordEvents(recordEvents), start(std::chrono::steady_clock::now()) {}
+
+    // Microseconds since the recorder was made
+    double Now() const
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // A complete span; args is a JSON object body such as "\"t\": 3" (or empty)
+    void AddSpan(const std::string &name, const char *category, int tid, double startUs, double endUs, const std::string &args = "")
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        PhaseTotal &total = totals[name];
+        total.count++;
+        total.seconds += (endUs - startUs) * 1e-6;
+        if (recordEvents)
+            events.push_back(Event{'X', name, category, tid, startUs, endUs - startUs, args});
+    }
+
+    // A counter track sample; args holds the counter values, e.g. "\"dfm_ms\": 1.5"
+    void AddCounter(const std::string &name, double timeUs, const std::string &args)
+    {
+        if (!recordEvents)
+            return;
+        std::lock_guard<std::mutex> guard(lock);
+        events.push_back(Event{'C', name, "counter", 0, timeUs, 0.0, args});
+    }
+
+    void SetThreadName(int tid, const std::string &name)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        threadNames[tid] = name;
+    }
+
+    const std::map<std::string, PhaseTotal> &GetTotals() const { return totals; }
+
+    bool Write(const std::string &path) const
+    {
+        FILE *out = fopen(path.c_str(), "wt");
+        if (!out)
+            return false;
+        fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        bool first = true;
+        for (const auto &thread : threadNames)
+        {
+            fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", thread.first, thread.second.c_str());
+            first = false;
+        }
+        for (const Event &e : events)
+        {
+            fprintf(out, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"%c\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f",
+                    first ? "" : ",\n", e.name.c_str(), e.category, e.phase, e.tid, e.startUs);
+            if (e.phase == 'X')
+                fprintf(out, ", \"dur\": %.3f", e.durationUs);
+            fprintf(out, ", \"args\": {%s}}", e.args.c_str());
+            first = false;
+        }
+        fprintf(out, "\n]}\n");
+        bool ok = ferror(out) == 0;
+        fclose(out);
+        return ok;
+    }
+
+private:
+    struct Event
+    {
+        char phase;
+        std::string name;
+        const char *category;
+        int tid;
+        double startUs, durationUs;
+        std::string args;
+    };
+
+    bool recordEvents;
+    std::chrono::steady_clock::time_point start;
+    std::mutex lock;
+    std::vector<Event> events;
+    std::map<std::string, PhaseTotal> totals;
+    std::map<int, std::string> threadNames;
+};
+
+// Adds a span from its construction to its destruction
+class TraceSpan
+{
+public:
+    TraceSpan(TraceRecorder &recorder, const std::string &name, const char *category, int tid = 0, const std::string &args = "")
+        : recorder(recorder), name(name), category(category), tid(tid), args(args), startUs(recorder.Now()) {}
+    ~TraceSpan() { recorder.AddSpan(name, category, tid, startUs, recorder.Now(), args); }
+
+private:
+    TraceRecorder &recorder;
+    std::string name;
+    const char *category;
+    int tid;
+    std::string args;
+    double startUs;
+};
+
+#endif // _TRACE_H_
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Measures the strong and weak scaling of NFDRS4_spatial on synthetic grids.
+
+usage: scaling_bench.py [--bin <dir>] [--threads 1,2,4,8] [--grid 256x256]
+                        [--cells-per-thread 16384] [--hours 48] [--repeat 3]
+                        [--workdir <dir>] [--json <file>]
+
+Input files are written by NFDRS4_spatial_input into the work directory (and
+reused when they already exist). Strong scaling runs one --grid with each
+thread count; weak scaling grows a square grid with the thread count so every
+thread keeps --cells-per-thread cells. Each run is repeated and the fastest
+kept. Throughput is reported in burnable cell-hours per second, both for the
+whole run (reads and writes included) and for the compute phase alone, with
+the speedup and parallel efficiency against the first thread count.
+"""
+import argparse
+import json
+import math
+import os
+import re
+import subprocess
+import sys
+
+RUN_LINE = re.compile(r"Run: ([0-9.]+) s, ([0-9]+) cell-hours, ([0-9.]+) cell-hours/s computing, ([0-9.]+) cell-hours/s overall")
+
+
+def make_input(args, rows, cols):
+    path = os.path.join(args.workdir, "input_%dx%dx%d_s%d.nc" % (rows, cols, args.hours, args.seed))
+    if not os.path.exists(path):
+        cmd = [os.path.join(args.bin, "NFDRS4_spatial_input"), "-o", path, "--rows", str(rows), "--cols", str(cols),
+               "--hours", str(args.hours), "--burnable", str(args.burnable), "--seed", str(args.seed)]
+        subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    return path
+
+
+def run_spatial(args, inputPath, threads):
+    """Fastest of --repeat runs: (seconds, cell-hours, compute rate, overall rate)."""
+    best = None
+    outputPath = os.path.join(args.workdir, "output_nfdrs.nc")
+    for _ in range(args.repeat):
+        cmd = [os.path.join(args.bin, "NFDRS4_spatial"), "-i", inputPath, "-o", outputPath, "--threads", str(threads),
+               "--summary"]
+        if args.chunk_size:
+            cmd += ["--chunk-size", str(args.chunk_size)]
+        out = subprocess.run(cmd, check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+        match = RUN_LINE.search(out)
+        if not match:
+            sys.exit("No summary line in the NFDRS4_spatial output:\n" + out)
+        result = (float(match.group(1)), int(match.group(2)), float(match.group(3)), float(match.group(4)))
+        if best is None or result[0] < best[0]:
+            best = result
+    return best
+
+
+def print_table(title, rows):
+    print(title)
+    print("%8s %12s %14s %14s %14s %9s %11s" % ("threads", "grid", "cell-hours", "compute ch/s", "overall ch/s",
+                                               "speedup", "efficiency"))
+    for r in rows:
+        print("%8d %12s %14d %14.0f %14.0f %9.2f %10.0f%%" % (r["threads"], r["grid"], r["cell_hours"], r["compute_rate"],
+                                                            r["overall_rate"], r["speedup"], r["efficiency"] * 100.0))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Strong and weak scaling of NFDRS4_spatial on synthetic grids.")
+    parser.add_argument("--bin", default=".", help="directory with NFDRS4_spatial and NFDRS4_spatial_input")
+    parser.add_argument("--threads", default="1,2,4,8", help="comma separated thread counts")
+    parser.add_argument("--grid", default="256x256", help="strong scaling grid, rows x cols")
+    parser.add_argument("--cells-per-thread", type=int, default=16384, help="weak scaling cells per thread")
+    parser.add_argument("--hours", type=int, default=48)
+    parser.add_argument("--burnable", type=float, default=0.8)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--chunk-size", type=int, default=0, help="cells per work chunk (NFDRS4_spatial default if 0)")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--workdir", default="scaling_bench")
+    parser.add_argument("--skip-strong", action="store_true")
+    parser.add_argument("--skip-weak", action="store_true")
+    parser.add_argument("--json", help="also write the results to this file")
+    args = parser.parse_args()
+
+    threadCounts = [int(t) for t in args.threads.split(",")]
+    os.makedirs(args.workdir, exist_ok=True)
+    results = {"hours": args.hours, "burnable": args.burnable, "strong": [], "weak": []}
+
+    if not args.skip_strong:
+        rows, cols = [int(v) for v in args.grid.lower().split("x")]
+        inputPath = make_input(args, rows, cols)
+        base = None
+        for threads in threadCounts:
+            seconds, cellHours, computeRate, overallRate = run_spatial(args, inputPath, threads)
+            base = base or (threads, overallRate)
+            speedup = overallRate / base[1]
+            results["strong"].append({"threads": threads, "grid": "%dx%d" % (rows, cols), "seconds": seconds,
+                                      "cell_hours": cellHours, "compute_rate": computeRate, "overall_rate": overallRate,
+                                      "speedup": speedup, "efficiency": speedup * base[0] / threads})
+        print_table("Strong scaling (%s cells, %d hours)" % (args.grid, args.hours), results["strong"])
+
+    if not args.skip_weak:
+        base = None
+        for threads in threadCounts:
+            side = int(round(math.sqrt(args.cells_per_thread * threads)))
+            inputPath = make_input(args, side, side)
+            seconds, cellHours, computeRate, overallRate = run_spatial(args, inputPath, threads)
+            #same work per thread: ideal scaling keeps the throughput per thread constant
+            base = base or (threads, overallRate)
+            speedup = overallRate / base[1]
+            results["weak"].append({"threads": threads, "grid": "%dx%d" % (side, side), "seconds": seconds,
+                                    "cell_hours": cellHours, "compute_rate": computeRate, "overall_rate": overallRate,
+                                    "speedup": speedup, "efficiency": speedup * base[0] / threads})
+        print_table("Weak scaling (%d cells per thread, %d hours)" % (args.cells_per_thread, args.hours), results["weak"])
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <netcdf>
+#include <string>
+#include <thread>
 #include <vector>
 #include <nfdrs4.h>
+#include <livefuelmoisturebatch.h>
 
 #include "timer.h"
+#include "trace.h"
 #include "args.hxx"
 
 using namespace std;
@@ -11,6 +17,7 @@ using namespace std;
 constexpr int NO_DATA = -1;
 constexpr const char *DEFAULT_INPUT_NFDRS = "../data/input_nfdrs.nc";
 constexpr const char *DEFAULT_OUTPUT_NFDRS = "../data/output_nfdrs.nc";
+constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
 
 struct StaticNFDRSData
 {
@@ -93,6 +100,118 @@ struct DynamicNFDRSData
     }
 };
 
+// Peak memory of a run, projected from the grid before anything is allocated
+struct MemoryProjection
+{
+    size_t burnableCells = 0;
+    size_t stateBytes = 0;   // NFDRS4 objects and burnable cell indices
+    size_t lfmBatchBytes = 0; // LiveFuelMoistureBatch, with --lfm-batch
+    size_t staticBytes = 0;  // static input fields
+    size_t inputBytes = 0;   // one timestep of dynamic inputs
+    size_t outputBytes = 0;  // output arrays for all timesteps
+    size_t outputBytesPerStep = 0;
+
+    size_t Total() const { return stateBytes + lfmBatchBytes + staticBytes + inputBytes + outputBytes; }
+};
+
+MemoryProjection ProjectMemory(const StaticNFDRSData &staticData, size_t T, bool runDFM, map<int, char> &fModelMap,
+                               bool lfmBatch, double lfmLatBand)
+{
+    MemoryProjection memory;
+    size_t spatialSize = staticData.N * staticData.M;
+
+    // One NFDRS4 per fuel model in use gives the bytes of every cell with that model
+    map<int, size_t> cellsPerModel;
+    for (size_t i = 0; i < spatialSize; ++i)
+    {
+        if (staticData.isBurnable[i] == 1)
+            cellsPerModel[staticData.fModels[i]]++;
+    }
+    for (const auto &model : cellsPerModel)
+    {
+        NFDRS4 prototype(staticData.lat[0], fModelMap[model.first], 1, staticData.annAvgPrec[0], true, true, false);
+        memory.stateBytes += model.second * (prototype.MemoryFootprint() + sizeof(size_t));
+        memory.burnableCells += model.second;
+    }
+    if (lfmBatch && memory.burnableCells > 0)
+    {
+        // The batch grows linearly with the cells, so one and two cells give its size
+        NFDRS4 prototype(staticData.lat[0], 'Y', 1, staticData.annAvgPrec[0], true, true, false);
+        LiveFuelMoistureBatch one, two;
+        one.Initialize(prototype.HerbFM, prototype.WoodyFM, vector<double>(1, staticData.lat[0]), lfmLatBand);
+        two.Initialize(prototype.HerbFM, prototype.WoodyFM, vector<double>(2, staticData.lat[0]), lfmLatBand);
+        size_t perCell = two.MemoryFootprint() - one.MemoryFootprint();
+        memory.lfmBatchBytes = one.MemoryFootprint() + (memory.burnableCells - 1) * perCell;
+    }
+
+    memory.staticBytes = spatialSize * (3 * sizeof(int) + 2 * sizeof(double));
+    memory.inputBytes = spatialSize * ((runDFM ? 5 : 10) * sizeof(double) + sizeof(int));
+    memory.outputBytesPerStep = spatialSize * (runDFM ? 13 : 8) * sizeof(double);
+    memory.outputBytes = T * memory.outputBytesPerStep;
+    return memory;
+}
+
+void PrintMemoryProjection(const MemoryProjection &memory, size_t T)
+{
+    const double MiB = 1024.0 * 1024.0;
+    printf("Projected peak memory: %.1f MiB\n", memory.Total() / MiB);
+    printf("  NFDRS4 state   %10.1f MiB (%zu burnable cells, %.1f KiB each)\n", memory.stateBytes / MiB, memory.burnableCells,
+           memory.burnableCells ? memory.stateBytes / 1024.0 / memory.burnableCells : 0.0);
+    if (memory.lfmBatchBytes > 0)
+        printf("  LFM batch      %10.1f MiB\n", memory.lfmBatchBytes / MiB);
+    printf("  static inputs  %10.1f MiB\n", memory.staticBytes / MiB);
+    printf("  timestep input %10.1f MiB\n", memory.inputBytes / MiB);
+    printf("  outputs        %10.1f MiB (%zu timesteps)\n", memory.outputBytes / MiB, T);
+}
+
+// Bytes of the variables read for one timestep
+size_t DynamicBytes(const DynamicNFDRSData &data)
+{
+    size_t bytes = 4 * sizeof(int);
+    bytes += (data.temp.size() + data.rh.size() + data.ppt.size() + data.windSpeed.size() + data.sr.size()) * sizeof(double);
+    bytes += data.snowDay.size() * sizeof(int);
+    bytes += (data.MC1.size() + data.MC10.size() + data.MC100.size() + data.MC1000.size() + data.fuelTemp.size()) * sizeof(double);
+    return bytes;
+}
+
+// Where the run's time went, from the trace's phase totals
+void PrintTraceSummary(const TraceRecorder &trace, double runSeconds, size_t cellHours, int numThreads,
+                       size_t bytesRead, size_t bytesWritten, const NFDRS4PerfCounters &perf)
+{
+    const auto &totals = trace.GetTotals();
+    auto seconds = [&](const char *name)
+    {
+        auto it = totals.find(name);
+        return it != totals.end() ? it->second.seconds : 0.0;
+    };
+    printf("\n%-14s %8s %12s %9s\n", "Phase", "Count", "Seconds", "% of run");
+    for (const auto &phase : totals)
+    {
+        printf("%-14s %8zu %12.3f %9.1f\n", phase.first.c_str(), phase.second.count, phase.second.seconds,
+               runSeconds > 0.0 ? 100.0 * phase.second.seconds / runSeconds : 0.0);
+    }
+    printf("(cells are summed over %d thread(s), step_compute is wall clock)\n", numThreads);
+    double computeSeconds = seconds("step_compute");
+    double readSeconds = seconds("read_static") + seconds("read_step");
+    double writeSeconds = seconds("write_output");
+    printf("Run: %.3f s, %zu cell-hours, %.0f cell-hours/s computing, %.0f cell-hours/s overall\n", runSeconds, cellHours,
+           computeSeconds > 0.0 ? cellHours / computeSeconds : 0.0, runSeconds > 0.0 ? cellHours / runSeconds : 0.0);
+    printf("Read: %.1f MB at %.1f MB/s, written: %.1f MB at %.1f MB/s\n", bytesRead * 1e-6,
+           readSeconds > 0.0 ? bytesRead * 1e-6 / readSeconds : 0.0, bytesWritten * 1e-6,
+           writeSeconds > 0.0 ? bytesWritten * 1e-6 / writeSeconds : 0.0);
+    if (perf.enabled)
+    {
+        double dfm = 0.0;
+        for (int p = NFDRS4_PERF_DFM_1H; p <= NFDRS4_PERF_DFM_1000H; p++)
+            dfm += perf.nanoseconds[p] * 1e-9;
+        printf("NFDRS4 (summed over threads): dead fuel %.3f s, live fuel/GSI %.3f s, KBDI %.3f s, indexes %.3f s\n", dfm,
+               perf.nanoseconds[NFDRS4_PERF_LFM_GSI] * 1e-9, perf.nanoseconds[NFDRS4_PERF_KBDI] * 1e-9,
+               perf.nanoseconds[NFDRS4_PERF_INDEXES] * 1e-9);
+    }
+    else
+        printf("Build with -DNFDRS4_PERF_COUNTERS=ON to split cells into dead fuel and index time\n");
+}
+
 DynamicNFDRSData ReadDynamicNFDRS(
     const string &input_nfdrs, const string &output_dfm,
     size_t N, size_t M, size_t t, bool runDFM)
@@ -173,6 +292,14 @@ int main(int argc, char **argv)
     args::ValueFlag<string> inputNFDRS(parser, "path", "Input NFDRS4 file path", {'i', "input-nfdrs-path"});
     args::ValueFlag<string> outputNFDRS(parser, "path", "Output NFDRS4 file path", {'o', "output-nfdrs-path"});
     args::ValueFlag<string> outputDFM(parser, "path", "DFM file path", {'d', "dfm-path"});
+    args::ValueFlag<int> threadsFlag(parser, "n", "Threads updating the cells (default 1)", {'t', "threads"});
+    args::ValueFlag<size_t> chunkSizeFlag(parser, "cells", "Cells per work chunk (default 4096)", {"chunk-size"});
+    args::ValueFlag<string> traceFlag(parser, "path", "Write a Chrome trace (JSON) of reads, cell chunks and writes, and print a summary", {"trace"});
+    args::Flag summaryFlag(parser, "summary", "Print the time per phase and the throughput", {"summary"});
+    args::ValueFlag<double> memoryLimitFlag(parser, "MiB", "Refuse to run if the projected peak memory exceeds this many MiB, and suggest a tiling", {"memory-limit"});
+    args::Flag memoryEstimateFlag(parser, "memory-estimate", "Print the projected peak memory and exit", {"memory-estimate"});
+    args::Flag lfmBatchFlag(parser, "lfm-batch", "Update the herb and woody live fuel moisture of each chunk at once (LiveFuelMoistureBatch)", {"lfm-batch"});
+    args::ValueFlag<double> lfmLatBandFlag(parser, "degrees", "With --lfm-batch, cells in latitude bands this wide share their daylength (default 0, exact latitudes)", {"lfm-lat-band"});
 
     try
     {
@@ -215,12 +342,26 @@ int main(int argc, char **argv)
         cout << "DFM file path: " << output_dfm << endl;
     }
 
+    int numThreads = threadsFlag ? max(1, args::get(threadsFlag)) : 1;
+    size_t chunkSize = chunkSizeFlag ? max((size_t)1, args::get(chunkSizeFlag)) : DEFAULT_CHUNK_SIZE;
+    bool writeTrace = traceFlag;
+    bool printSummary = writeTrace || summaryFlag;
+    TraceRecorder trace(writeTrace);
+    trace.SetThreadName(0, "main");
+    for (int w = 1; w < numThreads; ++w)
+        trace.SetThreadName(w, "worker " + to_string(w));
+    NFDRS4::ResetPerfCounters();
+    size_t bytesRead = 0, bytesWritten = 0;
+
     cout << "\nReading static data..." << endl;
+    double spanStart = trace.Now();
     StaticNFDRSData staticData = ReadStaticNFDRS(input_nfdrs);
+    trace.AddSpan("read_static", "io", 0, spanStart, trace.Now());
 
     size_t N = staticData.N;
     size_t M = staticData.M;
     size_t spatialSize = N * M;
+    bytesRead += spatialSize * (3 * sizeof(int) + 2 * sizeof(double));
 
     cout << "Reading dynamic data and processing..." << endl;
 
@@ -233,6 +374,41 @@ int main(int argc, char **argv)
     cout << "Time steps: " << T << endl;
     cout << "Spatial size: " << N << " x " << M << endl;
 
+    // Define Fuel Behaviour Model Mapping
+    map<int, char> fModelMap = {
+        {1, 'V'},
+        {2, 'W'},
+        {3, 'X'},
+        {4, 'Y'},
+        {5, 'Z'}
+    };
+
+    // Check the projected memory before allocating the grid and outputs
+    bool lfmBatch = lfmBatchFlag;
+    double lfmLatBand = lfmLatBandFlag ? max(0.0, args::get(lfmLatBandFlag)) : 0.0;
+    MemoryProjection memory = ProjectMemory(staticData, T, runDFM, fModelMap, lfmBatch, lfmLatBand);
+    PrintMemoryProjection(memory, T);
+    if (memoryLimitFlag)
+    {
+        const double MiB = 1024.0 * 1024.0;
+        size_t limit = (size_t)(args::get(memoryLimitFlag) * MiB);
+        if (memory.Total() > limit)
+        {
+            // Every term grows with the cells, so row bands of the grid divide it evenly
+            size_t tiles = (memory.Total() + limit - 1) / limit;
+            cerr << "Projected peak memory exceeds the limit of " << args::get(memoryLimitFlag) << " MiB" << endl;
+            if (tiles <= N)
+                fprintf(stderr, "Split the grid into %zu tiles of at most %zu rows (south_north) and run them separately\n",
+                        tiles, (N + tiles - 1) / tiles);
+            size_t fixedBytes = memory.Total() - memory.outputBytes;
+            if (fixedBytes < limit && memory.outputBytesPerStep > 0)
+                fprintf(stderr, "or run at most %zu timesteps at a time\n", (limit - fixedBytes) / memory.outputBytesPerStep);
+            return EXIT_FAILURE;
+        }
+    }
+    if (memoryEstimateFlag)
+        return EXIT_SUCCESS;
+
     vector<double> MC1, MC10, MC100, MC1000, fuelTemp;
 
     if (runDFM)
@@ -255,19 +431,12 @@ int main(int argc, char **argv)
     vector<double> BI(T * spatialSize, NO_DATA);
     vector<double> IC(T * spatialSize, NO_DATA);
 
-    // Define Fuel Behaviour Model Mapping
-    map<int, char> fModelMap = {
-        {1, 'V'},
-        {2, 'W'},
-        {3, 'X'},
-        {4, 'Y'},
-        {5, 'Z'}
-    };
-
     // Initialize NFDRS objects for burnable locations
+    spanStart = trace.Now();
     vector<NFDRS4> NFDRSGrid;
-    NFDRSGrid.reserve(spatialSize);
+    NFDRSGrid.reserve(memory.burnableCells);
     vector<size_t> burnableIndices;
+    burnableIndices.reserve(memory.burnableCells);
     for (size_t i = 0; i < spatialSize; ++i)
     {
         if (staticData.isBurnable[i] == 1)
@@ -280,21 +449,86 @@ int main(int argc, char **argv)
         }
     }
 
-    for (size_t t = 0; t < T; ++t)
+    // With --lfm-batch the cells stop at the observation hour before their indexes,
+    // and the batch updates the live fuel moisture of each chunk's cells together
+    LiveFuelMoistureBatch liveFuels;
+    if (lfmBatch && !NFDRSGrid.empty())
     {
-        Timer timer;
-        printf("Timestep: %zu/%zu...\n", t + 1, T);
+        vector<double> lats(NFDRSGrid.size());
+        for (size_t c = 0; c < NFDRSGrid.size(); ++c)
+        {
+            lats[c] = staticData.lat[burnableIndices[c]];
+            NFDRSGrid[c].SetDeferLiveFuels(true);
+        }
+        liveFuels.Initialize(NFDRSGrid[0].HerbFM, NFDRSGrid[0].WoodyFM, lats, lfmLatBand);
+        for (size_t c = 0; c < NFDRSGrid.size(); ++c)
+        {
+            if (!liveFuels.LoadCell(c, NFDRSGrid[c].HerbFM, NFDRSGrid[c].WoodyFM))
+            {
+                cerr << "Cell " << burnableIndices[c] << " has live fuel parameters the batch cannot share" << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        printf("Live fuel batch: %zu cells, %s, %s GSI window per cell, %.1f MiB\n", liveFuels.Size(),
+               lfmLatBand > 0.0 ? ("daylength per " + to_string(lfmLatBand) + " degree band").c_str() : "exact latitudes",
+               liveFuels.SharesGSIWindow() ? "one" : "herb and woody", liveFuels.MemoryFootprint() / (1024.0 * 1024.0));
+    }
+    trace.AddSpan("init", "compute", 0, spanStart, trace.Now());
 
-        // Read dynamic data for timestep t
-        DynamicNFDRSData dynamicData = ReadDynamicNFDRS(input_nfdrs, output_dfm, N, M, t, runDFM);
+    // Copies the outputs of burnable cell c to the output arrays
+    auto saveOutputs = [&](size_t c, size_t t)
+    {
+        size_t tidx = t * spatialSize + burnableIndices[c];
+        KBDI[tidx] = NFDRSGrid[c].KBDI;
+        GSI[tidx] = NFDRSGrid[c].m_GSI;
+        MCWOOD[tidx] = NFDRSGrid[c].MCWOOD;
+        MCHERB[tidx] = NFDRSGrid[c].MCHERB;
+        SC[tidx] = NFDRSGrid[c].SC;
+        ERC[tidx] = NFDRSGrid[c].ERC;
+        BI[tidx] = NFDRSGrid[c].BI;
+        IC[tidx] = NFDRSGrid[c].IC;
+    };
+
+    // Completes the deferred live fuel update of the cells [begin, end) that have
+    // one pending, one batch update per run of consecutive pending cells
+    auto completeLiveFuels = [&](size_t begin, size_t end)
+    {
+        vector<LFMDailyInputs> inputs;
+        vector<LFMDailyOutputs> outputs;
+        size_t run = begin;
+        for (size_t c = begin; c <= end; ++c)
+        {
+            if (c < end && NFDRSGrid[c].LiveFuelsPending())
+            {
+                if (inputs.empty())
+                {
+                    inputs.resize(end - begin);
+                    outputs.resize(end - begin);
+                }
+                inputs[c - begin] = NFDRSGrid[c].GetLiveFuelInputs();
+                continue;
+            }
+            if (c > run)
+            {
+                liveFuels.Update(run, c - run, &inputs[run - begin], &outputs[run - begin]);
+                for (size_t r = run; r < c; ++r)
+                {
+                    const LFMDailyOutputs &out = outputs[r - begin];
+                    NFDRSGrid[r].CompleteLiveFuels(out.HerbFM, out.WoodyFM, out.GSI);
+                }
+            }
+            run = c + 1;
+        }
+    };
 
-        // Process timestep
-        size_t c = 0;
-        for (size_t i : burnableIndices)
+    // Updates the burnable cells [begin, end) of NFDRSGrid for timestep t
+    auto processCells = [&](size_t begin, size_t end, size_t t, const DynamicNFDRSData &dynamicData)
+    {
+        for (size_t c = begin; c < end; ++c)
         {
-            size_t idx = i;                    // Spatial index
-            size_t tidx = t * spatialSize + i; // Time-space index
-            
+            size_t idx = burnableIndices[c];   // Spatial index
+            size_t tidx = t * spatialSize + idx; // Time-space index
+
             if (runDFM)
             {
                 // Run DFM on CPU
@@ -321,21 +555,71 @@ int main(int argc, char **argv)
                     dynamicData.MC1000[idx], dynamicData.fuelTemp[idx]);
             }
 
-            // Save results to output arrays
-            KBDI[tidx] = NFDRSGrid[c].KBDI;
-            GSI[tidx] = NFDRSGrid[c].m_GSI;
-            MCWOOD[tidx] = NFDRSGrid[c].MCWOOD;
-            MCHERB[tidx] = NFDRSGrid[c].MCHERB;
-            SC[tidx] = NFDRSGrid[c].SC;
-            ERC[tidx] = NFDRSGrid[c].ERC;
-            BI[tidx] = NFDRSGrid[c].BI;
-            IC[tidx] = NFDRSGrid[c].IC;
-            c++;
+            // Save results to output arrays, once the live fuels are done with --lfm-batch
+            if (!lfmBatch)
+                saveOutputs(c, t);
+        }
+        if (lfmBatch)
+        {
+            completeLiveFuels(begin, end);
+            for (size_t c = begin; c < end; ++c)
+                saveOutputs(c, t);
+        }
+    };
+
+    size_t numCells = burnableIndices.size();
+    size_t numChunks = (numCells + chunkSize - 1) / chunkSize;
+    for (size_t t = 0; t < T; ++t)
+    {
+        Timer timer;
+        printf("Timestep: %zu/%zu...\n", t + 1, T);
+        string stepArgs = "\"t\": " + to_string(t);
+
+        // Read dynamic data for timestep t
+        spanStart = trace.Now();
+        DynamicNFDRSData dynamicData = ReadDynamicNFDRS(input_nfdrs, output_dfm, N, M, t, runDFM);
+        trace.AddSpan("read_step", "io", 0, spanStart, trace.Now(), stepArgs);
+        bytesRead += DynamicBytes(dynamicData);
+
+        // Process timestep: cells are independent, idle threads take the next chunk
+        NFDRS4PerfCounters perfBefore = NFDRS4::GetPerfCounters();
+        spanStart = trace.Now();
+        atomic<size_t> nextChunk(0);
+        auto worker = [&](int tid)
+        {
+            size_t k;
+            while ((k = nextChunk++) < numChunks)
+            {
+                size_t begin = k * chunkSize, end = min(begin + chunkSize, numCells);
+                double chunkStart = trace.Now();
+                processCells(begin, end, t, dynamicData);
+                trace.AddSpan("cells", "compute", tid, chunkStart, trace.Now(),
+                              stepArgs + ", \"first\": " + to_string(begin) + ", \"count\": " + to_string(end - begin));
+            }
+        };
+        vector<thread> workers;
+        for (int w = 1; w < numThreads; ++w)
+            workers.push_back(thread(worker, w));
+        worker(0);
+        for (thread &w : workers)
+            w.join();
+        double computeEnd = trace.Now();
+        trace.AddSpan("step_compute", "compute", 0, spanStart, computeEnd, stepArgs);
+        NFDRS4PerfCounters perf = NFDRS4::GetPerfCounters();
+        if (perf.enabled)
+        {
+            // this step's NFDRS4 phase times, summed over the threads
+            double dfmMs = 0.0;
+            for (int p = NFDRS4_PERF_DFM_1H; p <= NFDRS4_PERF_DFM_1000H; p++)
+                dfmMs += (perf.nanoseconds[p] - perfBefore.nanoseconds[p]) * 1e-6;
+            double indexMs = (perf.nanoseconds[NFDRS4_PERF_INDEXES] - perfBefore.nanoseconds[NFDRS4_PERF_INDEXES]) * 1e-6;
+            trace.AddCounter("nfdrs4_phase_ms", computeEnd, "\"dfm\": " + to_string(dfmMs) + ", \"indexes\": " + to_string(indexMs));
         }
         printf("Done.\n");
     }
 
     // Write results to NetCDF file
+    spanStart = trace.Now();
     netCDF::NcFile outputFile(output_nfdrs, netCDF::NcFile::replace);
 
     auto timeDim = outputFile.addDim("time", T);
@@ -377,6 +661,18 @@ int main(int argc, char **argv)
     ICData.putVar(&IC[0]);
 
     outputFile.close();
+    bytesWritten = (runDFM ? 13 : 8) * T * spatialSize * sizeof(double);
+    trace.AddSpan("write_output", "io", 0, spanStart, trace.Now());
+
+    if (printSummary)
+        PrintTraceSummary(trace, trace.Now() * 1e-6, numCells * T, numThreads, bytesRead, bytesWritten, NFDRS4::GetPerfCounters());
+    if (writeTrace)
+    {
+        if (trace.Write(args::get(traceFlag)))
+            cout << "Trace written to " << args::get(traceFlag) << endl;
+        else
+            cerr << "Error writing trace " << args::get(traceFlag) << endl;
+    }
 
     return EXIT_SUCCESS;
 }
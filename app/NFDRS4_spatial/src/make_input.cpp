@@ -0,0 +1,267 @@
+/*
+    Writes a synthetic NFDRS4_spatial input file (input_nfdrs.nc) of any size,
+    for benchmarking without WRF-derived inputs. The static fields get a fuel
+    model mix and a burnable fraction, and the hourly weather follows diurnal
+    cycles with a smooth spatial offset per cell and passing afternoon storms.
+    The same options and seed always write the same file.
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <netcdf>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "args.hxx"
+
+using namespace std;
+
+constexpr double PI = 3.14159265358979323846;
+constexpr size_t STORM_BLOCK = 16; // storms cover blocks of STORM_BLOCK x STORM_BLOCK cells
+
+// Deterministic hash of the seed and up to three coordinates, uniform in [0, 1)
+double Hash01(uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0)
+{
+    uint64_t x = seed ^ (a * 0x9E3779B97F4A7C15ULL) ^ (b * 0xC2B2AE3D27D4EB4FULL) ^ (c * 0x165667B19E3779F9ULL);
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+bool IsLeapYear(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+int DaysInMonth(int year, int month)
+{
+    static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return month == 2 && IsLeapYear(year) ? 29 : days[month - 1];
+}
+
+int DayOfYear(int year, int month, int day)
+{
+    int doy = day;
+    for (int m = 1; m < month; ++m)
+        doy += DaysInMonth(year, m);
+    return doy;
+}
+
+// Parses "V=0.1,W=0.2,X=0.2,Y=0.4,Z=0.1" into cumulative weights of fuel models 1..5 (V..Z)
+bool ParseFuelMix(const string &spec, vector<double> &cumulative)
+{
+    const string models = "VWXYZ";
+    vector<double> weights(models.size(), 0.0);
+    stringstream ss(spec);
+    string item;
+    while (getline(ss, item, ','))
+    {
+        size_t eq = item.find('=');
+        if (eq != 1 || models.find(item[0]) == string::npos)
+            return false;
+        double w = atof(item.c_str() + 2);
+        if (w < 0.0)
+            return false;
+        weights[models.find(item[0])] = w;
+    }
+    double total = 0.0;
+    for (double w : weights)
+        total += w;
+    if (total <= 0.0)
+        return false;
+    cumulative.assign(weights.size(), 0.0);
+    double sum = 0.0;
+    for (size_t m = 0; m < weights.size(); ++m)
+    {
+        sum += weights[m] / total;
+        cumulative[m] = sum;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    args::ArgumentParser parser("Synthetic NFDRS4_spatial input generator", "By WIRC-SJSU.");
+    args::HelpFlag help(parser, "help", "Display help menu", {'h', "help"});
+    args::ValueFlag<string> outputFlag(parser, "path", "Output file path (default input_nfdrs.nc)", {'o', "output"});
+    args::ValueFlag<size_t> rowsFlag(parser, "N", "Grid rows, south_north (default 100)", {'n', "rows"});
+    args::ValueFlag<size_t> colsFlag(parser, "M", "Grid columns, west_east (default 100)", {'m', "cols"});
+    args::ValueFlag<size_t> hoursFlag(parser, "T", "Hourly timesteps (default 48)", {'t', "hours"});
+    args::ValueFlag<double> burnableFlag(parser, "fraction", "Fraction of burnable cells (default 0.8)", {"burnable"});
+    args::ValueFlag<string> fuelMixFlag(parser, "mix", "Fuel model weights (default V=0.1,W=0.2,X=0.2,Y=0.4,Z=0.1)", {"fuel-mix"});
+    args::ValueFlag<string> startFlag(parser, "date", "First day, YYYY-MM-DD (default 2024-06-01)", {"start"});
+    args::ValueFlag<double> latFlag(parser, "degrees", "Latitude of the south edge (default 37)", {"lat"});
+    args::ValueFlag<double> rainFlag(parser, "probability", "Chance of an afternoon storm per block and day (default 0.05)", {"rain"});
+    args::ValueFlag<uint64_t> seedFlag(parser, "seed", "Random seed (default 1)", {"seed"});
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (const args::Help &)
+    {
+        cout << parser;
+        return EXIT_SUCCESS;
+    }
+    catch (const args::ParseError &e)
+    {
+        cerr << e.what() << endl;
+        cerr << parser;
+        return EXIT_FAILURE;
+    }
+
+    string output = outputFlag ? args::get(outputFlag) : "input_nfdrs.nc";
+    size_t N = rowsFlag ? args::get(rowsFlag) : 100;
+    size_t M = colsFlag ? args::get(colsFlag) : 100;
+    size_t T = hoursFlag ? args::get(hoursFlag) : 48;
+    double burnable = burnableFlag ? args::get(burnableFlag) : 0.8;
+    double lat0 = latFlag ? args::get(latFlag) : 37.0;
+    double rainChance = rainFlag ? args::get(rainFlag) : 0.05;
+    uint64_t seed = seedFlag ? args::get(seedFlag) : 1;
+    vector<double> fuelMix;
+    if (!ParseFuelMix(fuelMixFlag ? args::get(fuelMixFlag) : "V=0.1,W=0.2,X=0.2,Y=0.4,Z=0.1", fuelMix))
+    {
+        cerr << "Invalid --fuel-mix, expected weights such as V=0.1,W=0.2,X=0.2,Y=0.4,Z=0.1" << endl;
+        return EXIT_FAILURE;
+    }
+    int year = 2024, month = 6, day = 1;
+    if (startFlag && (sscanf(args::get(startFlag).c_str(), "%d-%d-%d", &year, &month, &day) != 3 || month < 1 ||
+                      month > 12 || day < 1 || day > DaysInMonth(year, month)))
+    {
+        cerr << "Invalid --start date " << args::get(startFlag) << ", expected YYYY-MM-DD" << endl;
+        return EXIT_FAILURE;
+    }
+    if (N == 0 || M == 0 || T == 0 || burnable < 0.0 || burnable > 1.0)
+    {
+        cerr << "Rows, columns and hours must be positive and --burnable between 0 and 1" << endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t spatialSize = N * M;
+    try
+    {
+        netCDF::NcFile nfdrs(output, netCDF::NcFile::replace);
+        auto timeDim = nfdrs.addDim("time", T);
+        auto southNorthDim = nfdrs.addDim("south_north", N);
+        auto westEastDim = nfdrs.addDim("west_east", M);
+        vector<netCDF::NcDim> dims2 = {southNorthDim, westEastDim};
+        vector<netCDF::NcDim> dims3 = {timeDim, southNorthDim, westEastDim};
+
+        auto isBurnableVar = nfdrs.addVar("isBurnable", netCDF::ncInt, dims2);
+        auto latVar = nfdrs.addVar("Latitude", netCDF::ncDouble, dims2);
+        auto annAvgPrecVar = nfdrs.addVar("AnnAvgPPT", netCDF::ncDouble, dims2);
+        auto fModelsVar = nfdrs.addVar("FuelModel", netCDF::ncInt, dims2);
+        auto slopeClassVar = nfdrs.addVar("SlopeClass", netCDF::ncInt, dims2);
+        auto yearVar = nfdrs.addVar("Year", netCDF::ncInt, timeDim);
+        auto monthVar = nfdrs.addVar("Month", netCDF::ncInt, timeDim);
+        auto dayVar = nfdrs.addVar("Day", netCDF::ncInt, timeDim);
+        auto hourVar = nfdrs.addVar("Hour", netCDF::ncInt, timeDim);
+        auto tempVar = nfdrs.addVar("Temp", netCDF::ncDouble, dims3);
+        auto rhVar = nfdrs.addVar("RH", netCDF::ncDouble, dims3);
+        auto pptVar = nfdrs.addVar("PPT", netCDF::ncDouble, dims3);
+        auto snowDayVar = nfdrs.addVar("SnowDay", netCDF::ncInt, dims3);
+        auto windSpeedVar = nfdrs.addVar("WindSpeed", netCDF::ncDouble, dims3);
+        auto srVar = nfdrs.addVar("SR", netCDF::ncDouble, dims3);
+
+        // Static fields; offset is a smooth terrain-like field used by the weather
+        vector<int> isBurnable(spatialSize), fModels(spatialSize), slopeClass(spatialSize);
+        vector<double> lat(spatialSize), annAvgPrec(spatialSize), offset(spatialSize);
+        size_t burnableCells = 0;
+        for (size_t i = 0; i < N; ++i)
+        {
+            for (size_t j = 0; j < M; ++j)
+            {
+                size_t idx = i * M + j;
+                offset[idx] = sin(2.0 * PI * i / max(N, (size_t)8)) * cos(2.0 * PI * j / max(M, (size_t)8)) + (Hash01(seed, 1, idx) - 0.5) * 0.2;
+                isBurnable[idx] = Hash01(seed, 2, idx) < burnable ? 1 : 0;
+                burnableCells += isBurnable[idx];
+                double u = Hash01(seed, 3, idx);
+                int fModel = 1;
+                while (fModel < (int)fuelMix.size() && u >= fuelMix[fModel - 1])
+                    fModel++;
+                fModels[idx] = fModel;
+                slopeClass[idx] = 1 + (int)(Hash01(seed, 4, idx) * 5.0);
+                lat[idx] = lat0 + 0.01 * i;
+                annAvgPrec[idx] = 20.0 + 10.0 * offset[idx];
+            }
+        }
+        isBurnableVar.putVar(&isBurnable[0]);
+        latVar.putVar(&lat[0]);
+        annAvgPrecVar.putVar(&annAvgPrec[0]);
+        fModelsVar.putVar(&fModels[0]);
+        slopeClassVar.putVar(&slopeClass[0]);
+
+        // Hourly weather, one timestep at a time
+        vector<double> temp(spatialSize), rh(spatialSize), ppt(spatialSize), windSpeed(spatialSize), sr(spatialSize);
+        vector<int> snowDay(spatialSize, 0);
+        vector<size_t> count = {1, N, M};
+        int hour = 0;
+        for (size_t t = 0; t < T; ++t)
+        {
+            int doy = DayOfYear(year, month, day);
+            size_t dayIndex = t / 24;
+            double season = cos(2.0 * PI * (doy - 200) / 365.0);          // 1 in mid July
+            double diurnal = sin(2.0 * PI * (hour - 9) / 24.0);          // peaks at 15:00
+            double declination = 23.44 * PI / 180.0 * sin(2.0 * PI * (doy - 81) / 365.0);
+            for (size_t idx = 0; idx < spatialSize; ++idx)
+            {
+                double latRad = lat[idx] * PI / 180.0;
+                double hourAngle = (hour - 12) * 15.0 * PI / 180.0;
+                double sinElevation = sin(latRad) * sin(declination) + cos(latRad) * cos(declination) * cos(hourAngle);
+
+                size_t block = (idx / M) / STORM_BLOCK * ((M + STORM_BLOCK - 1) / STORM_BLOCK) + (idx % M) / STORM_BLOCK;
+                bool storm = hour >= 14 && hour <= 18 && Hash01(seed, 5, dayIndex, block) < rainChance;
+
+                temp[idx] = 65.0 + 15.0 * season + 14.0 * diurnal - 8.0 * offset[idx] + (Hash01(seed, 6, t, idx) - 0.5) * 2.0;
+                rh[idx] = min(100.0, max(5.0, 40.0 - 10.0 * season - 22.0 * diurnal + 10.0 * offset[idx] + (storm ? 35.0 : 0.0)));
+                ppt[idx] = storm ? 0.02 + 0.1 * Hash01(seed, 7, t, block) : 0.0;
+                windSpeed[idx] = max(0.0, 6.0 + 4.0 * diurnal + 3.0 * offset[idx] + 4.0 * Hash01(seed, 8, t, idx) + (storm ? 10.0 : 0.0));
+                sr[idx] = max(0.0, 1000.0 * sinElevation) * (storm ? 0.3 : 1.0);
+            }
+
+            vector<size_t> start1 = {t};
+            vector<size_t> count1 = {1};
+            yearVar.putVar(start1, count1, &year);
+            monthVar.putVar(start1, count1, &month);
+            dayVar.putVar(start1, count1, &day);
+            hourVar.putVar(start1, count1, &hour);
+            vector<size_t> start = {t, 0, 0};
+            tempVar.putVar(start, count, &temp[0]);
+            rhVar.putVar(start, count, &rh[0]);
+            pptVar.putVar(start, count, &ppt[0]);
+            snowDayVar.putVar(start, count, &snowDay[0]);
+            windSpeedVar.putVar(start, count, &windSpeed[0]);
+            srVar.putVar(start, count, &sr[0]);
+
+            if (++hour == 24)
+            {
+                hour = 0;
+                if (++day > DaysInMonth(year, month))
+                {
+                    day = 1;
+                    if (++month > 12)
+                    {
+                        month = 1;
+                        year++;
+                    }
+                }
+            }
+        }
+        nfdrs.close();
+
+        printf("%s: %zu x %zu cells (%zu burnable), %zu hours\n", output.c_str(), N, M, burnableCells, T);
+    }
+    catch (const netCDF::exceptions::NcException &e)
+    {
+        cerr << "NetCDF Error: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
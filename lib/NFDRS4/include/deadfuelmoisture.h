@@ -358,6 +358,7 @@ public:
     DeadFuelMoisture( const DeadFuelMoisture& rhs ) ;
     // Assignment operator
     const DeadFuelMoisture& operator=( const DeadFuelMoisture& rhs ) ;
+    void copyStateFrom( const DeadFuelMoisture& rhs ) ;
     const char* className( void ) const ;
     // Static convenience functions
     static DeadFuelMoisture* createDeadFuelMoisture1( const std::string& name="" ) ;
@@ -478,6 +479,7 @@ public:
 	void initializeParameters( double radius, const std::string& name ) ;
 	DFMCalcState GetState();
 	bool SetState(DFMCalcState state);
+	size_t MemoryFootprint( void ) const ;
 // Protected methods
 protected:
     void diffusivity( double bp ) ;
@@ -504,6 +506,7 @@ protected:
             bool    pertubateColumn=false,
             bool    rampRai0=false
          ) ;
+    double perturbation( double min, double max ) ;
 
 // Protected data members
 protected:
@@ -591,7 +594,9 @@ protected:
     std::vector<double> m_w; //!< Array of nodal moisture contents (g water/g dry fuel).
     long    m_updates;  //!< Number of calls made to update().
     int m_state;  //!< Prevailing dead fuel moisture state.
-    int     m_randseed; //!< If not zero, nodal temperature, saturation, and moisture contents are pertubated by some small amount. If < 0, uses system clock for seed.
+    int     m_randseed; //!< If not zero, nodal temperature, saturation, and moisture contents are pertubated by some small amount. If < 0, uses system clock for seed, which setRandomSeed() then stores here.
+    unsigned long long m_randKey;   //!< Perturbation stream key derived from \a m_randseed by setRandomSeed().
+    unsigned long long m_randDraws; //!< Number of perturbations drawn during the current update().
     std::vector<double> m_Ttold; //!< Temporary array of nodal temperatures (oC).
     std::vector<double> m_Tsold; //!< Temporary array of nodal fiber saturation points (g water/g dry fuel).
     std::vector<double> m_Twold; //!< Temporary array of nodal moisture contents (g water/g dry fuel).
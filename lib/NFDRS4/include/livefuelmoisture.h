@@ -1,9 +1,11 @@
 #ifndef LIVEFUELMOISTURE_H
 #define LIVEFUELMOISTURE_H
 #include <math.h>
+#include <ctime>
 #include <vector>
 #include <deque>
 #include "lfmcalcstate.h"
+#include "slidingwindow.h"
 
 #define NOVALUE -9999.9
 #define RADPERDAY 0.017214
@@ -20,6 +22,21 @@
     <i>Glob. Chan. Biol.</i> 11<b>(4)</b>: 619-632.
  */
 
+//------------------------------------------------------------------------------
+/*! \struct LFMDailyInputs
+    \brief Inputs of one daily herb and woody update, as NFDRS4 passes them to
+    LiveFuelMoisture::Update(), see NFDRS4::SetDeferLiveFuels().
+ */
+struct LFMDailyInputs
+{
+	double Temp, MaxTemp, MinTemp, RH, MinRH;//F and %
+	double HerbPrecip, WoodyPrecip;//precipitation over each model's GetNumPrecipDays()
+	int Jday;
+	time_t Time;
+	bool SnowDay;//snow covered long enough to hold both moistures at their minimum
+	bool ResetHerb;//LiveFuelMoisture::ResetHerbState() is due before this update
+};
+
 //------------------------------------------------------------------------------
 /*! \class LiveFuelMoisture LiveFuelMoisture.h
     \brief Determines moisture content of live herbaceous and woody fuels
@@ -71,16 +88,19 @@ class LiveFuelMoisture
 		bool GetIsAnnual();
 		LFMCalcState GetState();
 		bool SetState(LFMCalcState state);
+		void CopyStateFrom(const LiveFuelMoisture& rhs);
+		size_t MemoryFootprint() const;
 
         void SetUseRTPrecip(bool set);
         bool GetUseRTPrecip();
     private:
+		friend class LiveFuelMoistureBatch;
 		bool m_UseVPDAvg;
         bool m_IsHerb;
         bool m_IsAnnual;
         int m_LFIdaysAvg;
         double m_Lat;
-		std::deque<double> qGSI;
+		SlidingWindow qGSI;
         double m_TminMin;
         double m_TminMax;
         double m_VPDMin;
@@ -0,0 +1,104 @@
+#ifndef LIVEFUELMOISTUREBATCH_H
+#define LIVEFUELMOISTUREBATCH_H
+#include <cstddef>
+#include <ctime>
+#include <vector>
+#include "livefuelmoisture.h"
+
+//------------------------------------------------------------------------------
+/*! \struct LFMDailyOutputs
+    \brief Results of one daily herb and woody update, as NFDRS4 takes them in
+    NFDRS4::CompleteLiveFuels().
+ */
+struct LFMDailyOutputs
+{
+	double HerbFM, WoodyFM;//% dry wt
+	double GSI;//running average GSI of the herb model
+};
+
+//------------------------------------------------------------------------------
+/*! \class LiveFuelMoistureBatch livefuelmoisturebatch.h
+    \brief Daily herb and woody GSI and live fuel moisture for many cells at once.
+
+    Gives the results of calling LiveFuelMoisture::Update() and GetMoisture() on
+    each cell's herb and woody models, for grids whose cells share their GSI
+    limits and LFM parameters (they may differ in latitude):
+    - daylength comes from per latitude sines and cosines and a per day of year
+      declination table, leaving one acos per cell and day, or, when a latitude
+      band is given, from a (band, day of year) table with no trig at all;
+    - the minimum temperature, VPD and daylength indicators are computed once
+      for herb and woody when their limits agree;
+    - the running GSI windows are kept structure of arrays, one window per cell
+      when herb and woody GSI are the same (the default parameters), two otherwise.
+
+    With no latitude band the results are bit for bit those of the LiveFuelMoisture
+    objects. Cells are independent, so Update() may be called from several
+    threads on disjoint cell ranges.
+ */
+class LiveFuelMoistureBatch
+{
+public:
+	LiveFuelMoistureBatch();
+
+	bool Initialize(const LiveFuelMoisture& herb, const LiveFuelMoisture& woody, const std::vector<double>& lats, double latBand = 0.0);
+	bool LoadCell(size_t cell, const LiveFuelMoisture& herb, const LiveFuelMoisture& woody);
+	void StoreCell(size_t cell, LiveFuelMoisture& herb, LiveFuelMoisture& woody) const;
+	void Update(size_t first, size_t count, const LFMDailyInputs* inputs, LFMDailyOutputs* outputs);
+
+	size_t Size() const { return m_numCells; }
+	bool SharesGSIWindow() const { return m_shareWindow; }
+	double GetLatBand() const { return m_latBand; }
+	size_t MemoryFootprint() const;
+
+private:
+	//running GSI windows of every cell, the same arithmetic as SlidingWindow
+	struct GSIWindows
+	{
+		size_t capacity;
+		std::vector<double> values;             // capacity per cell
+		std::vector<double> prefix;             // capacity + 1 per cell
+		std::vector<unsigned> head, size;
+		std::vector<unsigned long long> count;
+
+		void Resize(size_t numCells, size_t windowCapacity);
+		void Push(size_t cell, double value);
+		void PopOldest(size_t cell, size_t n);
+		double Mean(size_t cell) const;
+		size_t MemoryFootprint() const;
+		double& Prefix(size_t cell, unsigned long long k) { return prefix[cell * (capacity + 1) + k % (capacity + 1)]; }
+		double Prefix(size_t cell, unsigned long long k) const { return prefix[cell * (capacity + 1) + k % (capacity + 1)]; }
+		void Rebase(size_t cell);
+	};
+	static const int NDAYS = 367;//days of year 0 - 366 in the declination and band tables
+
+	static void LoadWindow(GSIWindows& windows, size_t cell, const SlidingWindow& window);
+	static void StoreWindow(const GSIWindows& windows, size_t cell, SlidingWindow& window);
+	static bool SameGSI(const LiveFuelMoisture& a, const LiveFuelMoisture& b);
+	static bool SameLFM(const LiveFuelMoisture& a, const LiveFuelMoisture& b);
+	static double Daylength(double sinLat, double cosLat, double sinDecl, double cosDecl);
+	double Daylength(size_t cell, int doy) const;
+	double BandLatitude(size_t band) const;
+	static double VPD(LiveFuelMoisture& model, const LFMDailyInputs& in);
+	double HerbMoisture(size_t cell, double GSI, bool snowDay);
+	double WoodyMoisture(double GSI, bool snowDay) const;
+
+	LiveFuelMoisture m_herb, m_woody;// parameters and indicator functions
+	size_t m_numCells;
+	double m_latBand;
+	bool m_shareTmin, m_shareVPD, m_shareDayl, m_shareWindow;
+
+	//daylength: per cell latitude terms and per day declination terms, or with
+	//a latitude band the daylength of every (band, day of year)
+	std::vector<double> m_sinLat, m_cosLat;
+	std::vector<double> m_sinDecl, m_cosDecl;
+	std::vector<unsigned> m_band;       // band of each cell, from m_firstBand
+	unsigned m_firstBand;
+	std::vector<double> m_bandDayl;
+
+	GSIWindows m_herbGSI, m_woodyGSI;
+	std::vector<time_t> m_lastUpdateTime;
+	std::vector<unsigned char> m_greenedUp, m_exceeded120, m_canIncrease;
+	std::vector<double> m_lastHerbFM;
+};
+
+#endif // LIVEFUELMOISTUREBATCH_H
@@ -0,0 +1,49 @@
+#ifndef MEMORYFOOTPRINT_H
+#define MEMORYFOOTPRINT_H
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+/*! \brief Heap bytes behind standard containers, used by the MemoryFootprint()
+    methods. These count the storage the container asks for, not the
+    allocator's own per-block overhead.
+ */
+
+//! Heap bytes of a string of the given capacity, 0 while it fits the small string buffer.
+inline size_t StringHeapBytes(size_t capacity)
+{
+	static const size_t smallCapacity = std::string().capacity();
+	return capacity > smallCapacity ? capacity + 1 : 0;
+}
+
+inline size_t StringHeapBytes(const std::string& s)
+{
+	return StringHeapBytes(s.capacity());
+}
+
+template <class T>
+inline size_t VectorHeapBytes(const std::vector<T>& v)
+{
+	return v.capacity() * sizeof(T);
+}
+
+//! Heap bytes of a deque holding n elements: 512 byte blocks and a map of at least 8 block pointers.
+template <class T>
+inline size_t DequeHeapBytes(size_t n)
+{
+	const size_t perBlock = sizeof(T) < 512 ? 512 / sizeof(T) : 1;
+	size_t blocks = n / perBlock + 1;
+	size_t mapSlots = blocks + 2 > 8 ? blocks + 2 : 8;
+	return blocks * perBlock * sizeof(T) + mapSlots * sizeof(void*);
+}
+
+//! Heap bytes of an unordered_map's nodes and buckets, not of what the values own.
+template <class K, class V>
+inline size_t UnorderedMapHeapBytes(const std::unordered_map<K, V>& m)
+{
+	return m.size() * (sizeof(void*) + sizeof(typename std::unordered_map<K, V>::value_type)) + m.bucket_count() * sizeof(void*);
+}
+
+#endif
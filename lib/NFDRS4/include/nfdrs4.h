@@ -19,6 +19,8 @@
 #include "deadfuelmoisture.h"
 #include "livefuelmoisture.h"
 #include "nfdrs4calcstate.h"
+#include "nfdrs4perf.h"
+#include "slidingwindow.h"
 #include "utctime.h"
 
 /*Fuel Model Definition*/
@@ -152,6 +154,18 @@ Functions:
 
 ***************************************************************************/
 
+//------------------------------------------------------------------------------
+/*! \struct NFDRS4Indexes
+    \brief Components and indexes for one fuel model, as returned by
+    NFDRS4::iCalcIndexesForFuelModels().
+*/
+struct NFDRS4Indexes
+{
+	char FuelModel;
+	bool Valid;//false if the fuel model is unknown or the indexes could not be calculated
+	double SC, ERC, BI, IC;
+};
+
 //------------------------------------------------------------------------------
 /*! \class NFDRS4
     \brief Main calculator for the US National Fire Danger Rating System components
@@ -176,6 +190,7 @@ class NFDRS4
  		bool iSetFuelModel(char cFM);
         int iSetFuelMoistures (double fMC1, double fMC10,double fMC100, double fMC1000, double fMCWood, double fMCHerb, double fuelTempC);
         int iCalcIndexes (int iWS, int iSlopeCls,double* fSC,double* fERC, double* fBI, double* fIC,double fGSI = -999,double fKBDI = -999);
+        int iCalcIndexesForFuelModels(int iWS, int iSlopeCls, const std::vector<char>& fuelModels, std::vector<NFDRS4Indexes>& indexes, double fGSI = -999, double fKBDI = -999);
         int iCalcKBDI (double fPrecipAmt, int iMaxTemp,double fCummPrecip, int iYKBDI, double fAvgPrecip);
 		double Cure(double fGSI = -999, double fGreenupThreshold = 0.5, double fGSIMax = 1.0);
 
@@ -228,6 +243,26 @@ class NFDRS4
 		bool ReadState(std::string fileName);
 		bool SaveState(std::string fileName);
 		bool LoadState(NFDRS4State state);
+		//copies only the evolving model state from src, for branching
+		//forecast scenarios into preallocated copies of an NFDRS4
+		void CopyStateFrom(const NFDRS4& src);
+		//bytes one instance holds, including its sticks, GSI models, windows
+		//and fuel model map, for sizing grid runs
+		size_t MemoryFootprint() const;
+		//per phase call counts and times of all threads, zero unless the
+		//library is built with NFDRS4_PERF_COUNTERS, see nfdrs4perf.h
+		static NFDRS4PerfCounters GetPerfCounters();
+		static void ResetPerfCounters();
+		//grid runs can hand the daily herb and woody update to a
+		//LiveFuelMoistureBatch: the update at the observation hour then stops
+		//before the indexes, LiveFuelsPending() is true, GetLiveFuelInputs()
+		//gives the batch's inputs and CompleteLiveFuels() takes its results.
+		//HerbFM and WoodyFM are not updated while deferring
+		void SetDeferLiveFuels(bool defer);
+		bool GetDeferLiveFuels();
+		bool LiveFuelsPending();
+		const LFMDailyInputs& GetLiveFuelInputs();
+		void CompleteLiveFuels(double herbFM, double woodyFM, double GSI);
 		const int nPrecipQueueDays = 90;
         const int nHoursPerDay = 24;
         double GetMinTemp();
@@ -236,6 +271,7 @@ class NFDRS4
         double GetPcp24();
 
 		void AddCustomFuel(CFuelModelParams fmParams);
+		CFuelModelParams GetActiveFuelModelParams();
 		double CTA;
         double Lat;
         int NFDRSVersion;
@@ -273,11 +309,21 @@ class NFDRS4
         time_t utcHourDiff;
         utctime::UTCTime lastUtcUpdateTime;
         utctime::UTCTime lastDailyUpdateTime;
-        std::deque<double> qPrecip;
-        std::deque<double> qHourlyPrecip;
-        std::deque<double> qHourlyTemp;
-        std::deque<double> qHourlyRH;
+        SlidingWindow qPrecip{ (size_t)nPrecipQueueDays };
+        SlidingWindow qHourlyPrecip{ (size_t)nHoursPerDay };
+        SlidingWindow qHourlyTemp{ (size_t)nHoursPerDay };
+        SlidingWindow qHourlyRH{ (size_t)nHoursPerDay };
 		std::unordered_map<char, CFuelModelParams> mapFuels;
+	private:
+		void ApplyFuelModelParams(CFuelModelParams& fm);
+		void ResetHerbState();
+		void UpdateLiveFuels(double Temp, double MaxTemp, double MinTemp, double RH, double MinRH, int Julian, time_t thisTime);
+		void SetMoisturesAndCalcIndexes(double fMC1, double fMC10, double fMC100, double fMC1000, double fuelTempC, double WS);
+		bool m_deferLiveFuels;
+		bool m_liveFuelsPending;
+		bool m_herbResetPending;
+		LFMDailyInputs m_liveFuelInputs;
+		double m_pendingWS;
 };
 
 
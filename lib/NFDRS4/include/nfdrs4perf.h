@@ -0,0 +1,132 @@
+#ifndef NFDRS4PERF_H
+#define NFDRS4PERF_H
+#include <chrono>
+
+//------------------------------------------------------------------------------
+/*! \enum NFDRS4PerfPhase
+    \brief Timed phases of NFDRS4::Update() and DeadFuelMoisture::update().
+    The stick phases include their diffusivity calls.
+ */
+enum NFDRS4PerfPhase
+{
+	NFDRS4_PERF_TIME,//date checks, reinit and UTC times
+	NFDRS4_PERF_DFM_1H,
+	NFDRS4_PERF_DFM_10H,
+	NFDRS4_PERF_DFM_100H,
+	NFDRS4_PERF_DFM_1000H,
+	NFDRS4_PERF_DIFFUSIVITY,
+	NFDRS4_PERF_LFM_GSI,
+	NFDRS4_PERF_KBDI,
+	NFDRS4_PERF_INDEXES,
+	NFDRS4_PERF_QUEUES,//hourly and daily sliding windows
+	NFDRS4_PERF_PHASES
+};
+
+//------------------------------------------------------------------------------
+/*! \var NFDRS4_PERF_DFM_STATES
+    \brief Number of DeadFuelMoisture::DFM_State values counted.
+ */
+static const int NFDRS4_PERF_DFM_STATES = 11;
+
+//------------------------------------------------------------------------------
+/*! \struct NFDRS4PerfCounters nfdrs4perf.h
+    \brief Timed sections and time per phase of the NFDRS4 hot path, summed over
+    every thread, as returned by NFDRS4::GetPerfCounters().
+
+    The counters are only kept when the library is built with
+    NFDRS4_PERF_COUNTERS defined (cmake -DNFDRS4_PERF_COUNTERS=ON); otherwise
+    the instrumentation compiles to nothing and enabled is false.
+ */
+struct NFDRS4PerfCounters
+{
+	bool enabled;
+	unsigned long long calls[NFDRS4_PERF_PHASES];//calls; once per update that ran it for the phases NFDRS4::Update() laps
+	unsigned long long nanoseconds[NFDRS4_PERF_PHASES];
+	unsigned long long dfmUpdates;//stick updates done
+	unsigned long long dfmStates[NFDRS4_PERF_DFM_STATES];//moisture time steps spent in each DFM_State
+	unsigned long long dfmSubSteps;//moisture time steps of the stick updates
+	unsigned long long dfmRejected;//stick updates refused for out of range inputs
+
+	NFDRS4PerfCounters() { Clear(); }
+	void Clear();
+	void Add(const NFDRS4PerfCounters& other);
+	static const char* GetPhaseName(int phase);
+	static const char* GetDFMStateName(int state);
+};
+
+//------------------------------------------------------------------------------
+/*! \brief Adds to the calling thread's counters; the NFDRS4_PERF_ macros
+    below call these only in instrumented builds.
+ */
+void NFDRS4PerfAddPhase(int phase, unsigned long long nanoseconds, bool countCall = true);
+void NFDRS4PerfAddDFM(const int* stateSteps);
+void NFDRS4PerfAddDFMRejected();
+NFDRS4PerfCounters NFDRS4PerfGetCounters();
+void NFDRS4PerfResetCounters();
+
+#ifdef NFDRS4_PERF_COUNTERS
+//------------------------------------------------------------------------------
+/*! \class CNFDRS4PerfScope nfdrs4perf.h
+    \brief Adds the time from its construction to its destruction to a phase.
+ */
+class CNFDRS4PerfScope
+{
+public:
+	CNFDRS4PerfScope(int phase) : m_phase(phase), m_start(std::chrono::steady_clock::now()) {}
+	~CNFDRS4PerfScope()
+	{
+		NFDRS4PerfAddPhase(m_phase, (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+	}
+private:
+	int m_phase;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CNFDRS4PerfTimer nfdrs4perf.h
+    \brief Splits a function into consecutive phases: Lap() adds the time since
+    the previous lap to a phase, LapMore() adds it to a phase already lapped
+    in this call without counting another call, Restart() drops it (time
+    already counted by a nested scope).
+ */
+class CNFDRS4PerfTimer
+{
+public:
+	CNFDRS4PerfTimer() : m_start(std::chrono::steady_clock::now()) {}
+	void Lap(int phase)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		NFDRS4PerfAddPhase(phase, (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start).count());
+		m_start = now;
+	}
+	void LapMore(int phase)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		NFDRS4PerfAddPhase(phase, (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start).count(), false);
+		m_start = now;
+	}
+	void Restart() { m_start = std::chrono::steady_clock::now(); }
+private:
+	std::chrono::steady_clock::time_point m_start;
+};
+
+#define NFDRS4_PERF_CONCAT2(a, b) a##b
+#define NFDRS4_PERF_CONCAT(a, b) NFDRS4_PERF_CONCAT2(a, b)
+#define NFDRS4_PERF_SCOPE(phase) CNFDRS4PerfScope NFDRS4_PERF_CONCAT(nfdrs4PerfScope, __LINE__)(phase)
+#define NFDRS4_PERF_TIMER(timer) CNFDRS4PerfTimer timer
+#define NFDRS4_PERF_LAP(timer, phase) timer.Lap(phase)
+#define NFDRS4_PERF_LAP_MORE(timer, phase) timer.LapMore(phase)
+#define NFDRS4_PERF_RESTART(timer) timer.Restart()
+#define NFDRS4_PERF_DFM(stateSteps) NFDRS4PerfAddDFM(stateSteps)
+#define NFDRS4_PERF_DFM_REJECTED() NFDRS4PerfAddDFMRejected()
+#else
+#define NFDRS4_PERF_SCOPE(phase)
+#define NFDRS4_PERF_TIMER(timer)
+#define NFDRS4_PERF_LAP(timer, phase)
+#define NFDRS4_PERF_LAP_MORE(timer, phase)
+#define NFDRS4_PERF_RESTART(timer)
+#define NFDRS4_PERF_DFM(stateSteps)
+#define NFDRS4_PERF_DFM_REJECTED()
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef NFDRS4TIMELINE_H
+#define NFDRS4TIMELINE_H
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include "nfdrs4.h"
+
+//------------------------------------------------------------------------------
+/*! \struct NFDRS4Observation
+    \brief One hourly observation, in the units of NFDRS4::Update().
+*/
+struct NFDRS4Observation
+{
+	int Year, Month, Day, Hour;
+	double Temp, RH, PPTAmt, SolarRad, WS;
+	bool SnowDay;
+};
+
+//------------------------------------------------------------------------------
+/*! \struct NFDRS4Outputs
+    \brief Model outputs after one hourly observation. Stale is set when an
+    earlier observation was corrected and the hour has not been recomputed.
+*/
+struct NFDRS4Outputs
+{
+	double MC1, MC10, MC100, MC1000, MCHERB, MCWOOD, FuelTemperature;
+	double BI, ERC, SC, IC, GSI;
+	int KBDI;
+	bool Stale;
+};
+
+//------------------------------------------------------------------------------
+/*! \class NFDRS4Timeline nfdrs4timeline.h
+    \brief Drives an NFDRS4 with hourly observations while keeping the recent
+    observations, their outputs and a bounded ring of in-memory checkpoints, so
+    late or corrected observations only require replaying the hours from the
+    nearest checkpoint before them.
+
+    Checkpoints hold the model state before an hour and are taken every
+    checkpointInterval hours; when the ring is full the oldest checkpoint is
+    reused. Hours older than maxHours are forgotten. Corrections are accepted
+    back to the oldest checkpoint still covered by the kept hours (see
+    GetFirstCorrectableHour()). The NFDRS4 must be fully configured before
+    the timeline is created, since checkpoint slots are copies of it.
+*/
+class NFDRS4Timeline
+{
+public:
+	NFDRS4Timeline(NFDRS4* pModel, size_t maxHours = 168, size_t checkpointInterval = 24);
+	~NFDRS4Timeline();
+
+	void Update(const NFDRS4Observation& obs);
+	int Correct(const NFDRS4Observation& obs);
+	int Recompute();
+
+	bool HasStale() const { return m_firstStale < m_hours.size(); }
+	size_t GetNumHours() const { return m_hours.size(); }
+	const NFDRS4Observation& GetObservation(size_t i) const { return m_hours[i]; }
+	const NFDRS4Outputs& GetOutputs(size_t i) const { return m_outputs[i]; }
+	int FindHour(int Year, int Month, int Day, int Hour) const;
+	int GetFirstCorrectableHour() const;
+	size_t GetNumCheckpoints() const { return m_checkpoints.size(); }
+
+private:
+	struct Checkpoint
+	{
+		unsigned long long seq;//sequence number of the hour that follows the checkpoint
+		size_t slot;
+	};
+	static long long HourKey(int Year, int Month, int Day, int Hour);
+	size_t CheckpointIndex(const Checkpoint& cp) const { return (size_t)(cp.seq - m_firstSeq); }
+	void Step(size_t i);
+	void TakeCheckpoint(size_t i);
+	void DropCheckpointsAfter(size_t i);
+	void Trim();
+
+	NFDRS4* m_pModel;
+	size_t m_maxHours;
+	size_t m_checkpointInterval;
+	unsigned long long m_firstSeq;//sequence number of m_hours[0]
+	std::deque<NFDRS4Observation> m_hours;
+	std::deque<NFDRS4Outputs> m_outputs;
+	std::deque<Checkpoint> m_checkpoints;//oldest first
+	size_t m_numSlots;
+	std::vector<NFDRS4> m_slots;//created on first use
+	std::vector<size_t> m_freeSlots;
+	size_t m_firstStale;//index of the first stale hour, m_hours.size() if none
+};
+
+#endif // NFDRS4TIMELINE_H
@@ -0,0 +1,67 @@
+#ifndef SLIDINGWINDOW_H
+#define SLIDINGWINDOW_H
+#include <cstddef>
+#include <deque>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------------
+/*! \class SlidingWindow slidingwindow.h
+    \brief Fixed capacity ring buffer of the most recent values with O(1)
+    running sum, minimum and maximum.
+
+    Values equal to the window's no-data value occupy a slot (so the window
+    still spans a fixed number of hours or days) but are ignored by Sum(),
+    Min() and Max(). Sums are kept as prefix sums so any trailing span can be
+    totalled without a scan, and min/max are kept in monotonic queues.
+    Gaps are absorbed by PushRepeated() / PushMissing() in at most Capacity()
+    steps no matter how long the gap is.
+ */
+class SlidingWindow
+{
+public:
+	SlidingWindow(size_t capacity = 1, double noData = -999.0);
+
+	void Push(double value);
+	void PushRepeated(double value, size_t count);
+	void PushMissing(size_t count);
+	void PopOldest(size_t count);
+	void Clear();
+	void SetCapacity(size_t capacity);
+
+	size_t Size() const { return m_size; }
+	size_t Capacity() const { return m_capacity; }
+	bool IsFull() const { return m_size == m_capacity; }
+	double GetNoData() const { return m_noData; }
+
+	double At(size_t i) const;
+	double Newest() const;
+	std::vector<double> Values() const;
+	size_t MemoryFootprint() const;
+
+	double Sum() const;
+	double SumLast(size_t n) const;
+	double Mean() const;
+	double Min() const;
+	double Max() const;
+
+private:
+	friend class LiveFuelMoistureBatch;
+	bool IsMissing(double value) const { return value == m_noData; }
+	double& Prefix(unsigned long long k) { return m_prefix[k % m_prefix.size()]; }
+	double Prefix(unsigned long long k) const { return m_prefix[k % m_prefix.size()]; }
+	void Expire();
+	void Rebase();
+
+	size_t m_capacity;
+	size_t m_size;
+	size_t m_head;                  // slot of the oldest value
+	unsigned long long m_count;     // total values ever pushed
+	double m_noData;
+	std::vector<double> m_values;
+	std::vector<double> m_prefix;   // m_prefix[k] = sum of valid values pushed before k, capacity + 1 slots
+	std::deque<std::pair<unsigned long long, double> > m_minQ;
+	std::deque<std::pair<unsigned long long, double> > m_maxQ;
+};
+
+#endif // SLIDINGWINDOW_H
@@ -41,6 +41,8 @@ using std::vector;
 
 // Custom include files
 #include "deadfuelmoisture.h"
+#include "memoryfootprint.h"
+#include "nfdrs4perf.h"
 
 //#define DEBUG
 #undef DEBUG
@@ -163,6 +165,22 @@ DeadFuelMoisture::DeadFuelMoisture( const DeadFuelMoisture& r )
     m_updates   = r.m_updates;
     m_state     = r.m_state;
     m_randseed  = r.m_randseed;
+    m_randKey   = r.m_randKey;
+    m_randDraws = r.m_randDraws;
+    m_Jday      = r.m_Jday;
+    m_Year      = r.m_Year;
+    m_Month     = r.m_Month;
+    m_Day       = r.m_Day;
+    m_Hour      = r.m_Hour;
+    m_Min       = r.m_Min;
+    m_Sec       = r.m_Sec;
+    obstime     = r.obstime;
+    m_Ttold     = r.m_Ttold;
+    m_Tsold     = r.m_Tsold;
+    m_Twold     = r.m_Twold;
+    m_Tv        = r.m_Tv;
+    m_To        = r.m_To;
+    m_Tg        = r.m_Tg;
     return;
 }
 
@@ -237,10 +255,106 @@ const DeadFuelMoisture& DeadFuelMoisture::operator=( const DeadFuelMoisture& r )
         m_updates   = r.m_updates;
         m_state     = r.m_state;
         m_randseed  = r.m_randseed;
+        m_randKey   = r.m_randKey;
+        m_randDraws = r.m_randDraws;
+        m_Jday      = r.m_Jday;
+        m_Year      = r.m_Year;
+        m_Month     = r.m_Month;
+        m_Day       = r.m_Day;
+        m_Hour      = r.m_Hour;
+        m_Min       = r.m_Min;
+        m_Sec       = r.m_Sec;
+        obstime     = r.obstime;
+        m_Ttold     = r.m_Ttold;
+        m_Tsold     = r.m_Tsold;
+        m_Twold     = r.m_Twold;
+        m_Tv        = r.m_Tv;
+        m_To        = r.m_To;
+        m_Tg        = r.m_Tg;
     }
     return( *this );
 }
 
+//------------------------------------------------------------------------------
+/*! \brief Copies only the evolving stick state from another stick.
+
+    Copies the nodal temperature, saturation, diffusivity and moisture
+    profiles, the previous and current observation values and the update
+    counters. Stick geometry, parameters and name are left untouched, so this
+    is the cheap way to reset a scenario copy of a stick back to an observed
+    state. If the two sticks do not have the same number of nodes a full
+    assignment is done instead.
+
+    \param[in] r Reference to the DeadFuelMoisture from which to copy.
+ */
+
+void DeadFuelMoisture::copyStateFrom( const DeadFuelMoisture& r )
+{
+    if ( this == &r )
+        return;
+    if ( m_nodes != r.m_nodes )
+    {
+        *this = r;
+        return;
+    }
+    m_Jday      = r.m_Jday;
+    m_Year      = r.m_Year;
+    m_Month     = r.m_Month;
+    m_Day       = r.m_Day;
+    m_Hour      = r.m_Hour;
+    m_Min       = r.m_Min;
+    m_Sec       = r.m_Sec;
+    obstime     = r.obstime;
+    m_bp0       = r.m_bp0;
+    m_ha0       = r.m_ha0;
+    m_rc0       = r.m_rc0;
+    m_sv0       = r.m_sv0;
+    m_ta0       = r.m_ta0;
+    m_init      = r.m_init;
+    m_bp1       = r.m_bp1;
+    m_et        = r.m_et;
+    m_ha1       = r.m_ha1;
+    m_rc1       = r.m_rc1;
+    m_sv1       = r.m_sv1;
+    m_ta1       = r.m_ta1;
+    m_pptrate   = r.m_pptrate;
+    m_ra0       = r.m_ra0;
+    m_ra1       = r.m_ra1;
+    m_rdur      = r.m_rdur;
+    m_hf        = r.m_hf;
+    m_wsa       = r.m_wsa;
+    m_sem       = r.m_sem;
+    m_wfilm     = r.m_wfilm;
+    m_elapsed   = r.m_elapsed;
+    // same node count, so these copy into the existing storage
+    m_t         = r.m_t;
+    m_s         = r.m_s;
+    m_d         = r.m_d;
+    m_w         = r.m_w;
+    m_updates   = r.m_updates;
+    m_state     = r.m_state;
+    return;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Bytes held by the stick: the object itself, its nodal and
+    temporary arrays and its name.
+
+    \return Size in bytes, not counting allocator overhead.
+ */
+
+size_t DeadFuelMoisture::MemoryFootprint( void ) const
+{
+    size_t bytes = sizeof( DeadFuelMoisture ) + StringHeapBytes( m_name );
+    const std::vector<double>* arrays[] = { &m_x, &m_v, &m_t, &m_s, &m_d, &m_w,
+        &m_Ttold, &m_Tsold, &m_Twold, &m_Tv, &m_To, &m_Tg };
+    for ( const std::vector<double>* a : arrays )
+    {
+        bytes += VectorHeapBytes( *a );
+    }
+    return( bytes );
+}
+
 //------------------------------------------------------------------------------
 /*! \brief Virtual class destructor.
  */
@@ -514,6 +628,7 @@ double DeadFuelMoisture::desorptionRate( void ) const
 
 void DeadFuelMoisture::diffusivity ( double bp )
 {
+	NFDRS4_PERF_SCOPE(NFDRS4_PERF_DIFFUSIVITY);
 	double tk, qv, cpv, dv, ps1, c1, c2, wc, daw, svaw, vfaw, vfcw, rfcw, fac, con, qw, e, dvpr;
 	// Loop for each node
     for ( int i=0; i<m_nodes; i++ )
@@ -1296,19 +1411,37 @@ void DeadFuelMoisture::setRampRai0( bool ramp )
     \param[in] randseed If not zero, nodal temperature, saturation,
     and moisture contents are pertubated by some small amount.
     If > 0, this value is used as the seed. If < 0, uses system clock for seed.
+
+    The seed keys the stick's own perturbation stream (see perturbation()),
+    so sticks with the same seed and update history draw the same
+    perturbations whichever thread updates them.  A clock seed is read once
+    here and kept as the (positive) seed, so the stick stays reproducible
+    from then on, and a saved state restores the same stream.
  */
 
 void DeadFuelMoisture::setRandomSeed( int randseed )
 {
     m_randseed = randseed;
+    unsigned long long seed = 0;
     if ( m_randseed > 0 )
     {
-        srand( (unsigned int) m_randseed );
+        seed = (unsigned long long) m_randseed;
     }
     else if ( m_randseed < 0 )
     {
-        srand( (unsigned int) time(NULL) );
+        m_randseed = (int) ( time(NULL) & 0x7fffffff );
+        if ( m_randseed == 0 )
+        {
+            m_randseed = 1;
+        }
+        seed = (unsigned long long) m_randseed;
     }
+    // SplitMix64 finalizer, so that nearby seeds give unrelated streams
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = ( seed ^ ( seed >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    seed = ( seed ^ ( seed >> 27 ) ) * 0x94D049BB133111EBULL;
+    m_randKey = seed ^ ( seed >> 31 );
+    m_randDraws = 0;
     return;
 }
 
@@ -1478,7 +1611,8 @@ double DeadFuelMoisture::surfaceTemperature( void ) const
     \param[in] min  Minimum range value.
     \param[in] max  Maximum range value.
 
-    Uses the system rand() to generate the number.
+    Uses the system rand() to generate the number, so it shares that global
+    state; the stick update itself draws from perturbation() instead.
 
     \return A uniformly distributed random number within [\a min .. \a max].
  */
@@ -1488,6 +1622,34 @@ double DeadFuelMoisture::uniformRandom( double min, double max )
     return( (max - min) * ( (double) rand() / (double) RAND_MAX ) + min );
 }
 
+//------------------------------------------------------------------------------
+/*! \brief Derives the stick's next perturbation, uniformly distributed in
+    the range [\a min .. \a max).
+
+    \param[in] min  Minimum range value.
+    \param[in] max  Maximum range value.
+
+    The number is a counter based SplitMix64 hash of the stick's seed key,
+    its update count and the number of draws made so far in this update, so
+    it keeps no global state: sticks may be updated concurrently, and a
+    perturbed run gives the same results however its sticks are spread
+    over threads.
+
+    \return A uniformly distributed random number within [\a min .. \a max).
+ */
+
+double DeadFuelMoisture::perturbation( double min, double max )
+{
+    unsigned long long z = m_randKey
+        + (unsigned long long) m_updates * 0xD1B54A32D192ED03ULL
+        + ( ++m_randDraws ) * 0x9E3779B97F4A7C15ULL;
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    z ^= ( z >> 31 );
+    // top 53 bits as a double in [0, 1)
+    return( (max - min) * ( (double) ( z >> 11 ) * ( 1.0 / 9007199254740992.0 ) ) + min );
+}
+
 bool isLeapYear(int year)
 {
 	bool isLeap = false;
@@ -1650,6 +1812,7 @@ bool DeadFuelMoisture::update(
 {
     // Increment update counter
     m_updates++;
+    m_randDraws = 0;
     m_elapsed += et;
 
     //--------------------------------------------------------------------------
@@ -1671,6 +1834,7 @@ bool DeadFuelMoisture::update(
         cerr << str.str() << "\n";
 
         // Msg::Instance().userWarning( str.str() );
+        NFDRS4_PERF_DFM_REJECTED();
         return(false);
     }
     // Cumulative rainfall must equal or exceed its previous value
@@ -1687,6 +1851,7 @@ bool DeadFuelMoisture::update(
         // Assume a RAWS station reset and return
         m_rc1 = rcum;
         m_ra0 = 0.;
+        NFDRS4_PERF_DFM_REJECTED();
         return(false);
     }
     // Relative humidity must be reasonable
@@ -1700,6 +1865,7 @@ bool DeadFuelMoisture::update(
             << " g/g.";
         cerr << str.str() << "\n";
         //Msg::Instance().userWarning( str.str() );
+        NFDRS4_PERF_DFM_REJECTED();
         return(false);
     }
     // Ambient temperature must be reasonable
@@ -1713,6 +1879,7 @@ bool DeadFuelMoisture::update(
             << " oC.";
         cerr << str.str() << "\n";
         //Msg::Instance().userWarning( str.str() );
+        NFDRS4_PERF_DFM_REJECTED();
         return(false);
     }
     // Insolation must be reasonable
@@ -1727,6 +1894,7 @@ bool DeadFuelMoisture::update(
             << " W/m2.";
         cerr << str.str() << "\n";
         //Msg::Instance().userWarning( str.str() );
+        NFDRS4_PERF_DFM_REJECTED();
         return(false);
     }
 
@@ -2060,7 +2228,7 @@ SB 1/6/2007
                 m_s[i] = ( ae * m_Tsold[i+1] + aw * m_Tsold[i-1] + ar * m_Tsold[i] ) / ap;
                 if ( m_randseed )
                 {
-                    double rn = uniformRandom( -.0001, 0.0001 );
+                    double rn = perturbation( -.0001, 0.0001 );
                     m_s[i] += rn;
                 }
                 //constrain to Sir instead of 1.0 as otherwise once we get in here we never leave saturation (continuousLiquid stays always true)
@@ -2091,7 +2259,7 @@ SB 1/6/2007
                     m_w[i] = m_wsa + m_s[i] * wdiff;
                     if ( m_pertubateColumn )
                     {
-                        double rn = uniformRandom( -.0001, 0.0001 );
+                        double rn = perturbation( -.0001, 0.0001 );
                         m_w[i] += rn;
                     }
                     m_w[i] = ( m_w[i] > m_wmx ) ? m_wmx : m_w[i];
@@ -2112,7 +2280,7 @@ SB 1/6/2007
                            / ap;
                     if ( m_randseed )
                     {
-                        double rn = uniformRandom( -.0001, 0.0001 );
+                        double rn = perturbation( -.0001, 0.0001 );
                         m_w[i] += rn;
                     }
                     m_w[i] = ( m_w[i] > m_wmx ) ? m_wmx : m_w[i];
@@ -2132,7 +2300,7 @@ SB 1/6/2007
             m_t[i] = ( ae * m_Ttold[i+1] + aw * m_Ttold[i-1] + ar * m_Ttold[i] ) / ap;
             if ( m_randseed )
             {
-                double rn = uniformRandom( -.0001, 0.0001 );
+                double rn = perturbation( -.0001, 0.0001 );
                 m_t[i] += rn;
             }
             m_t[i] = ( m_t[i] > 71. ) ? 71. : m_t[i];
@@ -2147,6 +2315,7 @@ SB 1/6/2007
         }
     }   // Next moisture time step
 
+    NFDRS4_PERF_DFM(tstate);
     // Store prevailing state
     m_state = DFM_State_None;
     int max = tstate[0];
@@ -2269,6 +2438,8 @@ void DeadFuelMoisture::zero( void )
     m_updates   = 0;
     m_state     = DFM_State_None;
     m_randseed  = 0;
+    m_randKey   = 0;
+    m_randDraws = 0;
     return;
 }
 
@@ -2409,12 +2580,14 @@ istream& operator>>( istream& input, DeadFuelMoisture& r )
     input >> vname >> r.m_wmx;
     input >> vname >> r.m_dx;
     input >> vname >> r.m_wmax;
-    input >> vname >> n;
+    // operator<<() writes these two counts in parentheses
+    char paren;
+    input >> vname >> paren >> n >> paren;
     for ( i=0; i<n; i++ )
     {
         input >> r.m_x[i];
     }
-    input >> vname >> n;
+    input >> vname >> paren >> n >> paren;
     for ( i=0; i<n; i++ )
     {
         input >> r.m_v[i];
@@ -2473,6 +2646,7 @@ istream& operator>>( istream& input, DeadFuelMoisture& r )
     input >> vname >> n;
     r.m_state = n;
     input >> vname >> r.m_randseed;
+    r.setRandomSeed( r.m_randseed );
     return( input );
 }
 
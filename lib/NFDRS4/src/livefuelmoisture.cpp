@@ -28,6 +28,7 @@
 #include<numeric>
 
 #include "livefuelmoisture.h"
+#include "memoryfootprint.h"
 //#include <ctime>
 
 using namespace std;
@@ -48,8 +49,7 @@ void LiveFuelMoisture::Initialize(double Lat,bool IsHerb, bool IsAnnual = false)
     }
 	//if (iGSI.size() > 0)
 	//	iGSI.clear();
-	while (qGSI.size() > 0)
-		qGSI.pop_front();
+	qGSI.Clear();
 
 	//while (qPrecip.size() > 0)
 	//	qPrecip.pop();
@@ -83,21 +83,15 @@ void LiveFuelMoisture::Update(double TempF, double MaxTempF, double MinTempF, do
 		GSI = CalcGSI_VPDAvg(RH, TempF, MaxTempF, MinTempF, RTPrcp, m_Lat, Jday);
 	//cout << "iGSI: " << GSI << " " << CalcRunningAvgGSI() << " " << m_MaxGSI << " " << endl;
 	//iGSI.push_back(GSI);
-	int gDays = 0, days = 0, pDays = 0;
+	int days = 0, pDays = 0;
 	if (lastUpdateTime != 0)
 	{
         int secs = thisTime - lastUpdateTime;
         days = secs / 86400;//86400 seconds per day
 		if (days > 1)//gap, deal with it by removing extra values
-		{
-			gDays = min(days - 1, (int)qGSI.size());
-			for (int p = 0; p < gDays; p++)
-				qGSI.pop_front();
-		}
+			qGSI.PopOldest(days - 1);
 	}
-	qGSI.push_back(GSI);
-	while (qGSI.size() > m_LFIdaysAvg)
-		qGSI.pop_front();
+	qGSI.Push(GSI);
 	lastUpdateTime = thisTime;
 }
 
@@ -154,6 +148,7 @@ void LiveFuelMoisture::SetLimits(double TminMin = -2.0,double TminMax = 5.0,doub
 void LiveFuelMoisture::SetMAPeriod(unsigned int MAPeriod=21)
 {
     m_LFIdaysAvg = m_LFIdaysAvg = max((unsigned int) 1, MAPeriod);;
+    qGSI.SetCapacity(m_LFIdaysAvg);
 }
 
 void LiveFuelMoisture::SetUseVPDAvg(bool set)
@@ -279,11 +274,7 @@ LiveFuelMoisture::LiveFuelMoisture(double Lat,bool IsHerb, bool IsAnnual)
 
 double LiveFuelMoisture::CalcRunningAvgGSI()
 {
- 	double val = 0.0, gsi = 0.0;
-	gsi = std::accumulate(qGSI.begin(), qGSI.end(), val);
-	if(qGSI.size() > 0)
-		gsi /= qGSI.size();
-    return gsi;
+    return qGSI.Mean();
 }
 double LiveFuelMoisture::CalcRunningAvgHerbFM(bool SnowDay)
 {
@@ -528,13 +519,8 @@ LFMCalcState LiveFuelMoisture::GetState()
 	ret.m_MaxGSI = m_MaxGSI;
 	ret.m_MaxLFMVal = m_MaxLFMVal;
 	ret.m_MinLFMVal = m_MinLFMVal;
-	deque<double> copyQ = qGSI;
-	while (copyQ.size() > 0)
-	{
-		double qVal = copyQ.front();
-		ret.m_qGSI.push_back((float)qVal);
-		copyQ.pop_front();
-	}
+	for (size_t i = 0; i < qGSI.Size(); i++)
+		ret.m_qGSI.push_back((float)qGSI.At(i));
 	ret.m_Slope = m_Slope;
 	ret.m_TminMax = m_TminMax;
 	ret.m_TminMin = m_TminMin;
@@ -566,11 +552,12 @@ bool LiveFuelMoisture::SetState(LFMCalcState state)
 	m_MaxGSI = state.m_MaxGSI;
 	m_MaxLFMVal = state.m_MaxLFMVal;
 	m_MinLFMVal = state.m_MinLFMVal;
+	qGSI.SetCapacity(m_LFIdaysAvg);
 	vector<FP_STORAGE_TYPE> copyV = state.m_qGSI;
 	for(int i = 0; i < copyV.size(); i++)
 	{
 		double qVal = copyV[i];
-		qGSI.push_back((float)qVal);
+		qGSI.Push((float)qVal);
 	}
 	m_Slope = state.m_Slope;
 	m_TminMax = state.m_TminMax;
@@ -585,3 +572,31 @@ bool LiveFuelMoisture::SetState(LFMCalcState state)
     m_RTPrcpMax = state.m_pcpMax;
 	return true;
 }
+
+//------------------------------------------------------------------------------
+/*! \brief Copies only the evolving GSI state (running GSI window, green-up
+    flags, last herb moisture and last update time) from another instance.
+    GSI limits and LFM parameters are left as they are.
+    \param[in] rhs: LiveFuelMoisture to copy from.
+    \return NONE
+ */
+void LiveFuelMoisture::CopyStateFrom(const LiveFuelMoisture& rhs)
+{
+	if (this == &rhs)
+		return;
+	qGSI = rhs.qGSI;
+	hasGreenedUpThisYear = rhs.hasGreenedUpThisYear;
+	hasExceeded120ThisYear = rhs.hasExceeded120ThisYear;
+	canIncreaseHerb = rhs.canIncreaseHerb;
+	lastHerbFM = rhs.lastHerbFM;
+	lastUpdateTime = rhs.lastUpdateTime;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Bytes held by the object, including its running GSI window.
+    \return Size in bytes, not counting allocator overhead.
+ */
+size_t LiveFuelMoisture::MemoryFootprint() const
+{
+	return sizeof(LiveFuelMoisture) - sizeof(SlidingWindow) + qGSI.MemoryFootprint();
+}
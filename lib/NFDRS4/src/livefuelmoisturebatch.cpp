@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <cmath>
+#include "livefuelmoisturebatch.h"
+#include "memoryfootprint.h"
+
+using namespace std;
+
+LiveFuelMoistureBatch::LiveFuelMoistureBatch()
+{
+	m_numCells = 0;
+	m_latBand = 0.0;
+	m_firstBand = 0;
+	m_shareTmin = m_shareVPD = m_shareDayl = m_shareWindow = false;
+	m_herbGSI.capacity = m_woodyGSI.capacity = 1;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Sets up the batch for one cell per latitude, with every cell's GSI
+    window empty and its herb state reset, as after LiveFuelMoisture::Initialize().
+    \param[in] herb: Herb model whose GSI limits and LFM parameters all cells use.
+    \param[in] woody: Woody model whose GSI limits and LFM parameters all cells use.
+    \param[in] lats: Latitude of each cell (degrees).
+    \param[in] latBand: Width (degrees) of the latitude bands sharing one daylength
+    per day of year, 0 for each cell's exact latitude.
+    \return false if there are no cells.
+ */
+bool LiveFuelMoistureBatch::Initialize(const LiveFuelMoisture& herb, const LiveFuelMoisture& woody, const vector<double>& lats, double latBand/* = 0.0*/)
+{
+	m_herb = herb;
+	m_woody = woody;
+	m_numCells = lats.size();
+	m_latBand = max(0.0, latBand);
+	m_shareTmin = herb.m_TminMin == woody.m_TminMin && herb.m_TminMax == woody.m_TminMax;
+	m_shareVPD = herb.m_UseVPDAvg == woody.m_UseVPDAvg && herb.m_VPDMin == woody.m_VPDMin && herb.m_VPDMax == woody.m_VPDMax;
+	m_shareDayl = herb.m_DaylenMin == woody.m_DaylenMin && herb.m_DaylenMax == woody.m_DaylenMax;
+	m_shareWindow = SameGSI(herb, woody);
+
+	m_sinDecl.resize(NDAYS);
+	m_cosDecl.resize(NDAYS);
+	for (int doy = 0; doy < NDAYS; doy++)
+	{
+		double decl = MINDECL * cos((doy + DAYSOFF) * RADPERDAY);
+		m_sinDecl[doy] = sin(decl);
+		m_cosDecl[doy] = cos(decl);
+	}
+	m_sinLat.clear();
+	m_cosLat.clear();
+	m_band.clear();
+	m_bandDayl.clear();
+	if (m_latBand > 0.0)
+	{
+		//bands counted from 90 S, the table only holds those with cells
+		m_band.resize(m_numCells);
+		unsigned lastBand = 0;
+		m_firstBand = ~0u;
+		for (size_t c = 0; c < m_numCells; c++)
+		{
+			m_band[c] = (unsigned)max(0.0, floor((min(90.0, lats[c]) + 90.0) / m_latBand));
+			m_firstBand = min(m_firstBand, m_band[c]);
+			lastBand = max(lastBand, m_band[c]);
+		}
+		for (size_t c = 0; c < m_numCells; c++)
+			m_band[c] -= m_firstBand;
+		m_bandDayl.resize(m_numCells > 0 ? (lastBand - m_firstBand + 1) * NDAYS : 0);
+		for (size_t b = 0; b * NDAYS < m_bandDayl.size(); b++)
+		{
+			double lat = BandLatitude(b);
+			for (int doy = 0; doy < NDAYS; doy++)
+				m_bandDayl[b * NDAYS + doy] = m_herb.CalcDayl(lat, doy);
+		}
+	}
+	else
+	{
+		m_sinLat.resize(m_numCells);
+		m_cosLat.resize(m_numCells);
+		for (size_t c = 0; c < m_numCells; c++)
+		{
+			//as LiveFuelMoisture::CalcDayl()
+			double lat = lats[c] * RADPERDEG;
+			if (lat > 1.5707) lat = 1.5707;
+			if (lat < -1.5707) lat = -1.5707;
+			m_sinLat[c] = sin(lat);
+			m_cosLat[c] = cos(lat);
+		}
+	}
+
+	m_herbGSI.Resize(m_numCells, herb.m_LFIdaysAvg);
+	m_woodyGSI.Resize(m_shareWindow ? 0 : m_numCells, woody.m_LFIdaysAvg);
+	m_lastUpdateTime.assign(m_numCells, 0);
+	m_greenedUp.assign(m_numCells, 0);
+	m_exceeded120.assign(m_numCells, 0);
+	m_canIncrease.assign(m_numCells, 0);
+	m_lastHerbFM.assign(m_numCells, -1.0);
+	return m_numCells > 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Copies a cell's GSI windows and herb state from its models, e.g. to
+    continue a run from saved state.
+    \return false if the cell is out of range or its models' GSI limits or LFM
+    parameters differ from those the batch was initialized with.
+ */
+bool LiveFuelMoistureBatch::LoadCell(size_t cell, const LiveFuelMoisture& herb, const LiveFuelMoisture& woody)
+{
+	if (cell >= m_numCells || !SameGSI(herb, m_herb) || !SameLFM(herb, m_herb) || !SameGSI(woody, m_woody) || !SameLFM(woody, m_woody))
+		return false;
+	if (herb.qGSI.m_capacity != m_herbGSI.capacity || herb.lastUpdateTime != woody.lastUpdateTime)
+		return false;
+	if (m_shareWindow && herb.qGSI.Values() != woody.qGSI.Values())
+		return false;
+	if (!m_shareWindow && woody.qGSI.m_capacity != m_woodyGSI.capacity)
+		return false;
+	LoadWindow(m_herbGSI, cell, herb.qGSI);
+	if (!m_shareWindow)
+		LoadWindow(m_woodyGSI, cell, woody.qGSI);
+	m_lastUpdateTime[cell] = herb.lastUpdateTime;
+	m_greenedUp[cell] = herb.hasGreenedUpThisYear;
+	m_exceeded120[cell] = herb.hasExceeded120ThisYear;
+	m_canIncrease[cell] = herb.canIncreaseHerb;
+	m_lastHerbFM[cell] = herb.lastHerbFM;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Copies a cell's GSI windows and herb state back to its models, e.g.
+    before saving the cell's NFDRS4 state.
+ */
+void LiveFuelMoistureBatch::StoreCell(size_t cell, LiveFuelMoisture& herb, LiveFuelMoisture& woody) const
+{
+	if (cell >= m_numCells)
+		return;
+	StoreWindow(m_herbGSI, cell, herb.qGSI);
+	StoreWindow(m_shareWindow ? m_herbGSI : m_woodyGSI, cell, woody.qGSI);
+	herb.lastUpdateTime = woody.lastUpdateTime = m_lastUpdateTime[cell];
+	herb.hasGreenedUpThisYear = m_greenedUp[cell] != 0;
+	herb.hasExceeded120ThisYear = m_exceeded120[cell] != 0;
+	herb.canIncreaseHerb = m_canIncrease[cell] != 0;
+	herb.lastHerbFM = m_lastHerbFM[cell];
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Daily update of the cells [first, first + count), the equivalent of
+    LiveFuelMoisture::Update() on each cell's herb and woody models followed by
+    CalcRunningAvgGSI() and GetMoisture().
+    \param[in] inputs: count inputs, inputs[i] for cell first + i.
+    \param[out] outputs: count results.
+ */
+void LiveFuelMoistureBatch::Update(size_t first, size_t count, const LFMDailyInputs* inputs, LFMDailyOutputs* outputs)
+{
+	count = first < m_numCells ? min(count, m_numCells - first) : 0;
+	const bool rtPrecipHerb = m_herb.m_useRTPrecip, rtPrecipWoody = m_woody.m_useRTPrecip;
+	for (size_t i = 0; i < count; i++)
+	{
+		const size_t c = first + i;
+		const LFMDailyInputs& in = inputs[i];
+		if (in.ResetHerb)
+		{
+			m_greenedUp[c] = m_canIncrease[c] = m_exceeded120[c] = 0;
+			m_lastHerbFM[c] = -1.0;
+		}
+
+		//indicators, in the order of LiveFuelMoisture::CalcGSI()
+		double dayl = Daylength(c, in.Jday);
+		double tMinInd = m_herb.GetTminInd(in.MinTemp);
+		double vpdInd = m_herb.GetVPDInd(VPD(m_herb, in));
+		double daylenInd = m_herb.GetDaylInd(dayl);
+		double herbGSI = rtPrecipHerb ? tMinInd * vpdInd * daylenInd * m_herb.GetPrcpInd(in.HerbPrecip) : tMinInd * vpdInd * daylenInd;
+
+		int days = 0;
+		if (m_lastUpdateTime[c] != 0)
+		{
+			int secs = in.Time - m_lastUpdateTime[c];
+			days = secs / 86400;
+		}
+		if (days > 1)//gap, deal with it by removing extra values
+			m_herbGSI.PopOldest(c, days - 1);
+		m_herbGSI.Push(c, herbGSI);
+		if (!m_shareWindow)
+		{
+			if (!m_shareTmin)
+				tMinInd = m_woody.GetTminInd(in.MinTemp);
+			if (!m_shareVPD)
+				vpdInd = m_woody.GetVPDInd(VPD(m_woody, in));
+			if (!m_shareDayl)
+				daylenInd = m_woody.GetDaylInd(dayl);
+			double woodyGSI = rtPrecipWoody ? tMinInd * vpdInd * daylenInd * m_woody.GetPrcpInd(in.WoodyPrecip) : tMinInd * vpdInd * daylenInd;
+			if (days > 1)
+				m_woodyGSI.PopOldest(c, days - 1);
+			m_woodyGSI.Push(c, woodyGSI);
+		}
+		m_lastUpdateTime[c] = in.Time;
+
+		double herbMean = m_herbGSI.Mean(c);
+		double woodyMean = m_shareWindow ? herbMean : m_woodyGSI.Mean(c);
+		outputs[i].GSI = herbMean;
+		outputs[i].HerbFM = HerbMoisture(c, herbMean, in.SnowDay);
+		outputs[i].WoodyFM = WoodyMoisture(woodyMean, in.SnowDay);
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Bytes held by the batch, for sizing grid runs.
+    \return Size in bytes, not counting allocator overhead.
+ */
+size_t LiveFuelMoistureBatch::MemoryFootprint() const
+{
+	return sizeof(LiveFuelMoistureBatch) - 2 * sizeof(LiveFuelMoisture) + m_herb.MemoryFootprint() + m_woody.MemoryFootprint()
+		+ VectorHeapBytes(m_sinLat) + VectorHeapBytes(m_cosLat) + VectorHeapBytes(m_sinDecl) + VectorHeapBytes(m_cosDecl)
+		+ VectorHeapBytes(m_band) + VectorHeapBytes(m_bandDayl)
+		+ m_herbGSI.MemoryFootprint() + m_woodyGSI.MemoryFootprint()
+		+ VectorHeapBytes(m_lastUpdateTime) + VectorHeapBytes(m_greenedUp) + VectorHeapBytes(m_exceeded120)
+		+ VectorHeapBytes(m_canIncrease) + VectorHeapBytes(m_lastHerbFM);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief True if two models compute the same daily GSI from the same inputs.
+ */
+bool LiveFuelMoistureBatch::SameGSI(const LiveFuelMoisture& a, const LiveFuelMoisture& b)
+{
+	if (a.m_TminMin != b.m_TminMin || a.m_TminMax != b.m_TminMax || a.m_VPDMin != b.m_VPDMin || a.m_VPDMax != b.m_VPDMax
+		|| a.m_DaylenMin != b.m_DaylenMin || a.m_DaylenMax != b.m_DaylenMax || a.m_UseVPDAvg != b.m_UseVPDAvg
+		|| a.m_LFIdaysAvg != b.m_LFIdaysAvg || a.m_useRTPrecip != b.m_useRTPrecip)
+		return false;
+	return !a.m_useRTPrecip || (a.m_RTPrcpMin == b.m_RTPrcpMin && a.m_RTPrcpMax == b.m_RTPrcpMax && a.m_nDaysPrecip == b.m_nDaysPrecip);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief True if two models turn the same running GSI into the same moisture.
+ */
+bool LiveFuelMoistureBatch::SameLFM(const LiveFuelMoisture& a, const LiveFuelMoisture& b)
+{
+	return a.m_IsHerb == b.m_IsHerb && a.m_IsAnnual == b.m_IsAnnual && a.m_MaxGSI == b.m_MaxGSI
+		&& a.m_GreenupThreshold == b.m_GreenupThreshold && a.m_MinLFMVal == b.m_MinLFMVal && a.m_MaxLFMVal == b.m_MaxLFMVal
+		&& a.m_Slope == b.m_Slope && a.m_Intercept == b.m_Intercept;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Daylength (seconds) from the latitude and declination terms, the
+    arithmetic of LiveFuelMoisture::CalcDayl().
+ */
+double LiveFuelMoistureBatch::Daylength(double sinLat, double cosLat, double sinDecl, double cosDecl)
+{
+	double cosegeom = cosLat * cosDecl;
+	double sinegeom = sinLat * sinDecl;
+	double coshss = -(sinegeom) / cosegeom;
+	if (coshss < -1.0) coshss = -1.0;  /* 24-hr daylight */
+	if (coshss > 1.0) coshss = 1.0;    /* 0-hr daylight */
+	return 2.0 * acos(coshss) * SECPERRAD;
+}
+
+double LiveFuelMoistureBatch::Daylength(size_t cell, int doy) const
+{
+	bool inTable = doy >= 0 && doy < NDAYS;
+	if (m_latBand > 0.0 && inTable)
+		return m_bandDayl[m_band[cell] * NDAYS + doy];
+	double sinDecl, cosDecl;
+	if (inTable)
+	{
+		sinDecl = m_sinDecl[doy];
+		cosDecl = m_cosDecl[doy];
+	}
+	else
+	{
+		double decl = MINDECL * cos((doy + DAYSOFF) * RADPERDAY);
+		sinDecl = sin(decl);
+		cosDecl = cos(decl);
+	}
+	if (m_latBand > 0.0)
+	{
+		double lat = BandLatitude(m_band[cell]) * RADPERDEG;
+		lat = max(-1.5707, min(1.5707, lat));
+		return Daylength(sin(lat), cos(lat), sinDecl, cosDecl);
+	}
+	return Daylength(m_sinLat[cell], m_cosLat[cell], sinDecl, cosDecl);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Latitude (degrees) of the middle of a band of the daylength table.
+ */
+double LiveFuelMoistureBatch::BandLatitude(size_t band) const
+{
+	return min(90.0, -90.0 + (m_firstBand + band + 0.5) * m_latBand);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Vapor pressure deficit (Pa) as LiveFuelMoisture::CalcGSI() or
+    CalcGSI_VPDAvg() computes it for the model.
+ */
+double LiveFuelMoistureBatch::VPD(LiveFuelMoisture& model, const LFMDailyInputs& in)
+{
+	if (!model.m_UseVPDAvg)
+		return model.CalcVPD(max(in.MinRH, 5.0), in.MaxTemp);
+	double tDew = model.CalcDPT(in.Temp, in.RH);
+	return model.CalcVPDavg(tDew, (in.MaxTemp + in.MinTemp) / 2);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief LiveFuelMoisture::CalcRunningAvgHerbFM() on the cell's herb state.
+ */
+double LiveFuelMoistureBatch::HerbMoisture(size_t cell, double GSI, bool snowDay)
+{
+	double rescale = GSI / m_herb.m_MaxGSI;
+	double ret = m_herb.m_MinLFMVal;
+	rescale = min(1.0, rescale);
+	rescale = max(0.0, rescale);
+	if (rescale >= m_herb.m_GreenupThreshold && !snowDay)
+	{
+		ret = m_herb.m_Slope * rescale + m_herb.m_Intercept;
+		if (!m_greenedUp[cell])
+		{
+			m_greenedUp[cell] = 1;
+			m_canIncrease[cell] = 1;
+		}
+	}
+	if (!m_canIncrease[cell] && m_lastHerbFM[cell] >= 0)
+		ret = min(ret, m_lastHerbFM[cell]);
+	if (!m_exceeded120[cell] && ret >= 120)
+		m_exceeded120[cell] = 1;
+	if (m_exceeded120[cell] && ret < 120.0 && m_herb.m_IsAnnual)
+		m_canIncrease[cell] = 0;
+	m_lastHerbFM[cell] = ret;
+	return ret;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief LiveFuelMoisture::CalcRunningAvgWoodyFM().
+ */
+double LiveFuelMoistureBatch::WoodyMoisture(double GSI, bool snowDay) const
+{
+	double rescale = GSI / m_woody.m_MaxGSI;
+	rescale = min(1.0, rescale);
+	rescale = max(0.0, rescale);
+	if (rescale >= m_woody.m_GreenupThreshold && !snowDay)
+		return m_woody.m_Slope * rescale + m_woody.m_Intercept;
+	return m_woody.m_MinLFMVal;
+}
+
+void LiveFuelMoistureBatch::LoadWindow(GSIWindows& windows, size_t cell, const SlidingWindow& window)
+{
+	size_t cap = windows.capacity;
+	copy(window.m_values.begin(), window.m_values.end(), windows.values.begin() + cell * cap);
+	copy(window.m_prefix.begin(), window.m_prefix.end(), windows.prefix.begin() + cell * (cap + 1));
+	windows.head[cell] = (unsigned)window.m_head;
+	windows.size[cell] = (unsigned)window.m_size;
+	windows.count[cell] = window.m_count;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Copies a cell's window into a SlidingWindow, rebuilding its min/max queues.
+ */
+void LiveFuelMoistureBatch::StoreWindow(const GSIWindows& windows, size_t cell, SlidingWindow& window)
+{
+	size_t cap = windows.capacity;
+	window.SetCapacity(cap);
+	copy(windows.values.begin() + cell * cap, windows.values.begin() + (cell + 1) * cap, window.m_values.begin());
+	copy(windows.prefix.begin() + cell * (cap + 1), windows.prefix.begin() + (cell + 1) * (cap + 1), window.m_prefix.begin());
+	window.m_head = windows.head[cell];
+	window.m_size = windows.size[cell];
+	window.m_count = windows.count[cell];
+	window.m_minQ.clear();
+	window.m_maxQ.clear();
+	for (size_t i = 0; i < window.m_size; i++)
+	{
+		double value = window.At(i);
+		if (window.IsMissing(value))
+			continue;
+		unsigned long long k = window.m_count - window.m_size + i;
+		while (!window.m_minQ.empty() && window.m_minQ.back().second >= value)
+			window.m_minQ.pop_back();
+		window.m_minQ.push_back(make_pair(k, value));
+		while (!window.m_maxQ.empty() && window.m_maxQ.back().second <= value)
+			window.m_maxQ.pop_back();
+		window.m_maxQ.push_back(make_pair(k, value));
+	}
+}
+
+void LiveFuelMoistureBatch::GSIWindows::Resize(size_t numCells, size_t windowCapacity)
+{
+	capacity = max((size_t)1, windowCapacity);
+	values.assign(numCells * capacity, -999.0);
+	prefix.assign(numCells * (capacity + 1), 0.0);
+	head.assign(numCells, 0);
+	size.assign(numCells, 0);
+	count.assign(numCells, 0);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief SlidingWindow::Push() on the cell's window. GSI is never the window's
+    no-data value, so every value counts in the sums.
+ */
+void LiveFuelMoistureBatch::GSIWindows::Push(size_t cell, double value)
+{
+	size_t slot;
+	if (size[cell] == capacity)
+	{
+		slot = head[cell];
+		head[cell] = (unsigned)((head[cell] + 1) % capacity);
+	}
+	else
+	{
+		slot = (head[cell] + size[cell]) % capacity;
+		size[cell]++;
+	}
+	values[cell * capacity + slot] = value;
+	unsigned long long n = count[cell];
+	Prefix(cell, n + 1) = Prefix(cell, n) + value;
+	count[cell] = n + 1;
+	if (count[cell] % capacity == 0)
+		Rebase(cell);
+}
+
+void LiveFuelMoistureBatch::GSIWindows::PopOldest(size_t cell, size_t n)
+{
+	n = min(n, (size_t)size[cell]);
+	head[cell] = (unsigned)((head[cell] + n) % capacity);
+	size[cell] -= (unsigned)n;
+}
+
+double LiveFuelMoistureBatch::GSIWindows::Mean(size_t cell) const
+{
+	size_t n = size[cell];
+	if (n == 0)
+		return 0.0;
+	unsigned long long k = count[cell];
+	return (Prefix(cell, k) - Prefix(cell, k - n)) / n;
+}
+
+size_t LiveFuelMoistureBatch::GSIWindows::MemoryFootprint() const
+{
+	return VectorHeapBytes(values) + VectorHeapBytes(prefix) + VectorHeapBytes(head) + VectorHeapBytes(size) + VectorHeapBytes(count);
+}
+
+void LiveFuelMoistureBatch::GSIWindows::Rebase(size_t cell)
+{
+	unsigned long long oldest = count[cell] - size[cell];
+	Prefix(cell, oldest) = 0.0;
+	for (size_t i = 0; i < size[cell]; i++)
+	{
+		double value = values[cell * capacity + (head[cell] + i) % capacity];
+		Prefix(cell, oldest + i + 1) = Prefix(cell, oldest + i) + value;
+	}
+}
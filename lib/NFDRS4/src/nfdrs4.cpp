@@ -7,6 +7,7 @@
 // Standard include files
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
 #include <sstream>
@@ -15,6 +16,8 @@
 #include <float.h>
 #include <algorithm>
 #include "nfdrs4.h"
+#include "memoryfootprint.h"
+#include "nfdrs4perf.h"
 #include <time.h>
 
 
@@ -57,6 +60,7 @@ NFDRS4::NFDRS4()
 	FuelTemperature = -999;
 	m_GSI = 0.0;
 	nConsectiveSnowDays = 0;
+	m_deferLiveFuels = m_liveFuelsPending = m_herbResetPending = false;
     Init(45, 'Y', 1, 0.0, true, true, true, 100, 13);
 }
 
@@ -69,6 +73,7 @@ NFDRS4::NFDRS4(double inLat, char FuelModel, int inSlopeClass, double inAvgAnnPr
 {
     CreateFuelModels();
     StartKBDI = 100;
+	m_deferLiveFuels = m_liveFuelsPending = m_herbResetPending = false;
 	Init(inLat, FuelModel, inSlopeClass, inAvgAnnPrecip, LT, Cure, IsAnnual, 100);
 }
 
@@ -134,12 +139,9 @@ void NFDRS4::Init(double inLat, char iFuelModel, int inSlopeClass, double inAvgA
     if(!isReinit)
 	    iSetFuelModel(iFuelModel);
     m_regObsHour = RegObsHour;
-    for (int h = 0; h < nHoursPerDay; h++)
-    {
-        qHourlyTemp.push_back(NORECORD);
-        qHourlyRH.push_back(NORECORD);
-        qHourlyPrecip.push_back(NORECORD);
-    }
+    qHourlyTemp.PushMissing(nHoursPerDay);
+    qHourlyRH.PushMissing(nHoursPerDay);
+    qHourlyPrecip.PushMissing(nHoursPerDay);
     utcHourDiff = utctime::get_hour_diff();
 }
 
@@ -186,6 +188,115 @@ int NFDRS4::iSetFuelMoistures (double fMC1, double fMC10,double fMC100, double f
    return EXIT_SUCCESS;
 }
 
+//------------------------------------------------------------------------------
+/*! \brief Daily herb and woody update at the observation hour. When deferring,
+    only records the inputs for a LiveFuelMoistureBatch, see SetDeferLiveFuels().
+ */
+void NFDRS4::UpdateLiveFuels(double Temp, double MaxTemp, double MinTemp, double RH, double MinRH, int Julian, time_t thisTime)
+{
+	bool snowDay = nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false;
+	if (m_deferLiveFuels)
+	{
+		m_liveFuelInputs.Temp = Temp;
+		m_liveFuelInputs.MaxTemp = MaxTemp;
+		m_liveFuelInputs.MinTemp = MinTemp;
+		m_liveFuelInputs.RH = RH;
+		m_liveFuelInputs.MinRH = MinRH;
+		m_liveFuelInputs.HerbPrecip = GetXDaysPrecipitation(HerbFM.GetNumPrecipDays());
+		m_liveFuelInputs.WoodyPrecip = GetXDaysPrecipitation(WoodyFM.GetNumPrecipDays());
+		m_liveFuelInputs.Jday = Julian;
+		m_liveFuelInputs.Time = thisTime;
+		m_liveFuelInputs.SnowDay = snowDay;
+		m_liveFuelInputs.ResetHerb = m_herbResetPending;
+		m_herbResetPending = false;
+		m_liveFuelsPending = true;
+		return;
+	}
+	HerbFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(HerbFM.GetNumPrecipDays()), thisTime);
+	WoodyFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(WoodyFM.GetNumPrecipDays()), thisTime);
+
+	m_GSI = HerbFM.CalcRunningAvgGSI();
+	MCHERB = HerbFM.GetMoisture(snowDay);
+	MCWOOD = WoodyFM.GetMoisture(snowDay);
+}
+
+void NFDRS4::ResetHerbState()
+{
+	HerbFM.ResetHerbState();
+	//a batch keeps its own herb state, it is reset with the next daily update
+	if (m_deferLiveFuels)
+		m_herbResetPending = true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Sets the fuel moistures and calculates the indexes, unless the live
+    fuel moistures are pending, in which case CompleteLiveFuels() calculates them.
+ */
+void NFDRS4::SetMoisturesAndCalcIndexes(double fMC1, double fMC10, double fMC100, double fMC1000, double fuelTempC, double WS)
+{
+	iSetFuelMoistures(fMC1, fMC10, fMC100, fMC1000, MCWOOD, MCHERB, fuelTempC);
+	if (m_liveFuelsPending)
+	{
+		m_pendingWS = WS;
+		return;
+	}
+	// Calculate the indices
+
+	double fSC, fERC, fBI, fIC;
+	iCalcIndexes((int)WS, SlopeClass, &fSC, &fERC, &fBI, &fIC);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Defers the daily herb and woody update to a LiveFuelMoistureBatch.
+    After an update at the observation hour LiveFuelsPending() is true and the
+    indexes are not calculated until CompleteLiveFuels() is called with the
+    batch's results, which must happen before the next update. HerbFM and
+    WoodyFM are left as they are while deferring, the batch holds their state
+    (see LiveFuelMoistureBatch::LoadCell() and StoreCell()).
+    \param[in] defer: true to defer, false for the usual update.
+ */
+void NFDRS4::SetDeferLiveFuels(bool defer)
+{
+	m_deferLiveFuels = defer;
+}
+
+bool NFDRS4::GetDeferLiveFuels()
+{
+	return m_deferLiveFuels;
+}
+
+bool NFDRS4::LiveFuelsPending()
+{
+	return m_liveFuelsPending;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Inputs of the pending daily update, for LiveFuelMoistureBatch::Update().
+ */
+const LFMDailyInputs& NFDRS4::GetLiveFuelInputs()
+{
+	return m_liveFuelInputs;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Completes a deferred update with the live fuel moistures and GSI
+    computed by a LiveFuelMoistureBatch, and calculates the indexes.
+    \param[in] herbFM: Herb moisture (% dry wt).
+    \param[in] woodyFM: Woody moisture (% dry wt).
+    \param[in] GSI: Running average GSI.
+ */
+void NFDRS4::CompleteLiveFuels(double herbFM, double woodyFM, double GSI)
+{
+	if (!m_liveFuelsPending)
+		return;
+	m_liveFuelsPending = false;
+	m_GSI = GSI;
+	MCHERB = herbFM;
+	MCWOOD = woodyFM;
+	double fSC, fERC, fBI, fIC;
+	iCalcIndexes((int)m_pendingWS, SlopeClass, &fSC, &fERC, &fBI, &fIC);
+}
+
 bool IsLeapYear(int year)
 {
     bool isLeap = false;
@@ -209,6 +320,7 @@ int CalcJulianDay(int year, int month, int day)
 //void NFDRS4::Update(int Year, int Month, int Day, int Hour, int Julian, double Temp, double MinTemp, double MaxTemp, double RH, double PPTAcc, double PPTAmt, double SolarRad, double WS, bool SnowDay, int RegObsHr)
 void NFDRS4::Update(int Year, int Month, int Day, int Hour, int Julian, double Temp, double MinTemp, double MaxTemp, double RH, double MinRH, double PPTAmt, double pcp24, double SolarRad, double WS, bool SnowDay, int RegObsHr)
 {
+    NFDRS4_PERF_TIMER(perf);
     int tJulian = CalcJulianDay(Year, Month - 1, Day);
     if (Julian != tJulian)
         printf("Julain day mismatch for Year = %d, Month = %d, Day = %d, passed Julian = %d, calced Julian = %d\n",
@@ -225,7 +337,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, int Julian, double T
 
 	//Herb and 1-Hour reset every year.... Verify we want to do this
     if (Julian < YesterdayJDay || YesterdayJDay < 0) {
-        HerbFM.ResetHerbState();
+        ResetHerbState();
     }
 	if (PrevYear != Year)
 	{		
@@ -252,26 +364,27 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, int Julian, double T
 		nelppt = 0.;
 		
     }
+    NFDRS4_PERF_LAP(perf, NFDRS4_PERF_TIME);
 #pragma omp parallel sections num_threads(4)
     {
 
 #pragma omp section
         {
-
+            NFDRS4_PERF_SCOPE(NFDRS4_PERF_DFM_1H);
             OneHourFM.update(Year, Month, Day, Hour, 0, 0, neltemp,nelrh,nelsr,nelppt,0.02179999999,true);
             MC1 = MyMC1 = OneHourFM.medianRadialMoisture() * 100;
 			//MC1 = MyMC1 = OneHourFM.meanWtdMoisture() * 100;
         }
 #pragma omp section
         {
-
+            NFDRS4_PERF_SCOPE(NFDRS4_PERF_DFM_10H);
             TenHourFM.update(Year, Month, Day, Hour, 0, 0, neltemp, nelrh, nelsr,nelppt,0.02179999999, true);
             MC10 = MyMC10 = TenHourFM.medianRadialMoisture() * 100;
 			//MC10 = MyMC10 = TenHourFM.meanWtdMoisture() * 100;
         }
 #pragma omp section
         {
-
+            NFDRS4_PERF_SCOPE(NFDRS4_PERF_DFM_100H);
             HundredHourFM.update(Year, Month, Day, Hour, 0, 0, neltemp, nelrh, nelsr, nelppt, 0.02179999999, true);
             MC100 = MyMC100 = HundredHourFM.medianRadialMoisture() * 100;
 			//MC100 = MyMC100 = HundredHourFM.meanWtdMoisture() * 100;
@@ -279,7 +392,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, int Julian, double T
         }
 #pragma omp section
         {
-
+            NFDRS4_PERF_SCOPE(NFDRS4_PERF_DFM_1000H);
             ThousandHourFM.update(Year, Month, Day, Hour, 0, 0, neltemp, nelrh, nelsr, nelppt, 0.02179999999, true);
             MC1000 = MyMC1000 = ThousandHourFM.medianRadialMoisture() * 100;
 			//MC1000 = MyMC1000 = ThousandHourFM.meanWtdMoisture() * 100;
@@ -287,24 +400,26 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, int Julian, double T
         }
     }
 
+	NFDRS4_PERF_RESTART(perf);
 	//moved here so we have hourly fueltemp to save to DB
 	FuelTemperature = OneHourFM.surfaceTemperature();
     //update 24 hour deques
     UTCTime thisUtcTime(Year, Month, Day, Hour, 0, 0);
     time_t thisDiff = thisUtcTime - lastUtcUpdateTime;
     time_t hoursDiff = thisDiff / utcHourDiff;
+    NFDRS4_PERF_LAP_MORE(perf, NFDRS4_PERF_TIME);
     if (hoursDiff > 1)//gap, insert NODATA
     {
-        for (int h = 1; h < hoursDiff; h++)
-        {
-            qHourlyPrecip.push_back(NORECORD);
-            qHourlyTemp.push_back(NORECORD);
-            qHourlyRH.push_back(NORECORD);
-        }
+        qHourlyPrecip.PushMissing(hoursDiff - 1);
+        qHourlyTemp.PushMissing(hoursDiff - 1);
+        qHourlyRH.PushMissing(hoursDiff - 1);
     }
-    qHourlyPrecip.push_back(PPTAmt);
-    qHourlyTemp.push_back(Temp);
-    qHourlyRH.push_back(RH);
+    //the daily min/max and pcp24 come from the caller here, but the windows
+    //still hold the last 24 hours, which is what a saved state keeps
+    qHourlyPrecip.Push(PPTAmt);
+    qHourlyTemp.Push(Temp);
+    qHourlyRH.Push(RH);
+    NFDRS4_PERF_LAP(perf, NFDRS4_PERF_QUEUES);
 
    // Update live fuel moisture once per day
     if (Hour == RegObsHr)// || num_updates==0)
@@ -323,34 +438,22 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, int Julian, double T
 		//update the precip deque before updating GSI!!!!
 		int days = secs / 86400;//86400 seconds per day
 		if (days > 1)//gap, deal with it by inserting zeroes
-		{
-			int pDays = min(days - 1, nPrecipQueueDays);
-			for (int p = 0; p < pDays; p++)
-				qPrecip.push_back(0.0);
-		}
-		qPrecip.push_back(pcp24);
-		while (qPrecip.size() > nPrecipQueueDays)
-			qPrecip.pop_front();
-
-		HerbFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(HerbFM.GetNumPrecipDays()), thisUtcTime.timestamp());
-		WoodyFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(WoodyFM.GetNumPrecipDays()), thisUtcTime.timestamp());
+			qPrecip.PushRepeated(0.0, days - 1);
+		qPrecip.Push(pcp24);
+		NFDRS4_PERF_LAP_MORE(perf, NFDRS4_PERF_QUEUES);
 
-		m_GSI = HerbFM.CalcRunningAvgGSI();
-        MCHERB = HerbFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
-        MCWOOD = WoodyFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
+		UpdateLiveFuels(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, thisUtcTime.timestamp());
+        NFDRS4_PERF_LAP(perf, NFDRS4_PERF_LFM_GSI);
         // Calculate the daily KBDI that is used for the drought fuel loading
         KBDI = iCalcKBDI(pcp24, (int) MaxTemp, CummPrecip, YKBDI, AvgPrecip);
 		YKBDI = KBDI;
+		NFDRS4_PERF_RESTART(perf);
 
 
         lastDailyUpdateTime = thisUtcTime;
 
     }
-	iSetFuelMoistures(MC1, MC10, MC100, MC1000, MCWOOD, MCHERB, FuelTemperature);
-	// Calculate the indices
-
-	double fSC, fERC, fBI, fIC;
-	iCalcIndexes((int)WS, SlopeClass, &fSC, &fERC, &fBI, &fIC);
+	SetMoisturesAndCalcIndexes(MC1, MC10, MC100, MC1000, FuelTemperature, WS);
     YesterdayJDay = Julian;
     lastUtcUpdateTime = thisUtcTime;
 }
@@ -362,6 +465,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
     double MaxTemp, double RH, double MinRH, double PPTAmt, double pcp24, double WS, bool SnowDay, 
     int RegObsHr, double MC1, double MC10, double MC100, double MC1000, double FuelTemperature)
 {
+    NFDRS4_PERF_TIMER(perf);
     int Julian = CalcJulianDay(Year, Month - 1, Day);
 
 	if (PrevYear > 0 && YesterdayJDay > 0)
@@ -375,7 +479,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
 
 	//Herb and 1-Hour reset every year.... Verify we want to do this
     if (Julian < YesterdayJDay || YesterdayJDay < 0) {
-        HerbFM.ResetHerbState();
+        ResetHerbState();
     }
 	if (PrevYear != Year)
 	{		
@@ -384,6 +488,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
 	
     //update 24 hour deques
     UTCTime thisUtcTime(Year, Month, Day, Hour, 0, 0);
+    NFDRS4_PERF_LAP(perf, NFDRS4_PERF_TIME);
 
    // Update live fuel moisture once per day
     if (Hour == RegObsHr)// || num_updates==0)
@@ -402,31 +507,19 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
 		//update the precip deque before updating GSI!!!!
 		int days = secs / 86400;//86400 seconds per day
 		if (days > 1)//gap, deal with it by inserting zeroes
-		{
-			int pDays = min(days - 1, nPrecipQueueDays);
-			for (int p = 0; p < pDays; p++)
-				qPrecip.push_back(0.0);
-		}
-		qPrecip.push_back(pcp24);
-		while (qPrecip.size() > nPrecipQueueDays)
-			qPrecip.pop_front();
-
-		HerbFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(HerbFM.GetNumPrecipDays()), thisUtcTime.timestamp());
-		WoodyFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(WoodyFM.GetNumPrecipDays()), thisUtcTime.timestamp());
+			qPrecip.PushRepeated(0.0, days - 1);
+		qPrecip.Push(pcp24);
+		NFDRS4_PERF_LAP(perf, NFDRS4_PERF_QUEUES);
 
-		m_GSI = HerbFM.CalcRunningAvgGSI();
-        MCHERB = HerbFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
-        MCWOOD = WoodyFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
+		UpdateLiveFuels(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, thisUtcTime.timestamp());
+        NFDRS4_PERF_LAP(perf, NFDRS4_PERF_LFM_GSI);
         // Calculate the daily KBDI that is used for the drought fuel loading
         KBDI = iCalcKBDI(pcp24, (int) MaxTemp, CummPrecip, YKBDI, AvgPrecip);
 		YKBDI = KBDI;
+		NFDRS4_PERF_RESTART(perf);
 
     }
-	iSetFuelMoistures(MC1, MC10, MC100, MC1000, MCWOOD, MCHERB, FuelTemperature);
-	// Calculate the indices
-
-	double fSC, fERC, fBI, fIC;
-	iCalcIndexes((int)WS, SlopeClass, &fSC, &fERC, &fBI, &fIC);
+	SetMoisturesAndCalcIndexes(MC1, MC10, MC100, MC1000, FuelTemperature, WS);
     YesterdayJDay = Julian;
     lastUtcUpdateTime = thisUtcTime;
 }
@@ -434,6 +527,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
 
 void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double RH, double PPTAmt, double SolarRad, double WS, bool SnowDay)
 {
+    NFDRS4_PERF_TIMER(perf);
     int Julian = CalcJulianDay(Year, Month - 1, Day);
     if (PrevYear > 0 && YesterdayJDay > 0)
     {
@@ -446,7 +540,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
 
     //Herb and 1-Hour reset every year.... Verify we want to do this
     if (Julian < YesterdayJDay || YesterdayJDay < 0) {
-        HerbFM.ResetHerbState();
+        ResetHerbState();
     }
     if (PrevYear != Year)
     {
@@ -472,26 +566,27 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
         nelppt = 0.;
 
     }
+    NFDRS4_PERF_LAP(perf, NFDRS4_PERF_TIME);
 #pragma omp parallel sections num_threads(4)
     {
 
 #pragma omp section
         {
-
+            NFDRS4_PERF_SCOPE(NFDRS4_PERF_DFM_1H);
             OneHourFM.update(Year, Month, Day, Hour, 0, 0, neltemp, nelrh, nelsr, nelppt, 0.02179999999, true);
             MC1 = MyMC1 = OneHourFM.medianRadialMoisture() * 100;
             //MC1 = MyMC1 = OneHourFM.meanWtdMoisture() * 100;
         }
 #pragma omp section
         {
-
+            NFDRS4_PERF_SCOPE(NFDRS4_PERF_DFM_10H);
             TenHourFM.update(Year, Month, Day, Hour, 0, 0, neltemp, nelrh, nelsr, nelppt, 0.02179999999, true);
             MC10 = MyMC10 = TenHourFM.medianRadialMoisture() * 100;
             //MC10 = MyMC10 = TenHourFM.meanWtdMoisture() * 100;
         }
 #pragma omp section
         {
-
+            NFDRS4_PERF_SCOPE(NFDRS4_PERF_DFM_100H);
             HundredHourFM.update(Year, Month, Day, Hour, 0, 0, neltemp, nelrh, nelsr, nelppt, 0.02179999999, true);
             MC100 = MyMC100 = HundredHourFM.medianRadialMoisture() * 100;
             //MC100 = MyMC100 = HundredHourFM.meanWtdMoisture() * 100;
@@ -499,7 +594,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
         }
 #pragma omp section
         {
-
+            NFDRS4_PERF_SCOPE(NFDRS4_PERF_DFM_1000H);
             ThousandHourFM.update(Year, Month, Day, Hour, 0, 0, neltemp, nelrh, nelsr, nelppt, 0.02179999999, true);
             MC1000 = MyMC1000 = ThousandHourFM.medianRadialMoisture() * 100;
             //MC1000 = MyMC1000 = ThousandHourFM.meanWtdMoisture() * 100;
@@ -507,6 +602,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
         }
     }
 
+    NFDRS4_PERF_RESTART(perf);
     //moved here so we have hourly fueltemp to save to DB
     FuelTemperature = OneHourFM.surfaceTemperature();
 
@@ -514,57 +610,19 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
     UTCTime thisUtcTime(Year, Month, Day, Hour, 0, 0);   
     time_t thisDiff = thisUtcTime - lastUtcUpdateTime;
     time_t hoursDiff = thisDiff / utcHourDiff;
+    NFDRS4_PERF_LAP_MORE(perf, NFDRS4_PERF_TIME);
     if (hoursDiff > 1)//gap, insert NODATA
     {
-        for (int h = 1; h < hoursDiff; h++)
-        {
-            qHourlyPrecip.push_back(NORECORD);
-            qHourlyTemp.push_back(NORECORD);
-            qHourlyRH.push_back(NORECORD);
-        }
-    }
-    qHourlyPrecip.push_back(PPTAmt);
-    qHourlyTemp.push_back(Temp);
-    qHourlyRH.push_back(RH);
-    //trim the deques
-    while (qHourlyTemp.size() > 24)
-        qHourlyTemp.pop_front();
-    while (qHourlyRH.size() > 24)
-        qHourlyRH.pop_front();
-    while (qHourlyPrecip.size() > 24)
-        qHourlyPrecip.pop_front();
-    //deques OK, now figure Min/Max's and 24 hour pcp
-    double MinRH = NORECORD, MinTemp = NORECORD, MaxTemp = NORECORD, pcp24 = 0.0;
-    
-    for (std::deque<double>::iterator it = qHourlyTemp.begin(); it != qHourlyTemp.end(); ++it)
-    {
-        if ((*it) != NORECORD)
-        {
-            if (MaxTemp == NORECORD)
-                MaxTemp = *it;
-            else
-                MaxTemp = max(MaxTemp, *it);
-            if (MinTemp == NORECORD)
-                MinTemp = *it;
-            else
-                MinTemp = min(MinTemp, *it);
-        }
-    }
-    for (std::deque<double>::iterator it = qHourlyRH.begin(); it != qHourlyRH.end(); ++it)
-    {
-        if ((*it) != NORECORD)
-        {
-            if (MinRH == NORECORD)
-                MinRH = *it;
-            else
-                MinRH = min(MinRH, *it);
-        }
-    }
-    for (std::deque<double>::iterator it = qHourlyPrecip.begin(); it != qHourlyPrecip.end(); ++it)
-    {
-        if (*it != NORECORD)
-            pcp24 += *it;
+        qHourlyPrecip.PushMissing(hoursDiff - 1);
+        qHourlyTemp.PushMissing(hoursDiff - 1);
+        qHourlyRH.PushMissing(hoursDiff - 1);
     }
+    qHourlyPrecip.Push(PPTAmt);
+    qHourlyTemp.Push(Temp);
+    qHourlyRH.Push(RH);
+    //windows are fixed at 24 hours and keep their own min/max and sums
+    double MinRH = qHourlyRH.Min(), MinTemp = qHourlyTemp.Min(), MaxTemp = qHourlyTemp.Max(), pcp24 = qHourlyPrecip.Sum();
+    NFDRS4_PERF_LAP(perf, NFDRS4_PERF_QUEUES);
     // Update live fuel moisture once per day
     if (Hour == m_regObsHour)// || num_updates==0)
     {
@@ -580,33 +638,21 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
         //update the precip deque before updating GSI!!!!
         int days = secs / 86400;//86400 seconds per day
         if (days > 1)//gap, deal with it by inserting zeroes
-        {
-            int pDays = min(days - 1, nPrecipQueueDays);
-            for (int p = 0; p < pDays; p++)
-                qPrecip.push_back(0.0);
-        }
-        qPrecip.push_back(pcp24);
-        while (qPrecip.size() > nPrecipQueueDays)
-            qPrecip.pop_front();
+            qPrecip.PushRepeated(0.0, days - 1);
+        qPrecip.Push(pcp24);
+        NFDRS4_PERF_LAP_MORE(perf, NFDRS4_PERF_QUEUES);
 
-        HerbFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(HerbFM.GetNumPrecipDays()), thisUtcTime.timestamp());
-        WoodyFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(WoodyFM.GetNumPrecipDays()), thisUtcTime.timestamp());
-
-        m_GSI = HerbFM.CalcRunningAvgGSI();
-        MCHERB = HerbFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
-        MCWOOD = WoodyFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
+        UpdateLiveFuels(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, thisUtcTime.timestamp());
+        NFDRS4_PERF_LAP(perf, NFDRS4_PERF_LFM_GSI);
         // Calculate the daily KBDI that is used for the drought fuel loading
         KBDI = iCalcKBDI(pcp24, (int)MaxTemp, CummPrecip, YKBDI, AvgPrecip);
         YKBDI = KBDI;
+        NFDRS4_PERF_RESTART(perf);
 
         lastDailyUpdateTime = thisUtcTime;
  
     }
-    iSetFuelMoistures(MC1, MC10, MC100, MC1000, MCWOOD, MCHERB, FuelTemperature);
-    // Calculate the indices
-
-    double fSC, fERC, fBI, fIC;
-    iCalcIndexes((int)WS, SlopeClass, &fSC, &fERC, &fBI, &fIC);
+    SetMoisturesAndCalcIndexes(MC1, MC10, MC100, MC1000, FuelTemperature, WS);
     YesterdayJDay = Julian;
     lastUtcUpdateTime = thisUtcTime;
 }
@@ -614,6 +660,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
 void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double RH, double PPTAmt, 
     double WS, bool SnowDay, double MC1, double MC10, double MC100, double MC1000, double FuelTemperature)
 {
+    NFDRS4_PERF_TIMER(perf);
     int Julian = CalcJulianDay(Year, Month - 1, Day);
     if (PrevYear > 0 && YesterdayJDay > 0)
     {
@@ -626,7 +673,7 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
 
     //Herb and 1-Hour reset every year.... Verify we want to do this
     if (Julian < YesterdayJDay || YesterdayJDay < 0) {
-        HerbFM.ResetHerbState();
+        ResetHerbState();
     }
     if (PrevYear != Year)
     {
@@ -637,57 +684,19 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
     UTCTime thisUtcTime(Year, Month, Day, Hour, 0, 0);   
     time_t thisDiff = thisUtcTime - lastUtcUpdateTime;
     time_t hoursDiff = thisDiff / utcHourDiff;
+    NFDRS4_PERF_LAP(perf, NFDRS4_PERF_TIME);
     if (hoursDiff > 1)//gap, insert NODATA
     {
-        for (int h = 1; h < hoursDiff; h++)
-        {
-            qHourlyPrecip.push_back(NORECORD);
-            qHourlyTemp.push_back(NORECORD);
-            qHourlyRH.push_back(NORECORD);
-        }
-    }
-    qHourlyPrecip.push_back(PPTAmt);
-    qHourlyTemp.push_back(Temp);
-    qHourlyRH.push_back(RH);
-    //trim the deques
-    while (qHourlyTemp.size() > 24)
-        qHourlyTemp.pop_front();
-    while (qHourlyRH.size() > 24)
-        qHourlyRH.pop_front();
-    while (qHourlyPrecip.size() > 24)
-        qHourlyPrecip.pop_front();
-    //deques OK, now figure Min/Max's and 24 hour pcp
-    double MinRH = NORECORD, MinTemp = NORECORD, MaxTemp = NORECORD, pcp24 = 0.0;
-    
-    for (std::deque<double>::iterator it = qHourlyTemp.begin(); it != qHourlyTemp.end(); ++it)
-    {
-        if ((*it) != NORECORD)
-        {
-            if (MaxTemp == NORECORD)
-                MaxTemp = *it;
-            else
-                MaxTemp = max(MaxTemp, *it);
-            if (MinTemp == NORECORD)
-                MinTemp = *it;
-            else
-                MinTemp = min(MinTemp, *it);
-        }
-    }
-    for (std::deque<double>::iterator it = qHourlyRH.begin(); it != qHourlyRH.end(); ++it)
-    {
-        if ((*it) != NORECORD)
-        {
-            if (MinRH == NORECORD)
-                MinRH = *it;
-            else
-                MinRH = min(MinRH, *it);
-        }
-    }
-    for (std::deque<double>::iterator it = qHourlyPrecip.begin(); it != qHourlyPrecip.end(); ++it)
-    {
-        if (*it != NORECORD)
-            pcp24 += *it;
+        qHourlyPrecip.PushMissing(hoursDiff - 1);
+        qHourlyTemp.PushMissing(hoursDiff - 1);
+        qHourlyRH.PushMissing(hoursDiff - 1);
     }
+    qHourlyPrecip.Push(PPTAmt);
+    qHourlyTemp.Push(Temp);
+    qHourlyRH.Push(RH);
+    //windows are fixed at 24 hours and keep their own min/max and sums
+    double MinRH = qHourlyRH.Min(), MinTemp = qHourlyTemp.Min(), MaxTemp = qHourlyTemp.Max(), pcp24 = qHourlyPrecip.Sum();
+    NFDRS4_PERF_LAP(perf, NFDRS4_PERF_QUEUES);
     // Update live fuel moisture once per day
     if (Hour == m_regObsHour)// || num_updates==0)
     {
@@ -703,33 +712,21 @@ void NFDRS4::Update(int Year, int Month, int Day, int Hour, double Temp, double
         //update the precip deque before updating GSI!!!!
         int days = secs / 86400;//86400 seconds per day
         if (days > 1)//gap, deal with it by inserting zeroes
-        {
-            int pDays = min(days - 1, nPrecipQueueDays);
-            for (int p = 0; p < pDays; p++)
-                qPrecip.push_back(0.0);
-        }
-        qPrecip.push_back(pcp24);
-        while (qPrecip.size() > nPrecipQueueDays)
-            qPrecip.pop_front();
-
-        HerbFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(HerbFM.GetNumPrecipDays()), thisUtcTime.timestamp());
-        WoodyFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(WoodyFM.GetNumPrecipDays()), thisUtcTime.timestamp());
+            qPrecip.PushRepeated(0.0, days - 1);
+        qPrecip.Push(pcp24);
+        NFDRS4_PERF_LAP_MORE(perf, NFDRS4_PERF_QUEUES);
 
-        m_GSI = HerbFM.CalcRunningAvgGSI();
-        MCHERB = HerbFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
-        MCWOOD = WoodyFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
+        UpdateLiveFuels(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, thisUtcTime.timestamp());
+        NFDRS4_PERF_LAP(perf, NFDRS4_PERF_LFM_GSI);
         // Calculate the daily KBDI that is used for the drought fuel loading
         KBDI = iCalcKBDI(pcp24, (int)MaxTemp, CummPrecip, YKBDI, AvgPrecip);
         YKBDI = KBDI;
+        NFDRS4_PERF_RESTART(perf);
 
         lastDailyUpdateTime = thisUtcTime;
  
     }
-    iSetFuelMoistures(MC1, MC10, MC100, MC1000, MCWOOD, MCHERB, FuelTemperature);
-    // Calculate the indices
-
-    double fSC, fERC, fBI, fIC;
-    iCalcIndexes((int)WS, SlopeClass, &fSC, &fERC, &fBI, &fIC);
+    SetMoisturesAndCalcIndexes(MC1, MC10, MC100, MC1000, FuelTemperature, WS);
     YesterdayJDay = Julian;
     lastUtcUpdateTime = thisUtcTime;
 }
@@ -738,6 +735,7 @@ void NFDRS4::UpdateDaily(int Year, int Month, int Day, int Julian, double Temp,
 	double MaxTemp, double RH, double MinRH, double pcp24, double WS,
 	double fMC1, double fMC10, double fMC100, double fMC1000, double fuelTemp,bool SnowDay)
 {
+    NFDRS4_PERF_TIMER(perf);
     if (PrevYear > 0 && YesterdayJDay > 0)
 	{
 		if (Year < PrevYear || (Year >(PrevYear + 1)) || (365 * (Year - PrevYear) + Julian - YesterdayJDay > 30))
@@ -749,7 +747,7 @@ void NFDRS4::UpdateDaily(int Year, int Month, int Day, int Julian, double Temp,
 
 	//Herb resets every year.... Verify we want to do this
 	if (Julian < YesterdayJDay || YesterdayJDay < 0) {
-		HerbFM.ResetHerbState();
+		ResetHerbState();
 	}
 	if (PrevYear != Year)
 	{
@@ -764,34 +762,22 @@ void NFDRS4::UpdateDaily(int Year, int Month, int Day, int Julian, double Temp,
     int secs = thisUtcTime.timestamp() - lastDailyUpdateTime.timestamp(); //difftime(thisTime, lastUpdateTime);
     int days = secs / 86400;//86400 seconds per day
 
+	NFDRS4_PERF_LAP(perf, NFDRS4_PERF_TIME);
 	//do the precip deque before updating GSI!
 	if (days > 1)//gap, deal with it by inserting zeroes
-	{
-		int pDays = min(days - 1, nPrecipQueueDays);
-		for (int p = 0; p < pDays; p++)
-			qPrecip.push_back(0.0);
-	}
-	qPrecip.push_back(pcp24);
-	while (qPrecip.size() > nPrecipQueueDays)
-		qPrecip.pop_front();
+		qPrecip.PushRepeated(0.0, days - 1);
+	qPrecip.Push(pcp24);
+	NFDRS4_PERF_LAP(perf, NFDRS4_PERF_QUEUES);
 
 	// Update live fuel moisture once per day
-	HerbFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(HerbFM.GetNumPrecipDays()), thisUtcTime.timestamp());
-    WoodyFM.Update(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, GetXDaysPrecipitation(WoodyFM.GetNumPrecipDays()), thisUtcTime.timestamp());
-
-    m_GSI = HerbFM.CalcRunningAvgGSI();
-    MCHERB = HerbFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
-    MCWOOD = WoodyFM.GetMoisture(nConsectiveSnowDays >= SNOWDAYS_TRIGGER ? true : false);
+	UpdateLiveFuels(Temp, MaxTemp, MinTemp, RH, MinRH, Julian, thisUtcTime.timestamp());
+    NFDRS4_PERF_LAP(perf, NFDRS4_PERF_LFM_GSI);
     // Calculate the daily KBDI that is used for the drought fuel loading
     KBDI = iCalcKBDI(pcp24, (int)MaxTemp, CummPrecip, YKBDI, AvgPrecip);
     YKBDI = KBDI;
+    NFDRS4_PERF_RESTART(perf);
 
-    iSetFuelMoistures(fMC1, fMC10, fMC100, fMC1000, MCWOOD, MCHERB, fuelTemp);
-    // Calculate the indices
-
-    double fSC, fERC, fBI, fIC;
-    //FuelTemperature = fuelTemp;
-    iCalcIndexes((int)WS, SlopeClass, &fSC, &fERC, &fBI, &fIC);
+    SetMoisturesAndCalcIndexes(fMC1, fMC10, fMC100, fMC1000, fuelTemp, WS);
 
     YesterdayJDay = Julian;
 
@@ -924,32 +910,130 @@ bool NFDRS4::iSetFuelModel(char cFM)
     auto it = mapFuels.equal_range(cFM).first;
     if (it != mapFuels.end())
     {
-        CFuelModelParams fm = (*it).second;
-        FuelModel = fm.getFuelModel();
-        FuelDescription = fm.getDescription();
-        SG1 = fm.getSG1();
-        SG10 = fm.getSG10();
-        SG100 = fm.getSG100();
-        SG1000 = fm.getSG1000();
-        SGWOOD = fm.getSGWood();
-        SGHERB = fm.getSGHerb();
-        HD = fm.getHD();
-        L1 = fm.getL1();
-        L10 = fm.getL10();
-        L100 = fm.getL100();
-        L1000 = fm.getL1000();
-        LWOOD = fm.getLWood();
-        LHERB = fm.getLHerb();
-        DEPTH = fm.getDepth();
-        MXD = fm.getMXD();
-        SCM = fm.getSCM();
-        LDROUGHT = fm.getLDrought();
-        WNDFC = fm.getWNDFC();
+        ApplyFuelModelParams((*it).second);
         return true;
     }
     return false;
 }
 
+void NFDRS4::ApplyFuelModelParams(CFuelModelParams& fm)
+{
+    FuelModel = fm.getFuelModel();
+    FuelDescription = fm.getDescription();
+    SG1 = fm.getSG1();
+    SG10 = fm.getSG10();
+    SG100 = fm.getSG100();
+    SG1000 = fm.getSG1000();
+    SGWOOD = fm.getSGWood();
+    SGHERB = fm.getSGHerb();
+    HD = fm.getHD();
+    L1 = fm.getL1();
+    L10 = fm.getL10();
+    L100 = fm.getL100();
+    L1000 = fm.getL1000();
+    LWOOD = fm.getLWood();
+    LHERB = fm.getLHerb();
+    DEPTH = fm.getDepth();
+    MXD = fm.getMXD();
+    SCM = fm.getSCM();
+    LDROUGHT = fm.getLDrought();
+    WNDFC = fm.getWNDFC();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns the fuel model parameters currently in use, including any
+    MXD or SCM overrides set with SetMXD() and SetSCMax().
+ */
+CFuelModelParams NFDRS4::GetActiveFuelModelParams()
+{
+    CFuelModelParams fm;
+    fm.setFuelModel((char)FuelModel);
+    fm.setDescription(FuelDescription.c_str());
+    fm.setSG1(SG1);
+    fm.setSG10(SG10);
+    fm.setSG100(SG100);
+    fm.setSG1000(SG1000);
+    fm.setSGWood(SGWOOD);
+    fm.setSGHerb(SGHERB);
+    fm.setHD((int)HD);
+    fm.setL1(L1);
+    fm.setL10(L10);
+    fm.setL100(L100);
+    fm.setL1000(L1000);
+    fm.setLWood(LWOOD);
+    fm.setLHerb(LHERB);
+    fm.setDepth(DEPTH);
+    fm.setMXD((int)MXD);
+    fm.setSCM((int)SCM);
+    fm.setLDrought(LDROUGHT);
+    fm.setWNDFC(WNDFC);
+    return fm;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Calculates SC, ERC, BI and IC for several fuel models from the
+    current fuel moistures, GSI and KBDI.
+
+    Fuel moistures do not depend on the fuel model, so one Update() can feed
+    any number of fuel models. Each model is evaluated with its catalog
+    parameters (MXD and SCM included). The active fuel model, its indexes and
+    the load transfer state are restored afterwards, so this can be called
+    after every Update() without changing the results of later updates.
+    \param[in] iWS: Windspeed (mph), as passed to iCalcIndexes().
+    \param[in] iSlopeCls: Slope Class (1-5 or actual in degrees).
+    \param[in] fuelModels: Fuel models (standard or custom) to evaluate.
+    \param[out] indexes: One entry per fuel model, in the same order.
+    \param[in] fGSI: Optional stored GSI, see iCalcIndexes().
+    \param[in] fKBDI: Optional stored KBDI, see iCalcIndexes().
+    \return Number of fuel models successfully evaluated.
+ */
+int NFDRS4::iCalcIndexesForFuelModels(int iWS, int iSlopeCls, const std::vector<char>& fuelModels, std::vector<NFDRS4Indexes>& indexes, double fGSI, double fKBDI)
+{
+    CFuelModelParams active = GetActiveFuelModelParams();
+    double saveBI = BI, saveERC = ERC, saveSC = SC, saveIC = IC, saveGSI = m_GSI;
+    double saveW1P = W1P, saveWHERBP = WHERBP, saveWTOT = WTOT, saveFctCur = fctCur, saveDroughtUnit = DroughtUnit;
+    double saveWTMCD = WTMCD, saveWTMCL = WTMCL, saveWTMCDE = WTMCDE, saveWTMCLE = WTMCLE;
+    int nValid = 0;
+    indexes.resize(fuelModels.size());
+    for (size_t f = 0; f < fuelModels.size(); f++)
+    {
+        NFDRS4Indexes& idx = indexes[f];
+        idx.FuelModel = fuelModels[f];
+        idx.Valid = false;
+        idx.SC = idx.ERC = idx.BI = idx.IC = 0.0;
+        if (!iSetFuelModel(fuelModels[f]))
+            continue;
+        if (iCalcIndexes(iWS, iSlopeCls, &idx.SC, &idx.ERC, &idx.BI, &idx.IC, fGSI, fKBDI))
+        {
+            idx.Valid = true;
+            nValid++;
+        }
+        m_GSI = saveGSI;
+    }
+    ApplyFuelModelParams(active);
+    W1 = L1 * CTA;
+    W10 = L10 * CTA;
+    W100 = L100 * CTA;
+    W1000 = L1000 * CTA;
+    WWOOD = LWOOD * CTA;
+    WHERB = LHERB * CTA;
+    WDROUGHT = LDROUGHT * CTA;
+    BI = saveBI;
+    ERC = saveERC;
+    SC = saveSC;
+    IC = saveIC;
+    W1P = saveW1P;
+    WHERBP = saveWHERBP;
+    WTOT = saveWTOT;
+    fctCur = saveFctCur;
+    DroughtUnit = saveDroughtUnit;
+    WTMCD = saveWTMCD;
+    WTMCL = saveWTMCL;
+    WTMCDE = saveWTMCDE;
+    WTMCLE = saveWTMCLE;
+    return nValid;
+}
+
 
 // Calculates all Components and Indices for NFDRS4
 // iWS: Windspeed (mph)
@@ -960,6 +1044,7 @@ bool NFDRS4::iSetFuelModel(char cFM)
 // fIC: Ignition Component (dim)
 int NFDRS4::iCalcIndexes (int iWS, int iSlopeCls,double* fSC,double* fERC, double* fBI, double *fIC, double fGSI, double fKBDI)
 {
+    NFDRS4_PERF_SCOPE(NFDRS4_PERF_INDEXES);
 
     double STD = .0555, STL = .0555;
     double RHOD = 32, RHOL = 32;
@@ -1291,6 +1376,7 @@ int NFDRS4::iCalcIndexes (int iWS, int iSlopeCls,double* fSC,double* fERC, doubl
 int NFDRS4::iCalcKBDI (double fPrecipAmt, int iMaxTemp,
                 double fCummPrecip, int iYKBDI, double fAvgPrecip)
 {
+    NFDRS4_PERF_SCOPE(NFDRS4_PERF_KBDI);
     int net = 0, idq = 0;
     double pptnet = 0.00,xkbdi = 0.00,xtemp = 0.00;
 
@@ -1594,18 +1680,9 @@ int NFDRS4::GetStartKBDI()
 
 double NFDRS4::GetXDaysPrecipitation(int nDays)
 {
-	double startVal = 0.0, val = 0.0;
-	if (nDays >= qPrecip.size())
-		val = std::accumulate(qPrecip.begin(), qPrecip.end(), startVal);
-	else
-	{
-		int startDay = qPrecip.size() - nDays;
-		for (int d = startDay; d < qPrecip.size(); d++)
-		{
-			val += qPrecip.at(d);
-		}
-	}
-	return val;
+	if (nDays <= 0)
+		return 0.0;
+	return qPrecip.SumLast(nDays);
 }
 
 bool NFDRS4::ReadState(string fileName)
@@ -1659,17 +1736,17 @@ bool NFDRS4::LoadState(NFDRS4State state)
 	YKBDI = state.m_YKBDI;
 	for (int i = 0; i < state.m_qPrecip.size(); i++)
 	{
-		qPrecip.push_back(state.m_qPrecip.at(i));
+		qPrecip.Push(state.m_qPrecip.at(i));
 	}
     //added 2021/01/26 - Hourly temp RH and precip deques
-    qHourlyPrecip.clear();
-    qHourlyRH.clear();
-    qHourlyTemp.clear();
+    qHourlyPrecip.Clear();
+    qHourlyRH.Clear();
+    qHourlyTemp.Clear();
     for (int h = 0; h < nHoursPerDay; h++)
     {
-        qHourlyTemp.push_back(state.m_qHourlyTemp[h]);
-        qHourlyRH.push_back(state.m_qHourlyRH[h]);
-        qHourlyPrecip.push_back(state.m_qHourlyPrecip[h]);
+        qHourlyTemp.Push(state.m_qHourlyTemp[h]);
+        qHourlyRH.Push(state.m_qHourlyRH[h]);
+        qHourlyPrecip.Push(state.m_qHourlyPrecip[h]);
     }
     //end 2021/01/26 additions
 	OneHourFM.SetState(state.fm1State);
@@ -1683,61 +1760,114 @@ bool NFDRS4::LoadState(NFDRS4State state)
 	return true;
 }
 
-double NFDRS4::GetMinTemp()
+//------------------------------------------------------------------------------
+/*! \brief Per phase counters of every NFDRS4 on every thread since the last
+    ResetPerfCounters(); enabled is false (and all counts zero) unless the
+    library is built with NFDRS4_PERF_COUNTERS.
+ */
+NFDRS4PerfCounters NFDRS4::GetPerfCounters()
+{
+	return NFDRS4PerfGetCounters();
+}
+
+void NFDRS4::ResetPerfCounters()
+{
+	NFDRS4PerfResetCounters();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Copies the evolving model state (stick profiles, GSI windows,
+    precipitation and hourly windows, KBDI, moistures, indexes and update
+    times) from src into this object.
+
+    Fuel models, stick and GSI parameters are not copied, so this is meant
+    for scenario slots made once as copies of (or configured like) src. This
+    lets ensemble members be reset to an observed state each forecast cycle
+    without allocation or re-copying the fuel model map.
+    \param[in] src: NFDRS4 to copy the state from.
+ */
+void NFDRS4::CopyStateFrom(const NFDRS4& src)
+{
+    if (this == &src)
+        return;
+    OneHourFM.copyStateFrom(src.OneHourFM);
+    TenHourFM.copyStateFrom(src.TenHourFM);
+    HundredHourFM.copyStateFrom(src.HundredHourFM);
+    ThousandHourFM.copyStateFrom(src.ThousandHourFM);
+    HerbFM.CopyStateFrom(src.HerbFM);
+    WoodyFM.CopyStateFrom(src.WoodyFM);
+    m_herbResetPending = src.m_herbResetPending;
+    MC1 = src.MC1;
+    MC10 = src.MC10;
+    MC100 = src.MC100;
+    MC1000 = src.MC1000;
+    MCWOOD = src.MCWOOD;
+    MCHERB = src.MCHERB;
+    BI = src.BI;
+    ERC = src.ERC;
+    SC = src.SC;
+    IC = src.IC;
+    KBDI = src.KBDI;
+    YKBDI = src.YKBDI;
+    CummPrecip = src.CummPrecip;
+    PrevYear = src.PrevYear;
+    YesterdayJDay = src.YesterdayJDay;
+    SnowCovered = src.SnowCovered;
+    FuelTemperature = src.FuelTemperature;
+    m_GSI = src.m_GSI;
+    nConsectiveSnowDays = src.nConsectiveSnowDays;
+    lastUtcUpdateTime = src.lastUtcUpdateTime;
+    lastDailyUpdateTime = src.lastDailyUpdateTime;
+    qPrecip = src.qPrecip;
+    qHourlyPrecip = src.qHourlyPrecip;
+    qHourlyTemp = src.qHourlyTemp;
+    qHourlyRH = src.qHourlyRH;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Bytes held by this object: the object itself, the four dead fuel
+    sticks, the herb and woody GSI models, the precipitation and hourly
+    windows (at their full size), the fuel description and the fuel model map.
+
+    A grid run needs about this much per cell for the NFDRS4 objects alone.
+    \return Size in bytes, not counting allocator overhead.
+ */
+size_t NFDRS4::MemoryFootprint() const
 {
-    double minTemp = NORECORD;
-    for (std::deque<double>::iterator it = qHourlyTemp.begin(); it != qHourlyTemp.end(); ++it)
+    size_t bytes = sizeof(NFDRS4) + StringHeapBytes(FuelDescription);
+    const DeadFuelMoisture* sticks[] = { &OneHourFM, &TenHourFM, &HundredHourFM, &ThousandHourFM };
+    for (const DeadFuelMoisture* stick : sticks)
+        bytes += stick->MemoryFootprint() - sizeof(DeadFuelMoisture);
+    bytes += HerbFM.MemoryFootprint() - sizeof(LiveFuelMoisture);
+    bytes += WoodyFM.MemoryFootprint() - sizeof(LiveFuelMoisture);
+    const SlidingWindow* windows[] = { &qPrecip, &qHourlyPrecip, &qHourlyTemp, &qHourlyRH };
+    for (const SlidingWindow* window : windows)
+        bytes += window->MemoryFootprint() - sizeof(SlidingWindow);
+    bytes += UnorderedMapHeapBytes(mapFuels);
+    for (const auto& fm : mapFuels)
     {
-        if ((*it) != NORECORD)
-        {
-            if (minTemp == NORECORD)
-                minTemp = *it;
-            else
-                minTemp = min(minTemp, *it);
-        }
+        //getDescription() is not const but only reads the description
+        bytes += StringHeapBytes(strlen(const_cast<CFuelModelParams&>(fm.second).getDescription()));
     }
-    return minTemp;
+    return bytes;
+}
+
+double NFDRS4::GetMinTemp()
+{
+    return qHourlyTemp.Min();
 }
 
 double NFDRS4::GetMaxTemp()
 {
-    double maxTemp = NORECORD;
-    for (std::deque<double>::iterator it = qHourlyTemp.begin(); it != qHourlyTemp.end(); ++it)
-    {
-        if ((*it) != NORECORD)
-        {
-            if (maxTemp == NORECORD)
-                maxTemp = *it;
-            else
-                maxTemp = max(maxTemp, *it);
-        }
-    }
-    return maxTemp;
+    return qHourlyTemp.Max();
 }
 double NFDRS4::GetMinRH()
 {
-    double minRH = NORECORD;
-    for (std::deque<double>::iterator it = qHourlyRH.begin(); it != qHourlyRH.end(); ++it)
-    {
-        if ((*it) != NORECORD)
-        {
-            if (minRH == NORECORD)
-                minRH = *it;
-            else
-                minRH = min(minRH, *it);
-        }
-    }
-    return minRH;
+    return qHourlyRH.Min();
 }
 double NFDRS4::GetPcp24()
 {
-    double pcp24 = 0.0;
-    for (std::deque<double>::iterator it = qHourlyPrecip.begin(); it != qHourlyPrecip.end(); ++it)
-    {
-        if (*it != NORECORD)
-            pcp24 += *it;
-    }
-    return pcp24;
+    return qHourlyPrecip.Sum();
 }
 
 void NFDRS4::AddCustomFuel(CFuelModelParams fmParams)
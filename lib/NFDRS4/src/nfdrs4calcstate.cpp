@@ -86,26 +86,14 @@ NFDRS4State::NFDRS4State(NFDRS4 *pNFDRS)
 	m_UseLoadTransfer = pNFDRS->UseLoadTransfer;
 	m_YesterdayJDay = pNFDRS->YesterdayJDay;
 	m_YKBDI = pNFDRS->YKBDI;
-	float tVal;
-	std::deque<double> qCopy = pNFDRS->qPrecip;
-	while(qCopy.size() > 0)
-	{
-		tVal = (float)qCopy.front();
-		m_qPrecip.push_back(tVal);
-		qCopy.pop_front();
-	}
-	//hourly deques are always 24 entries
-	std::deque<double> qTempCopy = pNFDRS->qHourlyTemp;
-	std::deque<double> qRHcopy = pNFDRS->qHourlyRH;
-	std::deque<double> qPcpCopy = pNFDRS->qHourlyPrecip;
+	for (size_t i = 0; i < pNFDRS->qPrecip.Size(); i++)
+		m_qPrecip.push_back((float)pNFDRS->qPrecip.At(i));
+	//hourly windows are always 24 entries
 	for (int h = 0; h < pNFDRS->nHoursPerDay; h++)
 	{
-		m_qHourlyTemp.push_back((float)qTempCopy.front());
-		m_qHourlyRH.push_back((float)qRHcopy.front());
-		m_qHourlyPrecip.push_back((float)qPcpCopy.front());
-		qTempCopy.pop_front();
-		qRHcopy.pop_front();
-		qPcpCopy.pop_front();
+		m_qHourlyTemp.push_back((float)pNFDRS->qHourlyTemp.At(h));
+		m_qHourlyRH.push_back((float)pNFDRS->qHourlyRH.At(h));
+		m_qHourlyPrecip.push_back((float)pNFDRS->qHourlyPrecip.At(h));
 	}
 	m_KBDIThreshold = pNFDRS->KBDIThreshold;
 	fm1State = pNFDRS->OneHourFM.GetState();
@@ -0,0 +1,212 @@
+#include "nfdrs4perf.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+void NFDRS4PerfCounters::Clear()
+{
+#ifdef NFDRS4_PERF_COUNTERS
+	enabled = true;
+#else
+	enabled = false;
+#endif
+	for (int p = 0; p < NFDRS4_PERF_PHASES; p++)
+		calls[p] = nanoseconds[p] = 0;
+	dfmUpdates = 0;
+	for (int s = 0; s < NFDRS4_PERF_DFM_STATES; s++)
+		dfmStates[s] = 0;
+	dfmSubSteps = 0;
+	dfmRejected = 0;
+}
+
+void NFDRS4PerfCounters::Add(const NFDRS4PerfCounters& other)
+{
+	for (int p = 0; p < NFDRS4_PERF_PHASES; p++)
+	{
+		calls[p] += other.calls[p];
+		nanoseconds[p] += other.nanoseconds[p];
+	}
+	dfmUpdates += other.dfmUpdates;
+	for (int s = 0; s < NFDRS4_PERF_DFM_STATES; s++)
+		dfmStates[s] += other.dfmStates[s];
+	dfmSubSteps += other.dfmSubSteps;
+	dfmRejected += other.dfmRejected;
+}
+
+const char* NFDRS4PerfCounters::GetPhaseName(int phase)
+{
+	static const char* names[NFDRS4_PERF_PHASES] = { "time", "dfm_1h", "dfm_10h", "dfm_100h", "dfm_1000h", "diffusivity",
+		"lfm_gsi", "kbdi", "indexes", "queues" };
+	return phase >= 0 && phase < NFDRS4_PERF_PHASES ? names[phase] : "unknown";
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Name of a DFM_State, as DeadFuelMoisture::stateName().
+ */
+const char* NFDRS4PerfCounters::GetDFMStateName(int state)
+{
+	static const char* names[NFDRS4_PERF_DFM_STATES] = { "None", "Adsorption", "Desorption", "Condensation1", "Condensation2",
+		"Evaporation", "Rainfall1", "Rainfall2", "Rainstorm", "Stagnation", "Error" };
+	return state >= 0 && state < NFDRS4_PERF_DFM_STATES ? names[state] : "unknown";
+}
+
+//------------------------------------------------------------------------------
+/*! \class CPerfThreadCounters
+    \brief One thread's counters. Only the owning thread writes them, so a
+    relaxed load and store is enough and no update is lost; other threads
+    read them when summing. A thread's counters are kept after it exits.
+ */
+class CPerfThreadCounters
+{
+public:
+	CPerfThreadCounters();
+	~CPerfThreadCounters();
+
+	static void Increment(atomic<unsigned long long>& counter, unsigned long long n)
+	{
+		counter.store(counter.load(memory_order_relaxed) + n, memory_order_relaxed);
+	}
+	void AddTo(NFDRS4PerfCounters& sum) const;
+
+	atomic<unsigned long long> calls[NFDRS4_PERF_PHASES];
+	atomic<unsigned long long> nanoseconds[NFDRS4_PERF_PHASES];
+	atomic<unsigned long long> dfmUpdates;
+	atomic<unsigned long long> dfmStates[NFDRS4_PERF_DFM_STATES];
+	atomic<unsigned long long> dfmSubSteps;
+	atomic<unsigned long long> dfmRejected;
+};
+
+//------------------------------------------------------------------------------
+/*! \brief The live threads' counters, the sum of exited threads' counters
+    and the sum at the last reset.
+ */
+struct PerfRegistry
+{
+	mutex lock;
+	vector<CPerfThreadCounters*> threads;
+	NFDRS4PerfCounters exited;
+	NFDRS4PerfCounters atReset;
+};
+
+static PerfRegistry& GetRegistry()
+{
+	static PerfRegistry registry;
+	return registry;
+}
+
+CPerfThreadCounters::CPerfThreadCounters()
+{
+	for (int p = 0; p < NFDRS4_PERF_PHASES; p++)
+		calls[p] = nanoseconds[p] = 0;
+	dfmUpdates = 0;
+	for (int s = 0; s < NFDRS4_PERF_DFM_STATES; s++)
+		dfmStates[s] = 0;
+	dfmSubSteps = 0;
+	dfmRejected = 0;
+	PerfRegistry& registry = GetRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	registry.threads.push_back(this);
+}
+
+CPerfThreadCounters::~CPerfThreadCounters()
+{
+	PerfRegistry& registry = GetRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	AddTo(registry.exited);
+	for (size_t t = 0; t < registry.threads.size(); t++)
+	{
+		if (registry.threads[t] == this)
+		{
+			registry.threads.erase(registry.threads.begin() + t);
+			break;
+		}
+	}
+}
+
+void CPerfThreadCounters::AddTo(NFDRS4PerfCounters& sum) const
+{
+	for (int p = 0; p < NFDRS4_PERF_PHASES; p++)
+	{
+		sum.calls[p] += calls[p].load(memory_order_relaxed);
+		sum.nanoseconds[p] += nanoseconds[p].load(memory_order_relaxed);
+	}
+	sum.dfmUpdates += dfmUpdates.load(memory_order_relaxed);
+	for (int s = 0; s < NFDRS4_PERF_DFM_STATES; s++)
+		sum.dfmStates[s] += dfmStates[s].load(memory_order_relaxed);
+	sum.dfmSubSteps += dfmSubSteps.load(memory_order_relaxed);
+	sum.dfmRejected += dfmRejected.load(memory_order_relaxed);
+}
+
+static CPerfThreadCounters& ThisThread()
+{
+	static thread_local CPerfThreadCounters counters;
+	return counters;
+}
+
+void NFDRS4PerfAddPhase(int phase, unsigned long long nanoseconds, bool countCall/* = true*/)
+{
+	CPerfThreadCounters& counters = ThisThread();
+	if (countCall)
+		CPerfThreadCounters::Increment(counters.calls[phase], 1);
+	CPerfThreadCounters::Increment(counters.nanoseconds[phase], nanoseconds);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Adds one stick update.
+    \param[in] stateSteps The update's moisture time steps in each DFM_State.
+ */
+void NFDRS4PerfAddDFM(const int* stateSteps)
+{
+	CPerfThreadCounters& counters = ThisThread();
+	unsigned long long subSteps = 0;
+	for (int s = 0; s < NFDRS4_PERF_DFM_STATES; s++)
+	{
+		CPerfThreadCounters::Increment(counters.dfmStates[s], (unsigned long long)stateSteps[s]);
+		subSteps += (unsigned long long)stateSteps[s];
+	}
+	CPerfThreadCounters::Increment(counters.dfmUpdates, 1);
+	CPerfThreadCounters::Increment(counters.dfmSubSteps, subSteps);
+}
+
+void NFDRS4PerfAddDFMRejected()
+{
+	CPerfThreadCounters::Increment(ThisThread().dfmRejected, 1);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief The counters of every thread, live or exited, since the last reset.
+ */
+NFDRS4PerfCounters NFDRS4PerfGetCounters()
+{
+	NFDRS4PerfCounters sum;
+	PerfRegistry& registry = GetRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	sum.Add(registry.exited);
+	for (size_t t = 0; t < registry.threads.size(); t++)
+		registry.threads[t]->AddTo(sum);
+	//counters only grow, a reset remembers where they were
+	const NFDRS4PerfCounters& base = registry.atReset;
+	for (int p = 0; p < NFDRS4_PERF_PHASES; p++)
+	{
+		sum.calls[p] -= base.calls[p];
+		sum.nanoseconds[p] -= base.nanoseconds[p];
+	}
+	sum.dfmUpdates -= base.dfmUpdates;
+	for (int s = 0; s < NFDRS4_PERF_DFM_STATES; s++)
+		sum.dfmStates[s] -= base.dfmStates[s];
+	sum.dfmSubSteps -= base.dfmSubSteps;
+	sum.dfmRejected -= base.dfmRejected;
+	return sum;
+}
+
+void NFDRS4PerfResetCounters()
+{
+	PerfRegistry& registry = GetRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	NFDRS4PerfCounters sum;
+	sum.Add(registry.exited);
+	for (size_t t = 0; t < registry.threads.size(); t++)
+		registry.threads[t]->AddTo(sum);
+	registry.atReset = sum;
+}
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include "nfdrs4timeline.h"
+
+using namespace std;
+
+NFDRS4Timeline::NFDRS4Timeline(NFDRS4* pModel, size_t maxHours/* = 168*/, size_t checkpointInterval/* = 24*/)
+{
+	m_pModel = pModel;
+	m_maxHours = max((size_t)1, maxHours);
+	m_checkpointInterval = max((size_t)1, checkpointInterval);
+	m_firstSeq = 0;
+	m_firstStale = 0;
+	//enough slots to keep a checkpoint before every kept hour
+	m_numSlots = m_maxHours / m_checkpointInterval + 2;
+	m_slots.reserve(m_numSlots);
+}
+
+NFDRS4Timeline::~NFDRS4Timeline()
+{
+}
+
+long long NFDRS4Timeline::HourKey(int Year, int Month, int Day, int Hour)
+{
+	return ((long long)Year * 10000 + Month * 100 + Day) * 100 + Hour;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Runs the model for a new observation and records its outputs.
+    Pending corrections are recomputed first. An observation that is not
+    later than the newest kept hour is handled by Correct().
+    \param[in] obs: Hourly observation.
+ */
+void NFDRS4Timeline::Update(const NFDRS4Observation& obs)
+{
+	if (m_hours.size() > 0)
+	{
+		const NFDRS4Observation& last = m_hours.back();
+		if (HourKey(obs.Year, obs.Month, obs.Day, obs.Hour) <= HourKey(last.Year, last.Month, last.Day, last.Hour))
+		{
+			Correct(obs);
+			return;
+		}
+	}
+	if (HasStale())
+		Recompute();
+	m_hours.push_back(obs);
+	m_outputs.push_back(NFDRS4Outputs());
+	Step(m_hours.size() - 1);
+	m_firstStale = m_hours.size();
+	Trim();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Replaces the observation for the same hour, or inserts a late one,
+    and flags the outputs from that hour onward as stale. Nothing is
+    recomputed until Recompute() or the next Update().
+    \param[in] obs: Corrected or late hourly observation.
+    \return 1 on success, 0 if the hour is older than GetFirstCorrectableHour().
+ */
+int NFDRS4Timeline::Correct(const NFDRS4Observation& obs)
+{
+	long long key = HourKey(obs.Year, obs.Month, obs.Day, obs.Hour);
+	//position of the last hour not later than obs
+	int pos = (int)m_hours.size() - 1;
+	while (pos >= 0 && HourKey(m_hours[pos].Year, m_hours[pos].Month, m_hours[pos].Day, m_hours[pos].Hour) > key)
+		pos--;
+	size_t p;
+	bool replace = false;
+	if (pos >= 0 && HourKey(m_hours[pos].Year, m_hours[pos].Month, m_hours[pos].Day, m_hours[pos].Hour) == key)
+	{
+		p = (size_t)pos;
+		replace = true;
+	}
+	else
+		p = (size_t)(pos + 1);
+	if (!replace && p == m_hours.size())
+	{
+		Update(obs);
+		return 1;
+	}
+	if (m_checkpoints.empty() || CheckpointIndex(m_checkpoints.front()) > p)
+		return 0;
+	if (replace)
+		m_hours[p] = obs;
+	else
+	{
+		//later hours shift, so checkpoints after p no longer line up
+		DropCheckpointsAfter(p);
+		m_hours.insert(m_hours.begin() + p, obs);
+		m_outputs.insert(m_outputs.begin() + p, NFDRS4Outputs());
+		if (m_firstStale >= p)
+			m_firstStale++;
+	}
+	for (size_t i = p; i < m_outputs.size(); i++)
+		m_outputs[i].Stale = true;
+	m_firstStale = min(m_firstStale, p);
+	return 1;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Restores the newest checkpoint at or before the first stale hour
+    and replays the kept observations from there.
+    \return Number of hours replayed.
+ */
+int NFDRS4Timeline::Recompute()
+{
+	if (!HasStale())
+		return 0;
+	size_t c = m_checkpoints.size();
+	while (c > 0 && CheckpointIndex(m_checkpoints[c - 1]) > m_firstStale)
+		c--;
+	if (c == 0)//cannot happen, Correct() refuses hours without a checkpoint
+		return 0;
+	size_t start = CheckpointIndex(m_checkpoints[c - 1]);
+	DropCheckpointsAfter(start);
+	m_pModel->CopyStateFrom(m_slots[m_checkpoints.back().slot]);
+	for (size_t i = start; i < m_hours.size(); i++)
+		Step(i);
+	m_firstStale = m_hours.size();
+	int nReplayed = (int)(m_hours.size() - start);
+	Trim();
+	return nReplayed;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns the index of the kept hour matching the date, or -1.
+ */
+int NFDRS4Timeline::FindHour(int Year, int Month, int Day, int Hour) const
+{
+	long long key = HourKey(Year, Month, Day, Hour);
+	for (int i = (int)m_hours.size() - 1; i >= 0; i--)
+	{
+		long long hKey = HourKey(m_hours[i].Year, m_hours[i].Month, m_hours[i].Day, m_hours[i].Hour);
+		if (hKey == key)
+			return i;
+		if (hKey < key)
+			break;
+	}
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns the index of the oldest hour that can still be corrected,
+    or -1 if there are no checkpoints yet.
+ */
+int NFDRS4Timeline::GetFirstCorrectableHour() const
+{
+	if (m_checkpoints.empty())
+		return -1;
+	return (int)CheckpointIndex(m_checkpoints.front());
+}
+
+void NFDRS4Timeline::Step(size_t i)
+{
+	if (m_checkpoints.empty() || i - CheckpointIndex(m_checkpoints.back()) >= m_checkpointInterval)
+		TakeCheckpoint(i);
+	const NFDRS4Observation& obs = m_hours[i];
+	m_pModel->Update(obs.Year, obs.Month, obs.Day, obs.Hour, obs.Temp, obs.RH, obs.PPTAmt, obs.SolarRad, obs.WS, obs.SnowDay);
+	NFDRS4Outputs& out = m_outputs[i];
+	out.MC1 = m_pModel->MC1;
+	out.MC10 = m_pModel->MC10;
+	out.MC100 = m_pModel->MC100;
+	out.MC1000 = m_pModel->MC1000;
+	out.MCHERB = m_pModel->MCHERB;
+	out.MCWOOD = m_pModel->MCWOOD;
+	out.FuelTemperature = m_pModel->GetFuelTemperature();
+	out.BI = m_pModel->BI;
+	out.ERC = m_pModel->ERC;
+	out.SC = m_pModel->SC;
+	out.IC = m_pModel->IC;
+	out.GSI = m_pModel->m_GSI;
+	out.KBDI = m_pModel->KBDI;
+	out.Stale = false;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Saves the model state before hour i, reusing the oldest checkpoint's
+    slot when the ring is full.
+ */
+void NFDRS4Timeline::TakeCheckpoint(size_t i)
+{
+	size_t slot;
+	if (!m_freeSlots.empty())
+	{
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else if (m_slots.size() < m_numSlots)
+	{
+		//first use of a slot, copying the model also copies its configuration
+		m_slots.push_back(*m_pModel);
+		m_checkpoints.push_back({ m_firstSeq + i, m_slots.size() - 1 });
+		return;
+	}
+	else
+	{
+		slot = m_checkpoints.front().slot;
+		m_checkpoints.pop_front();
+	}
+	m_slots[slot].CopyStateFrom(*m_pModel);
+	m_checkpoints.push_back({ m_firstSeq + i, slot });
+}
+
+void NFDRS4Timeline::DropCheckpointsAfter(size_t i)
+{
+	while (!m_checkpoints.empty() && CheckpointIndex(m_checkpoints.back()) > i)
+	{
+		m_freeSlots.push_back(m_checkpoints.back().slot);
+		m_checkpoints.pop_back();
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Forgets hours beyond maxHours, and checkpoints taken before the
+    oldest kept hour.
+ */
+void NFDRS4Timeline::Trim()
+{
+	while (m_hours.size() > m_maxHours)
+	{
+		m_hours.pop_front();
+		m_outputs.pop_front();
+		m_firstSeq++;
+		if (m_firstStale > 0)
+			m_firstStale--;
+	}
+	while (!m_checkpoints.empty() && m_checkpoints.front().seq < m_firstSeq)
+	{
+		m_freeSlots.push_back(m_checkpoints.front().slot);
+		m_checkpoints.pop_front();
+	}
+}
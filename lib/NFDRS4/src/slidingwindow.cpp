@@ -0,0 +1,235 @@
+#include <algorithm>
+#include "memoryfootprint.h"
+#include "slidingwindow.h"
+
+using namespace std;
+
+SlidingWindow::SlidingWindow(size_t capacity, double noData)
+{
+	m_capacity = max((size_t)1, capacity);
+	m_noData = noData;
+	m_size = 0;
+	m_head = 0;
+	m_count = 0;
+	m_values.assign(m_capacity, m_noData);
+	m_prefix.assign(m_capacity + 1, 0.0);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Appends a value, dropping the oldest value if the window is full.
+    \param[in] value Value to append, or the no-data value for a missing record.
+ */
+void SlidingWindow::Push(double value)
+{
+	size_t slot;
+	if (m_size == m_capacity)
+	{
+		slot = m_head;
+		m_head = (m_head + 1) % m_capacity;
+	}
+	else
+	{
+		slot = (m_head + m_size) % m_capacity;
+		m_size++;
+	}
+	m_values[slot] = value;
+	bool missing = IsMissing(value);
+	Prefix(m_count + 1) = Prefix(m_count) + (missing ? 0.0 : value);
+	if (!missing)
+	{
+		while (!m_minQ.empty() && m_minQ.back().second >= value)
+			m_minQ.pop_back();
+		m_minQ.push_back(make_pair(m_count, value));
+		while (!m_maxQ.empty() && m_maxQ.back().second <= value)
+			m_maxQ.pop_back();
+		m_maxQ.push_back(make_pair(m_count, value));
+	}
+	m_count++;
+	Expire();
+	//periodically restart the prefix sums from the oldest value so
+	//round-off does not accumulate over long runs
+	if (m_count % m_capacity == 0)
+		Rebase();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Appends the same value count times. Runs in at most Capacity() steps.
+    \param[in] value Value to append.
+    \param[in] count Number of copies.
+ */
+void SlidingWindow::PushRepeated(double value, size_t count)
+{
+	if (count < m_capacity)
+	{
+		for (size_t i = 0; i < count; i++)
+			Push(value);
+		return;
+	}
+	//the window is completely replaced
+	m_head = 0;
+	m_size = m_capacity;
+	m_count += count;
+	fill(m_values.begin(), m_values.end(), value);
+	m_minQ.clear();
+	m_maxQ.clear();
+	if (!IsMissing(value))
+	{
+		m_minQ.push_back(make_pair(m_count - 1, value));
+		m_maxQ.push_back(make_pair(m_count - 1, value));
+	}
+	Rebase();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Appends count missing (no-data) records, e.g. for a gap in the data.
+ */
+void SlidingWindow::PushMissing(size_t count)
+{
+	PushRepeated(m_noData, count);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Removes up to count of the oldest values, shrinking the window.
+ */
+void SlidingWindow::PopOldest(size_t count)
+{
+	count = min(count, m_size);
+	m_head = (m_head + count) % m_capacity;
+	m_size -= count;
+	Expire();
+}
+
+void SlidingWindow::Clear()
+{
+	m_head = 0;
+	m_size = 0;
+	m_minQ.clear();
+	m_maxQ.clear();
+	Prefix(m_count) = 0.0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Changes the window length, keeping the newest values that still fit.
+ */
+void SlidingWindow::SetCapacity(size_t capacity)
+{
+	capacity = max((size_t)1, capacity);
+	if (capacity == m_capacity)
+		return;
+	vector<double> keep = Values();
+	size_t first = keep.size() > capacity ? keep.size() - capacity : 0;
+	m_capacity = capacity;
+	m_values.assign(m_capacity, m_noData);
+	m_prefix.assign(m_capacity + 1, 0.0);
+	m_count = 0;
+	Clear();
+	for (size_t i = first; i < keep.size(); i++)
+		Push(keep[i]);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns the i'th value, 0 being the oldest value in the window.
+ */
+double SlidingWindow::At(size_t i) const
+{
+	if (i >= m_size)
+		return m_noData;
+	return m_values[(m_head + i) % m_capacity];
+}
+
+double SlidingWindow::Newest() const
+{
+	if (m_size == 0)
+		return m_noData;
+	return At(m_size - 1);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns the window contents, oldest first.
+ */
+vector<double> SlidingWindow::Values() const
+{
+	vector<double> ret;
+	ret.reserve(m_size);
+	for (size_t i = 0; i < m_size; i++)
+		ret.push_back(At(i));
+	return ret;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Bytes held by the window, including sizeof(SlidingWindow). The
+    min/max queues are counted at Capacity() entries, their largest size, so
+    this is also the footprint after any number of pushes.
+ */
+size_t SlidingWindow::MemoryFootprint() const
+{
+	typedef std::pair<unsigned long long, double> Entry;
+	return sizeof(SlidingWindow) + VectorHeapBytes(m_values) + VectorHeapBytes(m_prefix)
+		+ 2 * DequeHeapBytes<Entry>(max(m_capacity, max(m_minQ.size(), m_maxQ.size())));
+}
+
+double SlidingWindow::Sum() const
+{
+	return SumLast(m_size);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Sum of the valid values among the newest n entries.
+ */
+double SlidingWindow::SumLast(size_t n) const
+{
+	n = min(n, m_size);
+	if (n == 0)
+		return 0.0;
+	return Prefix(m_count) - Prefix(m_count - n);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Sum() divided by the number of entries in the window, 0 if empty.
+ */
+double SlidingWindow::Mean() const
+{
+	if (m_size == 0)
+		return 0.0;
+	return Sum() / m_size;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Minimum valid value in the window, or the no-data value if none.
+ */
+double SlidingWindow::Min() const
+{
+	if (m_minQ.empty())
+		return m_noData;
+	return m_minQ.front().second;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Maximum valid value in the window, or the no-data value if none.
+ */
+double SlidingWindow::Max() const
+{
+	if (m_maxQ.empty())
+		return m_noData;
+	return m_maxQ.front().second;
+}
+
+void SlidingWindow::Expire()
+{
+	unsigned long long oldest = m_count - m_size;
+	while (!m_minQ.empty() && m_minQ.front().first < oldest)
+		m_minQ.pop_front();
+	while (!m_maxQ.empty() && m_maxQ.front().first < oldest)
+		m_maxQ.pop_front();
+}
+
+void SlidingWindow::Rebase()
+{
+	unsigned long long oldest = m_count - m_size;
+	Prefix(oldest) = 0.0;
+	for (size_t i = 0; i < m_size; i++)
+	{
+		double val = At(i);
+		Prefix(oldest + i + 1) = Prefix(oldest + i) + (IsMissing(val) ? 0.0 : val);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <vector>
+#include "fw21.h"
+#include "utctime.h"
+
+//Decoder of legacy FW13 fire weather files (fixed-width 'W13' and 'W98'
+//records). It produces the FW21Records FireWxConverter writes to FW21 files,
+//and CFW21Data::OpenStream() reads .fw13 files through it directly, without
+//an intermediate FW21 file.
+
+//------------------------------------------------------------------------------
+/*! \struct FW13StationRecords FW13Decoder.h
+    \brief The records of one station of a FW13 file, in file order.
+ */
+struct FW13StationRecords
+{
+	std::string station;
+	std::vector<FW21Record> records;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CFW13Decoder FW13Decoder.h
+    \brief Decodes the RAWS and NFDRS observation records of one FW13 file
+    into FW21Records, grouped by station in order of first appearance.
+
+    The file is read with a single read and decoded from memory: the text
+    encoding and the precipitation code are found by scanning the buffer,
+    not by reopening the file, and fixed-width columns are parsed in place.
+    Error and warning lines are kept in GetMessages() instead of being
+    printed, so files decoded on several threads can be reported in order.
+ */
+class CFW13Decoder
+{
+public:
+	CFW13Decoder();
+
+	static bool IsFW13File(const char* fileName);//by its .fw13 extension
+	int DecodeFile(const std::string& fileName);
+	void DecodeBuffer(const char* data, size_t size);
+
+	std::vector<FW13StationRecords>& GetStations() { return m_stations; }
+	size_t GetNumRecords() const { return m_numRecords; }
+	const std::string& GetMessages() const { return m_messages; }
+	int GetErrors() const { return m_errors; }
+	size_t GetBytesRead() const { return m_bytesRead; }
+
+private:
+	void DecodeLine(const char* line, size_t len);
+	void Report(const char* format, ...);
+	FW13StationRecords& GetStation(const std::string& station);
+
+	std::vector<FW13StationRecords> m_stations;
+	std::string m_messages;
+	int m_errors;
+	size_t m_numRecords;
+	size_t m_bytesRead;
+	long m_lineNo;
+	int m_prevPcpCode;
+	//for hourly precip tracking...
+	utctime::UTCTime m_lastTime;
+	time_t m_hoursDiff;
+	std::deque<double> m_prev23;
+};
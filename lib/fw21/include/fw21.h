@@ -1,7 +1,10 @@
 #pragma once
+#include <cstdio>
 #include <string>
+#include <string_view>
 #include <time64.h>
 #include <vector>
+#include "fw21store.h"
 
 const int iNODATA = -999;
 const double dNODATA = -999.0;
@@ -11,6 +14,7 @@ class FW21Record
 public:
 	FW21Record();
 	FW21Record(const FW21Record& rhs);
+	FW21Record& operator=(const FW21Record& rhs) = default;
 	~FW21Record();
 
 	//accessors
@@ -118,6 +122,11 @@ private:
 	double m_pcp24;
 };
 
+struct FW21StreamState;
+struct FW21ParseChunk;
+class CFW21StationIndex;
+class CFW21RowSplitter;
+
 class CFW21Data
 {
 public:
@@ -136,17 +145,46 @@ public:
 	static std::string GetFieldName(FW21FIELDS fieldNum);
 
 	int LoadFile(const char *fw21FileName, std::string station, int tzOffsetHours = 0, bool needMxFields = false);
+	//streaming access, records are read one at a time instead of being loaded
+	//.fw21b (see CFW21BinaryFile) and .fw13 (see CFW13Decoder) files are read too
+	int OpenStream(const char* fw21FileName, std::string station, int tzOffsetHours = 0, bool needMxFields = false);
+	bool ReadRecord(FW21Record& rec);
+	size_t ReadRecords(std::vector<FW21Record>& recs, size_t maxRecs);
+	bool IsStreamOpen() { return m_pStream != NULL; }
+	void CloseStream();
+	//single lines of any station, as they arrive
+	int OpenLineParser(const std::string& header, int tzOffsetHours = 0, bool needMxFields = false, std::string* messages = NULL);
+	bool ParseLine(const std::string& line, FW21Record& rec, std::string* messages = NULL);
+	void SetTimeZoneOffset(int tzOffsetHours) { m_timeZoneOffset = tzOffsetHours; }//for Zulu times parsed after this call
+	//optional index of a multi station file, must outlive the loads that use it
+	void SetStationIndex(const CFW21StationIndex* index) { m_pStationIndex = index; }
+	//threads parsing csv files opened after this call, 0 for one per core
+	void SetNumThreads(int numThreads);
 	FW21Record GetRec(size_t recNum);//zero based! valid: 0->GetNumRecs() - 1
 	NFDRSDailyRec GetNFDRSDailyRec(size_t recNum);//zero based! valid: 0->GetNumRecs() - 1
-	size_t GetNumRecs() { return m_recs.size(); }
+	size_t GetNumRecs() { return m_records.GetNumRecs(); }
+	size_t GetRecordsMemoryUsage() { return m_records.GetMemoryUsage(); }//bytes, see CFW21RecordStore
 	bool TimeIsZulu() {return m_bTimeIsZulu; }
 	TM ParseISO8061(const std::string input, int *tzOffset);
 	std::string DateToOriginal(TM inTm, int tzOffset);
 	int AddRecord(FW21Record rec);
 	int WriteFile(const char* fw21FileName, int offsetHours);
 private:
+	int OpenBinaryStream(std::string station, bool needMxFields);
+	int OpenFW13Stream(std::string station, bool needMxFields);
+	int ParseHeader(FW21StreamState* s, std::string line, bool needMxFields, std::string* messages);
+	bool ParseISO8061Fixed(const char* input, size_t len, TM* outTime, int* tzOffset);
+	TM BuildISO8061Time(int y, int M, int d, int h, int m, int s, bool isZulu);
+	bool ParseRecordLine(const FW21StreamState* s, std::string_view line, int lineNo, CFW21RowSplitter& splitter,
+		FW21Record& thisRec, int* dateZulu, std::string* messages);
+	void ParseChunk(const FW21StreamState* s, FW21ParseChunk* chunk);
+	bool ParseNextBlock(FW21StreamState* s);
+
 	std::string m_fileName;
-	std::vector< FW21Record> m_recs;
+	CFW21RecordStore m_records;//loaded records, compact
+	FW21StreamState* m_pStream;//open stream, see OpenStream()
+	const CFW21StationIndex* m_pStationIndex;
+	int m_numThreads;
 	bool m_bTimeIsZulu;
 	int m_timeZoneOffset;
 	//ensure field names match FW21FIELDS enum values if any additions made
@@ -159,3 +197,23 @@ private:
 
 };
 
+//------------------------------------------------------------------------------
+/*! \class CFW21Writer fw21.h
+    \brief Writes FW21 records one at a time, as CFW21Data::WriteFile() does,
+    so a file can be written while its records are still being produced.
+ */
+class CFW21Writer
+{
+public:
+	CFW21Writer();
+	~CFW21Writer();
+
+	int Open(const char* fw21FileName, bool append = false);//header written unless appending
+	bool WriteRecord(FW21Record& rec, int offsetHours);
+	bool Close();
+	bool IsOpen() { return m_file != NULL; }
+private:
+	FILE* m_file;
+	std::vector<char> m_buffer;
+};
+
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "fw21.h"
+
+//Binary columnar companion of a FW21 csv file (.fw21b). It holds the records
+//CFW21Data::LoadFile() accepts for every station, already converted and
+//validated, so repeated runs map the file instead of parsing the csv.
+//
+//Layout (host byte order, every section 8 byte aligned):
+//  FW21BinaryHeader
+//  FW21BinaryStation[numStations]  rows of each station are contiguous
+//  station names
+//  FW21BinaryColumn[numColumns]    FW21B_COLUMNS order
+//  column data, numRecs values each
+//Number columns are stored as integers of 1, 2 or 4 bytes scaled by a power
+//of ten when that gives back exactly the same double for every record,
+//otherwise as doubles. Times are seconds (or hours when all records are on
+//the hour) since 1970 of the record's local time. Since records are selected
+//and Zulu times converted when the file is written, it must be loaded with
+//the same UTC offset and needMxFields it was written with.
+
+const char FW21B_MAGIC[8] = { 'F', 'W', '2', '1', 'B', 'I', 'N', '\0' };
+const uint32_t FW21B_VERSION = 1;
+const uint32_t FW21B_BYTEORDER = 0x01020304;
+
+enum FW21B_FLAGS { FW21B_HAS_STATIONID = 1, FW21B_NEED_MX = 2, FW21B_TIME_IN_HOURS = 4 };
+
+//columns in file order, the moisture columns are only present with FW21B_NEED_MX
+enum FW21B_COLUMNS {
+	FW21B_TIME, FW21B_TZOFFSET, FW21B_TEMPF, FW21B_RH, FW21B_PCPIN, FW21B_WSMPH, FW21B_WAZI,
+	FW21B_SOLRAD, FW21B_SNOWFLAG, FW21B_GSMPH, FW21B_GAZI,
+	FW21B_DFM1, FW21B_DFM10, FW21B_DFM100, FW21B_DFM1000, FW21B_LFMHERB, FW21B_LFMWOOD,
+	FW21B_FUELTEMPC, FW21B_GSI, FW21B_KBDI, FW21B_NUM_COLUMNS
+};
+const int FW21B_NUM_WX_COLUMNS = FW21B_DFM1;
+
+enum FW21B_COLUMN_KIND { FW21B_INTEGER = 0, FW21B_DOUBLE = 1 };
+
+struct FW21BinaryHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t numRecs;
+	uint32_t numStations;
+	int32_t tzOffsetHours;//offset applied to Zulu times when written
+	uint32_t flags;//FW21B_FLAGS
+	uint32_t numColumns;
+	uint64_t stationsOffset;
+	uint64_t namesOffset;
+	uint64_t columnsOffset;
+	uint64_t fileSize;
+};
+
+struct FW21BinaryStation
+{
+	uint64_t firstRow;
+	uint64_t numRows;
+	uint32_t nameOffset;//from namesOffset
+	uint32_t nameLength;
+	uint32_t timeIsZulu;
+	uint32_t reserved;
+};
+
+struct FW21BinaryColumn
+{
+	uint32_t column;//FW21B_COLUMNS
+	uint8_t kind;//FW21B_COLUMN_KIND
+	uint8_t width;//bytes per value
+	uint8_t scale;//integers: value = stored / 10^scale
+	uint8_t reserved;
+	uint64_t offset;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CFW21BinaryFile fw21binary.h
+    \brief Writes .fw21b files and reads them through a read only memory map.
+ */
+class CFW21BinaryFile
+{
+public:
+	CFW21BinaryFile();
+	~CFW21BinaryFile();
+
+	static bool IsBinaryFile(const char* fileName);
+	static int Write(const char* fw21FileName, const char* fw21bFileName, int tzOffsetHours = 0, bool needMxFields = false);
+
+	int Open(const char* fw21bFileName);
+	void Close();
+	bool IsOpen() const { return m_data != NULL; }
+
+	const FW21BinaryHeader* GetHeader() const { return m_header; }
+	size_t GetNumStations() const { return m_header ? m_header->numStations : 0; }
+	std::string GetStation(size_t s) const;
+	int FindStation(const std::string& station) const;
+	const FW21BinaryStation* GetStationEntry(size_t s) const { return &m_stations[s]; }
+	void GetRecord(uint64_t row, FW21Record& rec) const;
+
+private:
+	int64_t GetInteger(int column, uint64_t row) const;
+	double GetValue(int column, uint64_t row) const;
+
+	const unsigned char* m_data;
+	size_t m_size;
+	const FW21BinaryHeader* m_header;
+	const FW21BinaryStation* m_stations;
+	const char* m_names;
+	const FW21BinaryColumn* m_columns;
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#endif
+};
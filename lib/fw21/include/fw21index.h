@@ -0,0 +1,57 @@
+#pragma once
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------------
+/*! \struct FW21StationRange
+    \brief A run of consecutive lines of one station in a FW21 file.
+ */
+struct FW21StationRange
+{
+	unsigned long long offset;//file offset of the first line
+	int firstLineNo;//line number reported for the first line
+	int numLines;
+	unsigned long long firstLineHash;//FNV-1a hash of the first line, checked by CFW21StationIndex::Load()
+};
+
+//------------------------------------------------------------------------------
+/*! \class CFW21StationIndex fw21index.h
+    \brief Station -> line ranges index of a multi station FW21 file.
+
+    Built with one pass over the file, so loading many stations from one file
+    (see CFW21Data::SetStationIndex()) reads each line once instead of scanning
+    the whole file for every station. The index can be saved beside the file
+    and reloaded; Load() rejects an index whose file size or modification
+    time does not match, or when the first line of any range has changed.
+    Lines with fewer fields than the header are not records of any station;
+    they stay with the station before them, which reports them when loaded.
+ */
+class CFW21StationIndex
+{
+public:
+	CFW21StationIndex();
+	~CFW21StationIndex();
+
+	int Build(const char* fw21FileName);
+	int Save(const char* indexFileName);
+	int Load(const char* indexFileName, const char* fw21FileName);
+	void Clear();
+
+	size_t GetNumStations() const { return m_stations.size(); }
+	const std::string& GetStation(size_t s) const { return m_stations[s]; }//in order of first appearance
+	const std::vector<FW21StationRange>* GetRanges(const std::string& station) const;
+	int GetNumLines(const std::string& station) const;
+
+private:
+	static bool GetFileSize(const char* fileName, unsigned long long* fileSize);
+	static bool GetFileTime(const char* fileName, long long* modTime);
+	static unsigned long long HashLine(std::string_view line);
+	bool CheckRanges(const char* fw21FileName) const;
+
+	unsigned long long m_fileSize;
+	long long m_fileTime;//modification time, seconds since 1970
+	std::vector<std::string> m_stations;
+	std::map<std::string, std::vector<FW21StationRange> > m_ranges;
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Low level helpers for reading FW21 (csv) files without per line allocations.
+//They reproduce the behavior of getline(), csv_read_row(), trim(), atof() and
+//atoi() as used by CFW21Data::LoadFile, so parsing results and validation
+//messages are unchanged.
+
+//------------------------------------------------------------------------------
+/*! \class CFW21LineReader fw21parser.h
+    \brief Reads a file through a large buffer and returns its lines as views
+    into the buffer, valid until the next call to NextLine().
+
+    Lines are split on '\n' only (a '\r' is left to the tokenizer, as with
+    getline). A file that ends with '\n' yields a final empty line, matching a
+    getline() loop driven by stream.good().
+ */
+class CFW21LineReader
+{
+public:
+	CFW21LineReader(size_t bufferSize = 4 * 1024 * 1024);
+	~CFW21LineReader();
+
+	bool Open(const char* fileName);
+	void Close();
+	bool IsOpen() const { return m_file != NULL; }
+	bool NextLine(std::string_view& line);
+	bool ReadBlock(std::vector<char>& block, size_t maxBytes, bool* isLast);
+	bool Seek(unsigned long long offset);
+	unsigned long long GetLineOffset() const { return m_lineOffset; }//file offset of the last line returned
+
+private:
+	bool Fill();
+
+	FILE* m_file;
+	std::vector<char> m_buf;
+	size_t m_pos;
+	size_t m_end;
+	unsigned long long m_bufOffset;//file offset of m_buf[0]
+	unsigned long long m_lineOffset;
+	bool m_eof;
+	bool m_done;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CFW21RowSplitter fw21parser.h
+    \brief Splits a csv line into fields in place. Lines containing quotes are
+    passed to csv_read_row() so quoting rules stay identical.
+ */
+class CFW21RowSplitter
+{
+public:
+	const std::vector<std::string_view>& Split(std::string_view line, char delimiter = ',');
+
+private:
+	std::vector<std::string_view> m_fields;
+	std::vector<std::string> m_quoted;//storage for fields of quoted lines
+	std::string m_line;
+};
+
+std::string_view FW21TrimView(std::string_view s);
+double FW21ToDouble(std::string_view s);
+int FW21ToInt(std::string_view s);
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <time64.h>
+
+class FW21Record;
+
+//------------------------------------------------------------------------------
+/*! \class CFW21Column fw21store.h
+    \brief A column of numbers kept as 16 or 32 bit integers scaled by a power
+    of ten while every value gives back exactly the same double, and as
+    doubles once one does not. FW21 values have few decimals, so most columns
+    stay 2 or 4 bytes per value.
+ */
+class CFW21Column
+{
+public:
+	CFW21Column();
+
+	void Clear();
+	void Push(double value);
+	double Get(size_t i) const;
+	size_t GetNumValues() const { return m_numValues; }
+	int GetWidth() const { return m_width; }//bytes per value
+	size_t GetMemoryUsage() const;
+
+private:
+	bool Encode(double value, int scale, int64_t* stored) const;
+	void Convert(int width, int scale);
+
+	std::vector<int16_t> m_int16;
+	std::vector<int32_t> m_int32;
+	std::vector<double> m_double;
+	int m_width;
+	int m_scale;
+	int64_t m_maxAbs;//largest stored integer magnitude
+	size_t m_numValues;
+};
+
+//------------------------------------------------------------------------------
+/*! \class CFW21RecordStore fw21store.h
+    \brief Compact in memory storage of the records of a CFW21Data.
+
+    Station IDs are interned and kept as runs of rows, times as hours since
+    1970 of the record's local time, values in CFW21Column's. The moisture,
+    GSI and KBDI fields (see CFW21Data::LoadFile() needMxFields) are only
+    stored once a record has one of them. Records come back identical to the
+    ones added, except that the date's tm_wday and tm_yday are recomputed and
+    tm_isdst is 0.
+ */
+class CFW21RecordStore
+{
+public:
+	CFW21RecordStore();
+
+	void Clear();
+	void Add(FW21Record& rec);
+	void Get(size_t row, FW21Record& rec) const;
+	size_t GetNumRecs() const { return m_temp.GetNumValues(); }
+	size_t GetNumStations() const { return m_stations.size(); }
+	const std::string& GetStation(size_t row) const;
+	size_t GetMemoryUsage() const;
+
+private:
+	enum MX_COLUMNS { MX_DFM1, MX_DFM10, MX_DFM100, MX_DFM1000, MX_LFMHERB, MX_LFMWOOD, MX_FUELTEMPC, MX_GSI, MX_KBDI, MX_END };
+
+	std::vector<std::string> m_stations;
+	std::map<std::string, uint32_t> m_stationIds;
+	std::vector<std::pair<size_t, uint32_t> > m_stationRuns;//first row, station
+	CFW21Column m_time;//hours
+	std::map<size_t, TM> m_otherTimes;//times that do not convert back exactly
+	CFW21Column m_tzOffset;
+	CFW21Column m_temp;
+	CFW21Column m_RH;
+	CFW21Column m_pcp;
+	CFW21Column m_windSpeed;
+	CFW21Column m_windAzimuth;
+	CFW21Column m_solarRadiation;
+	CFW21Column m_snowFlag;
+	CFW21Column m_gustSpeed;
+	CFW21Column m_gustAzimuth;
+	bool m_hasMx;
+	CFW21Column m_mx[MX_END];
+};
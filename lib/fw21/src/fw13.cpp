@@ -0,0 +1,512 @@
+#include "fw13.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+using namespace std;
+using namespace utctime;
+
+static const char* errStrings[] =
+{
+	"Blank station id",
+	"Invalid date",
+	"Unrecognized Region ID",
+	"Unrecognized Unit ID",
+	"Unrecognized Unit ID (District)",
+	"Invalid Hour in RAWS record",
+	"Invalid Minutes in RAWS record.",
+	"-9999 found in record",
+	"Change in Precipitation Measurement code mid stream",
+	"Invalid or missing Precipitation Measurement Code",
+	"Solar radiation out of range",
+	"Missing solar radiation",
+	"Bad Gust Speed or Gust Azimuth"
+};
+
+//FW13 records are 75 columns; UTF-16 files hold one record per 152 bytes
+static const size_t FW13_COLUMNS = 75;
+static const size_t FW13_UTF16_RECORD = 152;
+
+//RH conversion utility routines
+static double satvap(double t)
+
+{//return saturationvapor pressure, baset on temperature t(degrees K)
+	if (t != 35.86)
+		return exp(1.81 + (t * 17.27 - 4717.31) / (t - 35.86));
+	else
+		return 0.0;
+}
+
+static double fTok(double f)
+{
+	//convert fahrenheit to kelvin
+	return (f - 32.0) / 1.8 + 273.16;
+}
+
+
+static int rhFromWb(double td, double tw, double pp)
+{
+	double corr = (0.00066 * (1.0 + (0.00115 * (tw - 273.16))) * pp * (td - tw));
+	double val = max(1.0, min(100.0, ((satvap(tw) - corr) / satvap(td)) * 100.0));
+	double rem = val - floor(val);
+	int ret = (int)floor(val);
+	return ret + ((rem >= 0.5) ? 1 : 0);
+}
+
+static int rhFromDp(double dry, double dew)
+{
+	double val = 100.0 * (exp(-7482.6 / (dew + 398.36) + 15.674)
+		/ exp(-7482.6 / (dry + 398.36) + 15.674));
+	double rem = val - floor(val);
+	int ret = (int)floor(val);
+	return ret + ((rem >= 0.5) ? 1 : 0);
+}
+
+static int RH(int RHType, int in, int db)
+{
+	int ret;
+	switch (RHType)
+	{
+	case 1://wet bulb
+		ret = rhFromWb(fTok(db), fTok((double)in), 900.0);//station press not corrected for elevation
+		break;
+	case 3:
+		ret = rhFromDp((double)db, (double)in);
+		break;
+	default:
+		ret = in;
+	}
+	return ret;
+}
+
+//------------------------------------------------------------------------------
+/*! \class CFW13Line
+    \brief Fixed-width columns of one record, read in place. Columns past the
+    end of the record read as NUL, as the C string copies they replace did.
+ */
+class CFW13Line
+{
+public:
+	CFW13Line(const char* line, size_t len) : m_line(line), m_len(len) {}
+
+	char At(size_t col) const { return col < m_len ? m_line[col] : 0; }
+	//true if all len columns are spaces
+	bool IsBlank(size_t col, size_t len) const
+	{
+		for (size_t i = 0; i < len; i++)
+			if (At(col + i) != ' ')
+				return false;
+		return true;
+	}
+	//atoi() of the columns: leading spaces, a sign and digits, 0 if none
+	int Int(size_t col, size_t len, bool* hasDigits = NULL) const
+	{
+		size_t i = 0;
+		while (i < len && isspace((unsigned char)At(col + i)))
+			i++;
+		bool negative = false;
+		if (i < len && (At(col + i) == '-' || At(col + i) == '+'))
+			negative = At(col + i++) == '-';
+		int value = 0;
+		size_t first = i;
+		for (; i < len && isdigit((unsigned char)At(col + i)); i++)
+			value = value * 10 + (At(col + i) - '0');
+		if (hasDigits)
+			*hasDigits = i > first;
+		return negative ? -value : value;
+	}
+	//atof() of the columns, without exponents
+	double Number(size_t col, size_t len) const
+	{
+		size_t i = 0;
+		while (i < len && isspace((unsigned char)At(col + i)))
+			i++;
+		bool negative = false;
+		if (i < len && (At(col + i) == '-' || At(col + i) == '+'))
+			negative = At(col + i++) == '-';
+		double value = 0.0;
+		for (; i < len && isdigit((unsigned char)At(col + i)); i++)
+			value = value * 10.0 + (At(col + i) - '0');
+		if (i < len && At(col + i) == '.')
+		{
+			double scale = 1.0;
+			for (i++; i < len && isdigit((unsigned char)At(col + i)); i++)
+			{
+				value = value * 10.0 + (At(col + i) - '0');
+				scale *= 10.0;
+			}
+			value /= scale;
+		}
+		return negative ? -value : value;
+	}
+	//the columns without surrounding white space
+	string Trimmed(size_t col, size_t len) const
+	{
+		size_t end = col;
+		while (end < col + len && At(end) != 0)
+			end++;
+		while (col < end && isspace((unsigned char)At(col)))
+			col++;
+		while (end > col && isspace((unsigned char)At(end - 1)))
+			end--;
+		return string(m_line + min(col, m_len), end - col);
+	}
+	bool Contains(const char* text) const
+	{
+		size_t n = strlen(text);
+		return search(m_line, m_line + m_len, text, text + n) != m_line + m_len;
+	}
+
+private:
+	const char* m_line;
+	size_t m_len;
+};
+
+CFW13Decoder::CFW13Decoder()
+{
+	m_errors = 0;
+	m_numRecords = 0;
+	m_bytesRead = 0;
+	m_lineNo = 0;
+	m_prevPcpCode = -1;
+	m_hoursDiff = utctime::get_hour_diff();
+	for (int i = 0; i < 23; i++)
+		m_prev23.push_back(0.0);
+}
+
+bool CFW13Decoder::IsFW13File(const char* fileName)
+{
+	size_t len = strlen(fileName);
+	if (len < 5 || fileName[len - 5] != '.')
+		return false;
+	string ext;
+	for (size_t i = len - 4; i < len; i++)
+		ext += (char)tolower((unsigned char)fileName[i]);
+	return ext == "fw13";
+}
+
+void CFW13Decoder::Report(const char* format, ...)
+{
+	char buf[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	m_messages += buf;
+}
+
+FW13StationRecords& CFW13Decoder::GetStation(const string& station)
+{
+	//files hold one or a few stations, the newest is the likely one
+	for (size_t s = m_stations.size(); s > 0; s--)
+	{
+		if (m_stations[s - 1].station == station)
+			return m_stations[s - 1];
+	}
+	m_stations.push_back(FW13StationRecords());
+	m_stations.back().station = station;
+	return m_stations.back();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads and decodes a FW13 file.
+    \param[in] fileName FW13 file.
+    \return 1 on success, -1 if the file cannot be read.
+ */
+int CFW13Decoder::DecodeFile(const string& fileName)
+{
+	ifstream in(fileName, ios_base::in | ios_base::binary);
+	if (!in.is_open())
+		return -1;
+	in.seekg(0, in.end);
+	streamoff size = in.tellg();
+	in.seekg(0, in.beg);
+	vector<char> data(size > 0 ? (size_t)size : 0);
+	if (size > 0 && !in.read(&data[0], size))
+		return -1;
+	DecodeBuffer(data.empty() ? NULL : &data[0], data.size());
+	return 1;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Decodes the contents of a FW13 file.
+
+    ASCII/UTF-8 records are lines; a file whose first 16 bit unit is at most
+    256 is read as UTF-16, 152 bytes per record. The last line is decoded even
+    without a newline.
+    \param[in] data File contents.
+    \param[in] size Bytes in data.
+ */
+void CFW13Decoder::DecodeBuffer(const char* data, size_t size)
+{
+	m_bytesRead += size;
+	vector<pair<const char*, size_t> > lines;
+	string utf16Text;
+	unsigned int firstUnit = size >= 2 ? (unsigned char)data[0] | ((unsigned char)data[1] << 8) : 0xFFFF;
+	if (firstUnit <= 256)
+	{
+		// UTF-16
+		size_t numRecords = size / FW13_UTF16_RECORD;
+		utf16Text.resize(numRecords * FW13_COLUMNS);
+		for (size_t r = 0; r < numRecords; r++)
+		{
+			const char* rec = data + r * FW13_UTF16_RECORD;
+			for (size_t i = 0; i < FW13_COLUMNS; i++)
+				utf16Text[r * FW13_COLUMNS + i] = rec[(i + 2) * 2];
+		}
+		for (size_t r = 0; r < numRecords; r++)
+			lines.push_back(make_pair(utf16Text.data() + r * FW13_COLUMNS, FW13_COLUMNS));
+	}
+	else
+	{   // Ascii / UTF-8
+		const char* end = data + size;
+		for (const char* p = data; p < end; )
+		{
+			const char* eol = (const char*)memchr(p, '\n', end - p);
+			if (!eol)
+				eol = end;
+			lines.push_back(make_pair(p, (size_t)(eol - p)));
+			p = eol + 1;
+		}
+	}
+	for (size_t l = 0; l < lines.size(); l++)
+	{
+		//records are C strings, anything after a NUL is ignored
+		const char* nul = (const char*)memchr(lines[l].first, 0, lines[l].second);
+		if (nul)
+			lines[l].second = nul - lines[l].first;
+	}
+
+	//need to know precipitation code
+	int pcpCode = -1;
+	for (size_t l = 0; l < lines.size() && pcpCode < 0; l++)
+	{
+		CFW13Line line(lines[l].first, lines[l].second);
+		if (lines[l].second > 63 && line.At(0) == 'W')
+		{
+			//1 = running 24 inches, 2 = running 24 mm, 3 = hourly inches, 4 = hourly mm
+			pcpCode = line.Int(62, 1);
+			if (pcpCode < 1 || pcpCode > 4)
+				pcpCode = -1;
+		}
+	}
+	if (pcpCode > 0)
+		m_prevPcpCode = pcpCode;
+	else
+	{
+		Report("\tError: Can not determine precipitation code (column 63)\n");
+		m_errors++;
+	}
+	for (size_t l = 0; l < lines.size(); l++)
+		DecodeLine(lines[l].first, lines[l].second);
+}
+
+void CFW13Decoder::DecodeLine(const char* text, size_t len)
+{
+	CFW13Line buf(text, len);
+	m_lineNo++;
+	//check buffer for NODATA since IBM can't understand fixed width fields....
+	//NODATA is -9999 slammed anywhere into the record
+	if (buf.Contains("-9999"))
+	{
+		Report("\tError: Line Number %ld, %s\n", m_lineNo, errStrings[7]);
+		m_errors++;
+		return;
+	}
+	//check record type, FW13 or FW9
+	if (buf.At(0) != 'W' || !((buf.At(1) == '1' && buf.At(2) == '3') || (buf.At(1) == '9' && buf.At(2) == '8')))
+		return;
+	//RAWS or NFDRS observations only
+	if (buf.At(21) != 'R' && buf.At(21) != 'O')
+		return;
+	string sta = buf.Trimmed(3, 6);
+	if (sta.length() == 0)//stationID can not be blank!!!!!!
+	{
+		Report("\tError: Line Number %ld, %s\n", m_lineNo, errStrings[0]);
+		m_errors++;
+		return;
+	}
+	int y = buf.Int(9, 4);
+	int m = buf.Int(13, 2);
+	int d = buf.Int(15, 2);
+	bool validDate;
+	try
+	{
+		UTCTime y2kCheck(y, m, d, 0, 0, 0);
+		validDate = y2kCheck.timestamp() != 0 && y >= 1900;
+	}
+	catch (const UTCTimeException&)
+	{
+		validDate = false;
+	}
+	if (!validDate)
+	{
+		Report("\tError: Line Number %ld, %s: %d/%d/%d\n", m_lineNo, errStrings[1], m, d, y);
+		m_errors++;
+		return;
+	}
+	FW13StationRecords& station = GetStation(sta);
+
+	int hr = buf.Int(17, 2);
+	if (hr >= 24 || hr < 0)
+	{
+		Report("\tError: Line Number %ld, %s : %d\n", m_lineNo, errStrings[5], hr);
+		m_errors++;
+		return;
+	}
+
+	int mn = buf.Int(19, 2);
+	if (mn > 60 || mn < 0)
+	{
+		Report("\tError: Line Number %ld, %s : %d\n", m_lineNo, errStrings[6], mn);
+		m_errors++;
+		return;
+	}
+
+	UTCTime thisTime(y, m, d, hr, mn, 0);
+	FW21Record rec;
+	rec.SetStation(sta);
+	rec.SetDateTime(thisTime.get_tm());
+	int db;
+	if (!buf.IsBlank(23, 3))
+	{
+		db = buf.Int(23, 3);
+		rec.SetTemp(db);
+	}
+	else
+	{
+		Report("\tError: Line Number %ld, temperature is blank\n", m_lineNo);
+		m_errors++;
+		return;
+	}
+	if (!buf.IsBlank(26, 3))
+	{
+		rec.SetRH(max(1, RH(buf.Int(61, 1), buf.Int(26, 3), db)));
+	}
+	else
+	{
+		Report("\tError: Line Number %ld, RH is invalid\n", m_lineNo);
+		m_errors++;
+		return;
+	}
+
+	//****************WIND SPEED AND DIRECTION *****************
+	int tdir = -1, tws = -1;
+	if (!buf.IsBlank(29, 3))
+		tdir = buf.Int(29, 3);
+	if (!buf.IsBlank(32, 3))
+		tws = buf.Int(32, 3);
+	if (tws >= 0 && tdir >= 0 && tdir <= 360)
+	{
+		rec.SetWindAzimuth(tdir);
+		rec.SetWindSpeed(tws);
+	}
+	//NEED TO CHECK PRECIP MEASUREMENT TYPE CODE
+	//1 = running 24 inches, 2 = running 24 mm, 3 = hourly inches, 4 = hourly mm
+	int pcpCode = buf.Int(62, 1);
+	if (m_prevPcpCode <= 0)
+		m_prevPcpCode = pcpCode;
+	if (m_prevPcpCode != pcpCode)
+	{
+		//this is an error that never should happen
+		Report("\tError: Line Number %ld, %s : %d\n", m_lineNo, errStrings[8], pcpCode);
+		m_errors++;
+		return;
+	}
+	double pcpValue = buf.Number(51, 5);
+	double thisPcp24 = -1.0, thisPcp = -1.0;
+	switch (pcpCode)
+	{
+	case 1:
+		thisPcp24 = pcpValue / 1000.0;//inches have implied decimal point
+		break;
+	case 2:
+		thisPcp24 = pcpValue * 0.03937007874; //millimeter to inch
+		break;
+	case 3:
+		thisPcp = pcpValue / 1000.0;//inches have implied decimal point
+		break;
+	case 4:
+		thisPcp = pcpValue * 0.03937007874; //millimeter to inch
+		break;
+	default:
+		Report("\tError: Line Number %ld, %s : %d\n", m_lineNo, errStrings[9], pcpCode);
+		m_errors++;
+		return;
+	}
+	//now deal with precip
+	double hours = (thisTime - m_lastTime) / m_hoursDiff;
+	for (int t = 1; t < hours && m_prev23.size() > 0; t++)
+		m_prev23.pop_front();
+	if (m_numRecords > 0)
+	{
+		if (thisPcp < 0.0)
+		{
+			double sum23 = std::accumulate(m_prev23.begin(), m_prev23.end(), 0.0);
+			thisPcp = thisPcp24 - sum23;
+			if (thisPcp < 0.0)
+				thisPcp = 0.0;
+		}
+	}
+	else
+	{
+		if (thisPcp < 0.0)
+		{
+			thisPcp = thisPcp24;
+		}
+	}
+	rec.SetPrecip(thisPcp);
+	m_prev23.push_back(thisPcp);
+	while (m_prev23.size() > 23)
+		m_prev23.pop_front();
+
+	bool hasSolar;
+	int tSolRad = buf.Int(64, 4, &hasSolar);
+	if (hasSolar)
+	{
+		if (tSolRad < 1400 && tSolRad >= 0)
+			rec.SetSolarRadiation(tSolRad);
+		else
+		{
+			Report("\tError: Line Number %ld, %s : %d\n", m_lineNo, errStrings[10], tSolRad);
+			return;
+		}
+	}
+	else
+	{
+		Report("\tError: Line Number %ld, %s\n", m_lineNo, errStrings[11]);
+		return;
+	}
+
+	//****************GUST SPEED AND DIRECTION *****************
+	// 11/2012 added for FFP4.1
+	int tgdir = -1, tgws = -1;
+	if (!buf.IsBlank(68, 3))
+		tgdir = buf.Int(68, 3);
+	if (!buf.IsBlank(71, 3))
+		tgws = buf.Int(71, 3);
+	if (tgws >= 0 && tgdir >= 0 && tgdir <= 360)
+	{
+		if (tgdir == 360)
+			tgdir = 0;
+		rec.SetGustAzimuth(tgdir);
+		rec.SetGustSpeed(tgws);
+	}
+	else
+	{
+		Report("\tWarning: Line Number %ld, %s\n", m_lineNo, errStrings[12]);
+	}
+
+	// snow flag, 11/2012 added for FFP4.1
+	char snow = buf.At(74);
+	rec.SetSnowFlag((snow == 'Y' || snow == 'y') ? 1 : 0);
+
+	station.records.push_back(rec);
+	m_numRecords++;
+	m_lastTime = thisTime;
+}
@@ -2,10 +2,17 @@
 #include <fstream>
 #include <vector>
 #include "csv_readrow.h"
+#include "fw21parser.h"
+#include "fw21index.h"
+#include "fw21binary.h"
+#include "fw13.h"
 #include "utctime.h"
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <cstdarg>
+#include <iterator>
+#include <thread>
 
 using namespace std;
 using namespace utctime;
@@ -13,7 +20,6 @@ using namespace utctime;
 
 TM CFW21Data::ParseISO8061(const string input, int* tzOffset)
 {
-	TM thisTime = { 0 };
 	//first, need to know if extended or basic ISO 8061 format, and if Zulu time or time zone offset, also if milliseconds are included(but we'll ignore them...)
 	bool isExtended = false;
 	bool isZulu = false;
@@ -69,46 +75,117 @@ TM CFW21Data::ParseISO8061(const string input, int* tzOffset)
 			*tzOffset = tzh;
 		}
 	}
+	return BuildISO8061Time(y, M, d, h, m, s, isZulu);
+}
+
+//day of the week and day of the year of a valid TM date, as gmtime() sets them
+static void SetWeekAndYearDay(TM* t)
+{
+	static const int daysBeforeMonth[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+	static const int monthOffset[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+	int y = (int)t->tm_year + 1900;
+	t->tm_yday = daysBeforeMonth[t->tm_mon] + t->tm_mday - 1 + ((t->tm_mon > 1 && is_leap_year(y)) ? 1 : 0);
+	if (t->tm_mon < 2)
+		y--;
+	t->tm_wday = (y + y / 4 - y / 100 + y / 400 + monthOffset[t->tm_mon] + t->tm_mday) % 7;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Range checks the parsed ISO 8061 fields and builds the local record
+    time, shared by ParseISO8061() and ParseISO8061Fixed().
+
+    All fields but tm_isdst are set, tm_wday and tm_yday for the local date.
+    Invalid dates come back with the date and time fields at -1, or all 0.
+ */
+TM CFW21Data::BuildISO8061Time(int y, int M, int d, int h, int m, int s, bool isZulu)
+{
+	TM thisTime = {};
 	if (y < 0 || M <= 0 || M > 12 || d <= 0 || d > 31 || h < 0 || h > 23 || m < 0 || m > 59 || s < 0 || s > 59)
 	{
 		thisTime.tm_year = thisTime.tm_mon = thisTime.tm_mday = thisTime.tm_hour = thisTime.tm_min = thisTime.tm_sec = -1;
 		return thisTime;
 	}
-	//now build the tm
+	//same checks UTCTime construction does, without computing a timestamp
+	try
+	{
+		validate_date(y, M, d, h, m, s);
+	}
+	catch (const invalid_date&)
+	{
+		return thisTime;
+	}
+	thisTime.tm_year = y - 1900;
+	thisTime.tm_mon = M - 1;
+	thisTime.tm_mday = d;
+	thisTime.tm_hour = h;
+	thisTime.tm_min = m;
+	thisTime.tm_sec = s;
 	if (isZulu)//convert to local time
+		tm_increment_hour(&thisTime, m_timeZoneOffset);
+	SetWeekAndYearDay(&thisTime);
+	return thisTime;
+}
+
+static inline bool ParseDigits(const char* p, int n, int* val)
+{
+	int v = 0;
+	for (int i = 0; i < n; i++)
 	{
-		try
-		{
-			UTCTime zTime(y, M, d, h, m, s);
-			thisTime = zTime.get_tm();
-			tm_increment_hour(&thisTime, m_timeZoneOffset);
-		}
-		catch (invalid_date e)
-		{
-			//cout << e.what();
-		}
-		catch (bad_time_init e)
-		{
+		unsigned c = (unsigned)(p[i] - '0');
+		if (c > 9)
+			return false;
+		v = v * 10 + (int)c;
+	}
+	*val = v;
+	return true;
+}
 
-		}
+//------------------------------------------------------------------------------
+/*! \brief Fixed format fast path for the usual FW21 date forms,
+    YYYY-MM-DDThh:mm:ss or YYYYMMDDThhmmss followed by Z, +hh, +hh:mm or +hhmm.
+    Gives the same result as ParseISO8061() for these forms.
+    \return false if input is not in one of these forms.
+ */
+bool CFW21Data::ParseISO8061Fixed(const char* input, size_t len, TM* outTime, int* tzOffset)
+{
+	int y, M, d, h, m, s, tzh = 0;
+	size_t p;
+	if (len >= 19 && input[4] == '-')
+	{
+		if (input[7] != '-' || input[10] != 'T' || input[13] != ':' || input[16] != ':')
+			return false;
+		if (!ParseDigits(input, 4, &y) || !ParseDigits(input + 5, 2, &M) || !ParseDigits(input + 8, 2, &d)
+			|| !ParseDigits(input + 11, 2, &h) || !ParseDigits(input + 14, 2, &m) || !ParseDigits(input + 17, 2, &s))
+			return false;
+		p = 19;
+	}
+	else if (len >= 15 && input[8] == 'T')
+	{
+		if (!ParseDigits(input, 4, &y) || !ParseDigits(input + 4, 2, &M) || !ParseDigits(input + 6, 2, &d)
+			|| !ParseDigits(input + 9, 2, &h) || !ParseDigits(input + 11, 2, &m) || !ParseDigits(input + 13, 2, &s))
+			return false;
+		p = 15;
 	}
 	else
+		return false;
+	bool isZulu = false;
+	if (len == p + 1 && input[p] == 'Z')
+		isZulu = true;
+	else if (len >= p + 3 && (input[p] == '+' || input[p] == '-') && ParseDigits(input + p + 1, 2, &tzh))
 	{
-		try
-		{
-			UTCTime lTime(y, M, d, h, m, s);
-			thisTime = lTime.get_tm();
-		}
-		catch (invalid_date e)
-		{
-			//cout << e.what();
-		}
-		catch (bad_time_init e)
-		{
-
-		}
+		size_t rest = len - (p + 3);
+		int tzm;
+		if (!(rest == 0 || (rest == 2 && ParseDigits(input + p + 3, 2, &tzm))
+			|| (rest == 3 && input[p + 3] == ':' && ParseDigits(input + p + 4, 2, &tzm))))
+			return false;
+		if (input[p] == '-')
+			tzh = -tzh;
 	}
-	return thisTime;
+	else
+		return false;
+	*tzOffset = isZulu ? m_timeZoneOffset : tzh;
+	*outTime = BuildISO8061Time(y, M, d, h, m, s, isZulu);
+	return true;
 }
 
 string CFW21Data::DateToOriginal(TM inTm, int tzOffset)
@@ -241,16 +318,21 @@ CFW21Data::CFW21Data()
 	m_fileName = "";
 	m_bTimeIsZulu = false;
 	m_timeZoneOffset = 0;
+	m_pStream = NULL;
+	m_pStationIndex = NULL;
+	m_numThreads = 1;
 }
 
 CFW21Data::CFW21Data(const CFW21Data& rhs)
 {//not implemented!!!!
-
+	m_pStream = NULL;
+	m_pStationIndex = NULL;
+	m_numThreads = 1;
 }
 
 CFW21Data::~CFW21Data()
 {
-
+	CloseStream();
 }
 
 std::string CFW21Data::GetFieldName(FW21FIELDS fieldNum)
@@ -260,427 +342,845 @@ std::string CFW21Data::GetFieldName(FW21FIELDS fieldNum)
 	return "";
 }
 
+//state of an open FW21 stream, see CFW21Data::OpenStream()
+struct FW21StreamState
+{
+	CFW21LineReader reader;
+	CFW21RowSplitter splitter;
+	std::string station;
+	bool anyStation;//lines of every station are read, see OpenLineParser()
+	bool needMxFields;
+	int nExpectedFields;
+	int lineNo;
+	bool firstRec;
+	bool moreLines;
+	int colIdx[CFW21Data::FW21_END];//column of each FW21FIELDS field, -1 if not in the header
+	//with a station index only the station's line ranges are read
+	bool useRanges;
+	std::vector<FW21StationRange> ranges;
+	size_t nextRange;
+	int linesLeft;
+	//.fw21b files are read from their columns
+	CFW21BinaryFile binary;
+	uint64_t nextRow;
+	uint64_t endRow;
+	//.fw13 files are decoded when opened, their records are in batch
+	bool fw13 = false;
+	//with more than one thread csv lines are parsed a block at a time
+	int numThreads;
+	std::vector<char> block;
+	std::vector<FW21Record> batch;
+	size_t batchPos;
+};
+
+//one thread's share of a block, see CFW21Data::ParseNextBlock()
+struct FW21ParseChunk
+{
+	const char* begin;
+	const char* end;
+	int firstLineNo;
+	int numLines;
+	int firstDateZulu;//-1 until a line gets to its date check
+	std::vector<FW21Record> recs;
+	std::string messages;
+};
+
+//bytes of csv each thread parses per block
+static const size_t parseChunkBytes = 4 * 1024 * 1024;
+
+//------------------------------------------------------------------------------
+/*! \brief printf() to stdout, or to messages if not NULL.
+ */
+static void Report(std::string* messages, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	if (!messages)
+		vprintf(format, args);
+	else
+	{
+		char buf[512];
+		va_list args2;
+		va_copy(args2, args);
+		int len = vsnprintf(buf, sizeof(buf), format, args);
+		if (len >= (int)sizeof(buf))
+		{
+			vector<char> longBuf(len + 1);
+			vsnprintf(longBuf.data(), longBuf.size(), format, args2);
+			messages->append(longBuf.data(), len);
+		}
+		else if (len > 0)
+			messages->append(buf, len);
+		va_end(args2);
+	}
+	va_end(args);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns the next line of a stream, following its line ranges if any.
+ */
+static bool NextStreamLine(FW21StreamState* s, string_view& line)
+{
+	if (!s->moreLines)
+		return false;
+	if (s->useRanges)
+	{
+		if (s->linesLeft <= 0)
+		{
+			if (s->nextRange >= s->ranges.size())
+				return false;
+			const FW21StationRange& range = s->ranges[s->nextRange++];
+			if (!s->reader.Seek(range.offset))
+				return false;
+			s->lineNo = range.firstLineNo - 1;
+			s->linesLeft = range.numLines;
+		}
+		s->linesLeft--;
+	}
+	return s->reader.NextLine(line);
+}
+
+void CFW21Data::SetNumThreads(int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = (int)thread::hardware_concurrency();
+	m_numThreads = numThreads > 0 ? numThreads : 1;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Loads every record for station into memory.
+    \return 0 on success, or the OpenStream() error code.
+ */
 int CFW21Data::LoadFile(const char *fw21FileName, std::string station, int tzOffsetHours/* = 0*/, bool needMxFields/* = false*/)
 {
+	int status = OpenStream(fw21FileName, station, tzOffsetHours, needMxFields);
+	if (status != 0)
+		return status;
+	FW21Record thisRec;
+	while (ReadRecord(thisRec))
+		m_records.Add(thisRec);
+	CloseStream();
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Finds the FW21 fields of a csv header line.
+    \param[in] s The stream, its colIdx and nExpectedFields are set.
+    \param[in] line The header line.
+    \param[in] needMxFields Also require the moisture, GSI and KBDI fields.
+    \param[out] messages Errors are appended here, or printed if NULL.
+    \return 0 on success, -2 if required weather fields are missing, -3 if
+    needMxFields and moisture fields are missing.
+ */
+int CFW21Data::ParseHeader(FW21StreamState* s, string line, bool needMxFields, std::string* messages)
+{
+	const char* buf = line.c_str();
+	vector<string> vFields = csv_read_row(line, ',');
+	s->nExpectedFields = vFields.size();
+	//get field Indexes
+	int* col = s->colIdx;
+	for (int f = FW21_STATION; f < FW21_END; f++)
+		col[f] = getColIndex(m_vFieldNames[f], vFields);
+	//basic check for required fields
+	if (col[FW21_DATE] < 0 || (col[FW21_TEMPF] < 0 && col[FW21_TEMPC] < 0) || col[FW21_RH] < 0 || (col[FW21_PCPIN] < 0 && col[FW21_PCPMM] < 0)
+		|| (col[FW21_WSMPH] < 0 && col[FW21_WSKPH] < 0) || col[FW21_WAZI] < 0 || col[FW21_SOLRAD] < 0 || col[FW21_SNOWFLAG] < 0)
+	{
+		//if(col[FW21_STATION] < 0)
+		//	printf("Error, field %s not found in header\n", m_vFieldNames[FW21_STATION].c_str());
+		if (col[FW21_DATE] < 0)
+			Report(messages, "Error, field %s not found in header\n", m_vFieldNames[FW21_DATE].c_str());
+		if (col[FW21_TEMPF] < 0 && col[FW21_TEMPC] < 0)
+			Report(messages, "Error, field %s or %s not found in header\n", m_vFieldNames[FW21_TEMPF].c_str(), m_vFieldNames[FW21_TEMPC].c_str());
+		if (col[FW21_RH] < 0)
+			Report(messages, "Error, field %s not found in header\n", m_vFieldNames[FW21_RH].c_str());
+		if (col[FW21_PCPIN] < 0 && col[FW21_PCPMM] < 0)
+			Report(messages, "Error, field %s or %s not found in header\n", m_vFieldNames[FW21_PCPIN].c_str(), m_vFieldNames[FW21_PCPMM].c_str());
+		if (col[FW21_WSMPH] < 0 && col[FW21_WSKPH] < 0)
+			Report(messages, "Error, field %s or %s not found in header\n", m_vFieldNames[FW21_WSMPH].c_str(), m_vFieldNames[FW21_WSKPH].c_str());
+		if (col[FW21_WAZI] < 0)
+			Report(messages, "Error, field %s not found in header\n", m_vFieldNames[FW21_WAZI].c_str());
+		if (col[FW21_SOLRAD] < 0)
+			Report(messages, "Error, field %s not found in header\n", m_vFieldNames[FW21_SOLRAD].c_str());
+		if (col[FW21_SNOWFLAG] < 0)
+			Report(messages, "Error, field %s not found in header\n", m_vFieldNames[FW21_SNOWFLAG].c_str());
+		Report(messages, "Header line is:\n%s\n", buf);
+		return -2;
+	}
+	if (needMxFields && (col[FW21_DFM1] < 0 || col[FW21_DFM10] < 0 || col[FW21_DFM100] < 0 || col[FW21_DFM1000] < 0 || col[FW21_LFMHERB] < 0
+		|| col[FW21_LFMWOOD] < 0 || col[FW21_FUELTEMPC] < 0 || col[FW21_GSI] < 0))
+	{
+		for (int f = FW21_DFM1; f <= FW21_FUELTEMPC; f++)
+		{
+			if (col[f] < 0)
+				Report(messages, "Error, field %s not found in header\n", m_vFieldNames[f].c_str());
+		}
+		if(col[FW21_GSI] < 0)
+			Report(messages, "Error, field %s not found in header\n", m_vFieldNames[FW21_GSI].c_str());
+		Report(messages, "Header line is:\n%s\n", buf);
+		return -3;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Opens a FW21 file and parses its header so records for station can
+    be read one at a time with ReadRecord(), without loading the file.
+    \param[in] fw21FileName FW21 file name.
+    \param[in] station Station to read, ignored if the file has no StationID column.
+    \param[in] tzOffsetHours Offset applied to Zulu times.
+    \param[in] needMxFields Also require and read the moisture, GSI and KBDI fields.
+    \return 0 on success, -1 if the file cannot be opened, -2 if required
+    weather fields are missing, -3 if needMxFields and moisture fields are missing.
+ */
+int CFW21Data::OpenStream(const char* fw21FileName, std::string station, int tzOffsetHours/* = 0*/, bool needMxFields/* = false*/)
+{
+	CloseStream();
 	m_timeZoneOffset = tzOffsetHours;
 	m_fileName = fw21FileName;
-	ifstream stream;
-	stream.open(m_fileName);
-	if (!stream.is_open())
+	if (CFW21BinaryFile::IsBinaryFile(fw21FileName))
+		return OpenBinaryStream(station, needMxFields);
+	if (CFW13Decoder::IsFW13File(fw21FileName))
+		return OpenFW13Stream(station, needMxFields);
+	FW21StreamState* s = new FW21StreamState;
+	if (!s->reader.Open(m_fileName.c_str()))
 	{
 		printf("Error opening %s as input\n", m_fileName.c_str());
+		delete s;
 		return -1;
 	}
-	char buf[1024];
 	//get the header line which contains FW12 fields
-	int bufSize = 1024;
-	stream.getline(buf, bufSize);
-	string line = buf;
-	vector<string> vFields = csv_read_row(line, ',');
-	int nExpectedFields = vFields.size();
-	//get field Indexes
-	int staIdx, dtIdx, tmpIdx, rhIdx, pcpIdx, wsIdx, wdirIdx, srIdx, snowIdx, gsIdx, gdirIdx, 
-		tmpCIdx, pcpmmIdx, wsKphIdx, gsKphIdx, fm1Idx, fm10Idx, fm100Idx, fm1000Idx, fmHerbIdx, fmWoodIdx,
-		fuelTempIdx, 
-		//minTempFIdx, maxTempFIdx, minRhIdx, pcp24Idx, 
-		biIdx, ercIdx, scIdx, icIdx,
-		gsiIdx, kbdiIdx;
-	staIdx = getColIndex(m_vFieldNames[FW21_STATION], vFields);
-	dtIdx = getColIndex(m_vFieldNames[FW21_DATE], vFields);
-	tmpIdx = getColIndex(m_vFieldNames[FW21_TEMPF], vFields);
-	rhIdx = getColIndex(m_vFieldNames[FW21_RH], vFields);
-	pcpIdx = getColIndex(m_vFieldNames[FW21_PCPIN], vFields);
-	wsIdx = getColIndex(m_vFieldNames[FW21_WSMPH], vFields);
-	wdirIdx = getColIndex(m_vFieldNames[FW21_WAZI], vFields);
-	srIdx = getColIndex(m_vFieldNames[FW21_SOLRAD], vFields);
-	snowIdx = getColIndex(m_vFieldNames[FW21_SNOWFLAG], vFields);
-	gsIdx = getColIndex(m_vFieldNames[FW21_GSMPH], vFields);
-	gdirIdx = getColIndex(m_vFieldNames[FW21_GAZI], vFields);
-	tmpCIdx = getColIndex(m_vFieldNames[FW21_TEMPC], vFields);
-	pcpmmIdx = getColIndex(m_vFieldNames[FW21_PCPMM], vFields);
-	wsKphIdx = getColIndex(m_vFieldNames[FW21_WSKPH], vFields);
-	gsKphIdx = getColIndex(m_vFieldNames[FW21_GSKPH], vFields);
-	fm1Idx = getColIndex(m_vFieldNames[FW21_DFM1], vFields);
-	fm10Idx = getColIndex(m_vFieldNames[FW21_DFM10], vFields);
-	fm100Idx = getColIndex(m_vFieldNames[FW21_DFM100], vFields);
-	fm1000Idx = getColIndex(m_vFieldNames[FW21_DFM1000], vFields);
-	fmHerbIdx = getColIndex(m_vFieldNames[FW21_LFMHERB], vFields);
-	fmWoodIdx = getColIndex(m_vFieldNames[FW21_LFMWOOD], vFields);
-	fuelTempIdx = getColIndex(m_vFieldNames[FW21_FUELTEMPC], vFields);
-	biIdx = getColIndex(m_vFieldNames[FW21_BI], vFields);
-	ercIdx = getColIndex(m_vFieldNames[FW21_ERC], vFields);
-	scIdx = getColIndex(m_vFieldNames[FW21_SC], vFields);
-	icIdx = getColIndex(m_vFieldNames[FW21_IC], vFields);
-	gsiIdx = getColIndex(m_vFieldNames[FW21_GSI], vFields);
-	kbdiIdx = getColIndex(m_vFieldNames[FW21_KBDI], vFields);
-
-	bool hasStationID = false;
-	if (staIdx >= 0)
-		hasStationID = true;
-	string strStation, strDate, strTemp, strRH, strPcp, strWindSpeed, strWDir, strSolRad, strSnow, strGustSpeed, strGustDir;
-	//basic check for required fields
-	if (dtIdx < 0 || (tmpIdx < 0 && tmpCIdx < 0) || rhIdx < 0 || (pcpIdx < 0 && pcpmmIdx < 0) || (wsIdx < 0 && wsKphIdx < 0) 
-		|| wdirIdx < 0 || srIdx < 0 || snowIdx < 0)
+	string_view lineView;
+	s->moreLines = s->reader.NextLine(lineView);
+	int status = ParseHeader(s, string(lineView), needMxFields, NULL);
+	if (status != 0)
 	{
-		//if(staIdx < 0)
-		//	printf("Error, field %s not found in header\n", m_vFieldNames[FW21_STATION].c_str());
-		if (dtIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_DATE].c_str());
-		if (tmpIdx < 0 && tmpCIdx < 0)
-			printf("Error, field %s or %s not found in header\n", m_vFieldNames[FW21_TEMPF].c_str(), m_vFieldNames[FW21_TEMPC].c_str());
-		if (rhIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_RH].c_str());
-		if (pcpIdx < 0 && pcpmmIdx < 0)
-			printf("Error, field %s or %s not found in header\n", m_vFieldNames[FW21_PCPIN].c_str(), m_vFieldNames[FW21_PCPMM].c_str());
-		if (wsIdx < 0 && wsKphIdx < 0)
-			printf("Error, field %s or %s not found in header\n", m_vFieldNames[FW21_WSMPH].c_str(), m_vFieldNames[FW21_WSKPH].c_str());
-		if (wdirIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_WAZI].c_str());
-		if (srIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_SOLRAD].c_str());
-		if (snowIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_SNOWFLAG].c_str());
-		printf("Header line is:\n%s\n", buf);
-		stream.close();
-		return -2;
+		delete s;
+		return status;
+	}
+	s->station = station;
+	s->anyStation = false;
+	s->needMxFields = needMxFields;
+	s->lineNo = 2;
+	s->firstRec = true;
+	s->useRanges = false;
+	s->nextRange = 0;
+	s->linesLeft = 0;
+	s->nextRow = s->endRow = 0;
+	if (m_pStationIndex && s->colIdx[FW21_STATION] >= 0)
+	{
+		const vector<FW21StationRange>* ranges = m_pStationIndex->GetRanges(station);
+		s->useRanges = true;
+		if (ranges)
+			s->ranges = *ranges;
+	}
+	//a station's line ranges are usually small, they are read sequentially
+	s->numThreads = s->useRanges ? 1 : m_numThreads;
+	s->batchPos = 0;
+	m_pStream = s;
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Prepares to parse single csv lines of any station with ParseLine(),
+    for records that arrive one at a time instead of in a file.
+    \param[in] header The FW21 csv header line naming the fields of the lines.
+    \param[in] tzOffsetHours Offset applied to Zulu times.
+    \param[in] needMxFields Also require and read the moisture, GSI and KBDI fields.
+    \param[out] messages Errors are appended here, or printed if NULL.
+    \return 0 on success, or the OpenStream() header error codes.
+ */
+int CFW21Data::OpenLineParser(const std::string& header, int tzOffsetHours/* = 0*/, bool needMxFields/* = false*/, std::string* messages/* = NULL*/)
+{
+	CloseStream();
+	m_timeZoneOffset = tzOffsetHours;
+	m_fileName = "";
+	FW21StreamState* s = new FW21StreamState;
+	int status = ParseHeader(s, header, needMxFields, messages);
+	if (status != 0)
+	{
+		delete s;
+		return status;
 	}
-	if (needMxFields && (fm1Idx < 0 || fm10Idx < 0 || fm100Idx < 0 || fm1000Idx < 0 || fmHerbIdx < 0 
-		|| fmWoodIdx < 0 || fuelTempIdx < 0 || gsiIdx < 0))
-	{
-		if (fm1Idx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_DFM1].c_str());
-		if (fm10Idx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_DFM10].c_str());
-		if (fm100Idx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_DFM100].c_str());
-		if (fm1000Idx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_DFM1000].c_str());
-		if (fmHerbIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_LFMHERB].c_str());
-		if (fmWoodIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_LFMWOOD].c_str());
-		if (fuelTempIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_FUELTEMPC].c_str());
-		if(gsiIdx < 0)
-			printf("Error, field %s not found in header\n", m_vFieldNames[FW21_GSI].c_str());
-		printf("Header line is:\n%s\n", buf);
-		stream.close();
+	s->anyStation = true;
+	s->needMxFields = needMxFields;
+	s->moreLines = false;
+	s->lineNo = 1;
+	s->firstRec = true;
+	s->useRanges = false;
+	s->nextRange = 0;
+	s->linesLeft = 0;
+	s->nextRow = s->endRow = 0;
+	s->numThreads = 1;
+	s->batchPos = 0;
+	m_pStream = s;
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Parses one csv line with the header given to OpenLineParser().
+    \param[in] line The line, without its newline.
+    \param[out] rec The record.
+    \param[out] messages Warnings and errors are appended here, or printed if NULL.
+    \return true if the record is acceptable.
+ */
+bool CFW21Data::ParseLine(const std::string& line, FW21Record& rec, std::string* messages/* = NULL*/)
+{
+	FW21StreamState* s = m_pStream;
+	if (!s || !s->anyStation)
+		return false;
+	int dateZulu = -1;
+	bool accepted = ParseRecordLine(s, line, ++s->lineNo, s->splitter, rec, &dateZulu, messages);
+	if (s->firstRec && dateZulu >= 0)
+	{
+		if (dateZulu)
+			m_bTimeIsZulu = true;
+		s->firstRec = false;
+	}
+	return accepted;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief OpenStream() for a .fw21b file (see CFW21BinaryFile), whose records
+    were validated when it was written.
+    \return As OpenStream(), -3 also if the file was written with a different
+    needMxFields or UTC offset.
+ */
+int CFW21Data::OpenBinaryStream(std::string station, bool needMxFields)
+{
+	FW21StreamState* s = new FW21StreamState;
+	int status = s->binary.Open(m_fileName.c_str());
+	if (status != 0)
+	{
+		if (status == -1)
+			printf("Error opening %s as input\n", m_fileName.c_str());
+		else
+			printf("Error, %s is not a valid FW21 binary file\n", m_fileName.c_str());
+		delete s;
+		return status;
+	}
+	//records were selected and converted with these settings
+	const FW21BinaryHeader* header = s->binary.GetHeader();
+	if (needMxFields != ((header->flags & FW21B_NEED_MX) != 0))
+	{
+		printf("Error, %s was written %s the moisture, GSI and KBDI fields, rewrite it with the same needMxFields\n",
+			m_fileName.c_str(), needMxFields ? "without" : "with");
+		delete s;
 		return -3;
 	}
-	//ok, ready to parse the data...
-	bool firstRec = true;
-	int lineNo = 2;
-	while (stream.good())
+	if (header->tzOffsetHours != m_timeZoneOffset)
 	{
-		stream.getline(buf, bufSize);
-		lineNo++;
-		line = buf;
-		vFields = csv_read_row(line, ',');
-		if (vFields.size() < nExpectedFields)
-		{
-			printf("Warning, line %d has less than %d fields, skipping record\n", lineNo, nExpectedFields);
+		printf("Error, %s was written with UTC offset %d, not %d, rewrite it with the same offset\n",
+			m_fileName.c_str(), (int)header->tzOffsetHours, m_timeZoneOffset);
+		delete s;
+		return -3;
+	}
+	s->station = station;
+	s->needMxFields = needMxFields;
+	s->moreLines = false;
+	s->nextRow = s->endRow = 0;
+	s->numThreads = 1;
+	s->batchPos = 0;
+	int stationNum = s->binary.FindStation(station);
+	if (stationNum >= 0)
+	{
+		const FW21BinaryStation* entry = s->binary.GetStationEntry(stationNum);
+		s->nextRow = entry->firstRow;
+		s->endRow = entry->firstRow + entry->numRows;
+		if (entry->timeIsZulu && entry->numRows > 0)
+			m_bTimeIsZulu = true;
+	}
+	m_pStream = s;
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief OpenStream() for a FW13 file (see CFW13Decoder). The file is decoded
+    whole and the station's records kept as ParseRecordLine() would read them
+    back from the FW21 file FireWxConverter writes: in time order, local time
+    with the stream's UTC offset, precipitation to 0.001 in, and the same
+    range checks.
+    \return As OpenStream(), -3 also if needMxFields since FW13 files have
+    no moisture fields.
+ */
+int CFW21Data::OpenFW13Stream(std::string station, bool needMxFields)
+{
+	if (needMxFields)
+	{
+		printf("Error, %s is a FW13 file, it has no moisture, GSI and KBDI fields\n", m_fileName.c_str());
+		return -3;
+	}
+	CFW13Decoder decoder;
+	if (decoder.DecodeFile(m_fileName) != 1)
+	{
+		printf("Error opening %s as input\n", m_fileName.c_str());
+		return -1;
+	}
+	printf("%s", decoder.GetMessages().c_str());
+	FW21StreamState* s = new FW21StreamState;
+	s->station = station;
+	s->needMxFields = false;
+	s->moreLines = false;
+	s->nextRow = s->endRow = 0;
+	s->numThreads = 1;
+	s->batchPos = 0;
+	s->fw13 = true;
+	for (auto& sta : decoder.GetStations())
+	{
+		if (sta.station.compare(station) != 0)
 			continue;
-		}
-		//added 4/26/2024 StationID is now optional, if not present all are assumed to be 'station' parameter
-		if (staIdx >= 0)
+		s->batch.reserve(sta.records.size());
+		//as AddRecord() keeps them when FireWxConverter writes the file
+		UTCTime lastUtc;
+		bool haveLast = false;
+		for (auto& rec : sta.records)
 		{
-			strStation = vFields[staIdx];
-			if (station.compare(strStation) != 0)
+			int y = rec.GetYear(), M = rec.GetMonth(), d = rec.GetDay(), h = rec.GetHour(), m = rec.GetMinutes();
+			UTCTime recUtc(y, M, d, h, m, 0);
+			if (haveLast && recUtc <= lastUtc)
+			{
+				printf("Error, %d/%d/%d %02d:%02d is not after the previous record, skipping record\n", M, d, y, h, m);
 				continue;
+			}
+			lastUtc = recUtc;
+			haveLast = true;
+			TM recTime = BuildISO8061Time(y, M, d, h, m, 0, false);
+			if (recTime.tm_mday <= 0)
+			{
+				printf("Error, date %d/%d/%d %02d:%02d is invalid, skipping record\n", M, d, y, h, m);
+				continue;
+			}
+			rec.SetDateTime(recTime);
+			rec.SetTimeZoneOffset(m_timeZoneOffset);
+			char pcp[32];
+			snprintf(pcp, sizeof(pcp), "%5.3f", rec.GetPrecip());
+			rec.SetPrecip(FW21ToDouble(FW21TrimView(pcp)));
+			const char* bad = NULL;
+			double value = 0.0;
+			if (rec.GetTemp() < -76.0 || rec.GetTemp() > 140.0)
+				bad = "Temperature(F)", value = rec.GetTemp();
+			else if (rec.GetRH() <= 0.0 || rec.GetRH() > 100.0)
+				bad = "RelativeHumidity(%)", value = rec.GetRH();
+			else if (rec.GetPrecip() < 0.0 || rec.GetPrecip() > 20.0)
+				bad = "Precipitation(in)", value = rec.GetPrecip();
+			else if (rec.GetSolarRadiation() < 0.0 || rec.GetSolarRadiation() > 2000.0)
+				bad = "SolarRadiation(W/m2)", value = rec.GetSolarRadiation();
+			if (bad)
+			{
+				printf("Error: Bad %s %.1f, DateTime: %d/%d/%d %02d:%02d\n", bad, value, M, d, y, h, m);
+				continue;
+			}
+			s->batch.push_back(std::move(rec));
 		}
-		else
-			strStation = station;
-		FW21Record thisRec;
-		thisRec.SetStation(strStation);
-		strDate = vFields[dtIdx];
-		trim(strDate);
-		if (strDate.empty())
+	}
+	m_pStream = s;
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads the next acceptable record of the open stream. Records for
+    other stations are skipped, invalid records are reported and skipped.
+    \param[out] thisRec The record.
+    \return false at the end of the file (or if no stream is open).
+ */
+bool CFW21Data::ReadRecord(FW21Record& thisRec)
+{
+	FW21StreamState* s = m_pStream;
+	if (!s)
+		return false;
+	if (s->binary.IsOpen())
+	{
+		if (s->nextRow >= s->endRow)
+			return false;
+		thisRec = FW21Record();
+		thisRec.SetStation(s->station);
+		s->binary.GetRecord(s->nextRow++, thisRec);
+		return true;
+	}
+	if (s->fw13)
+	{
+		if (s->batchPos >= s->batch.size())
+			return false;
+		thisRec = std::move(s->batch[s->batchPos++]);
+		return true;
+	}
+	if (s->numThreads > 1)
+	{
+		//records of the block parsed in parallel, in file order
+		while (s->batchPos >= s->batch.size())
 		{
-			printf("Error: DateTime is blank, line %d\n", lineNo);
-			continue;
+			if (!ParseNextBlock(s))
+				return false;
 		}
-		if (firstRec)
+		thisRec = std::move(s->batch[s->batchPos++]);
+		return true;
+	}
+	string_view lineView;
+	while (NextStreamLine(s, lineView))
+	{
+		int dateZulu = -1;
+		bool accepted = ParseRecordLine(s, lineView, ++s->lineNo, s->splitter, thisRec, &dateZulu, NULL);
+		if (s->firstRec && dateZulu >= 0)
 		{
 			//need to check for Zulu time
-			if (strDate.find('Z') != string::npos)
+			if (dateZulu)
 				m_bTimeIsZulu = true;
-			firstRec = false;
+			s->firstRec = false;
 		}
+		if (accepted)
+			return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Parses one data line of the open csv stream. Safe to call from
+    several threads at once, each with its own splitter and messages.
+    \param[in] s The stream.
+    \param[in] line The line.
+    \param[in] lineNo Its line number, for messages.
+    \param[in] splitter Row splitter of the calling thread.
+    \param[out] thisRec The record.
+    \param[out] dateZulu Set to 1 if the line's date has a 'Z', 0 if not,
+    unchanged if the line is rejected before its date is read.
+    \param[out] messages Warnings and errors are appended here, or printed if NULL.
+    \return true if the record is acceptable.
+ */
+bool CFW21Data::ParseRecordLine(const FW21StreamState* s, string_view line, int lineNo, CFW21RowSplitter& splitter,
+	FW21Record& thisRec, int* dateZulu, std::string* messages)
+{
+	const int* col = s->colIdx;
+	int nExpectedFields = s->nExpectedFields;
+	//fields are views into the line, numbers are converted in place
+	string_view strStation, strDate, strTemp, strRH, strPcp, strWindSpeed, strWDir, strSolRad, strSnow, strGustSpeed, strGustDir;
+	{
+		const vector<string_view>& vRow = splitter.Split(line, ',');
+		if (vRow.size() < (size_t)nExpectedFields)
+		{
+			Report(messages, "Warning, line %d has less than %d fields, skipping record\n", lineNo, nExpectedFields);
+			return false;
+		}
+		//added 4/26/2024 StationID is now optional, if not present all are assumed to be 'station' parameter
+		if (col[FW21_STATION] >= 0)
+		{
+			strStation = vRow[col[FW21_STATION]];
+			if (!s->anyStation && s->station.compare(strStation) != 0)
+				return false;
+		}
+		else
+			strStation = s->station;
+		thisRec = FW21Record();
+		thisRec.SetStation(string(strStation));
+		strDate = FW21TrimView(vRow[col[FW21_DATE]]);
+		if (strDate.empty())
+		{
+			Report(messages, "Error: DateTime is blank, line %d\n", lineNo);
+			return false;
+		}
+		int dateLen = (int)strDate.length();
+		//the first record's date tells if the file is in Zulu time
+		*dateZulu = strDate.find('Z') != string_view::npos ? 1 : 0;
 		int tzOffset = 0;
-		TM recTime = ParseISO8061(strDate, &tzOffset);
+		TM recTime;
+		if (!ParseISO8061Fixed(strDate.data(), strDate.length(), &recTime, &tzOffset))
+			recTime = ParseISO8061(string(strDate), &tzOffset);
 		if (recTime.tm_mon < 0 || recTime.tm_mday <= 0 || recTime.tm_hour < 0 || recTime.tm_min < 0 || recTime.tm_sec < 0)
 		{
-			printf("Error, line %d date (%s) is invalid, skipping record\n", lineNo, strDate.c_str());
-			continue;
+			Report(messages, "Error, line %d date (%.*s) is invalid, skipping record\n", lineNo, dateLen, strDate.data());
+			return false;
 		}
 		thisRec.SetDateTime(recTime);
 		thisRec.SetTimeZoneOffset(tzOffset);
-		if (tmpIdx >= 0)//use Fahrenheit if present
+		if (col[FW21_TEMPF] >= 0)//use Fahrenheit if present
 		{
-			strTemp = vFields[tmpIdx];
-			trim(strTemp);
+			strTemp = FW21TrimView(vRow[col[FW21_TEMPF]]);
 			if (!strTemp.empty())
-				thisRec.SetTemp(atof(strTemp.c_str()));
+				thisRec.SetTemp(FW21ToDouble(strTemp));
 		}
-		else if (tmpCIdx >= 0)
+		else
 		{
-			strTemp = vFields[tmpCIdx];
-			trim(strTemp);
+			strTemp = FW21TrimView(vRow[col[FW21_TEMPC]]);
 			if (!strTemp.empty())
-				thisRec.SetTemp(atof(strTemp.c_str()) * 1.8 + 32.0);
+				thisRec.SetTemp(FW21ToDouble(strTemp) * 1.8 + 32.0);
 		}
-		else
-			strTemp.clear();
-		strRH = vFields[rhIdx];
-		trim(strRH);
+		strRH = FW21TrimView(vRow[col[FW21_RH]]);
 		if (!strRH.empty())
-			thisRec.SetRH(max(atof(strRH.c_str()), 1.0));
-		if (pcpIdx >= 0)
+			thisRec.SetRH(max(FW21ToDouble(strRH), 1.0));
+		if (col[FW21_PCPIN] >= 0)
 		{
-			strPcp = vFields[pcpIdx];
-			trim(strPcp);
+			strPcp = FW21TrimView(vRow[col[FW21_PCPIN]]);
 			if (!strPcp.empty())
-				thisRec.SetPrecip(atof(strPcp.c_str()));
+				thisRec.SetPrecip(FW21ToDouble(strPcp));
 		}
-		else if (pcpmmIdx >= 0)
+		else
 		{
-			strPcp = vFields[pcpmmIdx];
-			trim(strPcp);
+			strPcp = FW21TrimView(vRow[col[FW21_PCPMM]]);
 			if (!strPcp.empty())
-				thisRec.SetPrecip(atof(strPcp.c_str()) / 25.4);
+				thisRec.SetPrecip(FW21ToDouble(strPcp) / 25.4);
 		}
-		else
-			strPcp.clear();
-		if (wsIdx >= 0)
+		if (col[FW21_WSMPH] >= 0)
 		{
-			strWindSpeed = vFields[wsIdx];
-			trim(strWindSpeed);
+			strWindSpeed = FW21TrimView(vRow[col[FW21_WSMPH]]);
 			if (!strWindSpeed.empty())
-				thisRec.SetWindSpeed(atof(strWindSpeed.c_str()));
+				thisRec.SetWindSpeed(FW21ToDouble(strWindSpeed));
 		}
-		else if (wsKphIdx >= 0)
+		else
 		{
-			strWindSpeed = vFields[wsKphIdx];
-			trim(strWindSpeed);
+			strWindSpeed = FW21TrimView(vRow[col[FW21_WSKPH]]);
 			if (!strWindSpeed.empty())
-				thisRec.SetWindSpeed((atof(strWindSpeed.c_str()) / 1.15) * 0.6213711922);
+				thisRec.SetWindSpeed((FW21ToDouble(strWindSpeed) / 1.15) * 0.6213711922);
 		}
-		strWDir = vFields[wdirIdx];
-		trim(strWDir);
+		strWDir = FW21TrimView(vRow[col[FW21_WAZI]]);
 		if(!strWDir.empty())
-			thisRec.SetWindAzimuth(atoi(strWDir.c_str()));
-		strSolRad = vFields[srIdx];
-		trim(strSolRad);
+			thisRec.SetWindAzimuth(FW21ToInt(strWDir));
+		strSolRad = FW21TrimView(vRow[col[FW21_SOLRAD]]);
 		if (!strSolRad.empty())
-			thisRec.SetSolarRadiation(atof(strSolRad.c_str()));
-		strSnow = vFields[snowIdx];
-		trim(strSnow);
+			thisRec.SetSolarRadiation(FW21ToDouble(strSolRad));
+		strSnow = FW21TrimView(vRow[col[FW21_SNOWFLAG]]);
 		if (!strSnow.empty())
-			thisRec.SetSnowFlag(atoi(strSnow.c_str()));
+			thisRec.SetSnowFlag(FW21ToInt(strSnow));
 		else // assume not snow covered
 			thisRec.SetSnowFlag(0);
-		if (gsIdx >= 0)
+		if (col[FW21_GSMPH] >= 0)
 		{
-			strGustSpeed = vFields[gsIdx];
-			trim(strGustSpeed);
+			strGustSpeed = FW21TrimView(vRow[col[FW21_GSMPH]]);
 			if (!strGustSpeed.empty())
-				thisRec.SetGustSpeed(atof(strGustSpeed.c_str()));
+				thisRec.SetGustSpeed(FW21ToDouble(strGustSpeed));
 		}
-		else if (gsKphIdx >= 0)
+		else if (col[FW21_GSKPH] >= 0)
 		{
-			strGustSpeed = vFields[gsKphIdx];
-			trim(strGustSpeed);
+			strGustSpeed = FW21TrimView(vRow[col[FW21_GSKPH]]);
 			if (!strGustSpeed.empty())
-				thisRec.SetGustSpeed((atof(strGustSpeed.c_str()) / 1.15) * 0.6213711922);
+				thisRec.SetGustSpeed((FW21ToDouble(strGustSpeed) / 1.15) * 0.6213711922);
 		}
-		if (gdirIdx >= 0)
+		if (col[FW21_GAZI] >= 0)
 		{
-			strGustDir = vFields[gdirIdx];
-			trim(strGustDir);
+			strGustDir = FW21TrimView(vRow[col[FW21_GAZI]]);
 			if (!strGustDir.empty())
-				thisRec.SetGustAzimuth(atoi(strGustDir.c_str()));
+				thisRec.SetGustAzimuth(FW21ToInt(strGustDir));
 		}
-		bool goodRec = true;
 		//first, check for blanks on key fields
-		if (strDate.length() <= 0)
-		{
-			printf("Error: DateTime is blank, line %d\n", lineNo);
-			continue;
-		}
 		if (strTemp.length() <= 0)
 		{
-			printf("Error: Temperature(F) is blank, line %d, DateTime: %s\n", lineNo, strDate.c_str());
-			continue;
+			Report(messages, "Error: Temperature(F) is blank, line %d, DateTime: %.*s\n", lineNo, dateLen, strDate.data());
+			return false;
 		}
 		if (strRH.length() <= 0)
 		{
-			printf("Error: RelativeHumidity(%%) is blank, line %d, DateTime: %s\n", lineNo, strDate.c_str());
-			continue;
+			Report(messages, "Error: RelativeHumidity(%%) is blank, line %d, DateTime: %.*s\n", lineNo, dateLen, strDate.data());
+			return false;
 		}
 		if (strPcp.length() <= 0)
 		{
-			printf("Error: Precipitation(in) is blank, line %d, DateTime: %s\n", lineNo, strDate.c_str());
-			continue;
+			Report(messages, "Error: Precipitation(in) is blank, line %d, DateTime: %.*s\n", lineNo, dateLen, strDate.data());
+			return false;
 		}
 		if (strSolRad.length() <= 0)
 		{
-			printf("Error: SolarRadiation(W/m2) is blank, line %d, DateTime: %s\n", lineNo, strDate.c_str());
-			continue;
+			Report(messages, "Error: SolarRadiation(W/m2) is blank, line %d, DateTime: %.*s\n", lineNo, dateLen, strDate.data());
+			return false;
 		}
 		//now some range checks
 		if (thisRec.GetTemp() < -76.0 || thisRec.GetTemp() > 140.0)
 		{
-			printf("Error: Bad Temperature(F) line %d, %.1f, DateTime: %s\n", lineNo, thisRec.GetTemp(), strDate.c_str());
-			continue;
+			Report(messages, "Error: Bad Temperature(F) line %d, %.1f, DateTime: %.*s\n", lineNo, thisRec.GetTemp(), dateLen, strDate.data());
+			return false;
 		}
 		if (thisRec.GetRH() <= 0.0 || thisRec.GetRH() > 100.0)
 		{
-			printf("Error: Bad RelativeHumidity(%%) line %d, %.1f, DateTime: %s\n", lineNo, thisRec.GetRH(), strDate.c_str());
-			continue;
+			Report(messages, "Error: Bad RelativeHumidity(%%) line %d, %.1f, DateTime: %.*s\n", lineNo, thisRec.GetRH(), dateLen, strDate.data());
+			return false;
 		}
 		if (thisRec.GetPrecip() < 0.0 || thisRec.GetPrecip() > 20.0)
 		{
-			printf("Error: Bad Precipitation(in) line %d, %.1f, DateTime: %s\n", lineNo, thisRec.GetPrecip(), strDate.c_str());
-			continue;
+			Report(messages, "Error: Bad Precipitation(in) line %d, %.1f, DateTime: %.*s\n", lineNo, thisRec.GetPrecip(), dateLen, strDate.data());
+			return false;
 		}
 		if (thisRec.GetSolarRadiation() < 0.0 || thisRec.GetSolarRadiation() > 2000.0)
 		{
-			printf("Error: Bad SolarRadiation(W/m2) line %d, %.1f, DateTime: %s\n", lineNo, thisRec.GetSolarRadiation(), strDate.c_str());
-			continue;
+			Report(messages, "Error: Bad SolarRadiation(W/m2) line %d, %.1f, DateTime: %.*s\n", lineNo, thisRec.GetSolarRadiation(), dateLen, strDate.data());
+			return false;
 		}
 		//non-fatal warnings
 		if (thisRec.GetWindSpeed() < 0.0 || thisRec.GetWindSpeed() > 99.0)
 		{
-			printf("Warning: Bad WindSpeed(mph) line %d, %.1f, DateTime: %s\n", lineNo, thisRec.GetWindSpeed(), strDate.c_str());
+			Report(messages, "Warning: Bad WindSpeed(mph) line %d, %.1f, DateTime: %.*s\n", lineNo, thisRec.GetWindSpeed(), dateLen, strDate.data());
 		}
 		if (thisRec.GetWindAzimuth() < 0 || thisRec.GetWindAzimuth() > 360)
 		{
-			printf("Warning: Bad WindAzimuth(degrees) line %d, %d, DateTime: %s\n", lineNo, thisRec.GetWindAzimuth(), strDate.c_str());
+			Report(messages, "Warning: Bad WindAzimuth(degrees) line %d, %d, DateTime: %.*s\n", lineNo, thisRec.GetWindAzimuth(), dateLen, strDate.data());
 		}
-		if (needMxFields)
+		if (s->needMxFields)
 		{
-			string fm1, fm10, fm100, fm1000, fmHerb, fmWood, gsi, fuelTemp, kbdi;
-			fm1 = vFields[fm1Idx];
-			trim(fm1);
-			if (!fm1.empty())
-				thisRec.SetMx1(atof(fm1.c_str()));
-			else
-			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_DFM1].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
-			}
-			fm10 = vFields[fm10Idx];
-			trim(fm10);
-			if (!fm10.empty())
-				thisRec.SetMx10(atof(fm10.c_str()));
-			else
-			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_DFM10].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
-			}
-			fm100 = vFields[fm100Idx];
-			trim(fm100);
-			if (!fm100.empty())
-				thisRec.SetMx100(atof(fm100.c_str()));
-			else
-			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_DFM100].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
-			}
-			fm1000 = vFields[fm1000Idx];
-			trim(fm1000);
-			if (!fm1000.empty())
-				thisRec.SetMx1000(atof(fm1000.c_str()));
-			else
-			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_DFM1000].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
-			}
-			fmHerb = vFields[fmHerbIdx];
-			trim(fmHerb);
-			if (!fmHerb.empty())
-				thisRec.SetMxHerb(atof(fmHerb.c_str()));
-			else
-			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_LFMHERB].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
-			}
-			fmWood = vFields[fmWoodIdx];
-			trim(fmWood);
-			if (!fmWood.empty())
-				thisRec.SetMxWood(atof(fmWood.c_str()));
-			else
-			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_LFMWOOD].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
-			}
-			fuelTemp = vFields[fuelTempIdx];
-			trim(fuelTemp);
-			if (!fuelTemp.empty())
-				thisRec.SetFuelTempC(atof(fuelTemp.c_str()));
-			else
-			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_FUELTEMPC].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
-			}
-			gsi = vFields[gsiIdx];
-			trim(gsi);
-			if (!gsi.empty())
-				thisRec.SetGSI(atof(gsi.c_str()));
-			else
-			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_GSI].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
-			}
-			kbdi = vFields[kbdiIdx];
-			trim(kbdi);
-			if (!kbdi.empty())
-				thisRec.SetKBDI(atoi(kbdi.c_str()));
-			else
+			//moisture, GSI and KBDI fields in the order they are checked, all required
+			const FW21FIELDS mxFields[] = { FW21_DFM1, FW21_DFM10, FW21_DFM100, FW21_DFM1000, FW21_LFMHERB, FW21_LFMWOOD, FW21_FUELTEMPC, FW21_GSI, FW21_KBDI };
+			bool haveAll = true;
+			for (int f = 0; f < 9; f++)
 			{
-				printf("Error: %s is blank, line %d, DateTime:: %s\n",
-					m_vFieldNames[FW21_KBDI].c_str(),
-					lineNo,
-					strDate.c_str());
-				continue;
+				string_view val = FW21TrimView(vRow[col[mxFields[f]]]);
+				if (val.empty())
+				{
+					Report(messages, "Error: %s is blank, line %d, DateTime:: %.*s\n",
+						m_vFieldNames[mxFields[f]].c_str(),
+						lineNo,
+						dateLen, strDate.data());
+					haveAll = false;
+					break;
+				}
+				switch (mxFields[f])
+				{
+				case FW21_DFM1: thisRec.SetMx1(FW21ToDouble(val)); break;
+				case FW21_DFM10: thisRec.SetMx10(FW21ToDouble(val)); break;
+				case FW21_DFM100: thisRec.SetMx100(FW21ToDouble(val)); break;
+				case FW21_DFM1000: thisRec.SetMx1000(FW21ToDouble(val)); break;
+				case FW21_LFMHERB: thisRec.SetMxHerb(FW21ToDouble(val)); break;
+				case FW21_LFMWOOD: thisRec.SetMxWood(FW21ToDouble(val)); break;
+				case FW21_FUELTEMPC: thisRec.SetFuelTempC(FW21ToDouble(val)); break;
+				case FW21_GSI: thisRec.SetGSI(FW21ToDouble(val)); break;
+				default: thisRec.SetKBDI(FW21ToInt(val)); break;
+				}
 			}
+			if (!haveAll)
+				return false;
 		}
-		//if we got here record is acceptable
-		m_recs.push_back(thisRec);
 	}
-	stream.close();
-	return 0;
+	//if we got here record is acceptable
+	return true;
+}
+
+
+
+//------------------------------------------------------------------------------
+/*! \brief Parses the lines of one chunk of a block, see ParseNextBlock().
+ */
+void CFW21Data::ParseChunk(const FW21StreamState* s, FW21ParseChunk* chunk)
+{
+	CFW21RowSplitter splitter;
+	FW21Record thisRec;
+	const char* p = chunk->begin;
+	int lineNo = chunk->firstLineNo;
+	for (int l = 0; l < chunk->numLines; l++)
+	{
+		const char* nl = (const char*)memchr(p, '\n', chunk->end - p);
+		string_view line(p, (nl ? nl : chunk->end) - p);
+		p = nl ? nl + 1 : chunk->end;
+		//as CFW21LineReader::NextLine(), stop at an embedded nul
+		const char* nul = (const char*)memchr(line.data(), '\0', line.size());
+		if (nul)
+			line = line.substr(0, nul - line.data());
+		int dateZulu = -1;
+		if (ParseRecordLine(s, line, lineNo++, splitter, thisRec, &dateZulu, &chunk->messages))
+			chunk->recs.push_back(thisRec);
+		if (chunk->firstDateZulu < 0 && dateZulu >= 0)
+			chunk->firstDateZulu = dateZulu;
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads the next block of whole lines, splits it into one newline
+    aligned chunk per thread and parses the chunks concurrently. Records and
+    messages are then merged in file order, with the line numbers a sequential
+    read reports.
+    \return false when there are no more lines.
+ */
+bool CFW21Data::ParseNextBlock(FW21StreamState* s)
+{
+	s->batch.clear();
+	s->batchPos = 0;
+	bool isLast = false;
+	if (!s->moreLines || !s->reader.ReadBlock(s->block, s->numThreads * parseChunkBytes, &isLast))
+		return false;
+	const char* data = s->block.data();
+	const char* end = data + s->block.size();
+	//chunks end right after a newline, only the tail of the last block has none
+	vector<FW21ParseChunk> chunks(s->numThreads);
+	const char* p = data;
+	int lineNo = s->lineNo + 1;
+	bool haveTail = false;
+	for (int c = 0; c < s->numThreads; c++)
+	{
+		FW21ParseChunk& chunk = chunks[c];
+		const char* chunkEnd = end;
+		if (c < s->numThreads - 1)
+		{
+			chunkEnd = data + s->block.size() * (c + 1) / s->numThreads;
+			if (chunkEnd < p)
+				chunkEnd = p;
+			const char* nl = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+			chunkEnd = nl ? nl + 1 : end;
+		}
+		chunk.begin = p;
+		chunk.end = chunkEnd;
+		chunk.firstLineNo = lineNo;
+		chunk.numLines = 0;
+		for (const char* q = p; (q = (const char*)memchr(q, '\n', chunkEnd - q)) != NULL; q++)
+			chunk.numLines++;
+		if (isLast && chunkEnd == end && !haveTail)
+		{
+			//the last line of the file, possibly empty
+			chunk.numLines++;
+			haveTail = true;
+		}
+		chunk.firstDateZulu = -1;
+		lineNo += chunk.numLines;
+		p = chunkEnd;
+	}
+	vector<thread> workers;
+	for (int c = 1; c < s->numThreads; c++)
+	{
+		if (chunks[c].numLines > 0)
+			workers.push_back(thread(&CFW21Data::ParseChunk, this, s, &chunks[c]));
+	}
+	ParseChunk(s, &chunks[0]);
+	for (size_t w = 0; w < workers.size(); w++)
+		workers[w].join();
+	for (int c = 0; c < s->numThreads; c++)
+	{
+		FW21ParseChunk& chunk = chunks[c];
+		if (chunk.messages.size() > 0)
+			fputs(chunk.messages.c_str(), stdout);
+		if (s->firstRec && chunk.firstDateZulu >= 0)
+		{
+			if (chunk.firstDateZulu)
+				m_bTimeIsZulu = true;
+			s->firstRec = false;
+		}
+		if (s->batch.empty())
+			s->batch.swap(chunk.recs);
+		else
+			s->batch.insert(s->batch.end(), make_move_iterator(chunk.recs.begin()), make_move_iterator(chunk.recs.end()));
+	}
+	s->lineNo = lineNo - 1;
+	if (isLast)
+		s->moreLines = false;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads up to maxRecs records of the open stream.
+    \param[out] recs The records (cleared first).
+    \param[in] maxRecs Maximum number of records to read.
+    \return Number of records read, 0 at the end of the file.
+ */
+size_t CFW21Data::ReadRecords(std::vector<FW21Record>& recs, size_t maxRecs)
+{
+	recs.clear();
+	FW21Record thisRec;
+	while (recs.size() < maxRecs && ReadRecord(thisRec))
+		recs.push_back(thisRec);
+	return recs.size();
+}
+
+void CFW21Data::CloseStream()
+{
+	delete m_pStream;
+	m_pStream = NULL;
 }
 
 FW21Record CFW21Data::GetRec(size_t recNum)//zero based! valid: 0->GetNumRecs() - 1
 {
 	FW21Record ret;
-	if (recNum >= 0 && recNum < m_recs.size())
-		ret = m_recs[recNum];
+	if (recNum >= 0 && recNum < m_records.GetNumRecs())
+		m_records.Get(recNum, ret);
 	return ret;
 }
 
@@ -689,7 +1189,7 @@ const double SECS_PER_DAY = 86400.0;
 NFDRSDailyRec CFW21Data::GetNFDRSDailyRec(size_t recNum)//zero based! valid: 0->GetNumRecs() - 1
 {
 	FW21Record rec, rec2;
-	if (recNum < 0 || recNum >= m_recs.size())
+	if (recNum < 0 || recNum >= m_records.GetNumRecs())
 	{
 		NFDRSDailyRec ret;
 		return ret;
@@ -733,9 +1233,9 @@ NFDRSDailyRec CFW21Data::GetNFDRSDailyRec(size_t recNum)//zero based! valid: 0->
 
 int CFW21Data::AddRecord(FW21Record rec)
 {
-	if (m_recs.size() > 0)//ensure rec is after last record
+	if (m_records.GetNumRecs() > 0)//ensure rec is after last record
 	{
-		FW21Record lastRec = m_recs[m_recs.size() - 1];
+		FW21Record lastRec = GetRec(m_records.GetNumRecs() - 1);
 		UTCTime lastUtc(lastRec.GetYear(), lastRec.GetMonth(), lastRec.GetDay(), lastRec.GetHour(), lastRec.GetMinutes(), 0);
 		UTCTime recUtc(rec.GetYear(), rec.GetMonth(), rec.GetDay(), rec.GetHour(), rec.GetMinutes(), 0);
 		if (rec.GetStation().compare(lastRec.GetStation()) == 0 && recUtc <= lastUtc)
@@ -744,7 +1244,7 @@ int CFW21Data::AddRecord(FW21Record rec)
 			return -1;
 		}
 	}
-	m_recs.push_back(rec);
+	m_records.Add(rec);
 	return 1;
 }
 
@@ -767,36 +1267,80 @@ string FormatTM(TM in, int offsetHours)
 
 int CFW21Data::WriteFile(const char* fw21FileName, int offsetHours)
 {
-	ofstream out;
-	out.open(fw21FileName, ofstream::out | ofstream::trunc);
-	//we only output English units, so disregard metric fields
-	for (int f = FW21_STATION; f <= FW21_GAZI; f++)
+	CFW21Writer writer;
+	if (writer.Open(fw21FileName) != 1)
+		return -1;
+	for (size_t r = 0; r < m_records.GetNumRecs(); r++)
 	{
-		if(f > FW21_STATION)
-			out << ",";
-		out << m_vFieldNames[f];
+		FW21Record rec = GetRec(r);
+		writer.WriteRecord(rec, offsetHours);
 	}
-	out << "\n";
+	return writer.Close() ? 1 : -1;
+}
+
+CFW21Writer::CFW21Writer()
+{
+	m_file = NULL;
+}
 
+CFW21Writer::~CFW21Writer()
+{
+	Close();
+}
 
-	for (vector<FW21Record>::iterator it = m_recs.begin(); it != m_recs.end(); ++it)
+//------------------------------------------------------------------------------
+/*! \brief Opens a FW21 file for writing.
+    \param[in] fw21FileName File to write.
+    \param[in] append Add records to the end of an existing file instead of
+    truncating it and writing the header.
+    \return 1 on success, -1 if the file cannot be opened.
+ */
+int CFW21Writer::Open(const char* fw21FileName, bool append)
+{
+	Close();
+	m_file = fopen(fw21FileName, append ? "ab" : "wb");
+	if (!m_file)
+		return -1;
+	m_buffer.resize(1 << 20);
+	setvbuf(m_file, &m_buffer[0], _IOFBF, m_buffer.size());
+	if (!append)
 	{
-		FW21Record rec = *it;
-		out << rec.GetStation() << ",";
-		string dateStr = FormatTM(rec.GetDateTime(), offsetHours);
-		out << dateStr << ",";
-		
-		out << std::fixed << std::setw(1) << std::setprecision(0) << rec.GetTemp() << ",";
-		out << std::fixed << std::setw(1) << std::setprecision(0) << rec.GetRH() << ",";
-		out << std::fixed << std::setw(5) << std::setprecision(3) << rec.GetPrecip() << ",";
-		out << std::fixed << std::setw(1) << std::setprecision(0) << rec.GetWindSpeed() << ",";
-		out << rec.GetWindAzimuth() << ",";
-		out << std::fixed << std::setw(1) << std::setprecision(0) << rec.GetSolarRadiation() << ",";
-		out << rec.GetSnowFlag() << ",";
-		out << std::fixed << std::setw(1) << std::setprecision(0) << rec.GetGustSpeed() << ",";
-		out << rec.GetGustAzimuth() << endl;
+		//we only output English units, so disregard metric fields
+		for (int f = CFW21Data::FW21_STATION; f <= CFW21Data::FW21_GAZI; f++)
+			fprintf(m_file, "%s%s", f > CFW21Data::FW21_STATION ? "," : "", CFW21Data::GetFieldName((CFW21Data::FW21FIELDS)f).c_str());
+		fputc('\n', m_file);
 	}
-
-	out.close();
 	return 1;
 }
+
+//------------------------------------------------------------------------------
+/*! \brief Writes one record.
+    \param[in] rec Record to write.
+    \param[in] offsetHours UTC offset written with the record's local time.
+    \return false if the file is not open or the write failed.
+ */
+bool CFW21Writer::WriteRecord(FW21Record& rec, int offsetHours)
+{
+	if (!m_file)
+		return false;
+	string dateStr = FormatTM(rec.GetDateTime(), offsetHours);
+	int n = fprintf(m_file, "%s,%s,%.0f,%.0f,%5.3f,%.0f,%d,%.0f,%d,%.0f,%d\n", rec.GetStation().c_str(), dateStr.c_str(),
+		rec.GetTemp(), rec.GetRH(), rec.GetPrecip(), rec.GetWindSpeed(), rec.GetWindAzimuth(),
+		rec.GetSolarRadiation(), rec.GetSnowFlag(), rec.GetGustSpeed(), rec.GetGustAzimuth());
+	return n > 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Flushes and closes the file.
+    \return false if any write failed.
+ */
+bool CFW21Writer::Close()
+{
+	if (!m_file)
+		return true;
+	bool ok = ferror(m_file) == 0;
+	if (fclose(m_file) != 0)
+		ok = false;
+	m_file = NULL;
+	return ok;
+}
@@ -0,0 +1,498 @@
+#include "fw21binary.h"
+#include "fw21index.h"
+#include "fw21parser.h"
+#include "csv_readrow.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const double pow10Table[] = { 1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0 };
+static const int maxScale = 6;
+
+static size_t Align8(size_t n)
+{
+	return (n + 7) & ~(size_t)7;
+}
+
+static double GetRecordValue(FW21Record& rec, int column)
+{
+	switch (column)
+	{
+	case FW21B_TZOFFSET: return rec.GetTimeZoneOffset();
+	case FW21B_TEMPF: return rec.GetTemp();
+	case FW21B_RH: return rec.GetRH();
+	case FW21B_PCPIN: return rec.GetPrecip();
+	case FW21B_WSMPH: return rec.GetWindSpeed();
+	case FW21B_WAZI: return rec.GetWindAzimuth();
+	case FW21B_SOLRAD: return rec.GetSolarRadiation();
+	case FW21B_SNOWFLAG: return rec.GetSnowFlag();
+	case FW21B_GSMPH: return rec.GetGustSpeed();
+	case FW21B_GAZI: return rec.GetGustAzimuth();
+	case FW21B_DFM1: return rec.GetMx1();
+	case FW21B_DFM10: return rec.GetMx10();
+	case FW21B_DFM100: return rec.GetMx100();
+	case FW21B_DFM1000: return rec.GetMx1000();
+	case FW21B_LFMHERB: return rec.GetMxHerb();
+	case FW21B_LFMWOOD: return rec.GetMxWood();
+	case FW21B_FUELTEMPC: return rec.GetFuelTTempC();
+	case FW21B_GSI: return rec.GetGSI();
+	case FW21B_KBDI: return rec.GetKBDI();
+	}
+	return 0.0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Picks the smallest integer encoding that gives back every value
+    bit for bit, or doubles if there is none.
+ */
+static void ChooseEncoding(const vector<double>& vals, FW21BinaryColumn& col)
+{
+	col.kind = FW21B_DOUBLE;
+	col.width = 8;
+	col.scale = 0;
+	for (int scale = 0; scale <= maxScale; scale++)
+	{
+		double p = pow10Table[scale];
+		long long minVal = 0, maxVal = 0;
+		bool ok = true;
+		for (size_t i = 0; i < vals.size() && ok; i++)
+		{
+			double scaled = vals[i] * p;
+			if (!(fabs(scaled) < 2147483647.0))
+			{
+				ok = false;
+				break;
+			}
+			long long r = llround(scaled);
+			double back = (double)r / p;
+			if (memcmp(&back, &vals[i], sizeof(double)) != 0)
+				ok = false;
+			minVal = min(minVal, r);
+			maxVal = max(maxVal, r);
+		}
+		if (ok)
+		{
+			col.kind = FW21B_INTEGER;
+			col.scale = scale;
+			if (minVal >= INT8_MIN && maxVal <= INT8_MAX)
+				col.width = 1;
+			else if (minVal >= INT16_MIN && maxVal <= INT16_MAX)
+				col.width = 2;
+			else
+				col.width = 4;
+			return;
+		}
+	}
+}
+
+static void WriteInteger(FILE* out, long long val, int width)
+{
+	int8_t v1 = (int8_t)val;
+	int16_t v2 = (int16_t)val;
+	int32_t v4 = (int32_t)val;
+	int64_t v8 = (int64_t)val;
+	switch (width)
+	{
+	case 1: fwrite(&v1, 1, 1, out); break;
+	case 2: fwrite(&v2, 2, 1, out); break;
+	case 4: fwrite(&v4, 4, 1, out); break;
+	default: fwrite(&v8, 8, 1, out); break;
+	}
+}
+
+static void WritePadding(FILE* out, size_t written)
+{
+	static const char zeros[8] = { 0 };
+	size_t pad = Align8(written) - written;
+	if (pad > 0)
+		fwrite(zeros, 1, pad, out);
+}
+
+//class CFW21BinaryFile
+CFW21BinaryFile::CFW21BinaryFile()
+{
+	m_data = NULL;
+	m_size = 0;
+	m_header = NULL;
+	m_stations = NULL;
+	m_names = NULL;
+	m_columns = NULL;
+#ifdef _WIN32
+	m_hFile = m_hMapping = NULL;
+#endif
+}
+
+CFW21BinaryFile::~CFW21BinaryFile()
+{
+	Close();
+}
+
+bool CFW21BinaryFile::IsBinaryFile(const char* fileName)
+{
+	char magic[8];
+	FILE* in = fopen(fileName, "rb");
+	if (!in)
+		return false;
+	bool isBinary = fread(magic, 1, 8, in) == 8 && memcmp(magic, FW21B_MAGIC, 8) == 0;
+	fclose(in);
+	return isBinary;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Writes the records CFW21Data::LoadFile() accepts for every station of
+    a FW21 file as a .fw21b file. Invalid records are reported as LoadFile() does.
+    \param[in] fw21FileName FW21 csv file.
+    \param[in] fw21bFileName Binary file to write (overwritten).
+    \param[in] tzOffsetHours Offset applied to Zulu times.
+    \param[in] needMxFields Require and store the moisture, GSI and KBDI fields.
+    \return 0 on success, the LoadFile() error code if the csv cannot be read,
+    -4 if the output cannot be written.
+ */
+int CFW21BinaryFile::Write(const char* fw21FileName, const char* fw21bFileName, int tzOffsetHours/* = 0*/, bool needMxFields/* = false*/)
+{
+	//without a StationID column every record belongs to the station asked for when loading
+	CFW21LineReader reader(64 * 1024);
+	if (!reader.Open(fw21FileName))
+	{
+		printf("Error opening %s as input\n", fw21FileName);
+		return -1;
+	}
+	string_view lineView;
+	reader.NextLine(lineView);
+	string line(lineView);
+	reader.Close();
+	bool hasStationID = getColIndex(CFW21Data::GetFieldName(CFW21Data::FW21_STATION), csv_read_row(line, ',')) >= 0;
+	CFW21StationIndex index;
+	vector<string> stations;
+	if (hasStationID)
+	{
+		int status = index.Build(fw21FileName);
+		if (status != 0)
+			return status;
+		for (size_t s = 0; s < index.GetNumStations(); s++)
+			stations.push_back(index.GetStation(s));
+	}
+	else
+		stations.push_back("");
+
+	int numColumns = needMxFields ? FW21B_NUM_COLUMNS : FW21B_NUM_WX_COLUMNS;
+	vector<FW21BinaryStation> stationTable(stations.size());
+	vector<long long> times;
+	vector< vector<double> > vals(numColumns);
+	FW21Record rec;
+	for (size_t s = 0; s < stations.size(); s++)
+	{
+		CFW21Data data;
+		if (hasStationID)
+			data.SetStationIndex(&index);
+		int status = data.OpenStream(fw21FileName, stations[s], tzOffsetHours, needMxFields);
+		if (status != 0)
+			return status;
+		stationTable[s].firstRow = times.size();
+		while (data.ReadRecord(rec))
+		{
+			TM recTime = rec.GetDateTime();
+			times.push_back((long long)timegm64(&recTime));
+			for (int c = FW21B_TZOFFSET; c < numColumns; c++)
+				vals[c].push_back(GetRecordValue(rec, c));
+		}
+		data.CloseStream();
+		stationTable[s].numRows = times.size() - stationTable[s].firstRow;
+		stationTable[s].timeIsZulu = data.TimeIsZulu() ? 1 : 0;
+		stationTable[s].reserved = 0;
+	}
+
+	//layout
+	FW21BinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FW21B_MAGIC, 8);
+	header.version = FW21B_VERSION;
+	header.byteOrder = FW21B_BYTEORDER;
+	header.numRecs = times.size();
+	header.numStations = (uint32_t)stations.size();
+	header.tzOffsetHours = tzOffsetHours;
+	header.flags = (hasStationID ? FW21B_HAS_STATIONID : 0) | (needMxFields ? FW21B_NEED_MX : 0);
+	header.numColumns = numColumns;
+	string names;
+	for (size_t s = 0; s < stations.size(); s++)
+	{
+		stationTable[s].nameOffset = (uint32_t)names.size();
+		stationTable[s].nameLength = (uint32_t)stations[s].size();
+		names += stations[s];
+	}
+	vector<FW21BinaryColumn> columns(numColumns);
+	bool timeInHours = true;
+	long long minTime = 0, maxTime = 0;
+	for (size_t r = 0; r < times.size(); r++)
+	{
+		if (times[r] % 3600 != 0)
+			timeInHours = false;
+	}
+	for (size_t r = 0; r < times.size(); r++)
+	{
+		long long t = timeInHours ? times[r] / 3600 : times[r];
+		minTime = (r == 0 || t < minTime) ? t : minTime;
+		maxTime = (r == 0 || t > maxTime) ? t : maxTime;
+	}
+	if (timeInHours)
+		header.flags |= FW21B_TIME_IN_HOURS;
+	columns[FW21B_TIME].kind = FW21B_INTEGER;
+	columns[FW21B_TIME].scale = 0;
+	columns[FW21B_TIME].width = (minTime >= INT32_MIN && maxTime <= INT32_MAX) ? 4 : 8;
+	for (int c = FW21B_TZOFFSET; c < numColumns; c++)
+		ChooseEncoding(vals[c], columns[c]);
+	header.stationsOffset = Align8(sizeof(FW21BinaryHeader));
+	header.namesOffset = header.stationsOffset + stations.size() * sizeof(FW21BinaryStation);
+	header.columnsOffset = Align8(header.namesOffset + names.size());
+	uint64_t offset = header.columnsOffset + numColumns * sizeof(FW21BinaryColumn);
+	for (int c = 0; c < numColumns; c++)
+	{
+		columns[c].column = c;
+		columns[c].reserved = 0;
+		columns[c].offset = offset;
+		offset = Align8(offset + header.numRecs * columns[c].width);
+	}
+	header.fileSize = offset;
+
+	FILE* out = fopen(fw21bFileName, "wb");
+	if (!out)
+	{
+		printf("Error opening %s as output.\n", fw21bFileName);
+		return -4;
+	}
+	fwrite(&header, sizeof(header), 1, out);
+	WritePadding(out, sizeof(header));
+	if (stationTable.size() > 0)
+		fwrite(stationTable.data(), sizeof(FW21BinaryStation), stationTable.size(), out);
+	fwrite(names.data(), 1, names.size(), out);
+	WritePadding(out, names.size());
+	fwrite(columns.data(), sizeof(FW21BinaryColumn), columns.size(), out);
+	for (int c = 0; c < numColumns; c++)
+	{
+		for (size_t r = 0; r < times.size(); r++)
+		{
+			if (c == FW21B_TIME)
+				WriteInteger(out, timeInHours ? times[r] / 3600 : times[r], columns[c].width);
+			else if (columns[c].kind == FW21B_DOUBLE)
+				fwrite(&vals[c][r], sizeof(double), 1, out);
+			else
+				WriteInteger(out, llround(vals[c][r] * pow10Table[columns[c].scale]), columns[c].width);
+		}
+		WritePadding(out, (size_t)header.numRecs * columns[c].width);
+	}
+	bool ok = ferror(out) == 0;
+	if (fclose(out) != 0 || !ok)
+	{
+		printf("Error writing %s\n", fw21bFileName);
+		return -4;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Maps a .fw21b file and checks its layout.
+    \return 0 on success, -1 if the file cannot be opened or mapped, -2 if it
+    is not a valid .fw21b file for this platform.
+ */
+int CFW21BinaryFile::Open(const char* fw21bFileName)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(fw21bFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return -1;
+	LARGE_INTEGER size;
+	HANDLE hMapping = NULL;
+	if (GetFileSizeEx(hFile, &size) && size.QuadPart > 0)
+		hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	void* data = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!data)
+	{
+		if (hMapping)
+			CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return -1;
+	}
+	m_hFile = hFile;
+	m_hMapping = hMapping;
+	m_size = (size_t)size.QuadPart;
+#else
+	int fd = open(fw21bFileName, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	struct stat st;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return -1;
+	m_size = (size_t)st.st_size;
+#endif
+	m_data = (const unsigned char*)data;
+
+	//check everything we will index before using it
+	const FW21BinaryHeader* header = (const FW21BinaryHeader*)m_data;
+	bool valid = m_size >= sizeof(FW21BinaryHeader)
+		&& memcmp(header->magic, FW21B_MAGIC, 8) == 0
+		&& header->version == FW21B_VERSION
+		&& header->byteOrder == FW21B_BYTEORDER
+		&& header->fileSize == m_size
+		&& (header->numColumns == (uint32_t)FW21B_NUM_COLUMNS || header->numColumns == (uint32_t)FW21B_NUM_WX_COLUMNS)
+		&& ((header->flags & FW21B_NEED_MX) != 0) == (header->numColumns == (uint32_t)FW21B_NUM_COLUMNS)
+		&& header->stationsOffset % 8 == 0 && header->columnsOffset % 8 == 0
+		&& header->stationsOffset + (uint64_t)header->numStations * sizeof(FW21BinaryStation) <= m_size
+		&& header->namesOffset <= m_size
+		&& header->columnsOffset + (uint64_t)header->numColumns * sizeof(FW21BinaryColumn) <= m_size;
+	if (valid)
+	{
+		m_header = header;
+		m_stations = (const FW21BinaryStation*)(m_data + header->stationsOffset);
+		m_names = (const char*)(m_data + header->namesOffset);
+		m_columns = (const FW21BinaryColumn*)(m_data + header->columnsOffset);
+		for (uint32_t s = 0; s < header->numStations && valid; s++)
+		{
+			valid = m_stations[s].firstRow + m_stations[s].numRows <= header->numRecs
+				&& header->namesOffset + m_stations[s].nameOffset + m_stations[s].nameLength <= m_size;
+		}
+		for (uint32_t c = 0; c < header->numColumns && valid; c++)
+		{
+			const FW21BinaryColumn& col = m_columns[c];
+			valid = col.column == c && col.offset % 8 == 0 && col.scale <= maxScale
+				&& (col.width == 1 || col.width == 2 || col.width == 4 || col.width == 8)
+				&& (col.kind == FW21B_INTEGER || (col.kind == FW21B_DOUBLE && col.width == 8))
+				&& col.offset + header->numRecs * col.width <= m_size;
+		}
+	}
+	if (!valid)
+	{
+		Close();
+		return -2;
+	}
+	return 0;
+}
+
+void CFW21BinaryFile::Close()
+{
+	if (m_data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle((HANDLE)m_hMapping);
+		CloseHandle((HANDLE)m_hFile);
+		m_hFile = m_hMapping = NULL;
+#else
+		munmap((void*)m_data, m_size);
+#endif
+	}
+	m_data = NULL;
+	m_size = 0;
+	m_header = NULL;
+	m_stations = NULL;
+	m_names = NULL;
+	m_columns = NULL;
+}
+
+string CFW21BinaryFile::GetStation(size_t s) const
+{
+	return string(m_names + m_stations[s].nameOffset, m_stations[s].nameLength);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Finds a station, any station matches file written without StationID.
+    \return Station number, -1 if not found.
+ */
+int CFW21BinaryFile::FindStation(const string& station) const
+{
+	if (!m_header)
+		return -1;
+	if (!(m_header->flags & FW21B_HAS_STATIONID))
+		return m_header->numStations > 0 ? 0 : -1;
+	for (uint32_t s = 0; s < m_header->numStations; s++)
+	{
+		if (m_stations[s].nameLength == station.size() && memcmp(m_names + m_stations[s].nameOffset, station.data(), station.size()) == 0)
+			return (int)s;
+	}
+	return -1;
+}
+
+int64_t CFW21BinaryFile::GetInteger(int column, uint64_t row) const
+{
+	const FW21BinaryColumn& col = m_columns[column];
+	const unsigned char* p = m_data + col.offset;
+	switch (col.width)
+	{
+	case 1: return ((const int8_t*)p)[row];
+	case 2: return ((const int16_t*)p)[row];
+	case 4: return ((const int32_t*)p)[row];
+	}
+	return ((const int64_t*)p)[row];
+}
+
+double CFW21BinaryFile::GetValue(int column, uint64_t row) const
+{
+	const FW21BinaryColumn& col = m_columns[column];
+	if (col.kind == FW21B_DOUBLE)
+		return ((const double*)(m_data + col.offset))[row];
+	int64_t val = GetInteger(column, row);
+	return col.scale > 0 ? (double)val / pow10Table[col.scale] : (double)val;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Fills a record from row, all fields except the station.
+    \param[in] row Zero based row.
+    \param[out] rec The record.
+ */
+void CFW21BinaryFile::GetRecord(uint64_t row, FW21Record& rec) const
+{
+	Time64_T seconds = GetInteger(FW21B_TIME, row);
+	if (m_header->flags & FW21B_TIME_IN_HOURS)
+		seconds *= 3600;
+	TM gmt;
+	gmtime64_r(&seconds, &gmt);
+	//the fields the csv parser sets
+	TM recTime = {};
+	recTime.tm_year = gmt.tm_year;
+	recTime.tm_mon = gmt.tm_mon;
+	recTime.tm_mday = gmt.tm_mday;
+	recTime.tm_hour = gmt.tm_hour;
+	recTime.tm_min = gmt.tm_min;
+	recTime.tm_sec = gmt.tm_sec;
+	recTime.tm_wday = gmt.tm_wday;
+	recTime.tm_yday = gmt.tm_yday;
+	rec.SetDateTime(recTime);
+	rec.SetTimeZoneOffset((int)GetValue(FW21B_TZOFFSET, row));
+	rec.SetTemp(GetValue(FW21B_TEMPF, row));
+	rec.SetRH(GetValue(FW21B_RH, row));
+	rec.SetPrecip(GetValue(FW21B_PCPIN, row));
+	rec.SetWindSpeed(GetValue(FW21B_WSMPH, row));
+	rec.SetWindAzimuth((int)GetValue(FW21B_WAZI, row));
+	rec.SetSolarRadiation(GetValue(FW21B_SOLRAD, row));
+	rec.SetSnowFlag((int)GetValue(FW21B_SNOWFLAG, row));
+	rec.SetGustSpeed(GetValue(FW21B_GSMPH, row));
+	rec.SetGustAzimuth((int)GetValue(FW21B_GAZI, row));
+	if (m_header->numColumns == (uint32_t)FW21B_NUM_COLUMNS)
+	{
+		rec.SetMx1(GetValue(FW21B_DFM1, row));
+		rec.SetMx10(GetValue(FW21B_DFM10, row));
+		rec.SetMx100(GetValue(FW21B_DFM100, row));
+		rec.SetMx1000(GetValue(FW21B_DFM1000, row));
+		rec.SetMxHerb(GetValue(FW21B_LFMHERB, row));
+		rec.SetMxWood(GetValue(FW21B_LFMWOOD, row));
+		rec.SetFuelTempC(GetValue(FW21B_FUELTEMPC, row));
+		rec.SetGSI(GetValue(FW21B_GSI, row));
+		rec.SetKBDI((int)GetValue(FW21B_KBDI, row));
+	}
+}
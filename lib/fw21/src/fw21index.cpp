@@ -0,0 +1,271 @@
+#include "fw21index.h"
+#include "fw21.h"
+#include "fw21parser.h"
+#include "csv_readrow.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+using namespace std;
+
+CFW21StationIndex::CFW21StationIndex()
+{
+	m_fileSize = 0;
+	m_fileTime = 0;
+}
+
+CFW21StationIndex::~CFW21StationIndex()
+{
+}
+
+void CFW21StationIndex::Clear()
+{
+	m_fileSize = 0;
+	m_fileTime = 0;
+	m_stations.clear();
+	m_ranges.clear();
+}
+
+bool CFW21StationIndex::GetFileSize(const char* fileName, unsigned long long* fileSize)
+{
+	FILE* in = fopen(fileName, "rb");
+	if (!in)
+		return false;
+#ifdef _WIN32
+	_fseeki64(in, 0, SEEK_END);
+	*fileSize = (unsigned long long)_ftelli64(in);
+#else
+	fseeko(in, 0, SEEK_END);
+	*fileSize = (unsigned long long)ftello(in);
+#endif
+	fclose(in);
+	return true;
+}
+
+bool CFW21StationIndex::GetFileTime(const char* fileName, long long* modTime)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(fileName, &st) != 0)
+		return false;
+#else
+	struct stat st;
+	if (stat(fileName, &st) != 0)
+		return false;
+#endif
+	*modTime = (long long)st.st_mtime;
+	return true;
+}
+
+//FNV-1a, ignoring a trailing '\r'
+unsigned long long CFW21StationIndex::HashLine(string_view line)
+{
+	if (!line.empty() && line.back() == '\r')
+		line.remove_suffix(1);
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < line.size(); i++)
+	{
+		hash ^= (unsigned char)line[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Checks that the first line of every range still hashes to the value
+    stored when the index was built, catching files rewritten with the same
+    size within the modification time resolution.
+    \return true if all ranges match.
+ */
+bool CFW21StationIndex::CheckRanges(const char* fw21FileName) const
+{
+	CFW21LineReader reader(64 * 1024);
+	if (!reader.Open(fw21FileName))
+		return false;
+	string_view lineView;
+	for (map<string, vector<FW21StationRange> >::const_iterator it = m_ranges.begin(); it != m_ranges.end(); ++it)
+	{
+		for (size_t r = 0; r < it->second.size(); r++)
+		{
+			const FW21StationRange& range = it->second[r];
+			if (!reader.Seek(range.offset) || !reader.NextLine(lineView) || HashLine(lineView) != range.firstLineHash)
+				return false;
+		}
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Builds the index with one pass over a FW21 file.
+    \param[in] fw21FileName FW21 file name.
+    \return 0 on success, -1 if the file cannot be opened, -2 if it has no
+    StationID column.
+ */
+int CFW21StationIndex::Build(const char* fw21FileName)
+{
+	Clear();
+	CFW21LineReader reader;
+	if (!reader.Open(fw21FileName) || !GetFileSize(fw21FileName, &m_fileSize) || !GetFileTime(fw21FileName, &m_fileTime))
+	{
+		printf("Error opening %s as input\n", fw21FileName);
+		return -1;
+	}
+	string_view lineView;
+	bool moreLines = reader.NextLine(lineView);
+	string line(lineView);
+	vector<string> vFields = csv_read_row(line, ',');
+	int staIdx = getColIndex(CFW21Data::GetFieldName(CFW21Data::FW21_STATION), vFields);
+	if (staIdx < 0)
+	{
+		printf("Error, field %s not found in header\n", CFW21Data::GetFieldName(CFW21Data::FW21_STATION).c_str());
+		printf("Header line is:\n%s\n", line.c_str());
+		return -2;
+	}
+	//same line numbering as CFW21Data::ReadRecord()
+	CFW21RowSplitter splitter;
+	FW21StationRange* current = NULL;
+	string currentStation;
+	int lineNo = 2;
+	while (moreLines && reader.NextLine(lineView))
+	{
+		lineNo++;
+		const vector<string_view>& vRow = splitter.Split(lineView, ',');
+		if (vRow.size() >= vFields.size())
+		{
+			string_view station = vRow[staIdx];
+			if (!current || station != currentStation)
+			{
+				vector<FW21StationRange>& ranges = m_ranges[string(station)];
+				if (ranges.empty())
+					m_stations.push_back(string(station));
+				FW21StationRange range = { reader.GetLineOffset(), lineNo, 0, HashLine(lineView) };
+				ranges.push_back(range);
+				current = &ranges.back();
+				currentStation = station;
+			}
+		}
+		if (current)
+			current->numLines++;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Writes the index as text: a header with the indexed file's size
+    and modification time, then one "station,offset,firstLineNo,numLines,hash"
+    line per range.
+    \return 0 on success, -1 if the file cannot be created.
+ */
+int CFW21StationIndex::Save(const char* indexFileName)
+{
+	FILE* out = fopen(indexFileName, "wt");
+	if (!out)
+	{
+		printf("Error opening %s as output.\n", indexFileName);
+		return -1;
+	}
+	fprintf(out, "FW21StationIndex,2,%llu,%lld\n", m_fileSize, m_fileTime);
+	for (size_t s = 0; s < m_stations.size(); s++)
+	{
+		const vector<FW21StationRange>& ranges = m_ranges[m_stations[s]];
+		for (size_t r = 0; r < ranges.size(); r++)
+			fprintf(out, "%s,%llu,%d,%d,%llu\n", m_stations[s].c_str(), ranges[r].offset, ranges[r].firstLineNo, ranges[r].numLines,
+				ranges[r].firstLineHash);
+	}
+	fclose(out);
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Reads an index written by Save().
+    \param[in] indexFileName Index file name.
+    \param[in] fw21FileName The indexed FW21 file, its size, modification time
+    and the first line of every range must match the index.
+    \return 0 on success, -1 if a file cannot be opened, -2 if the index is
+    invalid, -3 if it does not match fw21FileName (or was written by an older
+    version without the checks); the caller should rebuild it.
+ */
+int CFW21StationIndex::Load(const char* indexFileName, const char* fw21FileName)
+{
+	Clear();
+	unsigned long long fileSize = 0;
+	long long fileTime = 0;
+	if (!GetFileSize(fw21FileName, &fileSize) || !GetFileTime(fw21FileName, &fileTime))
+	{
+		printf("Error opening %s as input\n", fw21FileName);
+		return -1;
+	}
+	CFW21LineReader reader(64 * 1024);
+	if (!reader.Open(indexFileName))
+	{
+		printf("Error opening %s as input\n", indexFileName);
+		return -1;
+	}
+	string_view lineView;
+	int version = 0;
+	if (!reader.NextLine(lineView) || sscanf(string(lineView).c_str(), "FW21StationIndex,%d,%llu,%lld", &version, &m_fileSize, &m_fileTime) < 2)
+	{
+		printf("Error, %s is not a FW21 station index\n", indexFileName);
+		Clear();
+		return -2;
+	}
+	if (version != 2 || m_fileSize != fileSize || m_fileTime != fileTime)
+	{
+		printf("Error, %s does not match %s\n", indexFileName, fw21FileName);
+		Clear();
+		return -3;
+	}
+	while (reader.NextLine(lineView))
+	{
+		string line(lineView);
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty())
+			continue;
+		//station IDs may contain commas, the numbers are the last four fields
+		FW21StationRange range;
+		size_t c1 = line.size();
+		for (int f = 0; f < 4 && c1 != string::npos; f++)
+			c1 = c1 == 0 ? string::npos : line.rfind(',', c1 - 1);
+		if (c1 == string::npos || sscanf(line.c_str() + c1 + 1, "%llu,%d,%d,%llu", &range.offset, &range.firstLineNo, &range.numLines,
+			&range.firstLineHash) != 4)
+		{
+			printf("Error, %s is not a FW21 station index\n", indexFileName);
+			Clear();
+			return -2;
+		}
+		string station = line.substr(0, c1);
+		vector<FW21StationRange>& ranges = m_ranges[station];
+		if (ranges.empty())
+			m_stations.push_back(station);
+		ranges.push_back(range);
+	}
+	if (!CheckRanges(fw21FileName))
+	{
+		printf("Error, %s does not match %s\n", indexFileName, fw21FileName);
+		Clear();
+		return -3;
+	}
+	return 0;
+}
+
+const vector<FW21StationRange>* CFW21StationIndex::GetRanges(const string& station) const
+{
+	map<string, vector<FW21StationRange> >::const_iterator it = m_ranges.find(station);
+	if (it == m_ranges.end())
+		return NULL;
+	return &it->second;
+}
+
+int CFW21StationIndex::GetNumLines(const string& station) const
+{
+	const vector<FW21StationRange>* ranges = GetRanges(station);
+	int numLines = 0;
+	if (ranges)
+	{
+		for (size_t r = 0; r < ranges->size(); r++)
+			numLines += (*ranges)[r].numLines;
+	}
+	return numLines;
+}
@@ -0,0 +1,244 @@
+#include "fw21parser.h"
+#include "csv_readrow.h"
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+//class CFW21LineReader
+CFW21LineReader::CFW21LineReader(size_t bufferSize/* = 4 * 1024 * 1024*/)
+{
+	m_file = NULL;
+	m_buf.resize(bufferSize > 1024 ? bufferSize : 1024);
+	m_pos = m_end = 0;
+	m_bufOffset = m_lineOffset = 0;
+	m_eof = m_done = false;
+}
+
+CFW21LineReader::~CFW21LineReader()
+{
+	Close();
+}
+
+bool CFW21LineReader::Open(const char* fileName)
+{
+	Close();
+	m_file = fopen(fileName, "rb");
+	m_pos = m_end = 0;
+	m_bufOffset = m_lineOffset = 0;
+	m_eof = m_done = false;
+	return m_file != NULL;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Continues reading at offset, which must be the start of a line.
+ */
+bool CFW21LineReader::Seek(unsigned long long offset)
+{
+	if (!m_file)
+		return false;
+#ifdef _WIN32
+	int ret = _fseeki64(m_file, (long long)offset, SEEK_SET);
+#else
+	int ret = fseeko(m_file, (off_t)offset, SEEK_SET);
+#endif
+	m_pos = m_end = 0;
+	m_bufOffset = m_lineOffset = offset;
+	m_eof = m_done = false;
+	return ret == 0;
+}
+
+void CFW21LineReader::Close()
+{
+	if (m_file)
+		fclose(m_file);
+	m_file = NULL;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Moves the unread bytes to the front of the buffer (growing it if a
+    single line fills it) and reads more of the file.
+    \return false once the end of the file has been reached.
+ */
+bool CFW21LineReader::Fill()
+{
+	if (m_eof || !m_file)
+	{
+		m_eof = true;
+		return false;
+	}
+	if (m_pos > 0)
+	{
+		memmove(m_buf.data(), m_buf.data() + m_pos, m_end - m_pos);
+		m_bufOffset += m_pos;
+		m_end -= m_pos;
+		m_pos = 0;
+	}
+	if (m_end == m_buf.size())
+		m_buf.resize(m_buf.size() * 2);
+	size_t nRead = fread(m_buf.data() + m_end, 1, m_buf.size() - m_end, m_file);
+	m_end += nRead;
+	if (nRead == 0)
+		m_eof = true;
+	return nRead > 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns the next line, without its '\n'.
+    \param[out] line View of the line, valid until the next call.
+    \return false when there are no more lines.
+ */
+bool CFW21LineReader::NextLine(string_view& line)
+{
+	if (m_done)
+		return false;
+	size_t searched = m_pos;
+	while (true)
+	{
+		const char* start = m_buf.data() + m_pos;
+		const char* nl = (const char*)memchr(m_buf.data() + searched, '\n', m_end - searched);
+		if (nl)
+		{
+			line = string_view(start, nl - start);
+			m_pos = (nl - m_buf.data()) + 1;
+			break;
+		}
+		searched = m_end - m_pos;
+		if (!Fill())
+		{
+			//last line, possibly empty
+			line = string_view(m_buf.data() + m_pos, m_end - m_pos);
+			m_pos = m_end;
+			m_done = true;
+			break;
+		}
+		searched += m_pos;
+	}
+	m_lineOffset = m_bufOffset + (line.data() - m_buf.data());
+	//a line is a C string in the original reader, stop at an embedded nul
+	const char* nul = (const char*)memchr(line.data(), '\0', line.size());
+	if (nul)
+		line = line.substr(0, nul - line.data());
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns the next lines as one block of about maxBytes (more if a
+    single line is longer), so they can be split up and parsed concurrently.
+    \param[out] block Whole lines, each ending with '\n', followed at the end
+    of the file by the last line (possibly empty, as with NextLine()).
+    \param[in] maxBytes Size of the block, lines are never split.
+    \param[out] isLast Set if block holds the last line.
+    \return false when there are no more lines.
+ */
+bool CFW21LineReader::ReadBlock(vector<char>& block, size_t maxBytes, bool* isLast)
+{
+	block.clear();
+	*isLast = false;
+	if (m_done)
+		return false;
+	while (true)
+	{
+		size_t avail = m_end - m_pos;
+		if (avail < maxBytes && Fill())
+			continue;
+		const char* start = m_buf.data() + m_pos;
+		if (m_eof)
+		{
+			block.assign(start, start + avail);
+			m_pos = m_end;
+			m_done = true;
+			*isLast = true;
+			return true;
+		}
+		const char* cut = start + (avail < maxBytes ? avail : maxBytes);
+		while (cut > start && cut[-1] != '\n')
+			cut--;
+		if (cut > start)
+		{
+			block.assign(start, cut);
+			m_pos += cut - start;
+			return true;
+		}
+		//a line longer than maxBytes
+		maxBytes = avail + 1;
+	}
+}
+
+//class CFW21RowSplitter
+const vector<string_view>& CFW21RowSplitter::Split(string_view line, char delimiter/* = ','*/)
+{
+	m_fields.clear();
+	if (line.find('"') != string_view::npos)
+	{
+		m_line.assign(line.data(), line.size());
+		m_quoted = csv_read_row(m_line, delimiter);
+		for (size_t i = 0; i < m_quoted.size(); i++)
+			m_fields.push_back(m_quoted[i]);
+		return m_fields;
+	}
+	//as csv_read_row: a '\r' or (char)-1 ends the row
+	size_t fieldStart = 0;
+	for (size_t i = 0; i < line.size(); i++)
+	{
+		char c = line[i];
+		if (c == delimiter)
+		{
+			m_fields.push_back(line.substr(fieldStart, i - fieldStart));
+			fieldStart = i + 1;
+		}
+		else if (c == '\r' || c == '\n' || c == (char)-1)
+		{
+			m_fields.push_back(line.substr(fieldStart, i - fieldStart));
+			return m_fields;
+		}
+	}
+	m_fields.push_back(line.substr(fieldStart));
+	return m_fields;
+}
+
+static inline bool IsTrimSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Returns s without leading and trailing white space, as trim().
+ */
+string_view FW21TrimView(string_view s)
+{
+	size_t b = 0, e = s.size();
+	while (b < e && IsTrimSpace(s[b]))
+		b++;
+	while (e > b && IsTrimSpace(s[e - 1]))
+		e--;
+	return s.substr(b, e - b);
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Same result as atof() on a trimmed field. Plain numbers are parsed
+    with from_chars, anything else (signs, hex, trailing text) falls back to atof.
+ */
+double FW21ToDouble(string_view s)
+{
+	double val = 0.0;
+	from_chars_result res = from_chars(s.data(), s.data() + s.size(), val);
+	if (res.ec == errc() && res.ptr == s.data() + s.size())
+		return val;
+	string tmp(s);
+	return atof(tmp.c_str());
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Same result as atoi() on a trimmed field.
+ */
+int FW21ToInt(string_view s)
+{
+	int val = 0;
+	from_chars_result res = from_chars(s.data(), s.data() + s.size(), val);
+	if (res.ec == errc() && res.ptr == s.data() + s.size())
+		return val;
+	string tmp(s);
+	return atoi(tmp.c_str());
+}
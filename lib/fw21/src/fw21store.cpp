@@ -0,0 +1,301 @@
+#include "fw21store.h"
+#include "fw21.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+static const double pow10Table[] = { 1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0 };
+static const int64_t pow10Integers[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+static const int maxScale = 6;
+
+//class CFW21Column
+CFW21Column::CFW21Column()
+{
+	Clear();
+}
+
+void CFW21Column::Clear()
+{
+	vector<int16_t>().swap(m_int16);
+	vector<int32_t>().swap(m_int32);
+	vector<double>().swap(m_double);
+	m_width = 2;
+	m_scale = 0;
+	m_maxAbs = 0;
+	m_numValues = 0;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Scales value to an integer, if that converts back to exactly value.
+    \param[in] value The value.
+    \param[in] scale Power of ten.
+    \param[out] stored The integer.
+    \return false if value cannot be stored with scale.
+ */
+bool CFW21Column::Encode(double value, int scale, int64_t* stored) const
+{
+	//also rejects NaN and infinities, -0.0 would come back as 0.0
+	if (!(fabs(value) < 1.0e9) || (value == 0.0 && signbit(value)))
+		return false;
+	int64_t r = llround(value * pow10Table[scale]);
+	if ((scale > 0 ? (double)r / pow10Table[scale] : (double)r) != value)
+		return false;
+	*stored = r;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Rewrites the values with a wider type or a larger scale.
+ */
+void CFW21Column::Convert(int width, int scale)
+{
+	if (width == 8)
+	{
+		vector<double> values(m_numValues);
+		for (size_t i = 0; i < m_numValues; i++)
+			values[i] = Get(i);
+		m_double.swap(values);
+	}
+	else
+	{
+		int64_t mult = pow10Integers[scale - m_scale];
+		if (width == 4)
+		{
+			vector<int32_t> values(m_numValues);
+			for (size_t i = 0; i < m_numValues; i++)
+				values[i] = (int32_t)((m_width == 2 ? m_int16[i] : m_int32[i]) * mult);
+			m_int32.swap(values);
+		}
+		else
+		{
+			for (size_t i = 0; i < m_numValues; i++)
+				m_int16[i] = (int16_t)(m_int16[i] * mult);
+		}
+	}
+	if (width != 2)
+		vector<int16_t>().swap(m_int16);
+	if (width != 4)
+		vector<int32_t>().swap(m_int32);
+	m_width = width;
+	m_scale = scale;
+}
+
+void CFW21Column::Push(double value)
+{
+	if (m_width == 8)
+	{
+		m_double.push_back(value);
+		m_numValues++;
+		return;
+	}
+	int64_t stored = 0;
+	int scale = m_scale;
+	while (scale <= maxScale && !Encode(value, scale, &stored))
+		scale++;
+	int64_t maxAbs = 0;
+	int width = 8;
+	if (scale <= maxScale)
+	{
+		maxAbs = m_maxAbs * pow10Integers[scale - m_scale];
+		maxAbs = max(maxAbs, (int64_t)llabs(stored));
+		width = maxAbs > INT32_MAX ? 8 : (maxAbs > INT16_MAX ? 4 : 2);
+	}
+	if (width != m_width || (width != 8 && scale != m_scale))
+		Convert(width, width == 8 ? m_scale : scale);
+	if (width == 8)
+		m_double.push_back(value);
+	else if (width == 4)
+		m_int32.push_back((int32_t)stored);
+	else
+		m_int16.push_back((int16_t)stored);
+	m_maxAbs = maxAbs;
+	m_numValues++;
+}
+
+double CFW21Column::Get(size_t i) const
+{
+	if (m_width == 8)
+		return m_double[i];
+	int64_t r = m_width == 2 ? m_int16[i] : m_int32[i];
+	return m_scale > 0 ? (double)r / pow10Table[m_scale] : (double)r;
+}
+
+size_t CFW21Column::GetMemoryUsage() const
+{
+	return m_int16.capacity() * sizeof(int16_t) + m_int32.capacity() * sizeof(int32_t) + m_double.capacity() * sizeof(double);
+}
+
+//class CFW21RecordStore
+CFW21RecordStore::CFW21RecordStore()
+{
+	m_hasMx = false;
+}
+
+void CFW21RecordStore::Clear()
+{
+	m_stations.clear();
+	m_stationIds.clear();
+	m_stationRuns.clear();
+	m_time.Clear();
+	m_otherTimes.clear();
+	m_tzOffset.Clear();
+	m_temp.Clear();
+	m_RH.Clear();
+	m_pcp.Clear();
+	m_windSpeed.Clear();
+	m_windAzimuth.Clear();
+	m_solarRadiation.Clear();
+	m_snowFlag.Clear();
+	m_gustSpeed.Clear();
+	m_gustAzimuth.Clear();
+	m_hasMx = false;
+	for (int m = 0; m < MX_END; m++)
+		m_mx[m].Clear();
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Converts seconds since 1970 back to the TM the csv parser builds.
+ */
+static TM SecondsToTM(Time64_T seconds)
+{
+	TM gmt;
+	gmtime64_r(&seconds, &gmt);
+	TM recTime = {};
+	recTime.tm_year = gmt.tm_year;
+	recTime.tm_mon = gmt.tm_mon;
+	recTime.tm_mday = gmt.tm_mday;
+	recTime.tm_hour = gmt.tm_hour;
+	recTime.tm_min = gmt.tm_min;
+	recTime.tm_sec = gmt.tm_sec;
+	recTime.tm_wday = gmt.tm_wday;
+	recTime.tm_yday = gmt.tm_yday;
+	return recTime;
+}
+
+//date and time fields only: tm_wday, tm_yday and tm_isdst are derived (or left
+//unset by UTCTime::get_tm()), so they do not decide whether a TM round trips
+static bool SameTM(const TM& a, const TM& b)
+{
+	return a.tm_year == b.tm_year && a.tm_mon == b.tm_mon && a.tm_mday == b.tm_mday && a.tm_hour == b.tm_hour
+		&& a.tm_min == b.tm_min && a.tm_sec == b.tm_sec;
+}
+
+void CFW21RecordStore::Add(FW21Record& rec)
+{
+	size_t row = GetNumRecs();
+	string station = rec.GetStation();
+	if (m_stationRuns.empty() || m_stations[m_stationRuns.back().second] != station)
+	{
+		map<string, uint32_t>::iterator it = m_stationIds.find(station);
+		if (it == m_stationIds.end())
+		{
+			it = m_stationIds.insert(make_pair(station, (uint32_t)m_stations.size())).first;
+			m_stations.push_back(station);
+		}
+		m_stationRuns.push_back(make_pair(row, it->second));
+	}
+	TM recTime = rec.GetDateTime();
+	Time64_T seconds = timegm64(&recTime);
+	if (SameTM(SecondsToTM(seconds), recTime))
+		m_time.Push(seconds / 3600.0);
+	else
+	{
+		m_otherTimes[row] = recTime;
+		m_time.Push(0.0);
+	}
+	m_tzOffset.Push(rec.GetTimeZoneOffset());
+	m_temp.Push(rec.GetTemp());
+	m_RH.Push(rec.GetRH());
+	m_pcp.Push(rec.GetPrecip());
+	m_windSpeed.Push(rec.GetWindSpeed());
+	m_windAzimuth.Push(rec.GetWindAzimuth());
+	m_solarRadiation.Push(rec.GetSolarRadiation());
+	m_snowFlag.Push(rec.GetSnowFlag());
+	m_gustSpeed.Push(rec.GetGustSpeed());
+	m_gustAzimuth.Push(rec.GetGustAzimuth());
+	double mx[MX_END] = { rec.GetMx1(), rec.GetMx10(), rec.GetMx100(), rec.GetMx1000(), rec.GetMxHerb(), rec.GetMxWood(),
+		rec.GetFuelTTempC(), rec.GetGSI(), (double)rec.GetKBDI() };
+	if (!m_hasMx)
+	{
+		for (int m = 0; m < MX_END && !m_hasMx; m++)
+			m_hasMx = mx[m] != (m == MX_KBDI ? iNODATA : dNODATA);
+		if (!m_hasMx)
+			return;
+		//earlier records had none
+		for (int m = 0; m < MX_END; m++)
+		{
+			for (size_t r = 0; r < row; r++)
+				m_mx[m].Push(m == MX_KBDI ? iNODATA : dNODATA);
+		}
+	}
+	for (int m = 0; m < MX_END; m++)
+		m_mx[m].Push(mx[m]);
+}
+
+const string& CFW21RecordStore::GetStation(size_t row) const
+{
+	//last run starting at or before row
+	vector<pair<size_t, uint32_t> >::const_iterator it = upper_bound(m_stationRuns.begin(), m_stationRuns.end(),
+		make_pair(row, (uint32_t)UINT32_MAX));
+	return m_stations[(it - 1)->second];
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Fills rec with a stored record.
+    \param[in] row Zero based row, less than GetNumRecs().
+    \param[out] rec The record.
+ */
+void CFW21RecordStore::Get(size_t row, FW21Record& rec) const
+{
+	rec = FW21Record();
+	rec.SetStation(GetStation(row));
+	map<size_t, TM>::const_iterator other = m_otherTimes.empty() ? m_otherTimes.end() : m_otherTimes.find(row);
+	if (other != m_otherTimes.end())
+		rec.SetDateTime(other->second);
+	else
+		rec.SetDateTime(SecondsToTM((Time64_T)llround(m_time.Get(row) * 3600.0)));
+	rec.SetTimeZoneOffset((int)m_tzOffset.Get(row));
+	rec.SetTemp(m_temp.Get(row));
+	rec.SetRH(m_RH.Get(row));
+	rec.SetPrecip(m_pcp.Get(row));
+	rec.SetWindSpeed(m_windSpeed.Get(row));
+	rec.SetWindAzimuth((int)m_windAzimuth.Get(row));
+	rec.SetSolarRadiation(m_solarRadiation.Get(row));
+	rec.SetSnowFlag((int)m_snowFlag.Get(row));
+	rec.SetGustSpeed(m_gustSpeed.Get(row));
+	rec.SetGustAzimuth((int)m_gustAzimuth.Get(row));
+	if (m_hasMx)
+	{
+		rec.SetMx1(m_mx[MX_DFM1].Get(row));
+		rec.SetMx10(m_mx[MX_DFM10].Get(row));
+		rec.SetMx100(m_mx[MX_DFM100].Get(row));
+		rec.SetMx1000(m_mx[MX_DFM1000].Get(row));
+		rec.SetMxHerb(m_mx[MX_LFMHERB].Get(row));
+		rec.SetMxWood(m_mx[MX_LFMWOOD].Get(row));
+		rec.SetFuelTempC(m_mx[MX_FUELTEMPC].Get(row));
+		rec.SetGSI(m_mx[MX_GSI].Get(row));
+		rec.SetKBDI((int)m_mx[MX_KBDI].Get(row));
+	}
+}
+
+//------------------------------------------------------------------------------
+/*! \brief Approximate heap and object bytes used by the stored records.
+ */
+size_t CFW21RecordStore::GetMemoryUsage() const
+{
+	const CFW21Column* columns[] = { &m_time, &m_tzOffset, &m_temp, &m_RH, &m_pcp, &m_windSpeed, &m_windAzimuth,
+		&m_solarRadiation, &m_snowFlag, &m_gustSpeed, &m_gustAzimuth };
+	size_t bytes = sizeof(*this);
+	for (size_t c = 0; c < sizeof(columns) / sizeof(columns[0]); c++)
+		bytes += columns[c]->GetMemoryUsage();
+	for (int m = 0; m < MX_END; m++)
+		bytes += m_mx[m].GetMemoryUsage();
+	//map nodes are about four pointers plus the value
+	for (size_t s = 0; s < m_stations.size(); s++)
+		bytes += 2 * (sizeof(string) + m_stations[s].capacity()) + 4 * sizeof(void*) + sizeof(uint32_t);
+	bytes += m_stationRuns.capacity() * sizeof(m_stationRuns[0]);
+	bytes += m_otherTimes.size() * (4 * sizeof(void*) + sizeof(size_t) + sizeof(TM));
+	return bytes;
+}
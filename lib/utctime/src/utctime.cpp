@@ -45,7 +45,8 @@ UTCTime::UTCTime() :
         throw bad_time_init();
     }
 
-    TM* ptm = gmtime64(&m_timestamp);
+    TM ptm_buf;
+    TM* ptm = gmtime64_r(&m_timestamp, &ptm_buf);
     if ( ptm == 0 ) {
         throw bad_time_init();
     }
@@ -148,7 +149,8 @@ TM UTCTime::get_tm() const {
  */
 
 std::string UTCTime::time_string() const {
-    TM* utc_tm = gmtime64(&m_timestamp);
+    TM utc_tm_buf;
+    TM* utc_tm = gmtime64_r(&m_timestamp, &utc_tm_buf);
     if ( utc_tm == 0 ) {
         throw bad_time();
     }
@@ -168,7 +170,8 @@ std::string UTCTime::time_string() const {
  */
 
 std::string UTCTime::time_string_inet() const {
-    TM* utc_tm = gmtime64(&m_timestamp);
+    TM utc_tm_buf;
+    TM* utc_tm = gmtime64_r(&m_timestamp, &utc_tm_buf);
     if ( utc_tm == 0 ) {
         throw bad_time();
     }
@@ -285,7 +288,8 @@ bool utctime::check_utc_timestamp(const Time64_T check_time, int& secs_diff,
                                   const int year, const int month,
                                   const int day, const int hour,
                                   const int minute, const int second) {
-    TM* ptm = gmtime64(&check_time);
+    TM ptm_buf;
+    TM* ptm = gmtime64_r(&check_time, &ptm_buf);
     if ( ptm == 0 ) {
         throw bad_time();
     }
@@ -1003,7 +1007,8 @@ int utctime::get_utc_timestamp_sec_diff(const Time64_T check_time,
     //  Get a struct tm representing UTC time for the provided
     //  timestamp.
 
-    TM* ptm = gmtime64(&check_time);
+    TM ptm_buf;
+    TM* ptm = gmtime64_r(&check_time, &ptm_buf);
     if ( ptm == 0 ) {
         throw bad_time();
     }
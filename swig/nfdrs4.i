@@ -8,6 +8,9 @@
 #include "../lib/NFDRS4/include/deadfuelmoisture.h"
 %}
 %{
+#include "../lib/NFDRS4/include/slidingwindow.h"
+%}
+%{
 #include "../lib/NFDRS4/include/livefuelmoisture.h"
 %}
 %{
@@ -20,6 +23,9 @@
 #include "../lib/NFDRS4/include/nfdrs4calcstate.h"
 %}
 %{
+#include "../lib/NFDRS4/include/nfdrs4timeline.h"
+%}
+%{
 #include "../lib/utctime/include/utctime.h"
 %}
 %include typemaps.i
@@ -72,10 +78,12 @@ typedef long time_t;
 #endif
 
 %include "../lib/NFDRS4/include/deadfuelmoisture.h"
+%include "../lib/NFDRS4/include/slidingwindow.h"
 %include "../lib/NFDRS4/include/livefuelmoisture.h"
 %include "../lib/NFDRS4/include/dfmcalcstate.h"
 %include "../lib/NFDRS4/include/lfmcalcstate.h"
 %include "../lib/NFDRS4/include/nfdrs4calcstate.h"
 //%include "../lib/NFDRS4/include/station.h"
 %include "../lib/NFDRS4/include/nfdrs4.h"
+%include "../lib/NFDRS4/include/nfdrs4timeline.h"
 %include "../lib/utctime/include/utctime.h"